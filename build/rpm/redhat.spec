@@ -268,6 +268,7 @@ BuildRequires: procps autoconf bison flex
 BuildRequires: avahi-devel
 BuildRequires: xz-devel
 BuildRequires: zlib-devel
+BuildRequires: libzstd-devel
 %if !%{disable_python2}
 %if 0%{?default_python} != 3
 BuildRequires: python%{?default_python}-devel
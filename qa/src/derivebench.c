@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Derived metrics with binary operators over metrics with many
+ * instances ... exercises the compiled binary operator evaluation
+ * in derive_fetch.c for each of the arithmetic types, with type
+ * promotion, constant operands and the relational and boolean
+ * operators.
+ *
+ * The archive is expected to have been created by "interpbench -c",
+ * and is replayed in interpolation mode.  Without -t every value
+ * returned is reported, with -t only the cost per fetch.
+ *
+ * Setting PCP_DERIVED_NOCOMPILE in the environment selects the
+ * value-at-a-time evaluation, and the output should be the same.
+ *
+ * Usage: derivebench [-t] archive
+ */
+
+#include <pcp/pmapi.h>
+#include <sys/time.h>
+
+static int	timing;
+
+static struct {
+    const char	*name;
+    const char	*expr;
+} metrics[] = {
+    { "bench.d.add32",		"bench.counter.u32 + bench.counter.i32" },
+    { "bench.d.sub64",		"bench.counter.u64 - bench.counter.i64" },
+    { "bench.d.mul64",		"bench.instant.u64 * bench.discrete.u32" },
+    { "bench.d.mixfloat",	"bench.counter.float + bench.counter.i32" },
+    { "bench.d.mixdouble",	"bench.counter.double - bench.counter.u64" },
+    { "bench.d.div",		"bench.instant.double / bench.instant.u64" },
+    { "bench.d.plus",		"bench.instant.u64 + 1000" },
+    { "bench.d.const",		"3 * bench.instant.u64" },
+    { "bench.d.nested",		"(bench.instant.u64 + bench.discrete.u32) * 2 - bench.instant.double" },
+    { "bench.d.lt",		"bench.counter.u32 < bench.counter.i32" },
+    { "bench.d.geq",		"bench.counter.float >= bench.counter.i64" },
+    { "bench.d.eq",		"bench.discrete.u32 == 1" },
+    { "bench.d.neq",		"bench.instant.double != bench.instant.u64" },
+    { "bench.d.and",		"bench.instant.u64 > 1000 && bench.instant.double < 50" },
+    { "bench.d.or",		"bench.counter.i64 < 0 || bench.discrete.u32 > 1" },
+};
+#define NMETRIC (sizeof(metrics) / sizeof(metrics[0]))
+
+static double
+now(void)
+{
+    struct timeval	tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + (double)tv.tv_usec / 1000000;
+}
+
+static void
+replay(const char *archive)
+{
+    pmID		pmids[NMETRIC];
+    pmDesc		desc[NMETRIC];
+    const char		*names[NMETRIC];
+    pmResult		*rp;
+    pmValueSet		*vsp;
+    pmLogLabel		label;
+    struct timeval	start;
+    double		t0, elapsed;
+    long		nvalues = 0;
+    int			nfetch = 0;
+    int			ctx;
+    int			i, m, sts;
+
+    if ((ctx = pmNewContext(PM_CONTEXT_ARCHIVE, archive)) < 0) {
+	fprintf(stderr, "%s: %s: %s\n", pmGetProgname(), archive, pmErrStr(ctx));
+	exit(1);
+    }
+    for (m = 0; m < NMETRIC; m++)
+	names[m] = metrics[m].name;
+    if ((sts = pmLookupName(NMETRIC, names, pmids)) < 0) {
+	fprintf(stderr, "%s: pmLookupName: %s\n", pmGetProgname(), pmErrStr(sts));
+	exit(1);
+    }
+    for (m = 0; m < NMETRIC; m++) {
+	if ((sts = pmLookupDesc(pmids[m], &desc[m])) < 0) {
+	    fprintf(stderr, "%s: pmLookupDesc: %s: %s\n", pmGetProgname(), names[m], pmErrStr(sts));
+	    exit(1);
+	}
+    }
+    if ((sts = pmGetArchiveLabel(&label)) < 0) {
+	fprintf(stderr, "%s: pmGetArchiveLabel: %s\n", pmGetProgname(), pmErrStr(sts));
+	exit(1);
+    }
+    start = label.ll_start;
+    start.tv_usec += 100000;
+    /* 3.7 sec steps, so mostly between records */
+    if ((sts = pmSetMode(PM_MODE_INTERP, &start, 3700)) < 0) {
+	fprintf(stderr, "%s: pmSetMode: %s\n", pmGetProgname(), pmErrStr(sts));
+	exit(1);
+    }
+
+    t0 = now();
+    for ( ; ; ) {
+	if ((sts = pmFetch(NMETRIC, pmids, &rp)) < 0)
+	    break;
+	nfetch++;
+	for (m = 0; m < rp->numpmid; m++) {
+	    vsp = rp->vset[m];
+	    if (vsp->numval > 0)
+		nvalues += vsp->numval;
+	    if (timing)
+		continue;
+	    printf("fetch %d %s:", nfetch, metrics[m].name);
+	    if (vsp->numval < 0)
+		printf(" %s", pmErrStr(vsp->numval));
+	    for (i = 0; i < vsp->numval; i++) {
+		printf(" [%d]", vsp->vlist[i].inst);
+		pmPrintValue(stdout, vsp->valfmt, desc[m].type, &vsp->vlist[i], 1);
+	    }
+	    putchar('\n');
+	}
+	pmFreeResult(rp);
+    }
+    elapsed = now() - t0;
+    if (sts != PM_ERR_EOL) {
+	fprintf(stderr, "%s: pmFetch: %s\n", pmGetProgname(), pmErrStr(sts));
+	exit(1);
+    }
+    if (timing)
+	printf("%d fetches, %ld values, %.1f usec per fetch, %.1f nsec per value\n",
+		nfetch, nvalues, elapsed * 1e6 / nfetch,
+		nvalues ? elapsed * 1e9 / nvalues : 0);
+    else
+	printf("%d fetches, %ld values\n", nfetch, nvalues);
+    pmDestroyContext(ctx);
+}
+
+int
+main(int argc, char **argv)
+{
+    int		c, m;
+    char	*errmsg;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "t")) != EOF) {
+	switch (c) {
+	case 't':
+	    timing = 1;
+	    break;
+	default:
+	    optind = argc;
+	    break;
+	}
+    }
+    if (optind != argc - 1) {
+	fprintf(stderr, "Usage: %s [-t] archive\n", pmGetProgname());
+	exit(1);
+    }
+
+    for (m = 0; m < NMETRIC; m++) {
+	if (pmRegisterDerivedMetric(metrics[m].name, metrics[m].expr, &errmsg) < 0) {
+	    fprintf(stderr, "%s: %s: %s", pmGetProgname(), metrics[m].name, errmsg);
+	    free(errmsg);
+	    exit(1);
+	}
+    }
+    replay(argv[optind]);
+
+    exit(0);
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Common subexpressions shared between derived metrics ... fetch a
+ * set of derived metrics with common operands and subexpressions in
+ * one context, and each of the metrics alone in a context of its own
+ * (where nothing is shared), checking the values are the same.
+ *
+ * Every second fetch in the shared context is for the first metric
+ * only, so rate(), delta() and instant() histories that must not be shared
+ * between metrics are exercised.
+ *
+ * The archive is expected to have been created by "interpbench -c".
+ *
+ * Usage: derivecse archive
+ */
+
+#include <pcp/pmapi.h>
+
+static struct {
+    const char	*name;
+    const char	*expr;
+} metrics[] = {
+    { "cse.a",	"delta(bench.counter.u64) + bench.instant.u64" },
+    { "cse.b",	"delta(bench.counter.u64) * 2" },
+    { "cse.c",	"(bench.instant.u64 + bench.discrete.u32) * 2" },
+    { "cse.d",	"bench.instant.u64 + bench.discrete.u32 > 5" },
+    { "cse.e",	"delta(bench.counter.u64) > 0 && delta(bench.counter.u64) < 1000000" },
+    { "cse.f",	"rate(bench.counter.u64) + rate(bench.counter.u64)" },
+    { "cse.g",	"instant(bench.counter.u64) - instant(bench.counter.u64) + delta(bench.counter.u64)" },
+};
+#define NMETRIC (sizeof(metrics) / sizeof(metrics[0]))
+
+static void
+newcontext(const char *archive, struct timeval *start)
+{
+    int		sts;
+
+    if ((sts = pmNewContext(PM_CONTEXT_ARCHIVE, archive)) < 0) {
+	fprintf(stderr, "%s: %s: %s\n", pmGetProgname(), archive, pmErrStr(sts));
+	exit(1);
+    }
+    /* 3.7 sec steps, so mostly between records */
+    if (start != NULL && (sts = pmSetMode(PM_MODE_INTERP, start, 3700)) < 0) {
+	fprintf(stderr, "%s: pmSetMode: %s\n", pmGetProgname(), pmErrStr(sts));
+	exit(1);
+    }
+}
+
+static int
+compare(int step, int m, pmDesc *desc, pmValueSet *vsp, pmValueSet *xvsp)
+{
+    pmAtomValue	a, x;
+    int		i;
+
+    if (vsp->numval != xvsp->numval) {
+	printf("step %d %s: numval %d, alone %d\n", step, metrics[m].name,
+		vsp->numval, xvsp->numval);
+	return 1;
+    }
+    for (i = 0; i < vsp->numval; i++) {
+	pmExtractValue(vsp->valfmt, &vsp->vlist[i], desc->type, &a, PM_TYPE_DOUBLE);
+	pmExtractValue(xvsp->valfmt, &xvsp->vlist[i], desc->type, &x, PM_TYPE_DOUBLE);
+	if (vsp->vlist[i].inst != xvsp->vlist[i].inst || a.d != x.d) {
+	    printf("step %d %s: [%d] %g, alone [%d] %g\n", step, metrics[m].name,
+		    vsp->vlist[i].inst, a.d, xvsp->vlist[i].inst, x.d);
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    const char		*names[NMETRIC];
+    const char		*other = "bench.instant.u64";
+    pmID		pmids[NMETRIC];
+    pmID		otherid;
+    pmDesc		desc[NMETRIC];
+    pmLogLabel		label;
+    struct timeval	start;
+    pmResult		*rp, *xp;
+    char		*errmsg;
+    int			ctx[NMETRIC+1];
+    int			nvalues = 0;
+    int			ndiffer = 0;
+    int			step, numpmid;
+    int			i, m, sts;
+
+    pmSetProgname(argv[0]);
+    if (argc != 2) {
+	fprintf(stderr, "Usage: %s archive\n", pmGetProgname());
+	exit(1);
+    }
+
+    for (m = 0; m < NMETRIC; m++) {
+	if (pmRegisterDerivedMetric(metrics[m].name, metrics[m].expr, &errmsg) < 0) {
+	    fprintf(stderr, "%s: %s: %s", pmGetProgname(), metrics[m].name, errmsg);
+	    free(errmsg);
+	    exit(1);
+	}
+	names[m] = metrics[m].name;
+    }
+
+    /* ctx[NMETRIC] shares, ctx[m] is for metric m alone */
+    newcontext(argv[1], NULL);
+    if ((sts = pmGetArchiveLabel(&label)) < 0) {
+	fprintf(stderr, "%s: pmGetArchiveLabel: %s\n", pmGetProgname(), pmErrStr(sts));
+	exit(1);
+    }
+    start = label.ll_start;
+    start.tv_usec += 100000;
+    if ((sts = pmLookupName(NMETRIC, names, pmids)) < 0 ||
+	(sts = pmLookupName(1, &other, &otherid)) < 0) {
+	fprintf(stderr, "%s: pmLookupName: %s\n", pmGetProgname(), pmErrStr(sts));
+	exit(1);
+    }
+    for (m = 0; m < NMETRIC; m++) {
+	if ((sts = pmLookupDesc(pmids[m], &desc[m])) < 0) {
+	    fprintf(stderr, "%s: pmLookupDesc: %s: %s\n", pmGetProgname(), names[m], pmErrStr(sts));
+	    exit(1);
+	}
+    }
+    pmDestroyContext(pmWhichContext());
+    for (m = 0; m <= NMETRIC; m++) {
+	newcontext(argv[1], &start);
+	ctx[m] = pmWhichContext();
+    }
+
+    for (step = 0; ; step++) {
+	numpmid = (step & 1) ? 1 : NMETRIC;
+	pmUseContext(ctx[NMETRIC]);
+	if ((sts = pmFetch(numpmid, pmids, &rp)) < 0)
+	    break;
+	for (m = 0; m < NMETRIC; m++) {
+	    pmUseContext(ctx[m]);
+	    if (m >= numpmid) {
+		/* keep in step with the shared context */
+		if ((sts = pmFetch(1, &otherid, &xp)) >= 0)
+		    pmFreeResult(xp);
+		continue;
+	    }
+	    if ((sts = pmFetch(1, &pmids[m], &xp)) < 0) {
+		printf("step %d %s: alone: %s\n", step, names[m], pmErrStr(sts));
+		ndiffer++;
+		continue;
+	    }
+	    ndiffer += compare(step, m, &desc[m], rp->vset[m], xp->vset[0]);
+	    if (rp->vset[m]->numval > 0)
+		nvalues += rp->vset[m]->numval;
+	    pmFreeResult(xp);
+	}
+	pmFreeResult(rp);
+    }
+    if (sts != PM_ERR_EOL) {
+	fprintf(stderr, "%s: pmFetch: %s\n", pmGetProgname(), pmErrStr(sts));
+	exit(1);
+    }
+    printf("%d fetches, %d values, %d differ\n", step, nvalues, ndiffer);
+
+    for (i = 0; i <= NMETRIC; i++)
+	pmDestroyContext(ctx[i]);
+
+    exit(0);
+}
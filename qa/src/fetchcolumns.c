@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * pmExtendFetchGroup_columns ... fetch the numeric metrics of an
+ * archive created by "interpbench -c" as columns of doubles and of
+ * 64-bit integers, with rate, instant and unit conversion, and check
+ * every value against the same metrics fetched with
+ * pmExtendFetchGroup_indom in the same fetchgroup.
+ *
+ * With -t, time fetchgroups with only columns or only indom items
+ * for the same metrics instead, reporting the cost per fetch.
+ *
+ * With -h, make the same checks for the given metrics (which must
+ * share an instance domain) fetched from pmcd on host instead, for
+ * samples fetches delta msec apart.  PMDAs need not return instances
+ * in increasing order, which the indom items pass through unchanged
+ * and the columns must not depend on.
+ *
+ * Usage: fetchcolumns [-t] [-m maxinst] archive
+ *        fetchcolumns -h host [-d delta] [-m maxinst] [-s samples] metric ...
+ */
+
+#include <pcp/pmapi.h>
+#include <math.h>
+#include <sys/time.h>
+
+static const char *bnames[] = {
+    "bench.counter.u32", "bench.counter.i32", "bench.counter.u64",
+    "bench.counter.i64", "bench.counter.float", "bench.counter.double",
+    "bench.instant.double", "bench.instant.u64", "bench.discrete.u32",
+};
+#define NBENCH (sizeof(bnames) / sizeof(bnames[0]))
+
+/* default (rate for counters), none and unit conversions */
+static const char *bdscales[NBENCH] = {
+    NULL, NULL, "count x 10^3 / sec", NULL, "count / min", NULL,
+    NULL, "count x 10^-2", NULL,
+};
+static const char *biscales[NBENCH] = {
+    "instant", "instant", "instant", "instant", "instant", "instant",
+    "instant", "instant", "instant",
+};
+
+static const char	**names = bnames;
+static const char	**dscales = bdscales;
+static const char	**iscales = biscales;
+static unsigned int	nmetric = NBENCH;
+
+static unsigned int	maxinst = 64;
+static char		*host;
+static int		samples = 5;
+static int		delta;
+
+static double
+now(void)
+{
+    struct timeval	tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + (double)tv.tv_usec / 1000000;
+}
+
+static pmFG
+newgroup(const char *archive)
+{
+    pmLogLabel		label;
+    struct timeval	start;
+    pmFG		fg;
+    int			sts;
+
+    if (host != NULL) {
+	if ((sts = pmCreateFetchGroup(&fg, PM_CONTEXT_HOST, host)) < 0) {
+	    fprintf(stderr, "%s: %s: %s\n", pmGetProgname(), host, pmErrStr(sts));
+	    exit(1);
+	}
+	return fg;
+    }
+    if ((sts = pmCreateFetchGroup(&fg, PM_CONTEXT_ARCHIVE, archive)) < 0) {
+	fprintf(stderr, "%s: %s: %s\n", pmGetProgname(), archive, pmErrStr(sts));
+	exit(1);
+    }
+    if ((sts = pmGetArchiveLabel(&label)) < 0) {
+	fprintf(stderr, "%s: pmGetArchiveLabel: %s\n", pmGetProgname(), pmErrStr(sts));
+	exit(1);
+    }
+    start = label.ll_start;
+    start.tv_usec += 100000;
+    /* 3.7 sec steps, so mostly between records */
+    if ((sts = pmSetMode(PM_MODE_INTERP, &start, 3700)) < 0) {
+	fprintf(stderr, "%s: pmSetMode: %s\n", pmGetProgname(), pmErrStr(sts));
+	exit(1);
+    }
+    return fg;
+}
+
+static void
+check(int sts, const char *what)
+{
+    if (sts < 0) {
+	fprintf(stderr, "%s: %s: %s\n", pmGetProgname(), what, pmErrStr(sts));
+	exit(1);
+    }
+}
+
+static int
+differ(double a, double b)
+{
+    if (isnan(a) || isnan(b))
+	return !(isnan(a) && isnan(b));
+    return fabs(a - b) > 1e-9 * (fabs(a) > 1 ? fabs(a) : 1);
+}
+
+static void
+compare(const char *archive)
+{
+    pmFG		fg = newgroup(archive);
+    double		*dvalues = calloc(nmetric * maxinst, sizeof(double));
+    __int64_t		*ivalues = calloc(nmetric * maxinst, sizeof(__int64_t));
+    int			*dstss = calloc(nmetric * maxinst, sizeof(int));
+    int			*istss = calloc(nmetric * maxinst, sizeof(int));
+    int			*codes = calloc(maxinst, sizeof(int));
+    char		**inames = calloc(maxinst, sizeof(char *));
+    pmAtomValue		*dxvalues = calloc(nmetric * maxinst, sizeof(pmAtomValue));
+    pmAtomValue		*ixvalues = calloc(nmetric * maxinst, sizeof(pmAtomValue));
+    int			*dxstss = calloc(nmetric * maxinst, sizeof(int));
+    int			*ixstss = calloc(nmetric * maxinst, sizeof(int));
+    int			*xcodes = calloc(nmetric * maxinst, sizeof(int));
+    char		**xnames = calloc(nmetric * maxinst, sizeof(char *));
+    unsigned int	*xnum = calloc(nmetric, sizeof(unsigned int));
+    unsigned int	numrows, inumrows;
+    int			sts, dsts, ists;
+    int			nfetch = 0, nvalues = 0, ndiffer = 0;
+    unsigned int	j, k, m, n;
+
+    if (!dvalues || !ivalues || !dstss || !istss || !codes || !inames ||
+	!dxvalues || !ixvalues || !dxstss || !ixstss || !xcodes || !xnames ||
+	!xnum) {
+	perror("calloc");
+	exit(1);
+    }
+
+    check(pmExtendFetchGroup_columns(fg, nmetric, names, dscales, codes,
+		inames, dvalues, PM_TYPE_DOUBLE, dstss, maxinst, &numrows,
+		&dsts), "columns double");
+    check(pmExtendFetchGroup_columns(fg, nmetric, names, iscales, NULL,
+		NULL, ivalues, PM_TYPE_64, istss, maxinst, &inumrows,
+		&ists), "columns int64");
+    for (m = 0; m < nmetric; m++) {
+	check(pmExtendFetchGroup_indom(fg, names[m], dscales[m],
+		&xcodes[m * maxinst], &xnames[m * maxinst],
+		&dxvalues[m * maxinst], PM_TYPE_DOUBLE, &dxstss[m * maxinst],
+		maxinst, &xnum[m], NULL), names[m]);
+	check(pmExtendFetchGroup_indom(fg, names[m], iscales[m], NULL, NULL,
+		&ixvalues[m * maxinst], PM_TYPE_64, &ixstss[m * maxinst],
+		maxinst, NULL, NULL), names[m]);
+    }
+
+    for ( ; ; ) {
+	if (host != NULL && nfetch == samples) {
+	    sts = PM_ERR_EOL;
+	    break;
+	}
+	if (host != NULL && nfetch > 0 && delta > 0)
+	    usleep(delta * 1000);
+	if ((sts = pmFetchGroup(fg)) < 0)
+	    break;
+	nfetch++;
+	if (dsts < 0 || ists < 0 || numrows != inumrows) {
+	    printf("fetch %d: %u and %u rows, %s", nfetch, numrows, inumrows,
+		    pmErrStr(dsts));
+	    printf(" and %s\n", pmErrStr(ists));
+	    ndiffer++;
+	    continue;
+	}
+	for (j = 1; j < numrows; j++) {
+	    if (codes[j] <= codes[j-1]) {
+		printf("fetch %d: row %u instance %d after %d\n",
+			nfetch, j, codes[j], codes[j-1]);
+		ndiffer++;
+	    }
+	}
+	for (m = 0; m < nmetric; m++) {
+	    /*
+	     * indom items only report the instances that have values,
+	     * in the order of the value set, not necessarily sorted
+	     */
+	    for (j = n = 0; j < numrows; j++) {
+		size_t	c = m * maxinst + j;
+		size_t	x = m * maxinst;
+
+		for (k = 0; k < xnum[m]; k++, x++) {
+		    if (xcodes[x] == codes[j])
+			break;
+		}
+		if (k < xnum[m]) {
+		    if (xnames[x] != inames[j] ||
+			dxstss[x] != dstss[c] || ixstss[x] != istss[c] ||
+			(dstss[c] == 0 && differ(dxvalues[x].d, dvalues[c])) ||
+			(istss[c] == 0 && ixvalues[x].ll != ivalues[c])) {
+			printf("fetch %d %s[%d]: %d %.17g %d %lld, indom %d %.17g %d %lld\n",
+				nfetch, names[m], codes[j],
+				dstss[c], dvalues[c], istss[c], (long long)ivalues[c],
+				dxstss[x], dxvalues[x].d, ixstss[x], (long long)ixvalues[x].ll);
+			ndiffer++;
+		    }
+		    if (dstss[c] == 0)
+			nvalues++;
+		    n++;
+		}
+		else if (dstss[c] != PM_ERR_VALUE || istss[c] != PM_ERR_VALUE ||
+			 !isnan(dvalues[c]) || ivalues[c] != -1) {
+		    printf("fetch %d %s[%d]: no value, got %d %g %d %lld\n",
+			    nfetch, names[m], codes[j],
+			    dstss[c], dvalues[c], istss[c], (long long)ivalues[c]);
+		    ndiffer++;
+		}
+	    }
+	    if (n != xnum[m]) {
+		printf("fetch %d %s: %u of %u indom values in rows\n",
+			nfetch, names[m], n, xnum[m]);
+		ndiffer++;
+	    }
+	}
+    }
+    if (sts != PM_ERR_EOL) {
+	fprintf(stderr, "%s: pmFetchGroup: %s\n", pmGetProgname(), pmErrStr(sts));
+	exit(1);
+    }
+    if (host != NULL)	/* live values come and go */
+	printf("%d fetches, %d differ\n", nfetch, ndiffer);
+    else
+	printf("%d fetches, %d values, %d differ\n", nfetch, nvalues, ndiffer);
+
+    pmDestroyFetchGroup(fg);
+    free(dvalues); free(ivalues); free(dstss); free(istss);
+    free(codes); free(inames);
+    free(dxvalues); free(ixvalues); free(dxstss); free(ixstss);
+    free(xcodes); free(xnames); free(xnum);
+}
+
+static void
+timing(const char *archive)
+{
+    pmFG		cfg = newgroup(archive);
+    pmFG		ifg = newgroup(archive);
+    double		*values = calloc(nmetric * maxinst, sizeof(double));
+    pmAtomValue		*xvalues = calloc(nmetric * maxinst, sizeof(pmAtomValue));
+    int			*codes = calloc(maxinst, sizeof(int));
+    int			*xcodes = calloc(nmetric * maxinst, sizeof(int));
+    double		t0, ct = 0, it = 0;
+    unsigned int	numrows, nrows = 0, m;
+    int			nfetch = 0;
+    int			csts, ists;
+
+    if (!values || !xvalues || !codes || !xcodes) {
+	perror("calloc");
+	exit(1);
+    }
+    check(pmExtendFetchGroup_columns(cfg, nmetric, names, dscales, codes,
+		NULL, values, PM_TYPE_DOUBLE, NULL, maxinst, &numrows, NULL),
+		"columns");
+    for (m = 0; m < nmetric; m++)
+	check(pmExtendFetchGroup_indom(ifg, names[m], dscales[m],
+		&xcodes[m * maxinst], NULL, &xvalues[m * maxinst],
+		PM_TYPE_DOUBLE, NULL, maxinst, NULL, NULL), names[m]);
+
+    for ( ; ; ) {
+	t0 = now();
+	csts = pmFetchGroup(cfg);
+	ct += now() - t0;
+	t0 = now();
+	ists = pmFetchGroup(ifg);
+	it += now() - t0;
+	if (csts < 0 || ists < 0)
+	    break;
+	nfetch++;
+	if (numrows > nrows)
+	    nrows = numrows;
+    }
+    if (csts != PM_ERR_EOL || ists != PM_ERR_EOL) {
+	fprintf(stderr, "%s: pmFetchGroup: %s\n", pmGetProgname(),
+		pmErrStr(csts != PM_ERR_EOL ? csts : ists));
+	exit(1);
+    }
+    printf("%d fetches, up to %u rows\n", nfetch, nrows);
+    printf("columns: %.1f usec per fetch\n", ct * 1e6 / nfetch);
+    printf("indom: %.1f usec per fetch\n", it * 1e6 / nfetch);
+
+    pmDestroyFetchGroup(cfg);
+    pmDestroyFetchGroup(ifg);
+    free(values); free(xvalues); free(codes); free(xcodes);
+}
+
+int
+main(int argc, char **argv)
+{
+    unsigned int	m;
+    int			c, tflag = 0;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "d:h:m:s:t")) != EOF) {
+	switch (c) {
+	case 'd':
+	    delta = atoi(optarg);
+	    break;
+	case 'h':
+	    host = optarg;
+	    break;
+	case 'm':
+	    maxinst = atoi(optarg);
+	    break;
+	case 's':
+	    samples = atoi(optarg);
+	    break;
+	case 't':
+	    tflag = 1;
+	    break;
+	default:
+	    optind = argc;
+	    break;
+	}
+    }
+    if ((host == NULL && optind != argc - 1) ||
+	(host != NULL && (optind == argc || tflag || samples < 1)) ||
+	maxinst == 0) {
+	fprintf(stderr, "Usage: %s [-t] [-m maxinst] archive\n", pmGetProgname());
+	fprintf(stderr, "       %s -h host [-d delta] [-m maxinst] [-s samples] metric ...\n", pmGetProgname());
+	exit(1);
+    }
+
+    if (host != NULL) {
+	/* rate (for counters) and instant */
+	nmetric = argc - optind;
+	names = (const char **)&argv[optind];
+	if ((dscales = calloc(nmetric, sizeof(char *))) == NULL ||
+	    (iscales = calloc(nmetric, sizeof(char *))) == NULL) {
+	    perror("calloc");
+	    exit(1);
+	}
+	for (m = 0; m < nmetric; m++)
+	    iscales[m] = "instant";
+	compare(NULL);
+    }
+    else if (tflag)
+	timing(argv[optind]);
+    else
+	compare(argv[optind]);
+
+    exit(0);
+}
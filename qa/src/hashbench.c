@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Compare the chained __pmHash* and open-addressing __pmFlatHash*
+ * tables from libpcp ... first for correctness (same set of entries
+ * visible after a mix of adds and deletes, and via both walkers),
+ * then optionally for speed with -t.
+ *
+ * Usage: hashbench [-t] [-n nkeys] [-s seed]
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+#include <sys/time.h>
+
+static int	nkeys = 10000;
+static int	timing;
+static int	errors;
+
+static double
+now(void)
+{
+    struct timeval	tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + (double)tv.tv_usec / 1000000;
+}
+
+/*
+ * PMID-like keys ... domain in the high bits and small cluster/item
+ * values, which is the case that stresses a simple modulo hash.
+ */
+static unsigned int
+mkkey(int i)
+{
+    return (60 << 22) | ((i / 1024) << 10) | (i % 1024);
+}
+
+static __pmHashWalkState
+count_cb(const __pmFlatHashNode *np, void *arg)
+{
+    int		*countp = (int *)arg;
+
+    if ((unsigned int)(__psint_t)np->data != np->key + 1) {
+	fprintf(stderr, "WalkCB: key %u bad data %u\n",
+		np->key, (unsigned int)(__psint_t)np->data);
+	errors++;
+    }
+    (*countp)++;
+    return PM_HASH_WALK_NEXT;
+}
+
+static __pmHashWalkState
+oddkey_cb(const __pmFlatHashNode *np, void *arg)
+{
+    (void)arg;
+    return (np->key & 1) ? PM_HASH_WALK_DELETE_NEXT : PM_HASH_WALK_NEXT;
+}
+
+static void
+check(void)
+{
+    __pmHashCtl		chain = { 0 };
+    __pmFlatHashCtl	flat = { 0 };
+    __pmFlatHashNode	*fp;
+    __pmHashNode	*hp;
+    unsigned int	key;
+    int			i, count;
+
+    for (i = 0; i < nkeys; i++) {
+	key = mkkey(i);
+	__pmHashAdd(key, (void *)(__psint_t)(key + 1), &chain);
+	__pmFlatHashAdd(key, (void *)(__psint_t)(key + 1), &flat);
+    }
+    if (chain.nodes != flat.nodes) {
+	printf("after add: chained %d nodes, flat %d nodes\n", chain.nodes, flat.nodes);
+	errors++;
+    }
+
+    /* delete every third key via __pmFlatHashDel during a walk */
+    count = 0;
+    for (fp = __pmFlatHashWalk(&flat, PM_HASH_WALK_START);
+	 fp != NULL;
+	 fp = __pmFlatHashWalk(&flat, PM_HASH_WALK_NEXT)) {
+	count++;
+	if (fp->key % 3 == 0)
+	    __pmFlatHashDel(fp->key, fp->data, &flat);
+    }
+    if (count != nkeys) {
+	printf("walk with delete: visited %d of %d nodes\n", count, nkeys);
+	errors++;
+    }
+    for (i = 0; i < nkeys; i++) {
+	key = mkkey(i);
+	if (key % 3 == 0)
+	    __pmHashDel(key, (void *)(__psint_t)(key + 1), &chain);
+    }
+
+    /* delete odd keys via __pmFlatHashWalkCB */
+    __pmFlatHashWalkCB(oddkey_cb, NULL, &flat);
+    for (i = 0; i < nkeys; i++) {
+	key = mkkey(i);
+	if (key & 1)
+	    __pmHashDel(key, (void *)(__psint_t)(key + 1), &chain);
+    }
+
+    if (chain.nodes != flat.nodes) {
+	printf("after delete: chained %d nodes, flat %d nodes\n", chain.nodes, flat.nodes);
+	errors++;
+    }
+    for (i = 0; i < nkeys; i++) {
+	key = mkkey(i);
+	hp = __pmHashSearch(key, &chain);
+	fp = __pmFlatHashSearch(key, &flat);
+	if ((hp == NULL) != (fp == NULL)) {
+	    printf("key %u: chained %s, flat %s\n", key,
+		    hp ? "found" : "missing", fp ? "found" : "missing");
+	    errors++;
+	}
+	else if (fp != NULL && fp->data != hp->data) {
+	    printf("key %u: data mismatch\n", key);
+	    errors++;
+	}
+    }
+    count = 0;
+    __pmFlatHashWalkCB(count_cb, &count, &flat);
+    if (count != flat.nodes) {
+	printf("WalkCB: visited %d of %d nodes\n", count, flat.nodes);
+	errors++;
+    }
+
+    __pmHashFree(&chain);
+    __pmFlatHashFree(&flat);
+    printf("%d keys: %s\n", nkeys, errors ? "FAILED" : "OK");
+}
+
+static void
+bench(void)
+{
+    __pmHashCtl		chain = { 0 };
+    __pmFlatHashCtl	flat = { 0 };
+    __pmHashNode	*hp;
+    __pmFlatHashNode	*fp;
+    unsigned int	key, *keys;
+    double		start, add[2], hit[2], miss[2];
+    long		found[2] = { 0, 0 };
+    int			i;
+
+    /* random lookup order, so neither table benefits from locality */
+    if ((keys = (unsigned int *)malloc(nkeys * sizeof(*keys))) == NULL) {
+	perror("malloc");
+	exit(1);
+    }
+    for (i = 0; i < nkeys; i++)
+	keys[i] = mkkey(i);
+    for (i = nkeys - 1; i > 0; i--) {
+	int		j = lrand48() % (i + 1);
+
+	key = keys[i];
+	keys[i] = keys[j];
+	keys[j] = key;
+    }
+
+    start = now();
+    for (i = 0; i < nkeys; i++)
+	__pmHashAdd(keys[i], (void *)(__psint_t)keys[i], &chain);
+    add[0] = now() - start;
+    start = now();
+    for (i = 0; i < nkeys; i++)
+	__pmFlatHashAdd(keys[i], (void *)(__psint_t)keys[i], &flat);
+    add[1] = now() - start;
+
+    start = now();
+    for (i = nkeys - 1; i >= 0; i--)
+	if ((hp = __pmHashSearch(keys[i], &chain)) != NULL)
+	    found[0]++;
+    hit[0] = now() - start;
+    start = now();
+    for (i = nkeys - 1; i >= 0; i--)
+	if ((fp = __pmFlatHashSearch(keys[i], &flat)) != NULL)
+	    found[1]++;
+    hit[1] = now() - start;
+
+    start = now();
+    for (i = 0; i < nkeys; i++)
+	if ((hp = __pmHashSearch(keys[i] ^ (1 << 21), &chain)) != NULL)
+	    found[0]++;
+    miss[0] = now() - start;
+    start = now();
+    for (i = 0; i < nkeys; i++)
+	if ((fp = __pmFlatHashSearch(keys[i] ^ (1 << 21), &flat)) != NULL)
+	    found[1]++;
+    miss[1] = now() - start;
+
+    printf("%-8s %10s %10s %10s   (ns per op, %d keys)\n",
+	    "table", "add", "hit", "miss", nkeys);
+    printf("%-8s %10.1f %10.1f %10.1f\n", "chained",
+	    add[0] * 1e9 / nkeys, hit[0] * 1e9 / nkeys, miss[0] * 1e9 / nkeys);
+    printf("%-8s %10.1f %10.1f %10.1f\n", "flat",
+	    add[1] * 1e9 / nkeys, hit[1] * 1e9 / nkeys, miss[1] * 1e9 / nkeys);
+    if (found[0] != found[1]) {
+	printf("lookups disagree: chained %ld flat %ld\n", found[0], found[1]);
+	errors++;
+    }
+
+    __pmHashFree(&chain);
+    __pmFlatHashFree(&flat);
+    free(keys);
+}
+
+int
+main(int argc, char **argv)
+{
+    int		c;
+    long	seed = 42;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "n:s:t")) != EOF) {
+	switch (c) {
+	case 'n':
+	    nkeys = atoi(optarg);
+	    break;
+	case 's':
+	    seed = atol(optarg);
+	    break;
+	case 't':
+	    timing = 1;
+	    break;
+	default:
+	    fprintf(stderr, "Usage: %s [-t] [-n nkeys] [-s seed]\n", pmGetProgname());
+	    exit(1);
+	}
+    }
+    if (nkeys < 1) {
+	fprintf(stderr, "%s: bad key count\n", pmGetProgname());
+	exit(1);
+    }
+    srand48(seed);
+
+    if (timing)
+	bench();
+    else
+	check();
+
+    exit(errors ? 1 : 0);
+}
@@ -0,0 +1,349 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Interpolated replay of metrics with many instances ... exercises
+ * the batched result construction in __pmLogFetchInterp for each of
+ * the arithmetic types and semantics.
+ *
+ * With -c, first create the archive (using libpcp_import) with ninst
+ * instances per metric and nrec records, then replay it in interpolation
+ * mode.  Without -t every value returned is reported, with -t only
+ * the cost per fetch.
+ *
+ * With -C, replay the archive in nctx contexts in lock step, checking
+ * that every context sees the same values, and report the use made
+ * of the archive record cache shared between the contexts.
+ *
+ * With -d (and -c), each metric is also missing some instances that
+ * the other metrics have, so their instances are disjoint.
+ *
+ * Usage: interpbench [-cdt] [-C nctx] [-i ninst] [-n nrec] [-s seed] archive
+ */
+
+#include <pcp/pmapi.h>
+#include <pcp/libpcp.h>
+#include <pcp/import.h>
+#include <limits.h>
+#include <sys/time.h>
+
+static int	ninst = 10;
+static int	nrec = 10;
+static int	timing;
+static int	nctx = 1;
+static int	disjoint;
+
+static struct {
+    const char	*name;
+    int		type;
+    int		sem;
+} metrics[] = {
+    { "bench.counter.u32",	PM_TYPE_U32,	PM_SEM_COUNTER },
+    { "bench.counter.i32",	PM_TYPE_32,	PM_SEM_COUNTER },
+    { "bench.counter.u64",	PM_TYPE_U64,	PM_SEM_COUNTER },
+    { "bench.counter.i64",	PM_TYPE_64,	PM_SEM_COUNTER },
+    { "bench.counter.float",	PM_TYPE_FLOAT,	PM_SEM_COUNTER },
+    { "bench.counter.double",	PM_TYPE_DOUBLE,	PM_SEM_COUNTER },
+    { "bench.instant.double",	PM_TYPE_DOUBLE,	PM_SEM_INSTANT },
+    { "bench.instant.u64",	PM_TYPE_U64,	PM_SEM_INSTANT },
+    { "bench.discrete.u32",	PM_TYPE_U32,	PM_SEM_DISCRETE },
+    { "bench.discrete.string",	PM_TYPE_STRING,	PM_SEM_DISCRETE },
+};
+#define NMETRIC (sizeof(metrics) / sizeof(metrics[0]))
+
+static double
+now(void)
+{
+    struct timeval	tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + (double)tv.tv_usec / 1000000;
+}
+
+static void
+check(int sts, const char *what)
+{
+    if (sts < 0) {
+	fprintf(stderr, "%s: %s: %s\n", pmGetProgname(), what, pmiErrStr(sts));
+	exit(1);
+    }
+}
+
+static void
+put(int *handle, int m, int k, const char *value, const char *what)
+{
+    if (disjoint && (k + m) % 7 == 3)
+	return;
+    check(pmiPutValueHandle(handle[m * ninst + k], value), what);
+}
+
+/*
+ * Counters mostly increase at a per-instance rate, but some of them
+ * wrap or go backwards, and every so often an instance is missing
+ * from a record, so all of the interpolation cases are covered.
+ */
+static void
+create(const char *archive)
+{
+    pmInDom	indom = pmiInDom(245, 1);
+    pmUnits	units = pmiUnits(0, 0, 1, 0, 0, PM_COUNT_ONE);
+    char	iname[32];
+    char	buf[64];
+    int		*handle;
+    long	*rate;
+    int		i, k, m, r;
+
+    check(pmiStart(archive, 0), "pmiStart");
+    check(pmiSetHostname("interpbench"), "pmiSetHostname");
+    check(pmiSetTimezone("UTC"), "pmiSetTimezone");
+    for (m = 0; m < NMETRIC; m++)
+	check(pmiAddMetric(metrics[m].name, pmiID(245, 0, m), metrics[m].type,
+			indom, metrics[m].sem, units), metrics[m].name);
+    if ((handle = (int *)malloc(NMETRIC * ninst * sizeof(int))) == NULL ||
+	(rate = (long *)malloc(ninst * sizeof(long))) == NULL) {
+	perror("malloc");
+	exit(1);
+    }
+    for (k = 0; k < ninst; k++) {
+	pmsprintf(iname, sizeof(iname), "inst-%d", k);
+	check(pmiAddInstance(indom, iname, k), "pmiAddInstance");
+	for (m = 0; m < NMETRIC; m++) {
+	    handle[m * ninst + k] = pmiGetHandle(metrics[m].name, iname);
+	    check(handle[m * ninst + k], "pmiGetHandle");
+	}
+	rate[k] = 1 + lrand48() % 100000;
+    }
+
+    for (r = 0; r < nrec; r++) {
+	for (k = 0; k < ninst; k++) {
+	    if ((k + r) % 17 == 5)
+		continue;
+	    i = 0;
+	    /* u32 close to UINT_MAX, so it wraps */
+	    pmsprintf(buf, sizeof(buf), "%u",
+			(unsigned int)(UINT_MAX - 300000 + r * rate[k]));
+	    put(handle, i++, k, buf, "u32");
+	    /* i32 goes backwards for odd instances */
+	    pmsprintf(buf, sizeof(buf), "%ld",
+			(k & 1) ? 1000000 - r * rate[k] : r * rate[k]);
+	    put(handle, i++, k, buf, "i32");
+	    pmsprintf(buf, sizeof(buf), "%llu",
+			(unsigned long long)k * 1000000000000ULL + r * rate[k] * 1000);
+	    put(handle, i++, k, buf, "u64");
+	    pmsprintf(buf, sizeof(buf), "%lld",
+			(k % 3 == 0) ? -(long long)r * rate[k] : (long long)r * rate[k]);
+	    put(handle, i++, k, buf, "i64");
+	    pmsprintf(buf, sizeof(buf), "%.3f", r * rate[k] / 7.0);
+	    put(handle, i++, k, buf, "float");
+	    pmsprintf(buf, sizeof(buf), "%.6f", r * rate[k] / 3.0 + k);
+	    put(handle, i++, k, buf, "double");
+	    pmsprintf(buf, sizeof(buf), "%.6f", (double)((r * rate[k]) % 1000) / 10);
+	    put(handle, i++, k, buf, "instant double");
+	    pmsprintf(buf, sizeof(buf), "%ld", (r * rate[k]) % 65536);
+	    put(handle, i++, k, buf, "instant u64");
+	    pmsprintf(buf, sizeof(buf), "%d", (r + k) / 4);
+	    put(handle, i++, k, buf, "discrete u32");
+	    pmsprintf(buf, sizeof(buf), "state-%d", (r + k) / 3);
+	    put(handle, i++, k, buf, "discrete string");
+	}
+	check(pmiWrite(1700000000 + r * 10, (r % 4) * 250000), "pmiWrite");
+    }
+    check(pmiEnd(), "pmiEnd");
+    free(handle);
+    free(rate);
+}
+
+/*
+ * values from the other contexts must match those of the first
+ */
+static int
+compare(int c, int nfetch, pmResult *rp, pmResult *xp)
+{
+    pmValueSet	*vsp, *xvsp;
+    pmValue	*vp, *xvp;
+    int		i, m;
+
+    for (m = 0; m < rp->numpmid; m++) {
+	vsp = rp->vset[m];
+	xvsp = xp->vset[m];
+	if (vsp->numval != xvsp->numval)
+	    goto differ;
+	for (i = 0; i < vsp->numval; i++) {
+	    vp = &vsp->vlist[i];
+	    xvp = &xvsp->vlist[i];
+	    if (vp->inst != xvp->inst)
+		goto differ;
+	    if (vsp->valfmt == PM_VAL_INSITU) {
+		if (vp->value.lval != xvp->value.lval)
+		    goto differ;
+	    }
+	    else if (vp->value.pval->vlen != xvp->value.pval->vlen ||
+		     memcmp(vp->value.pval, xvp->value.pval, vp->value.pval->vlen) != 0)
+		goto differ;
+	}
+    }
+    return 0;
+
+differ:
+    printf("fetch %d %s: context %d differs\n", nfetch, metrics[m].name, c);
+    return 1;
+}
+
+static void
+replay(const char *archive)
+{
+    pmID		pmids[NMETRIC];
+    const char		*names[NMETRIC];
+    pmResult		*rp, *xp;
+    pmValueSet		*vsp;
+    pmLogLabel		label;
+    __pmLogCacheStats	stats;
+    struct timeval	start;
+    double		t0, elapsed;
+    long		nvalues = 0;
+    int			nfetch = 0;
+    int			ndiffer = 0;
+    int			*ctx;
+    int			c, i, m, sts;
+
+    if ((ctx = (int *)malloc(nctx * sizeof(int))) == NULL) {
+	perror("malloc");
+	exit(1);
+    }
+    for (c = 0; c < nctx; c++) {
+	if ((ctx[c] = sts = pmNewContext(PM_CONTEXT_ARCHIVE, archive)) < 0) {
+	    fprintf(stderr, "%s: %s: %s\n", pmGetProgname(), archive, pmErrStr(sts));
+	    exit(1);
+	}
+	if (c == 0) {
+	    for (m = 0; m < NMETRIC; m++)
+		names[m] = metrics[m].name;
+	    if ((sts = pmLookupName(NMETRIC, names, pmids)) < 0) {
+		fprintf(stderr, "%s: pmLookupName: %s\n", pmGetProgname(), pmErrStr(sts));
+		exit(1);
+	    }
+	    if ((sts = pmGetArchiveLabel(&label)) < 0) {
+		fprintf(stderr, "%s: pmGetArchiveLabel: %s\n", pmGetProgname(), pmErrStr(sts));
+		exit(1);
+	    }
+	    start = label.ll_start;
+	    start.tv_usec += 100000;
+	}
+	/* 3.7 sec steps, so mostly between records */
+	if ((sts = pmSetMode(PM_MODE_INTERP, &start, 3700)) < 0) {
+	    fprintf(stderr, "%s: pmSetMode: %s\n", pmGetProgname(), pmErrStr(sts));
+	    exit(1);
+	}
+    }
+
+    t0 = now();
+    for ( ; ; ) {
+	pmUseContext(ctx[0]);
+	if ((sts = pmFetch(NMETRIC, pmids, &rp)) < 0)
+	    break;
+	nfetch++;
+	for (c = 1; c < nctx; c++) {
+	    pmUseContext(ctx[c]);
+	    if ((sts = pmFetch(NMETRIC, pmids, &xp)) < 0) {
+		printf("fetch %d: context %d: %s\n", nfetch, c, pmErrStr(sts));
+		ndiffer++;
+		continue;
+	    }
+	    ndiffer += compare(c, nfetch, rp, xp);
+	    pmFreeResult(xp);
+	}
+	for (m = 0; m < rp->numpmid; m++) {
+	    vsp = rp->vset[m];
+	    if (vsp->numval > 0)
+		nvalues += vsp->numval;
+	    if (timing)
+		continue;
+	    printf("fetch %d %s:", nfetch, metrics[m].name);
+	    if (vsp->numval < 0)
+		printf(" %s", pmErrStr(vsp->numval));
+	    for (i = 0; i < vsp->numval; i++) {
+		printf(" [%d]", vsp->vlist[i].inst);
+		pmPrintValue(stdout, vsp->valfmt, metrics[m].type, &vsp->vlist[i], 1);
+	    }
+	    putchar('\n');
+	}
+	pmFreeResult(rp);
+    }
+    elapsed = now() - t0;
+    if (sts != PM_ERR_EOL) {
+	fprintf(stderr, "%s: pmFetch: %s\n", pmGetProgname(), pmErrStr(sts));
+	exit(1);
+    }
+    if (timing)
+	printf("%d fetches, %ld values, %.1f usec per fetch, %.1f nsec per value\n",
+		nfetch, nvalues, elapsed * 1e6 / nfetch,
+		nvalues ? elapsed * 1e9 / nvalues : 0);
+    else
+	printf("%d fetches, %ld values\n", nfetch, nvalues);
+    if (nctx > 1) {
+	__pmLogCacheGetStats(&stats);
+	printf("%d contexts, %d differ, shared cache %s\n", nctx, ndiffer,
+		stats.hits > 0 ? "used" : "not used");
+	fprintf(stderr, "hits=%llu misses=%llu evictions=%llu entries=%u bytes=%llu limit=%llu\n",
+		(unsigned long long)stats.hits, (unsigned long long)stats.misses,
+		(unsigned long long)stats.evictions, stats.entries,
+		(unsigned long long)stats.bytes, (unsigned long long)stats.limit);
+    }
+    for (c = 0; c < nctx; c++)
+	pmDestroyContext(ctx[c]);
+    free(ctx);
+}
+
+int
+main(int argc, char **argv)
+{
+    int		c;
+    int		cflag = 0;
+    long	seed = 42;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "cdC:i:n:s:t")) != EOF) {
+	switch (c) {
+	case 'c':
+	    cflag = 1;
+	    break;
+	case 'd':
+	    disjoint = 1;
+	    break;
+	case 'C':
+	    nctx = atoi(optarg);
+	    break;
+	case 'i':
+	    ninst = atoi(optarg);
+	    break;
+	case 'n':
+	    nrec = atoi(optarg);
+	    break;
+	case 's':
+	    seed = atol(optarg);
+	    break;
+	case 't':
+	    timing = 1;
+	    break;
+	default:
+	    optind = argc;
+	    break;
+	}
+    }
+    if (optind != argc - 1) {
+	fprintf(stderr, "Usage: %s [-cdt] [-C nctx] [-i ninst] [-n nrec] [-s seed] archive\n",
+		pmGetProgname());
+	exit(1);
+    }
+    if (ninst < 1 || nrec < 2 || nctx < 1) {
+	fprintf(stderr, "%s: need at least 1 instance and 2 records\n", pmGetProgname());
+	exit(1);
+    }
+    srand48(seed);
+
+    if (cflag)
+	create(argv[optind]);
+    replay(argv[optind]);
+
+    exit(0);
+}
@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Exercise the pooled PDU buffers ... interior pin/unpin for each
+ * size class, recycling via the per-thread free lists, and concurrent
+ * pin/unpin with buffers handed between threads while the registry
+ * grows and shrinks.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pcp/pmapi.h>
+#include <pthread.h>
+#include "libpcp.h"
+
+#define NSLOT	256
+#define NBURST	300
+
+static int	sizes[] = { 16, 200, 1000, 3000, 12000, 40000, 100000, 300000 };
+static int	nsizes = sizeof(sizes) / sizeof(sizes[0]);
+
+static pthread_mutex_t	slot_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct {
+    int		*buf;
+    int		size;
+    int		tag;
+} slot[NSLOT];
+
+static int	iter = 20000;
+static int	nthread = 8;
+static int	errors;
+static int	finds;
+
+static void
+fill(int *buf, int size, int tag)
+{
+    int		i;
+
+    for (i = 0; i < size / (int)sizeof(int); i++)
+	buf[i] = tag + i;
+}
+
+static int
+check(int *buf, int size, int tag)
+{
+    int		i;
+
+    for (i = 0; i < size / (int)sizeof(int); i++) {
+	if (buf[i] != tag + i)
+	    return 0;
+    }
+    return 1;
+}
+
+static void
+single(void)
+{
+    __uint64_t	allocs0, reuses0, allocs, reuses, nreuse;
+    int		alloc, nfree;
+    int		i, sts;
+    int		*buf, *again;
+    char	*last;
+    int		bogus[4];
+
+    __pmCountPDUBufReuse(&allocs0, &reuses0);
+
+    for (i = 0; i < nsizes; i++) {
+	buf = (int *)__pmFindPDUBuf(sizes[i]);
+	last = (char *)buf + sizes[i] - sizeof(int);
+	__pmPinPDUBuf(last);
+	__pmPinPDUBuf((char *)buf + sizes[i] / 2 - (sizes[i] / 2) % sizeof(int));
+	__pmCountPDUBuf(sizes[i], &alloc, &nfree);
+	printf("size %d: pinned %d", sizes[i], alloc);
+	sts = __pmUnpinPDUBuf(buf);
+	printf(" unpin %d", sts);
+	sts = __pmUnpinPDUBuf(last);
+	printf(" %d", sts);
+	sts = __pmUnpinPDUBuf(last);
+	printf(" %d", sts);
+	sts = __pmUnpinPDUBuf(buf);
+	printf(" then %d", sts);
+	sts = __pmUnpinPDUBuf(last + sizeof(int));
+	printf(" beyond %d", sts);
+	__pmCountPDUBufReuse(&allocs, &reuses);
+	again = (int *)__pmFindPDUBuf(sizes[i]);
+	__pmCountPDUBufReuse(&allocs, &nreuse);
+	printf(" %s\n", nreuse > reuses ? "recycled" : "new");
+	__pmUnpinPDUBuf(again);
+    }
+
+    sts = __pmUnpinPDUBuf(bogus);
+    printf("unpin non-pdubuf: %d\n", sts);
+
+    __pmCountPDUBufReuse(&allocs, &reuses);
+    printf("allocs %d reuses %d\n",
+	    (int)(allocs - allocs0), (int)(reuses - reuses0));
+    __pmCountPDUBuf(0, &alloc, &nfree);
+    printf("pinned after single thread: %d\n", alloc);
+}
+
+static void *
+worker(void *arg)
+{
+    unsigned int	seed = (unsigned int)(__psint_t)arg;
+    int			*burst[NBURST];
+    int			*buf;
+    int			i, j, n, s, size, tag, sts;
+    int			nfind = 0, nerr = 0;
+
+    for (i = 0; i < iter; i++) {
+	n = rand_r(&seed) % NSLOT;
+	pthread_mutex_lock(&slot_lock);
+	if ((buf = slot[n].buf) != NULL) {
+	    size = slot[n].size;
+	    tag = slot[n].tag;
+	    slot[n].buf = NULL;
+	    pthread_mutex_unlock(&slot_lock);
+	    /* this thread drops the pins another thread took */
+	    if (!check(buf, size, tag))
+		nerr++;
+	    if (__pmUnpinPDUBuf((char *)buf + size - sizeof(int)) != 1)
+		nerr++;
+	    if (__pmUnpinPDUBuf(buf) != 1)
+		nerr++;
+	}
+	else {
+	    pthread_mutex_unlock(&slot_lock);
+	    s = rand_r(&seed) % nsizes;
+	    size = sizes[s] - (rand_r(&seed) % 4) * sizeof(int);
+	    tag = rand_r(&seed);
+	    if ((buf = (int *)__pmFindPDUBuf(size)) == NULL) {
+		nerr++;
+		continue;
+	    }
+	    nfind++;
+	    fill(buf, size, tag);
+	    __pmPinPDUBuf((char *)buf + size / 2 - (size / 2) % sizeof(int));
+	    if (__pmUnpinPDUBuf(buf) != 1)
+		nerr++;
+	    __pmPinPDUBuf((char *)buf + size - sizeof(int));
+	    pthread_mutex_lock(&slot_lock);
+	    if (slot[n].buf == NULL) {
+		slot[n].buf = buf;
+		slot[n].size = size;
+		slot[n].tag = tag;
+		buf = NULL;
+	    }
+	    pthread_mutex_unlock(&slot_lock);
+	    if (buf != NULL) {
+		/* lost the race for the slot, drop both pins */
+		if (__pmUnpinPDUBuf((char *)buf + size - sizeof(int)) != 1)
+		    nerr++;
+		if (__pmUnpinPDUBuf(buf) != 1)
+		    nerr++;
+	    }
+	}
+	if (i % 1000 == 999) {
+	    /* lots of live buffers at once, so the registry grows */
+	    for (j = 0; j < NBURST; j++) {
+		burst[j] = (int *)__pmFindPDUBuf(sizes[j % 3]);
+		nfind++;
+	    }
+	    for (j = 0; j < NBURST; j++) {
+		sts = __pmUnpinPDUBuf(burst[j]);
+		if (sts != 1)
+		    nerr++;
+	    }
+	}
+    }
+
+    pthread_mutex_lock(&slot_lock);
+    errors += nerr;
+    finds += nfind;
+    pthread_mutex_unlock(&slot_lock);
+    return NULL;
+}
+
+static void
+threads(void)
+{
+    __uint64_t	allocs0, reuses0, allocs, reuses;
+    pthread_t	*tid;
+    int		alloc, nfree;
+    int		i, n;
+
+    __pmCountPDUBufReuse(&allocs0, &reuses0);
+
+    if ((tid = (pthread_t *)malloc(nthread * sizeof(pthread_t))) == NULL) {
+	fprintf(stderr, "malloc failed\n");
+	exit(1);
+    }
+    for (i = 0; i < nthread; i++) {
+	if (pthread_create(&tid[i], NULL, worker, (void *)(__psint_t)(i + 1)) != 0) {
+	    fprintf(stderr, "pthread_create failed\n");
+	    exit(1);
+	}
+    }
+    for (i = 0; i < nthread; i++)
+	pthread_join(tid[i], NULL);
+    free(tid);
+
+    /* buffers still parked in slots */
+    for (n = 0, i = 0; i < NSLOT; i++) {
+	if (slot[i].buf == NULL)
+	    continue;
+	if (!check(slot[i].buf, slot[i].size, slot[i].tag))
+	    errors++;
+	if (__pmUnpinPDUBuf(slot[i].buf) != 1)
+	    errors++;
+	if (__pmUnpinPDUBuf(slot[i].buf) != 1)
+	    errors++;
+	slot[i].buf = NULL;
+	n++;
+    }
+
+    __pmCountPDUBufReuse(&allocs, &reuses);
+    printf("%d threads: errors %d, finds %s\n", nthread, errors,
+	    allocs - allocs0 + reuses - reuses0 == finds ? "match" : "MISMATCH");
+    if (pmDebugOptions.appl0)
+	fprintf(stderr, "finds %d allocs %d reuses %d parked %d\n", finds,
+		(int)(allocs - allocs0), (int)(reuses - reuses0), n);
+    __pmCountPDUBuf(0, &alloc, &nfree);
+    printf("pinned after threads: %d\n", alloc);
+}
+
+int
+main(int argc, char **argv)
+{
+    int		c;
+    int		sts;
+    int		errflag = 0;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "D:i:t:")) != EOF) {
+	switch (c) {
+	case 'D':
+	    if ((sts = pmSetDebug(optarg)) < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+	case 'i':
+	    iter = atoi(optarg);
+	    break;
+	case 't':
+	    nthread = atoi(optarg);
+	    break;
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+    if (errflag || optind != argc || iter <= 0 || nthread <= 0) {
+	fprintf(stderr, "Usage: %s [-D debug] [-i iter] [-t nthread]\n", pmGetProgname());
+	exit(1);
+    }
+
+    single();
+    threads();
+
+    return 0;
+}
@@ -0,0 +1,589 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Replay /proc snapshot files through the sscanf(3) and strtoul(3)
+ * parsing previously used in the linux and proc PMDAs, and through
+ * the procscan.h routines that replaced it ... first for correctness
+ * (every value extracted must be the same), then optionally for speed
+ * with -t.
+ *
+ * Usage: procscanbench [-t] [-n iterations] type file ...
+ *	where type is one of stat, interrupts (also for softirqs),
+ *	vmstat, netdev or pidstat
+ */
+
+#include <pcp/pmapi.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "procscan.h"
+
+static int	iterations = 1000;
+static int	timing;
+static int	errors;
+
+typedef int (*parser_t)(char *, int, unsigned long long *, int);
+
+/* values are appended to the caller's array, up to its maximum */
+#define EMIT(v) do { if (n < max) out[n] = (v); n++; } while (0)
+
+static double
+now(void)
+{
+    struct timeval	tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + (double)tv.tv_usec / 1000000;
+}
+
+/* split buffer into lines in place, one character at a time */
+static char *
+old_line(char **pp, char *end)
+{
+    char		*line = *pp, *p;
+
+    if (line >= end)
+	return NULL;
+    for (p = line; p < end && *p != '\n'; p++)
+	;
+    *p = '\0';
+    *pp = p < end ? p + 1 : end;
+    return line;
+}
+
+/*
+ * /proc/stat - cpu lines, then the single value lines
+ */
+static struct {
+    const char	*prefix;
+    const char	*fmt;
+    int		count;
+} statlines[] = {
+    { "page ", "page %llu %llu", 2 },
+    { "swap ", "swap %llu %llu", 2 },
+    { "intr ", "intr %llu", 1 },
+    { "ctxt ", "ctxt %llu", 1 },
+    { "btime ", "btime %llu", 1 },
+    { "processes ", "processes %llu", 1 },
+    { "procs_running ", "procs_running %llu", 1 },
+    { "procs_blocked ", "procs_blocked %llu", 1 },
+    { NULL }
+};
+
+static int
+old_stat(char *buf, int len, unsigned long long *out, int max)
+{
+    unsigned long long	v[10];
+    unsigned int	cpu;
+    char		*line, *p = buf;
+    int			i, k, n = 0, sts;
+
+    while ((line = old_line(&p, buf + len)) != NULL) {
+	if (strncmp(line, "cpu ", 4) == 0) {
+	    sts = sscanf(line, "cpu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu",
+		    &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8], &v[9]);
+	    for (k = 0; k < sts; k++)
+		EMIT(v[k]);
+	    continue;
+	}
+	if (strncmp(line, "cpu", 3) == 0 && isdigit((int)line[3])) {
+	    sts = sscanf(line, "cpu%u %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu",
+		    &cpu, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8], &v[9]);
+	    EMIT(cpu);
+	    for (k = 0; k < sts - 1; k++)
+		EMIT(v[k]);
+	    continue;
+	}
+	for (i = 0; statlines[i].prefix != NULL; i++) {
+	    if (strncmp(line, statlines[i].prefix, strlen(statlines[i].prefix)) != 0)
+		continue;
+	    sts = sscanf(line, statlines[i].fmt, &v[0], &v[1]);
+	    for (k = 0; k < sts; k++)
+		EMIT(v[k]);
+	    break;
+	}
+    }
+    return n;
+}
+
+static int
+new_stat(char *buf, int len, unsigned long long *out, int max)
+{
+    unsigned long long	v[10];
+    char		*line, *p = buf, *s;
+    int			i, k, n = 0, sts, plen;
+
+    while ((line = scan_line(&p, buf + len)) != NULL) {
+	if (strncmp(line, "cpu", 3) == 0) {
+	    s = line + 3;
+	    if (scan_isdigit(*s))
+		EMIT(scan_ull(&s));
+	    else if (*s != ' ')
+		continue;
+	    sts = scan_u64s(&s, v, 10);
+	    for (k = 0; k < sts; k++)
+		EMIT(v[k]);
+	    continue;
+	}
+	for (i = 0; statlines[i].prefix != NULL; i++) {
+	    plen = strlen(statlines[i].prefix);
+	    if (strncmp(line, statlines[i].prefix, plen) != 0)
+		continue;
+	    s = line + plen - 1;
+	    sts = scan_u64s(&s, v, statlines[i].count);
+	    for (k = 0; k < sts; k++)
+		EMIT(v[k]);
+	    break;
+	}
+    }
+    return n;
+}
+
+/*
+ * /proc/interrupts and /proc/softirqs - a header line of CPU names,
+ * then a name and a value per CPU column on each line
+ */
+static int
+old_interrupts(char *buf, int len, unsigned long long *out, int max)
+{
+    unsigned long long	value;
+    unsigned int	count;
+    char		*line, *p = buf, *s, *end;
+    int			i, n = 0, ncolumns = 0;
+
+    if ((line = old_line(&p, buf + len)) == NULL)
+	return 0;
+    for (s = line; *s != '\0'; ) {
+	if (!isdigit((int)*s)) {
+	    s++;
+	    continue;
+	}
+	value = strtoul(s, &end, 10);
+	if (end == s)
+	    break;
+	EMIT(value);
+	ncolumns++;
+	s = end;
+    }
+    while ((line = old_line(&p, buf + len)) != NULL) {
+	if (sscanf(line, "ERR: %u", &count) == 1 ||
+	    sscanf(line, "Err: %u", &count) == 1 ||
+	    sscanf(line, "BAD: %u", &count) == 1 ||
+	    sscanf(line, "MIS: %u", &count) == 1) {
+	    EMIT(count);
+	    continue;
+	}
+	if ((s = strchr(line, ':')) == NULL)
+	    continue;
+	for (s++, i = 0; i < ncolumns; i++) {
+	    value = strtoul(s, &end, 10);
+	    if (*end != '\0' && !isspace((int)*end))
+		continue;
+	    s = end;
+	    EMIT(value);
+	}
+    }
+    return n;
+}
+
+static int
+new_count(char *line, const char *name, unsigned long long *value)
+{
+    if (strncmp(line, name, 3) != 0 || line[3] != ':')
+	return 0;
+    line += 4;
+    return scan_u64(&line, value);
+}
+
+static int
+new_interrupts(char *buf, int len, unsigned long long *out, int max)
+{
+    unsigned long long	value;
+    char		*line, *p = buf, *s, *end;
+    int			i, n = 0, ncolumns = 0;
+
+    if ((line = scan_line(&p, buf + len)) == NULL)
+	return 0;
+    for (s = line; *s != '\0'; ) {
+	if (!scan_isdigit(*s)) {
+	    s++;
+	    continue;
+	}
+	EMIT(scan_ull(&s));
+	ncolumns++;
+    }
+    while ((line = scan_line(&p, buf + len)) != NULL) {
+	if (new_count(line, "ERR", &value) || new_count(line, "Err", &value) ||
+	    new_count(line, "BAD", &value) || new_count(line, "MIS", &value)) {
+	    EMIT((unsigned int)value);
+	    continue;
+	}
+	if ((s = strchr(line, ':')) == NULL)
+	    continue;
+	for (s++, i = 0; i < ncolumns; i++) {
+	    end = s;
+	    value = scan_ull(&end);
+	    if (*end != '\0' && !scan_isspace(*end))
+		continue;
+	    s = end;
+	    EMIT(value);
+	}
+    }
+    return n;
+}
+
+/*
+ * /proc/vmstat - name and value pairs, with the name looked up in a
+ * table of known names; the names in the file stand in for the PMDA
+ * table here, searched linearly (old) or via a sorted index (new)
+ */
+static char	*vmcopy;
+static char	**vmnames;
+static int	*vmorder;
+static int	nvmnames;
+
+static int
+vmcompare(const void *a, const void *b)
+{
+    return strcmp(vmnames[*(const int *)a], vmnames[*(const int *)b]);
+}
+
+static void
+vmstat_table(const char *buf, int len)
+{
+    char		*line, *p, *s;
+
+    if ((vmcopy = (char *)malloc(len + 1)) == NULL) {
+	perror("malloc");
+	exit(1);
+    }
+    memcpy(vmcopy, buf, len + 1);
+    for (p = vmcopy; (line = old_line(&p, vmcopy + len)) != NULL; ) {
+	if ((s = strchr(line, ' ')) == NULL)
+	    continue;
+	*s = '\0';
+	vmnames = (char **)realloc(vmnames, (nvmnames + 1) * sizeof(char *));
+	vmorder = (int *)realloc(vmorder, (nvmnames + 1) * sizeof(int));
+	if (vmnames == NULL || vmorder == NULL) {
+	    perror("realloc");
+	    exit(1);
+	}
+	vmnames[nvmnames] = line;
+	vmorder[nvmnames] = nvmnames;
+	nvmnames++;
+    }
+    qsort(vmorder, nvmnames, sizeof(int), vmcompare);
+}
+
+static int
+old_vmstat(char *buf, int len, unsigned long long *out, int max)
+{
+    unsigned long long	value;
+    char		*line, *p = buf, *s;
+    int			i, n = 0;
+
+    while ((line = old_line(&p, buf + len)) != NULL) {
+	if ((s = strchr(line, ' ')) == NULL)
+	    continue;
+	*s = '\0';
+	for (i = 0; i < nvmnames; i++) {
+	    if (strcmp(line, vmnames[i]) != 0)
+		continue;
+	    for (s++; *s; s++) {
+		if (isdigit((int)*s)) {
+		    sscanf(s, "%llu", &value);
+		    break;
+		}
+	    }
+	    if (*s == '\0')
+		continue;
+	    EMIT(i);
+	    EMIT(value);
+	}
+    }
+    return n;
+}
+
+static int
+new_vmstat(char *buf, int len, unsigned long long *out, int max)
+{
+    char		*line, *p = buf, *s;
+    int			lo, hi, mid, sts, n = 0;
+
+    while ((line = scan_line(&p, buf + len)) != NULL) {
+	if ((s = strchr(line, ' ')) == NULL)
+	    continue;
+	*s = '\0';
+	for (lo = 0, hi = nvmnames - 1; lo <= hi; ) {
+	    mid = (lo + hi) / 2;
+	    if ((sts = strcmp(line, vmnames[vmorder[mid]])) == 0)
+		break;
+	    if (sts < 0)
+		hi = mid - 1;
+	    else
+		lo = mid + 1;
+	}
+	if (lo > hi)
+	    continue;
+	for (s++; *s && !scan_isdigit(*s); s++)
+	    ;
+	if (*s == '\0')
+	    continue;
+	EMIT(vmorder[mid]);
+	EMIT(scan_ull(&s));
+    }
+    return n;
+}
+
+/*
+ * /proc/net/dev - two header lines, then an interface name and colon
+ * followed by the counters
+ */
+#define NETDEV_COUNTERS	16
+
+static int
+old_netdev(char *buf, int len, unsigned long long *out, int max)
+{
+    unsigned long long	value;
+    char		*line, *p = buf, *s;
+    int			j, n = 0;
+
+    while ((line = old_line(&p, buf + len)) != NULL) {
+	if ((s = strchr(line, ':')) == NULL)
+	    continue;
+	*s++ = '\0';
+	for (j = 0; j < NETDEV_COUNTERS; j++) {
+	    /* the PMDA ran off the end of short lines, stop here instead */
+	    for (; *s && !isdigit((int)*s); s++) {;}
+	    if (*s == '\0')
+		break;
+	    sscanf(s, "%llu", &value);
+	    for (; *s && !isspace((int)*s); s++) {;}
+	    EMIT(value);
+	}
+    }
+    return n;
+}
+
+static int
+new_netdev(char *buf, int len, unsigned long long *out, int max)
+{
+    char		*line, *p = buf, *s;
+    int			j, n = 0;
+
+    while ((line = scan_line(&p, buf + len)) != NULL) {
+	if ((s = strchr(line, ':')) == NULL)
+	    continue;
+	*s++ = '\0';
+	for (j = 0; j < NETDEV_COUNTERS; j++) {
+	    for (; *s && !scan_isdigit(*s); s++) {;}
+	    if (*s == '\0')
+		break;
+	    EMIT(scan_ull(&s));
+	}
+    }
+    return n;
+}
+
+/*
+ * /proc/<pid>/stat - pid, (command), state, then numeric fields
+ */
+static int
+old_pidstat(char *buf, int len, unsigned long long *out, int max)
+{
+    unsigned long long	value;
+    char		*p, *end;
+    int			n = 0;
+
+    (void)len;
+    EMIT(strtoul(buf, &end, 10));
+    if ((p = strrchr(buf, ')')) == NULL)
+	return n;
+    p += 2;
+    EMIT(*p);
+    for (;;) {
+	value = strtoull(++p, &end, 10);
+	if (end == p)
+	    break;
+	p = end;
+	EMIT(value);
+    }
+    return n;
+}
+
+static int
+new_pidstat(char *buf, int len, unsigned long long *out, int max)
+{
+    unsigned long long	value;
+    char		*p = buf;
+    int			n = 0;
+
+    (void)len;
+    EMIT(scan_ull(&p));
+    if ((p = strrchr(buf, ')')) == NULL)
+	return n;
+    p += 2;
+    EMIT(*p);
+    p++;
+    while (scan_u64(&p, &value))
+	EMIT(value);
+    return n;
+}
+
+static struct {
+    const char	*type;
+    parser_t	parse[2];
+} types[] = {
+    { "stat", { old_stat, new_stat } },
+    { "interrupts", { old_interrupts, new_interrupts } },
+    { "vmstat", { old_vmstat, new_vmstat } },
+    { "netdev", { old_netdev, new_netdev } },
+    { "pidstat", { old_pidstat, new_pidstat } },
+    { NULL }
+};
+
+/* read in the whole file, /proc files have no size so cannot stat(2) */
+static char *
+readfile(const char *file, int *lenp)
+{
+    char		*buf = NULL;
+    int			fd, len = 0, size = 0, sts;
+
+    if ((fd = open(file, O_RDONLY)) < 0) {
+	perror(file);
+	exit(1);
+    }
+    do {
+	if (len + 1 >= size) {
+	    size = size ? size * 2 : 8192;
+	    if ((buf = (char *)realloc(buf, size)) == NULL) {
+		perror("realloc");
+		exit(1);
+	    }
+	}
+	if ((sts = read(fd, buf + len, size - len - 1)) < 0) {
+	    perror(file);
+	    exit(1);
+	}
+	len += sts;
+    } while (sts > 0);
+    buf[len] = '\0';
+    close(fd);
+    *lenp = len;
+    return buf;
+}
+
+static void
+check(int t, const char *file)
+{
+    unsigned long long	*out[2];
+    const char		*name;
+    char		*buf, *work;
+    int			i, k, len, n[2], max, bad = 0;
+
+    buf = readfile(file, &len);
+    if (types[t].parse[0] == old_vmstat)
+	vmstat_table(buf, len);
+    max = len + 1;	/* never more values than characters */
+    out[0] = (unsigned long long *)malloc(max * sizeof(unsigned long long));
+    out[1] = (unsigned long long *)malloc(max * sizeof(unsigned long long));
+    work = (char *)malloc(len + 1);
+    if (out[0] == NULL || out[1] == NULL || work == NULL) {
+	perror("malloc");
+	exit(1);
+    }
+    for (k = 0; k < 2; k++) {
+	memcpy(work, buf, len + 1);
+	n[k] = types[t].parse[k](work, len, out[k], max);
+    }
+    if ((name = strrchr(file, '/')) != NULL)
+	name++;
+    else
+	name = file;
+
+    if (n[0] != n[1]) {
+	printf("%s %s: sscanf %d values, procscan %d values\n",
+		types[t].type, name, n[0], n[1]);
+	bad++;
+    }
+    else {
+	for (i = 0; i < n[0] && i < max; i++) {
+	    if (out[0][i] != out[1][i]) {
+		printf("%s %s: value[%d] sscanf %llu, procscan %llu\n",
+			types[t].type, name, i, out[0][i], out[1][i]);
+		if (bad++ > 10)
+		    break;
+	    }
+	}
+    }
+
+    if (timing) {
+	double		start, elapsed[2];
+	int		j;
+
+	for (k = 0; k < 2; k++) {
+	    start = now();
+	    for (j = 0; j < iterations; j++) {
+		memcpy(work, buf, len + 1);
+		types[t].parse[k](work, len, out[k], max);
+	    }
+	    elapsed[k] = now() - start;
+	}
+	printf("%-10s %-32s %10.2f %10.2f  (usec per parse, sscanf procscan)\n",
+		types[t].type, name,
+		elapsed[0] * 1e6 / iterations, elapsed[1] * 1e6 / iterations);
+    }
+    else
+	printf("%s %s: %d values %s\n", types[t].type, name, n[0],
+		bad ? "FAILED" : "OK");
+    errors += bad;
+
+    free(work);
+    free(out[0]);
+    free(out[1]);
+    free(buf);
+    if (types[t].parse[0] == old_vmstat) {
+	free(vmcopy);
+	free(vmnames);
+	free(vmorder);
+	vmnames = NULL;
+	vmorder = NULL;
+	nvmnames = 0;
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    int		c, t;
+
+    pmSetProgname(argv[0]);
+    while ((c = getopt(argc, argv, "n:t")) != EOF) {
+	switch (c) {
+	case 'n':
+	    iterations = atoi(optarg);
+	    break;
+	case 't':
+	    timing = 1;
+	    break;
+	default:
+	    errors++;
+	}
+    }
+    if (errors || optind + 1 >= argc || iterations < 1) {
+	fprintf(stderr, "Usage: %s [-t] [-n iterations] type file ...\n", pmGetProgname());
+	exit(1);
+    }
+    for (t = 0; types[t].type != NULL; t++)
+	if (strcmp(argv[optind], types[t].type) == 0)
+	    break;
+    if (types[t].type == NULL) {
+	fprintf(stderr, "%s: unknown type \"%s\"\n", pmGetProgname(), argv[optind]);
+	exit(1);
+    }
+    for (optind++; optind < argc; optind++)
+	check(t, argv[optind]);
+
+    exit(errors ? 1 : 0);
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * pmdaFetch for an indom managed with pmdaCache, with an instance
+ * profile that excludes all instances and includes only some ...
+ * when the inclusion list is shorter than the cache, libpcp_pmda
+ * walks the profile rather than the cache.
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+#include <pcp/pmda.h>
+
+#define NINST	20
+
+static pmdaIndom indomtab[] = {
+    { 0, 0, NULL },
+};
+
+static pmdaMetric metrictab[] = {
+    { NULL,
+      { PMDA_PMID(0, 0), PM_TYPE_U32, 0, PM_SEM_INSTANT,
+	PMDA_PMUNITS(0, 0, 0, 0, 0, 0) } },
+};
+
+static int
+fetchCallBack(pmdaMetric *mdesc, unsigned int inst, pmAtomValue *atom)
+{
+    atom->ul = 100 + inst;
+    return PMDA_FETCH_STATIC;
+}
+
+/*
+ * Fetch with an inclusion list of n instances (all instances if n < 0)
+ */
+static void
+fetch(pmdaInterface *dispatch, int n, int *instances)
+{
+    pmInDomProfile	ip;
+    pmProfile		prof;
+    pmResult		*rp;
+    pmID		pmid = metrictab[0].m_desc.pmid;
+    int			i, sts;
+
+    memset(&prof, 0, sizeof(prof));
+    prof.state = PM_PROFILE_INCLUDE;
+    printf("profile:");
+    if (n >= 0) {
+	ip.indom = indomtab[0].it_indom;
+	ip.state = PM_PROFILE_EXCLUDE;
+	ip.instances_len = n;
+	ip.instances = instances;
+	prof.profile_len = 1;
+	prof.profile = &ip;
+	for (i = 0; i < n; i++)
+	    printf(" %d", instances[i]);
+	if (n == 0)
+	    printf(" none");
+    }
+    else
+	printf(" all");
+    putchar('\n');
+
+    pmdaProfile(&prof, dispatch->version.any.ext);
+    if ((sts = pmdaFetch(1, &pmid, &rp, dispatch->version.any.ext)) < 0) {
+	printf("pmdaFetch: %s\n", pmErrStr(sts));
+	return;
+    }
+    printf("  numval %d:", rp->vset[0]->numval);
+    for (i = 0; i < rp->vset[0]->numval; i++)
+	printf(" [%d] %d", rp->vset[0]->vlist[i].inst,
+		rp->vset[0]->vlist[i].value.lval);
+    putchar('\n');
+    __pmFreeResultValues(rp);
+}
+
+int
+main(int argc, char **argv)
+{
+    pmdaInterface	dispatch;
+    char		name[16];
+    int			c, i, sts;
+    int			errflag = 0;
+    /* as decoded from a profile PDU, sorted ... 5 is hidden, 99 unknown */
+    int			some[] = { 2, 5, 7, 13, 99 };
+    int			many[NINST + 2];
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "D:")) != EOF) {
+	switch (c) {
+	case 'D':
+	    if ((sts = pmSetDebug(optarg)) < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+    if (errflag || optind != argc) {
+	fprintf(stderr, "Usage: %s [-D debug]\n", pmGetProgname());
+	exit(1);
+    }
+
+    pmdaDaemon(&dispatch, PMDA_INTERFACE_7, pmGetProgname(), 250, NULL, NULL);
+    pmdaSetFetchCallBack(&dispatch, fetchCallBack);
+    pmdaInit(&dispatch, indomtab, 1, metrictab, 1);
+    if (dispatch.status != 0) {
+	fprintf(stderr, "pmdaInit: %s\n", pmErrStr(dispatch.status));
+	exit(1);
+    }
+
+    for (i = 0; i < NINST; i++) {
+	pmsprintf(name, sizeof(name), "inst-%02d", i);
+	if ((sts = pmdaCacheStore(indomtab[0].it_indom, PMDA_CACHE_ADD, name, NULL)) != i) {
+	    fprintf(stderr, "pmdaCacheStore(%s): %d\n", name, sts);
+	    exit(1);
+	}
+    }
+    pmdaCacheStore(indomtab[0].it_indom, PMDA_CACHE_HIDE, "inst-05", NULL);
+    pmdaCacheStore(indomtab[0].it_indom, PMDA_CACHE_HIDE, "inst-17", NULL);
+    for (i = 0; i < NINST + 2; i++)
+	many[i] = i;
+
+    /* cache walk, nothing excluded */
+    fetch(&dispatch, -1, NULL);
+    /* profile walk, only the active instances from the list */
+    fetch(&dispatch, sizeof(some) / sizeof(some[0]), some);
+    fetch(&dispatch, 1, &some[2]);
+    fetch(&dispatch, 1, &some[1]);
+    fetch(&dispatch, 0, NULL);
+    /* inclusion list longer than the cache, so a cache walk */
+    fetch(&dispatch, NINST + 2, many);
+
+    return 0;
+}
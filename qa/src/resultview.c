@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Result views ... encode each result read from an archive created
+ * by "interpbench -c" as a PDU_RESULT and as a PDU_HIGHRES_RESULT,
+ * then check that __pmDecodeResultView() and its accessors return the
+ * same metrics, instances and values as the original result, and that
+ * the V2 and V3 archive records from __pmEncodeResultView() are the
+ * same as those from __pmEncodeResult().
+ *
+ * Some corrupted PDUs are also checked to be rejected.
+ *
+ * With -t, time __pmDecodeResult() + __pmEncodeResult() against
+ * __pmDecodeResultView() + __pmEncodeResultView() instead, reporting
+ * the cost per result.
+ *
+ * Usage: resultview [-t] archive
+ */
+
+#include <pcp/pmapi.h>
+#include <pcp/libpcp.h>
+#include <sys/time.h>
+
+static const char *names[] = {
+    "bench.counter.u32", "bench.counter.i32", "bench.counter.u64",
+    "bench.counter.i64", "bench.counter.float", "bench.counter.double",
+    "bench.instant.double", "bench.instant.u64", "bench.discrete.u32",
+    "bench.discrete.string",
+};
+#define NMETRIC (sizeof(names) / sizeof(names[0]))
+
+static pmID	pmids[NMETRIC];
+static pmDesc	descs[NMETRIC];
+static __pmLogCtl	v2ctl;
+static __pmLogCtl	v3ctl;
+
+static double
+now(void)
+{
+    struct timeval	tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + (double)tv.tv_usec / 1000000;
+}
+
+static void
+check(int sts, const char *what)
+{
+    if (sts < 0) {
+	fprintf(stderr, "%s: %s: %s\n", pmGetProgname(), what, pmErrStr(sts));
+	exit(1);
+    }
+}
+
+static void
+setup(const char *archive)
+{
+    unsigned int	m;
+
+    check(pmNewContext(PM_CONTEXT_ARCHIVE, archive), archive);
+    check(pmLookupName(NMETRIC, names, pmids), "pmLookupName");
+    for (m = 0; m < NMETRIC; m++)
+	check(pmLookupDesc(pmids[m], &descs[m]), names[m]);
+    v2ctl.label.magic = PM_LOG_MAGIC | PM_LOG_VERS02;
+    v3ctl.label.magic = PM_LOG_MAGIC | PM_LOG_VERS03;
+}
+
+static __pmPDU *
+encode(int type, __pmResult *rp)
+{
+    __pmPDU	*pb;
+
+    if (type == PDU_RESULT)
+	check(__pmEncodeResult(NULL, rp, &pb), "__pmEncodeResult");
+    else
+	check(__pmEncodeHighResResult(rp, &pb), "__pmEncodeHighResResult");
+    return pb;
+}
+
+static int
+compare_values(const char *tag, int n, __pmResult *rp, __pmResultView *view)
+{
+    pmValueSet	*vsp;
+    pmAtomValue	a, v;
+    int		ndiffer = 0;
+    int		sts, vsts;
+    int		i, j, type;
+
+    if (view->numpmid != rp->numpmid ||
+	view->timestamp.sec != rp->timestamp.sec ||
+	view->timestamp.nsec != rp->timestamp.nsec) {
+	printf("%s result %d: numpmid %d, view %d, timestamp differs\n",
+		tag, n, rp->numpmid, view->numpmid);
+	return 1;
+    }
+    for (i = 0; i < rp->numpmid; i++) {
+	vsp = rp->vset[i];
+	type = descs[i].type;
+	if (__pmResultViewPMID(view, i) != vsp->pmid ||
+	    __pmResultViewNumval(view, i) != vsp->numval ||
+	    (vsp->numval > 0 && __pmResultViewValfmt(view, i) != vsp->valfmt)) {
+	    printf("%s result %d %s: pmid %s numval %d, view %s %d\n",
+		    tag, n, names[i], pmIDStr(vsp->pmid), vsp->numval,
+		    pmIDStr(__pmResultViewPMID(view, i)),
+		    __pmResultViewNumval(view, i));
+	    ndiffer++;
+	    continue;
+	}
+	for (j = 0; j < vsp->numval; j++) {
+	    sts = pmExtractValue(vsp->valfmt, &vsp->vlist[j], type, &a, type);
+	    vsts = __pmResultViewExtract(view, i, j, type, &v, type);
+	    if (__pmResultViewInst(view, i, j) != vsp->vlist[j].inst ||
+		sts != vsts ||
+		(type == PM_TYPE_STRING && sts == 0 && strcmp(a.cp, v.cp) != 0) ||
+		(type != PM_TYPE_STRING && sts == 0 &&
+		 memcmp(&a, &v, sizeof(a)) != 0)) {
+		printf("%s result %d %s[%d]: differs\n", tag, n, names[i],
+			vsp->vlist[j].inst);
+		ndiffer++;
+	    }
+	    if (type == PM_TYPE_STRING) {
+		if (sts == 0)
+		    free(a.cp);
+		if (vsts == 0)
+		    free(v.cp);
+	    }
+	}
+    }
+    return ndiffer;
+}
+
+static int
+compare_record(const char *tag, int n, __pmLogCtl *lcp,
+		__pmResult *rp, __pmResultView *view)
+{
+    __pmPDU	*want, *got;
+    int		sts = 0;
+
+    check(__pmEncodeResult(lcp, rp, &want), "__pmEncodeResult");
+    check(__pmEncodeResultView(lcp, view, &got), "__pmEncodeResultView");
+    /* word 2 (from) is not used for archive records */
+    if (want[0] != got[0] || want[1] != got[1] ||
+	memcmp(&want[3], &got[3], want[0] - 3 * sizeof(__pmPDU)) != 0) {
+	printf("%s result %d: V%d record differs\n", tag, n,
+		__pmLogVersion(lcp));
+	sts = 1;
+    }
+    __pmUnpinPDUBuf(want);
+    __pmUnpinPDUBuf(got);
+    return sts;
+}
+
+static void
+corrupt(__pmResult *rp)
+{
+    __pmResultView	view;
+    __pmPDU		*pb;
+    int			i, len;
+
+    memset(&view, 0, sizeof(view));
+    for (i = 0; i < 4; i++) {
+	pb = encode(PDU_RESULT, rp);
+	len = pb[0];
+	switch (i) {
+	case 0:	/* short PDU */
+	    pb[0] = 5 * sizeof(__pmPDU);
+	    printf("short PDU: ");
+	    break;
+	case 1:	/* huge numpmid */
+	    pb[5] = htonl(len);
+	    printf("numpmid too big: ");
+	    break;
+	case 2:	/* truncated value blocks */
+	    pb[0] = len - sizeof(__pmPDU);
+	    printf("truncated: ");
+	    break;
+	case 3:	/* not a result */
+	    pb[1] = PDU_ERROR;
+	    printf("not a result: ");
+	    break;
+	}
+	printf("%s\n", pmErrStr(__pmDecodeResultView(pb, &view)));
+	__pmUnpinPDUBuf(pb);
+    }
+    __pmFreeResultView(&view);
+}
+
+static void
+compare(void)
+{
+    static int		types[] = { PDU_RESULT, PDU_HIGHRES_RESULT };
+    static char		*tags[] = { "PDU_RESULT", "PDU_HIGHRES_RESULT" };
+    __pmResultView	view;
+    __pmResult		*rp;
+    __pmPDU		*pb;
+    int			nresult = 0, nvalues = 0, ndiffer = 0;
+    int			i, t, sts;
+
+    memset(&view, 0, sizeof(view));
+    while ((sts = __pmFetch(NULL, NMETRIC, pmids, &rp)) >= 0) {
+	nresult++;
+	/* PDU_RESULT timestamps are only to the microsecond */
+	rp->timestamp.nsec -= rp->timestamp.nsec % 1000;
+	for (i = 0; i < rp->numpmid; i++)
+	    if (rp->vset[i]->numval > 0)
+		nvalues += rp->vset[i]->numval;
+	for (t = 0; t < 2; t++) {
+	    pb = encode(types[t], rp);
+	    if ((sts = __pmDecodeResultView(pb, &view)) < 0) {
+		printf("%s result %d: %s\n", tags[t], nresult, pmErrStr(sts));
+		ndiffer++;
+	    }
+	    else {
+		ndiffer += compare_values(tags[t], nresult, rp, &view);
+		ndiffer += compare_record(tags[t], nresult, &v2ctl, rp, &view);
+		ndiffer += compare_record(tags[t], nresult, &v3ctl, rp, &view);
+	    }
+	    __pmUnpinPDUBuf(pb);
+	}
+	if (nresult == 1)
+	    corrupt(rp);
+	__pmFreeResult(rp);
+    }
+    if (sts != PM_ERR_EOL)
+	check(sts, "__pmFetch");
+    __pmFreeResultView(&view);
+    printf("%d results, %d values, %d differ\n", nresult, nvalues, ndiffer);
+}
+
+static void
+timing(void)
+{
+    __pmResultView	view;
+    __pmResult		*rp, *xp;
+    __pmPDU		*pb, *work, *rec;
+    double		t0, dt = 0, vt = 0;
+    int			nresult = 0;
+    int			k, sts;
+
+    memset(&view, 0, sizeof(view));
+    while ((sts = __pmFetch(NULL, NMETRIC, pmids, &rp)) >= 0) {
+	nresult++;
+	pb = encode(PDU_HIGHRES_RESULT, rp);
+	if ((work = __pmFindPDUBuf(pb[0])) == NULL)
+	    check(-oserror(), "__pmFindPDUBuf");
+	for (k = 0; k < 10; k++) {
+	    /* __pmDecodeResult swaps in place, so both work on a copy */
+	    memcpy(work, pb, pb[0]);
+	    t0 = now();
+	    check(__pmDecodeHighResResult(work, &xp), "__pmDecodeHighResResult");
+	    check(__pmEncodeResult(&v3ctl, xp, &rec), "__pmEncodeResult");
+	    __pmUnpinPDUBuf(rec);
+	    __pmFreeResult(xp);
+	    dt += now() - t0;
+
+	    memcpy(work, pb, pb[0]);
+	    t0 = now();
+	    check(__pmDecodeResultView(work, &view), "__pmDecodeResultView");
+	    check(__pmEncodeResultView(&v3ctl, &view, &rec), "__pmEncodeResultView");
+	    __pmUnpinPDUBuf(rec);
+	    __pmReleaseResultView(&view);
+	    vt += now() - t0;
+	}
+	__pmUnpinPDUBuf(work);
+	__pmUnpinPDUBuf(pb);
+	__pmFreeResult(rp);
+    }
+    if (sts != PM_ERR_EOL)
+	check(sts, "__pmFetch");
+    __pmFreeResultView(&view);
+    printf("%d results\n", nresult);
+    printf("decode: %.1f usec per result\n", dt * 1e6 / (nresult * 10));
+    printf("view: %.1f usec per result\n", vt * 1e6 / (nresult * 10));
+}
+
+int
+main(int argc, char **argv)
+{
+    int		c, tflag = 0;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "t")) != EOF) {
+	switch (c) {
+	case 't':
+	    tflag = 1;
+	    break;
+	default:
+	    optind = argc;
+	    break;
+	}
+    }
+    if (optind != argc - 1) {
+	fprintf(stderr, "Usage: %s [-t] archive\n", pmGetProgname());
+	exit(1);
+    }
+
+    setup(argv[optind]);
+    if (tflag)
+	timing();
+    else
+	compare();
+
+    exit(0);
+}
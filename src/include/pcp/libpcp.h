@@ -388,6 +388,30 @@ PCP_CALL extern int __pmEncodeHighResResult(const __pmResult *, __pmPDU **);
 PCP_CALL extern int __pmDecodeResult(__pmPDU *, __pmResult **);
 PCP_CALL extern int __pmDecodeHighResResult(__pmPDU *, __pmResult **);
 PCP_CALL extern int __pmDecodeValueSet(__pmPDU *, int, __pmPDU *, char *, int, int, int, pmValueSet **);
+
+/*
+ * Read-only view of a PDU_RESULT or PDU_HIGHRES_RESULT, directly over
+ * the PDU buffer ... nothing is allocated, copied or byte-swapped in
+ * place, the accessors convert from network byte order as each field
+ * is used.
+ */
+typedef struct {
+    __pmPDU		*pdubuf;	/* pinned PDU, network byte order */
+    int			type;		/* PDU_RESULT or PDU_HIGHRES_RESULT */
+    int			numpmid;
+    __pmTimestamp	timestamp;
+    int			*vset;		/* vlist offsets, in __pmPDU units */
+    int			maxpmid;	/* allocated size of vset[] */
+} __pmResultView;
+
+PCP_CALL extern int __pmDecodeResultView(__pmPDU *, __pmResultView *);
+PCP_CALL extern void __pmReleaseResultView(__pmResultView *);
+PCP_CALL extern void __pmFreeResultView(__pmResultView *);
+PCP_CALL extern pmID __pmResultViewPMID(const __pmResultView *, int);
+PCP_CALL extern int __pmResultViewNumval(const __pmResultView *, int);
+PCP_CALL extern int __pmResultViewValfmt(const __pmResultView *, int);
+PCP_CALL extern int __pmResultViewInst(const __pmResultView *, int, int);
+PCP_CALL extern int __pmResultViewExtract(const __pmResultView *, int, int, int, pmAtomValue *, int);
 PCP_CALL extern int __pmSendProfile(int, int, int, pmProfile *);
 PCP_CALL extern int __pmDecodeProfile(__pmPDU *, int *, pmProfile **);
 PCP_CALL extern int __pmSendFetchPDU(int, int, int, int, pmID *, int);
@@ -437,6 +461,7 @@ PCP_CALL extern __pmPDU *__pmFindPDUBuf(int);
 PCP_CALL extern void __pmPinPDUBuf(void *);
 PCP_CALL extern int __pmUnpinPDUBuf(void *);
 PCP_CALL extern void __pmCountPDUBuf(int, int *, int *);
+PCP_CALL extern void __pmCountPDUBufReuse(__uint64_t *, __uint64_t *);
 
 /* PDU counting services */
 PCP_DATA extern unsigned int *__pmPDUCntIn;
@@ -542,6 +567,30 @@ PCP_CALL extern int __pmHashDel(unsigned int, void *, __pmHashCtl *);
 PCP_CALL extern void __pmHashClear(__pmHashCtl *);
 PCP_CALL extern void __pmHashFree(__pmHashCtl *);
 
+/* Open-addressing variant, contiguous slots and no per-node allocation */
+typedef struct __pmFlatHashNode {
+    unsigned int	key;
+    unsigned int	dist;		/* probe distance + 1, 0 => empty */
+    void		*data;
+} __pmFlatHashNode;
+typedef struct __pmFlatHashCtl {
+    int			nodes;
+    int			hsize;		/* always a power of 2 */
+    __pmFlatHashNode	*hash;
+    unsigned int	start;		/* __pmFlatHashWalk origin slot */
+    unsigned int	index;		/* __pmFlatHashWalk position */
+} __pmFlatHashCtl;
+PCP_CALL extern void __pmFlatHashInit(__pmFlatHashCtl *);
+PCP_CALL extern int __pmFlatHashPreAlloc(int, __pmFlatHashCtl *);
+typedef __pmHashWalkState(*__pmFlatHashWalkCallback)(const __pmFlatHashNode *, void *);
+PCP_CALL extern void __pmFlatHashWalkCB(__pmFlatHashWalkCallback, void *, const __pmFlatHashCtl *);
+PCP_CALL extern __pmFlatHashNode *__pmFlatHashWalk(__pmFlatHashCtl *, __pmHashWalkState);
+PCP_CALL extern __pmFlatHashNode *__pmFlatHashSearch(unsigned int, __pmFlatHashCtl *);
+PCP_CALL extern int __pmFlatHashAdd(unsigned int, void *, __pmFlatHashCtl *);
+PCP_CALL extern int __pmFlatHashDel(unsigned int, void *, __pmFlatHashCtl *);
+PCP_CALL extern void __pmFlatHashClear(__pmFlatHashCtl *);
+PCP_CALL extern void __pmFlatHashFree(__pmFlatHashCtl *);
+
 
 /*
  * Host specification allowing one or more pmproxy host, and port numbers
@@ -572,6 +621,7 @@ typedef struct {
     off_t	position;	/* current uncompressed file position */
     void	*priv;		/* private data, e.g. for fd, blk cache, etc */
 } __pmFILE;
+struct iovec;
 typedef struct __pm_fops {
     void	*(*__pmopen)(__pmFILE *, const char *, const char *);
     void        *(*__pmfdopen)(__pmFILE *, int, const char *);
@@ -581,6 +631,7 @@ typedef struct __pm_fops {
     int         (*__pmfgetc)(__pmFILE *);
     size_t	(*__pmread)(void *, size_t, size_t, __pmFILE *);
     size_t	(*__pmwrite)(void *, size_t, size_t, __pmFILE *);
+    size_t	(*__pmwritev)(const struct iovec *, int, __pmFILE *);	/* optional */
     int         (*__pmflush)(__pmFILE *);
     int         (*__pmfsync)(__pmFILE *);
     int		(*__pmfileno)(__pmFILE *);
@@ -604,6 +655,7 @@ PCP_CALL extern long __pmFtell(__pmFILE *);
 PCP_CALL extern int __pmFgetc(__pmFILE *);
 PCP_CALL extern size_t __pmFread(void *, size_t, size_t, __pmFILE *);
 PCP_CALL extern size_t __pmFwrite(void *, size_t, size_t, __pmFILE *);
+PCP_CALL extern size_t __pmFwritev(const struct iovec *, int, __pmFILE *);
 PCP_CALL extern int __pmFflush(__pmFILE *);
 PCP_CALL extern int __pmFsync(__pmFILE *);
 PCP_CALL extern off_t __pmLseek(__pmFILE *, off_t, int);
@@ -789,6 +841,45 @@ typedef struct {
     off_t		off_data;	/* end of data file */
 } __pmLogTI;
 
+/*
+ * PMID sidecar index (<archive>.pmidx) ... for each PMID, the runs of
+ * consecutive data volume records that contain a value for it, so a
+ * fetch of a few metrics can seek past the records it does not need.
+ * Built by pmlogger -X or pmlogindex(1), see e_pmidx.c
+ */
+typedef struct {
+    int			vol;		/* data volume no. */
+    int			len;		/* record length incl header and trailer */
+    off_t		off;		/* offset of record header in volume */
+} __pmLogPmidxRec;
+
+typedef struct {
+    int			first;		/* first record no. in the run */
+    int			count;		/* no. of consecutive records */
+} __pmLogPmidxRun;
+
+typedef struct {
+    pmID		pmid;		/* PM_ID_NULL for <mark> records */
+    int			nrun;
+    int			maxrun;
+    __pmLogPmidxRun	*run;
+} __pmLogPmidxMetric;
+
+typedef struct {
+    int			nrec;		/* records, in volume/offset order */
+    int			maxrec;
+    __pmLogPmidxRec	*rec;
+    int			nmetric;	/* sorted by PMID once loaded */
+    int			maxmetric;
+    __pmLogPmidxMetric	*metric;
+    __pmFlatHashCtl	hash;		/* (when writing) PMID -> metric[] */
+    int			nwant;		/* (when reading) PMIDs and the */
+    pmID		*want;		/*   records selected for them */
+    int			nsel;
+    __pmLogPmidxRun	*sel;
+    int			stale;		/* (when reading) offsets do not match */
+} __pmLogPmidx;
+
 /*
  * Log/Archive Control
  */
@@ -818,6 +909,8 @@ typedef struct {
     __pmTimestamp endtime;	/* (when reading) timestamp at logical EOF */
     int		numti;		/* (when reading) no. temporal index entries */
     __pmLogTI	*ti;		/* (when reading) temporal index */
+    int		tisorted;	/* (when reading) ti[] in time/vol/offset order */
+    __pmLogPmidx *pmidx;	/* PMID sidecar index, NULL if none */
     struct __pmnsTree *pmns;	/* namespace from meta data */
     int		numpmid;	/* no. names in namespace */
     int		multi;		/* part of a multi-archive context */
@@ -828,6 +921,7 @@ typedef struct {
 #define PM_LOG_STATE_INIT	1
 
 PCP_CALL extern int __pmEncodeResult(const __pmLogCtl *, const __pmResult *, __pmPDU **);
+PCP_CALL extern int __pmEncodeResultView(const __pmLogCtl *, const __pmResultView *, __pmPDU **);
 
 /*
  * Minimal information to retain for each archive in a multi-archive context
@@ -868,6 +962,13 @@ typedef struct {
     int			ac_num_logs;	/* The number of archives */
     int			ac_cur_log;	/* The currently open archive */
     __pmMultiLogCtl	**ac_log_list;	/* Current set of archives */
+    /*
+     * PMIDs wanted by the fetch in progress, used to skip data records
+     * via the PMID sidecar index ... only set within __pmLogFetch()
+     */
+    int			ac_pmidx_nwant;
+    pmID		*ac_pmidx_want;
+    void		*ac_readahead;	/* used in logutil.c */
 } __pmArchCtl;
 
 /*
@@ -934,14 +1035,20 @@ PCP_CALL extern size_t __pmLogLabelSize(const __pmLogCtl *);
 PCP_CALL extern int __pmLogChkLabel(__pmArchCtl *, __pmFILE *, __pmLogLabel *, int);
 PCP_CALL extern int __pmLogCreate(const char *, const char *, int, __pmArchCtl *, int);
 PCP_CALL extern __pmFILE *__pmLogNewFile(const char *, int);
+PCP_CALL extern int __pmLogSetCompress(const char *);
 PCP_CALL extern void __pmLogClose(__pmArchCtl *);
 PCP_CALL extern int __pmLogPutDesc(__pmArchCtl *, const pmDesc *, int, char **);
 PCP_CALL extern int __pmLogPutInDom(__pmArchCtl *, int, const __pmLogInDom * const);
 PCP_CALL extern int __pmLogPutResult(__pmArchCtl *, __pmPDU *);
 PCP_CALL extern int __pmLogPutResult2(__pmArchCtl *, __pmPDU *);
 PCP_CALL extern int __pmLogPutResult3(__pmArchCtl *, __pmPDU *);
+PCP_CALL extern int __pmLogPutResultv(__pmArchCtl *, int, __pmPDU **);
 PCP_CALL extern int __pmLogPutIndex(const __pmArchCtl *, const __pmTimestamp *);
 PCP_CALL extern int __pmLogLoadIndex(__pmLogCtl *);
+PCP_CALL extern int __pmLogPmidxAddRecord(__pmLogPmidx *, int, off_t, int);
+PCP_CALL extern int __pmLogPmidxAddPMID(__pmLogPmidx *, int, pmID);
+PCP_CALL extern int __pmLogPutPmidx(const char *, const __pmLogLabel *, __pmLogPmidx *);
+PCP_CALL extern void __pmLogFreePmidx(__pmLogPmidx *);
 PCP_CALL extern int __pmLogEncodeLabels(__pmLogCtl *, unsigned int, unsigned int, int, pmLabelSet *, const __pmTimestamp *, __int32_t **);
 PCP_CALL extern int __pmLogPutLabels(__pmArchCtl *, unsigned int, unsigned int, int, pmLabelSet *, const __pmTimestamp *);
 PCP_CALL extern int __pmLogPutText(__pmArchCtl *, unsigned int, unsigned int, char *, int);
@@ -963,6 +1070,19 @@ PCP_CALL extern int __pmLogRead(__pmArchCtl *, int, __pmFILE *, __pmResult **, i
 PCP_CALL extern int __pmLogRead_ctx(__pmContext *, int, __pmFILE *, __pmResult **, int);
 PCP_CALL extern int __pmLogChangeVol(__pmArchCtl *, int);
 PCP_CALL extern int __pmLogFetch(__pmContext *, int, pmID *, __pmResult **);
+
+/* process-wide cache of archive records shared by interpolating contexts */
+typedef struct {
+    __uint64_t		hits;		/* records found in the cache */
+    __uint64_t		misses;		/* records read from the archive */
+    __uint64_t		evictions;	/* records discarded to stay within limit */
+    __uint64_t		bytes;		/* approx memory held by cached records */
+    __uint64_t		limit;		/* max bytes, 0 to disable */
+    unsigned int	entries;	/* records currently cached */
+} __pmLogCacheStats;
+PCP_CALL extern void __pmLogCacheSetLimit(size_t);
+PCP_CALL extern void __pmLogCacheGetStats(__pmLogCacheStats *);
+
 PCP_CALL extern int __pmLogGetInDom(__pmArchCtl *, pmInDom, __pmTimestamp *, int **, char ***);
 PCP_CALL extern int __pmGetArchiveEnd(__pmArchCtl *, __pmTimestamp *);
 PCP_CALL extern int __pmLogLookupDesc(__pmArchCtl *, pmID, pmDesc *);
@@ -1434,6 +1554,7 @@ PCP_CALL extern int __pmSetRequestTimeout(double);
 
 /* instance profile methods */
 PCP_CALL extern int __pmInProfile(pmInDom, const pmProfile *, int);
+PCP_CALL extern pmInDomProfile *__pmFindProfile(pmInDom, const pmProfile *);
 
 /* instance equvalence method */
 PCP_CALL extern int __pmEquivInDom(pmInDom, pmInDom);
@@ -76,6 +76,14 @@ typedef struct pmdaMetric {
  */
 typedef int (*pmdaFetchCallBack)(pmdaMetric *, unsigned int, pmAtomValue *);
 
+/*
+ * Type of function call back used by pmdaFetch to fill the values for
+ * all of the instances of one metric in a single call: instance list,
+ * and then an array each of values and pmdaFetchCallBack-style return
+ * codes, one per instance.
+ */
+typedef int (*pmdaFetchBatchCallBack)(pmdaMetric *, int, const int *, pmAtomValue *, int *);
+
 /*
  * return values for a pmdaFetchCallBack method
  */
@@ -456,6 +464,12 @@ typedef struct pmdaOptions {
  *      pmAtom structure with a metrics value. This must be set if pmdaFetch is
  *      used as the fetch callback.
  *
+ * pmdaSetFetchBatchCallBack
+ *      Allows an application specific routine to be specified for filling
+ *      the values of all instances of a metric in one call from pmdaFetch.
+ *      Returning PM_ERR_NYI for a metric selects the per-instance fetch
+ *      callback for that metric instead.
+ *
  * pmdaSetCheckCallBack
  *      Allows an application specific routine to be called upon receipt of any
  *      PDU. For all PDUs except PDU_PROFILE, a result less than zero
@@ -499,6 +513,7 @@ PMDA_CALL extern void pmdaSendError(pmdaInterface *, int);
 
 PMDA_CALL extern void pmdaSetResultCallBack(pmdaInterface *, pmdaResultCallBack);
 PMDA_CALL extern void pmdaSetFetchCallBack(pmdaInterface *, pmdaFetchCallBack);
+PMDA_CALL extern void pmdaSetFetchBatchCallBack(pmdaInterface *, pmdaFetchBatchCallBack);
 PMDA_CALL extern void pmdaSetCheckCallBack(pmdaInterface *, pmdaCheckCallBack);
 PMDA_CALL extern void pmdaSetDoneCallBack(pmdaInterface *, pmdaDoneCallBack);
 PMDA_CALL extern void pmdaSetEndContextCallBack(pmdaInterface *, pmdaEndContextCallBack);
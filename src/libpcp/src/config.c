@@ -557,6 +557,16 @@ extern const char *compress_suffix_list(void);
 #else
 #define LZMA_DECOMPRESS		disabled
 #endif
+#if defined(HAVE_ZSTD_DECOMPRESSION)
+#define ZSTD_DECOMPRESS		enabled
+#else
+#define ZSTD_DECOMPRESS		disabled
+#endif
+#if defined(HAVE_GZIP_DECOMPRESSION)
+#define GZIP_DECOMPRESS		enabled
+#else
+#define GZIP_DECOMPRESS		disabled
+#endif
 #if defined(HAVE_TRANSPARENT_DECOMPRESSION)
 #define TRANSPARENT_DECOMPRESS	enabled
 #else
@@ -596,6 +606,8 @@ static struct {
 	{ "v3_archives",	enabled },			/* from pcp-6.0.0 */
 	{ "archive_features",	myfeatures },			/* from pcp-6.0.0 */
 	{ "y2038_safe",		Y2038_SAFE },			/* from pcp-6.3.0 */
+	{ "zstd_decompress",	ZSTD_DECOMPRESS },		/* from pcp-7.0.0 */
+	{ "gzip_decompress",	GZIP_DECOMPRESS },		/* from pcp-7.0.0 */
 };
 
 void
@@ -844,6 +844,33 @@ expandArchiveList(const char *names)
     return newlist;
 }
 
+/*
+ * Start read-ahead (if enabled) for the comma-separated archive names
+ * in list, until all of the read-ahead slots are busy.
+ */
+static void
+readAheadList(__pmArchCtl *acp, const char *list)
+{
+    char	name[MAXPATHLEN];
+    const char	*end;
+    size_t	len;
+
+    while (*list) {
+	if ((end = strchr(list, ',')) == NULL)
+	    end = list + strlen(list);
+	len = end - list;
+	if (len < sizeof(name)) {
+	    memcpy(name, list, len);
+	    name[len] = '\0';
+	    if (__pmLogReadAhead(acp, name) == 0)
+		break;
+	}
+	if (*end == '\0')
+	    break;
+	list = end + 1;
+    }
+}
+
 /*
  * Initialize the given archive(s) for this context.
  *
@@ -893,6 +920,9 @@ initarchive(__pmContext	*ctxp, const char *name)
     acp->ac_mark_done = 0;
     acp->ac_flags = ctxp->c_flags;
     acp->ac_meta_loaded = 0;
+    acp->ac_pmidx_nwant = 0;
+    acp->ac_pmidx_want = NULL;
+    __pmLogReadAheadInit(acp);
 
     /*
      * The list of names may contain one or more directories. Examine the
@@ -918,6 +948,13 @@ initarchive(__pmContext	*ctxp, const char *name)
 	    *end = '\0';
 	}
 
+	/*
+	 * With read-ahead, start opening the next archives in the list
+	 * while this one (and its metadata) is being loaded.
+	 */
+	if (end != NULL && acp->ac_readahead != NULL)
+	    readAheadList(acp, end + 1);
+
 	/*
 	 * Obtain a handle for the named archive.
 	 * __pmFindOrOpenArchive() will take care of closing the active archive,
@@ -1061,6 +1098,7 @@ initarchive(__pmContext	*ctxp, const char *name)
 	    goto error;
 	}
     }
+    __pmLogReadAheadSchedule(acp, PM_MODE_FORW);
 
     /* start after header + label record + trailer */
     ctxp->c_origin = acp->ac_log->label.start;
@@ -1104,6 +1142,7 @@ initarchive(__pmContext	*ctxp, const char *name)
 	}
 	free(acp->ac_log_list);
     }
+    __pmLogReadAheadFree(acp);
     if (acp->ac_log && --acp->ac_log->refcnt == 0)
 	free(acp->ac_log);
     free(acp);
@@ -1574,6 +1613,7 @@ pmDupContext(void)
 	tmpcon.c_archctl->ac_pmid_hc.nodes = 0;
 	tmpcon.c_archctl->ac_pmid_hc.hsize = 0;
 	tmpcon.c_archctl->ac_cache = NULL;
+	__pmLogReadAheadInit(tmpcon.c_archctl);
 
 	/*
 	 * Need a new ac_mfp, but pointing at the same volume so ac_offset
@@ -51,6 +51,21 @@ typedef struct {		/* one value in the expression tree */
     int		vlen;		/* from vlen of pmValueBlock for string and aggregates */
 } val_t;
 
+typedef struct {		/* compiled form of a binary operator node */
+    int			ctype;		/* type used for the computation */
+    int			relop;		/* 1 if result is cast back to U32 */
+    int			maxlen;		/* allocated length of arrays below */
+    int			npair;		/* number of matched instance pairs */
+    int			*lpair;		/* left ivlist[] index for each pair */
+    int			*rpair;		/* right ivlist[] index for each pair */
+    int			nlinst;		/* left instances when pairs matched */
+    int			*linst;
+    int			nrinst;		/* right instances when pairs matched */
+    int			*rinst;
+    pmAtomValue		*lvec;		/* left operands, promoted and scaled */
+    pmAtomValue		*rvec;		/* right operands, promoted and scaled */
+} binop_t;
+
 typedef struct {		/* dynamic information for an expression node */
     pmID		pmid;
     int			numval;		/* length of ivlist[] */
@@ -63,6 +78,10 @@ typedef struct {		/* dynamic information for an expression node */
     val_t		*last_ivlist;	/* values from previous fetch for delta() or rate() */
     struct timespec	last_stamp;	/* timestamp from previous fetch for rate() */
     int			bind;		/* for N_COLON: BIND_LEFT, _RIGHT or _BOTH */
+    binop_t		*binop;		/* for binary operators, once evaluated */
+    int			nref;		/* other parents sharing this node */
+    unsigned int	seq;		/* fetchseq when shared node evaluated */
+    int			sts;		/* and the result of that evaluation */
 } info_t;
 
 typedef struct {			/* for instance filtering */
@@ -131,6 +150,8 @@ typedef struct {
     int			glob_last;	/* last global metric added */
     int			fetch_has_dm;	/* ==1 if pmResult rewrite needed */
     int			numpmid;	/* from pmFetch before rewrite */
+    unsigned int	fetchseq;	/* bumped for each pmFetch rewrite */
+    __pmHashCtl		share;		/* common subexpressions, see share_expr() */
 } ctl_t;
 
 /* node_t types */
@@ -190,6 +211,7 @@ extern int __dmdesc(__pmContext *, int, pmID, pmDesc *) _PCP_HIDDEN;
 extern int __dmprefetch(__pmContext *, int, const pmID *, pmID **) _PCP_HIDDEN;
 extern void __dmpostfetch(__pmContext *, __pmResult **) _PCP_HIDDEN;
 extern void __dmdumpexpr(node_t *, int) _PCP_HIDDEN;
+extern void __dmfreebinop(binop_t *) _PCP_HIDDEN;
 extern char *__dmnode_type_str(int) _PCP_HIDDEN;
 extern int __dmhelptext(pmID, int, char **) _PCP_HIDDEN;
 
@@ -661,6 +661,351 @@ bin_op(int type, int op, pmAtomValue a, int ltype, int lmul, int ldiv, pmAtomVal
     return res;
 }
 
+/*
+ * Compiled binary operators.
+ *
+ * Rather than calling bin_op() for each pair of operand values, with
+ * type promotion and operator selection switched on for every value,
+ * a binary operator node is "compiled" the first time it is evaluated
+ * (see binop_compile()) to fix the computation type, then each fetch
+ * promotes all of the operand values in one pass, applies the operator
+ * to the whole vector in a type-specialised loop, and (for relational
+ * operators) casts the results back to U32 in another pass.
+ *
+ * The left-right instance pairing is also remembered between fetches
+ * and re-used, provided the instances of both operands are unchanged.
+ *
+ * PCP_DERIVED_NOCOMPILE in the environment selects the bin_op() path
+ * instead, which is useful for comparison.
+ */
+static int	nocompile = -1;
+
+void
+__dmfreebinop(binop_t *bp)
+{
+    free(bp->lpair);
+    free(bp->rpair);
+    free(bp->linst);
+    free(bp->rinst);
+    free(bp->lvec);
+    free(bp->rvec);
+    free(bp);
+}
+
+static binop_t *
+binop_compile(node_t *np)
+{
+    binop_t	*bp;
+
+    if ((bp = (binop_t *)calloc(1, sizeof(binop_t))) == NULL) {
+	pmNoMem("binop_compile", sizeof(binop_t), PM_FATAL_ERR);
+	/*NOTREACHED*/
+    }
+    if (np->type == N_LT || np->type == N_LEQ || np->type == N_EQ ||
+	np->type == N_GEQ || np->type == N_GT || np->type == N_NEQ ||
+	np->type == N_AND || np->type == N_OR) {
+	/* compare with operand type promotion, then cast to U32 */
+	bp->relop = 1;
+	bp->ctype = promote[np->left->desc.type][np->right->desc.type];
+    }
+    else
+	bp->ctype = np->desc.type;
+    bp->nlinst = bp->nrinst = -1;	/* no instances matched yet */
+    np->data.info->binop = bp;
+    return bp;
+}
+
+static void
+binop_grow(binop_t *bp, int len)
+{
+    size_t	need;
+
+    if (len <= bp->maxlen)
+	return;
+    need = len * sizeof(int);
+    if ((bp->lpair = (int *)realloc(bp->lpair, need)) == NULL ||
+	(bp->rpair = (int *)realloc(bp->rpair, need)) == NULL ||
+	(bp->linst = (int *)realloc(bp->linst, need)) == NULL ||
+	(bp->rinst = (int *)realloc(bp->rinst, need)) == NULL) {
+	pmNoMem("binop_grow: pairs", need, PM_FATAL_ERR);
+	/*NOTREACHED*/
+    }
+    need = len * sizeof(pmAtomValue);
+    if ((bp->lvec = (pmAtomValue *)realloc(bp->lvec, need)) == NULL ||
+	(bp->rvec = (pmAtomValue *)realloc(bp->rvec, need)) == NULL) {
+	pmNoMem("binop_grow: values", need, PM_FATAL_ERR);
+	/*NOTREACHED*/
+    }
+    bp->maxlen = len;
+}
+
+/*
+ * Match left and right operand instances, returning the number of
+ * pairs ... same algorithm as the bin_op() path in eval_expr(), but
+ * only done again if the instances of either operand have changed.
+ */
+static int
+binop_pairs(node_t *np, binop_t *bp, int numval)
+{
+    info_t	*lp = np->left->data.info;
+    info_t	*rp = np->right->data.info;
+    int		lnull = (np->left->desc.indom == PM_INDOM_NULL);
+    int		rnull = (np->right->desc.indom == PM_INDOM_NULL);
+    int		i, j, k;
+
+    binop_grow(bp, lp->numval > rp->numval ? lp->numval : rp->numval);
+
+    if (bp->nlinst == lp->numval && bp->nrinst == rp->numval) {
+	for (i = 0; i < lp->numval; i++) {
+	    if (bp->linst[i] != lp->ivlist[i].inst)
+		break;
+	}
+	if (i == lp->numval) {
+	    for (j = 0; j < rp->numval; j++) {
+		if (bp->rinst[j] != rp->ivlist[j].inst)
+		    break;
+	    }
+	    if (j == rp->numval)
+		/* same instances as last time, same pairs */
+		return bp->npair;
+	}
+    }
+
+    for (i = j = k = 0; k < numval; ) {
+	if (i >= lp->numval || j >= rp->numval)
+	    /* run out of operand instances, quit */
+	    break;
+	if (!lnull && !rnull && lp->ivlist[i].inst != rp->ivlist[j].inst) {
+	    /* left ith inst != right jth inst ... search in right */
+	    if ((pmDebugOptions.derive && pmDebugOptions.appl2) &&
+		np->left->type != N_FILTERINST &&
+		np->right->type != N_FILTERINST) {
+		fprintf(stderr, "binop_pairs: %s: inst[%d] mismatch left [%d]=%d right [%d]=%d\n",
+		    __dmnode_type_str(np->type), k,
+		    i, lp->ivlist[i].inst, j, rp->ivlist[j].inst);
+	    }
+	    for (j = 0; j < rp->numval; j++) {
+		if (lp->ivlist[i].inst == rp->ivlist[j].inst)
+		    break;
+	    }
+	    if (j == rp->numval) {
+		/* no match, next left instance and rescan right */
+		i++;
+		j = 0;
+		continue;
+	    }
+	    if ((pmDebugOptions.derive && pmDebugOptions.appl2) &&
+		np->left->type != N_FILTERINST &&
+		np->right->type != N_FILTERINST) {
+		fprintf(stderr, "binop_pairs: recover @ right [%d]=%d\n", j, rp->ivlist[j].inst);
+	    }
+	}
+	bp->lpair[k] = i;
+	bp->rpair[k] = j;
+	k++;
+	if (!lnull) {
+	    i++;
+	    if (!rnull) {
+		j++;
+		if (j >= rp->numval)
+		    j = 0;
+	    }
+	}
+	else if (!rnull)
+	    j++;
+    }
+    bp->npair = k;
+
+    for (i = 0; i < lp->numval; i++)
+	bp->linst[i] = lp->ivlist[i].inst;
+    bp->nlinst = lp->numval;
+    for (j = 0; j < rp->numval; j++)
+	bp->rinst[j] = rp->ivlist[j].inst;
+    bp->nrinst = rp->numval;
+
+    return bp->npair;
+}
+
+/*
+ * Gather operand values for each pair into vec[], promoted from type
+ * to ctype (and scaled for DOUBLE) as bin_op() does for one value.
+ */
+static void
+binop_gather(pmAtomValue *vec, const val_t *ivlist, const int *pair, int n,
+		int type, int ctype, int mul, int div)
+{
+    int		k;
+
+#define GATHER(to, from) \
+    for (k = 0; k < n; k++) vec[k].to = ivlist[pair[k]].value.from
+
+    switch (ctype) {
+	case PM_TYPE_64:
+	    if (type == PM_TYPE_32) { GATHER(ll, l); return; }
+	    if (type == PM_TYPE_U32) { GATHER(ll, ul); return; }
+	    break;
+	case PM_TYPE_U64:
+	    if (type == PM_TYPE_32) { GATHER(ull, l); return; }
+	    if (type == PM_TYPE_U32) { GATHER(ull, ul); return; }
+	    break;
+	case PM_TYPE_FLOAT:
+	    switch (type) {
+		case PM_TYPE_32: GATHER(f, l); return;
+		case PM_TYPE_U32: GATHER(f, ul); return;
+		case PM_TYPE_64: GATHER(f, ll); return;
+		case PM_TYPE_U64: GATHER(f, ull); return;
+	    }
+	    break;
+	case PM_TYPE_DOUBLE:
+	    switch (type) {
+		case PM_TYPE_32: GATHER(d, l); break;
+		case PM_TYPE_U32: GATHER(d, ul); break;
+		case PM_TYPE_64: GATHER(d, ll); break;
+		case PM_TYPE_U64: GATHER(d, ull); break;
+		case PM_TYPE_FLOAT: GATHER(d, f); break;
+		default: GATHER(d, d); break;
+	    }
+	    for (k = 0; k < n; k++)
+		vec[k].d = (vec[k].d / div) * mul;
+	    return;
+    }
+    /* no promotion needed */
+    for (k = 0; k < n; k++)
+	vec[k] = ivlist[pair[k]].value;
+#undef GATHER
+}
+
+/*
+ * l[k] = l[k] <op> r[k] for all k, in the type ctype
+ */
+static void
+binop_apply(int ctype, int op, pmAtomValue *l, const pmAtomValue *r, int n)
+{
+    int		k;
+
+#define APPLY(f, expr) \
+    for (k = 0; k < n; k++) l[k].f = (expr)
+#define APPLY_OPS(f, name) \
+    switch (op) { \
+	case N_PLUS:  APPLY(f, l[k].f + r[k].f); break; \
+	case N_MINUS: APPLY(f, l[k].f - r[k].f); break; \
+	case N_STAR:  APPLY(f, l[k].f * r[k].f); break; \
+	case N_LT:    APPLY(f, l[k].f < r[k].f); break; \
+	case N_LEQ:   APPLY(f, l[k].f <= r[k].f); break; \
+	case N_EQ:    APPLY(f, l[k].f == r[k].f); break; \
+	case N_GEQ:   APPLY(f, l[k].f >= r[k].f); break; \
+	case N_GT:    APPLY(f, l[k].f > r[k].f); break; \
+	case N_NEQ:   APPLY(f, l[k].f != r[k].f); break; \
+	case N_AND:   APPLY(f, (l[k].f != 0) && (r[k].f != 0)); break; \
+	case N_OR:    APPLY(f, (l[k].f != 0) || (r[k].f != 0)); break; \
+	case N_SLASH: \
+	    if (ctype == PM_TYPE_DOUBLE) { \
+		APPLY(f, l[k].f == 0 ? 0 : l[k].f / r[k].f); break; \
+	    } \
+	    /*FALLTHROUGH*/ \
+	default:	/* should not happen */ \
+	    fprintf(stderr, "binop_apply: botch: " name " op=%d\n", op); \
+	    APPLY(f, 0); \
+	    break; \
+    }
+
+    switch (ctype) {
+	case PM_TYPE_32:
+	    APPLY_OPS(l, "32");
+	    break;
+	case PM_TYPE_U32:
+	    APPLY_OPS(ul, "U32");
+	    break;
+	case PM_TYPE_64:
+	    APPLY_OPS(ll, "64");
+	    break;
+	case PM_TYPE_U64:
+	    APPLY_OPS(ull, "U64");
+	    break;
+	case PM_TYPE_FLOAT:
+	    APPLY_OPS(f, "FLOAT");
+	    break;
+	case PM_TYPE_DOUBLE:
+	    APPLY_OPS(d, "DOUBLE");
+	    break;
+	default:	/* should not happen */
+	    fprintf(stderr, "binop_apply: botch: type=%d is invalid\n", ctype);
+	    APPLY(ll, 0);
+	    break;
+    }
+#undef APPLY_OPS
+#undef APPLY
+}
+
+/*
+ * Evaluate a binary operator node with both operands having values,
+ * filling np->data.info->ivlist[] (already allocated for numval
+ * values) and returning the number of values.
+ */
+static int
+binop_eval(node_t *np, int numval)
+{
+    info_t	*ip = np->data.info;
+    info_t	*lp = np->left->data.info;
+    info_t	*rp = np->right->data.info;
+    binop_t	*bp;
+    int		n, k;
+
+    if ((bp = ip->binop) == NULL)
+	bp = binop_compile(np);
+    n = binop_pairs(np, bp, numval);
+
+    binop_gather(bp->lvec, lp->ivlist, bp->lpair, n, np->left->desc.type,
+		    bp->ctype, lp->mul_scale, lp->div_scale);
+    binop_gather(bp->rvec, rp->ivlist, bp->rpair, n, np->right->desc.type,
+		    bp->ctype, rp->mul_scale, rp->div_scale);
+    binop_apply(bp->ctype, np->type, bp->lvec, bp->rvec, n);
+
+    if (bp->relop) {
+	switch (bp->ctype) {
+	    case PM_TYPE_32:
+		for (k = 0; k < n; k++)
+		    ip->ivlist[k].value.ul = (__uint32_t)bp->lvec[k].l;
+		break;
+	    case PM_TYPE_U32:
+		for (k = 0; k < n; k++)
+		    ip->ivlist[k].value.ul = (__uint32_t)bp->lvec[k].ul;
+		break;
+	    case PM_TYPE_64:
+		for (k = 0; k < n; k++)
+		    ip->ivlist[k].value.ul = (__uint32_t)bp->lvec[k].ll;
+		break;
+	    case PM_TYPE_U64:
+		for (k = 0; k < n; k++)
+		    ip->ivlist[k].value.ul = (__uint32_t)bp->lvec[k].ull;
+		break;
+	    case PM_TYPE_FLOAT:
+		for (k = 0; k < n; k++)
+		    ip->ivlist[k].value.ul = (__uint32_t)bp->lvec[k].f;
+		break;
+	    case PM_TYPE_DOUBLE:
+		for (k = 0; k < n; k++)
+		    ip->ivlist[k].value.ul = (__uint32_t)bp->lvec[k].d;
+		break;
+	}
+    }
+    else {
+	for (k = 0; k < n; k++)
+	    ip->ivlist[k].value = bp->lvec[k];
+    }
+
+    if (np->left->desc.indom != PM_INDOM_NULL) {
+	for (k = 0; k < n; k++)
+	    ip->ivlist[k].inst = lp->ivlist[bp->lpair[k]].inst;
+    }
+    else {
+	for (k = 0; k < n; k++)
+	    ip->ivlist[k].inst = rp->ivlist[bp->rpair[k]].inst;
+    }
+
+    return n;
+}
+
 /*
  * For regular expression instance matching, the hash list of observed
  * instances could grow without bounds for a dynamic indom.
@@ -808,14 +1153,42 @@ adjust_constant(__pmContext *ctxp, node_t *np)
     }
 }
 
+static int eval_node(__pmContext *, node_t *, struct timespec *, int,
+		pmValueSet **, int);
+
 /*
  * Walk an expression tree, filling in operand values from the
  * pmResult at the leaf nodes and propagating the computed values
  * towards the root node of the tree.
+ *
+ * Nodes shared between expressions (common subexpressions, see
+ * share_expr() in derive_parser.y) are only evaluated the first
+ * time they are reached in each fetch.
  */
 static int
 eval_expr(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
 		pmValueSet **vset, int level)
+{
+    info_t	*ip;
+    ctl_t	*cp = (ctl_t *)ctxp->c_dm;
+
+    if (np->type == N_PATTERN || (ip = np->data.info) == NULL || ip->nref == 0)
+	return eval_node(ctxp, np, stamp, numpmid, vset, level);
+
+    if (ip->seq != cp->fetchseq) {
+	ip->sts = eval_node(ctxp, np, stamp, numpmid, vset, level);
+	ip->seq = cp->fetchseq;
+    }
+    else if (pmDebugOptions.derive && pmDebugOptions.appl2) {
+	fprintf(stderr, "eval_expr: %s node " PRINTF_P_PFX "%p: shared, already evaluated\n",
+		__dmnode_type_str(np->type), np);
+    }
+    return ip->sts;
+}
+
+static int
+eval_node(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
+		pmValueSet **vset, int level)
 {
     int		sts;
     int		i;
@@ -1856,6 +2229,10 @@ eval_expr(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
 		pmNoMem("eval_expr: expr ivlist", np->data.info->numval*sizeof(val_t), PM_FATAL_ERR);
 		/*NOTREACHED*/
 	    }
+	    if (nocompile == 0) {
+		np->data.info->numval = binop_eval(np, np->data.info->numval);
+		return np->data.info->numval;
+	    }
 	    /*
 	     * ivlist[k] = left->ivlist[i] <op> right->ivlist[j]
 	     */
@@ -2243,6 +2620,16 @@ __dmpostfetch(__pmContext *ctxp, __pmResult **result)
     if (cp == NULL || cp->fetch_has_dm == 0)
 	return;
 
+    PM_LOCK(__pmLock_extcall);
+    if (nocompile == -1) {
+	/* PCP_DERIVED_NOCOMPILE in environment, use bin_op() per value */
+	if (getenv("PCP_DERIVED_NOCOMPILE") == NULL)	/* THREADSAFE */
+	    nocompile = 0;
+	else
+	    nocompile = 1;
+    }
+    PM_UNLOCK(__pmLock_extcall);
+
     if (pmDebugOptions.derive && pmDebugOptions.desperate) {
 	fprintf(stderr, "__dmpostfetch: from context before rewrite ...\n");
 	__pmPrintResult_ctx(ctxp, stderr, rp);
@@ -2254,6 +2641,7 @@ __dmpostfetch(__pmContext *ctxp, __pmResult **result)
     }
     newrp->numpmid = cp->numpmid;
     newrp->timestamp = rp->timestamp;
+    cp->fetchseq++;
 
     timestamp.tv_sec = rp->timestamp.sec;
     timestamp.tv_nsec = rp->timestamp.nsec;
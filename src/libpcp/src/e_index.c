@@ -26,6 +26,8 @@
 #include <sys/stat.h>
 #include <assert.h>
 
+extern __pm_fops __pm_stdio;
+
 /*
  * On-Disk Temporal Index Record, Version 3
  */
@@ -217,18 +219,63 @@ __pmLogPutIndex(const __pmArchCtl *acp, const __pmTimestamp *tsp)
 	return PM_ERR_LABEL;
 }
 
+/*
+ * Swab and copy one on-disk temporal index record ... copy first, the
+ * record may be in a read-only mapping of the file
+ */
+static void
+__pmLogDecodeIndex(const __pmLogCtl *lcp, const char *buffer, __pmLogTI *tip)
+{
+    if (__pmLogVersion(lcp) == PM_LOG_VERS03) {
+	__pmTI_v3	ti_v3;
+
+	memcpy(&ti_v3, buffer, sizeof(ti_v3));
+	__pmLoadTimestamp(&ti_v3.sec[0], &tip->stamp);
+	tip->vol = ntohl(ti_v3.vol);
+	__ntohll((char *)&ti_v3.off_meta[0]);
+	__ntohll((char *)&ti_v3.off_data[0]);
+	memcpy((void *)&tip->off_meta, (void *)&ti_v3.off_meta[0], 2*sizeof(__int32_t));
+	memcpy((void *)&tip->off_data, (void *)&ti_v3.off_data[0], 2*sizeof(__int32_t));
+    }
+    else {
+	/* __pmLogVersion(lcp) == PM_LOG_VERS02 */
+	__pmTI_v2	ti_v2;
+
+	memcpy(&ti_v2, buffer, sizeof(ti_v2));
+	__pmLoadTimeval(&ti_v2.sec, &tip->stamp);
+	tip->vol = ntohl(ti_v2.vol);
+	tip->off_meta = ntohl(ti_v2.off_meta);
+	tip->off_data = ntohl(ti_v2.off_data);
+    }
+}
+
+/*
+ * Load the whole temporal index in one pass ... the file is mapped
+ * read-only when it is a plain file, else (compressed) read with a
+ * single __pmFread.  A partial record at the end (index being written
+ * by pmlogger right now) is ignored.
+ *
+ * Also note if ti[] is in time, volume and offset order (as written
+ * by pmlogger), which allows __pmLogSetTime to binary search it.
+ */
 int
 __pmLogLoadIndex(__pmLogCtl *lcp)
 {
     int		sts = 0;
     __pmFILE	*f = lcp->tifp;
+    struct stat	sbuf;
     size_t	record_size;
+    size_t	label_size;
     size_t	bytes;
-    void	*buffer;
+    size_t	count;
+    size_t	i;
+    char	*map = NULL;
+    char	*buffer = NULL;
     __pmLogTI	*tip;
 
     lcp->numti = 0;
     lcp->ti = NULL;
+    lcp->tisorted = 1;
 
     if (__pmLogVersion(lcp) == PM_LOG_VERS03)
 	record_size = sizeof(__pmTI_v3);
@@ -237,69 +284,65 @@ __pmLogLoadIndex(__pmLogCtl *lcp)
     else
 	return PM_ERR_LABEL;
 
-    if ((buffer = (void *)malloc(record_size)) == NULL) {
-	pmNoMem("__pmLogLoadIndex: buffer", record_size, PM_RECOV_ERR);
+    if (f == NULL)
+	return 0;
+    if (__pmFstat(f, &sbuf) < 0)
+	return -oserror();
+    label_size = __pmLogLabelSize(lcp);
+    if (sbuf.st_size <= label_size)
+	return 0;
+    if ((count = (sbuf.st_size - label_size) / record_size) == 0)
+	return 0;
+
+    bytes = count * sizeof(__pmLogTI);
+    if ((lcp->ti = (__pmLogTI *)malloc(bytes)) == NULL) {
+	pmNoMem("__pmLogLoadIndex: TI", bytes, PM_FATAL_ERR);
 	return -oserror();
     }
 
-    if (lcp->tifp != NULL) {
-	__pmFseek(f, (long)__pmLogLabelSize(lcp), SEEK_SET);
-	for ( ; ; ) {
-	    __pmLogTI	*tmp;
-	    bytes = (1 + lcp->numti) * sizeof(__pmLogTI);
-	    tmp = (__pmLogTI *)realloc(lcp->ti, bytes);
-	    if (tmp == NULL) {
-		pmNoMem("__pmLogLoadIndex: realloc TI", bytes, PM_FATAL_ERR);
+    if (f->fops == &__pm_stdio)
+	map = (char *)__pmMemoryMap(__pmFileno(f), sbuf.st_size, 0);
+    if (map != NULL) {
+	buffer = map + label_size;
+    }
+    else {
+	bytes = count * record_size;
+	if ((buffer = (char *)malloc(bytes)) == NULL) {
+	    pmNoMem("__pmLogLoadIndex: buffer", bytes, PM_RECOV_ERR);
+	    sts = -oserror();
+	    goto bad;
+	}
+	__pmFseek(f, (long)label_size, SEEK_SET);
+	bytes = __pmFread(buffer, 1, bytes, f);
+	if (bytes != count * record_size) {
+	    if (__pmFerror(f)) {
+		__pmClearerr(f);
 		sts = -oserror();
 		goto bad;
 	    }
-	    lcp->ti = tmp;
-	    bytes = __pmFread(buffer, 1, record_size, f);
-	    if (bytes != record_size) {
-		if (__pmFeof(f)) {
-		    __pmClearerr(f);
-		    sts = 0; 
-		    break;
-		}
-	  	if (pmDebugOptions.log)
-	    	    fprintf(stderr, "%s: bad TI entry len=%zu: expected %zu\n",
-			    "__pmLogLoadIndex", bytes, record_size);
-		if (__pmFerror(f)) {
-		    __pmClearerr(f);
-		    sts = -oserror();
-		    goto bad;
-		}
-		else {
-		    sts = PM_ERR_LOGREC;
-		    goto bad;
-		}
-	    }
-	    tip = &lcp->ti[lcp->numti];
-	    /*
-	     * swab and copy fields
-	     */
-	    if (__pmLogVersion(lcp) == PM_LOG_VERS03) {
-		__pmTI_v3	*tip_v3 = (__pmTI_v3 *)buffer;
-		__pmLoadTimestamp(&tip_v3->sec[0], &tip->stamp);
-		tip->vol = ntohl(tip_v3->vol);
-		__ntohll((char *)&tip_v3->off_meta[0]);
-		__ntohll((char *)&tip_v3->off_data[0]);
-		memcpy((void *)&tip->off_meta, (void *)&tip_v3->off_meta[0], 2*sizeof(__int32_t));
-		memcpy((void *)&tip->off_data, (void *)&tip_v3->off_data[0], 2*sizeof(__int32_t));
-	    }
-	    else {
-		/* __pmLogVersion(lcp) == PM_LOG_VERS02 */
-		__pmTI_v2	*tip_v2 = (__pmTI_v2 *)buffer;
-		__pmLoadTimeval(&tip_v2->sec, &tip->stamp);
-		tip->vol = ntohl(tip_v2->vol);
-		tip->off_meta = ntohl(tip_v2->off_meta);
-		tip->off_data = ntohl(tip_v2->off_data);
-	    }
+	    __pmClearerr(f);
+	    count = bytes / record_size;
+	}
+    }
 
-	    lcp->numti++;
+    for (i = 0, tip = lcp->ti; i < count; i++, tip++) {
+	__pmLogDecodeIndex(lcp, &buffer[i * record_size], tip);
+	if (i > 0 && lcp->tisorted &&
+	    (tip->vol < tip[-1].vol ||
+	     __pmTimestampSub(&tip->stamp, &tip[-1].stamp) < 0 ||
+	     (tip->vol == tip[-1].vol && tip->off_data < tip[-1].off_data))) {
+	    if (pmDebugOptions.log)
+		fprintf(stderr, "%s: TI[%zu] out of order\n",
+			"__pmLogLoadIndex", i);
+	    lcp->tisorted = 0;
 	}
     }
-    free(buffer);
+    lcp->numti = count;
+
+    if (map != NULL)
+	__pmMemoryUnmap(map, sbuf.st_size);
+    else
+	free(buffer);
     return sts;
 
 bad:
@@ -0,0 +1,651 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * PMID sidecar index for archives.
+ *
+ * An archive data volume is a sequence of pmResult records, and the
+ * only way to find the records holding values for a given metric is
+ * to read and decode every one of them.  The optional <archive>.pmidx
+ * file records, for every data record, the volume, offset and length,
+ * and for every PMID the runs of consecutive records containing it.
+ * While a fetch is in progress __pmLogRead_ctx() uses this to seek
+ * directly to the next (or previous) record that holds one of the
+ * wanted PMIDs, or a <mark> record.
+ *
+ * The sidecar is strictly advisory ... it is tied to the archive via
+ * the label pid and start time, any offset that does not line up with
+ * a record boundary disables skipping, and before every seek the
+ * record header (or trailer) length at the destination is checked
+ * against the sidecar.
+ *
+ * Thread-safe notes:
+ *
+ * The loaded sidecar hangs off the __pmLogCtl and is only used with
+ * the context lock held.
+ */
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include "internal.h"
+#include <sys/stat.h>
+
+#define PM_LOG_PMIDX_MAGIC	0x50434958	/* "PCIX" */
+#define PM_LOG_PMIDX_VERS	1
+
+/*
+ * On-Disk PMID Sidecar Index, all fields in network byte order:
+ *
+ *	header (__pmPmidxHdr)
+ *	nrec x record (__pmPmidxRec), in volume and offset order
+ *	nmetric x { pmid, nrun, nrun x { first, count } }, in PMID order
+ */
+typedef struct {
+    __int32_t	magic;		/* PM_LOG_PMIDX_MAGIC */
+    __int32_t	version;	/* PM_LOG_PMIDX_VERS */
+    __int32_t	pid;		/* from archive label */
+    __int32_t	start[3];	/* __pmTimestamp, from archive label */
+    __int32_t	nrec;
+    __int32_t	nmetric;
+} __pmPmidxHdr;
+
+typedef struct {
+    __int32_t	vol;
+    __int32_t	len;
+    __int32_t	off[2];
+} __pmPmidxRec;
+
+/*
+ * Append a data record, return its record number.
+ */
+int
+__pmLogPmidxAddRecord(__pmLogPmidx *px, int vol, off_t off, int len)
+{
+    __pmLogPmidxRec	*rp;
+
+    if (px->nrec == px->maxrec) {
+	int	max = px->maxrec == 0 ? 256 : 2 * px->maxrec;
+
+	if ((rp = (__pmLogPmidxRec *)realloc(px->rec, max * sizeof(*rp))) == NULL)
+	    return -oserror();
+	px->rec = rp;
+	px->maxrec = max;
+    }
+    rp = &px->rec[px->nrec];
+    rp->vol = vol;
+    rp->off = off;
+    rp->len = len;
+    return px->nrec++;
+}
+
+/*
+ * Note that record recno (the last one added) contains pmid.
+ */
+int
+__pmLogPmidxAddPMID(__pmLogPmidx *px, int recno, pmID pmid)
+{
+    __pmFlatHashNode	*hp;
+    __pmLogPmidxMetric	*mp;
+    __pmLogPmidxRun	*runp;
+    int			sts;
+
+    if ((hp = __pmFlatHashSearch((unsigned int)pmid, &px->hash)) != NULL)
+	mp = &px->metric[(int)(__psint_t)hp->data];
+    else {
+	if (px->nmetric == px->maxmetric) {
+	    int	max = px->maxmetric == 0 ? 64 : 2 * px->maxmetric;
+
+	    if ((mp = (__pmLogPmidxMetric *)realloc(px->metric, max * sizeof(*mp))) == NULL)
+		return -oserror();
+	    px->metric = mp;
+	    px->maxmetric = max;
+	}
+	sts = __pmFlatHashAdd((unsigned int)pmid, (void *)(__psint_t)px->nmetric, &px->hash);
+	if (sts < 0)
+	    return sts;
+	mp = &px->metric[px->nmetric++];
+	mp->pmid = pmid;
+	mp->nrun = mp->maxrun = 0;
+	mp->run = NULL;
+    }
+
+    if (mp->nrun > 0) {
+	runp = &mp->run[mp->nrun - 1];
+	if (runp->first + runp->count == recno) {
+	    runp->count++;
+	    return 0;
+	}
+	if (runp->first + runp->count > recno)
+	    return 0;		/* already noted */
+    }
+    if (mp->nrun == mp->maxrun) {
+	int	max = mp->maxrun == 0 ? 4 : 2 * mp->maxrun;
+
+	if ((runp = (__pmLogPmidxRun *)realloc(mp->run, max * sizeof(*runp))) == NULL)
+	    return -oserror();
+	mp->run = runp;
+	mp->maxrun = max;
+    }
+    runp = &mp->run[mp->nrun++];
+    runp->first = recno;
+    runp->count = 1;
+    return 0;
+}
+
+/*
+ * Index a pmResult record as written to a data volume by logputresult()
+ * ... pb[] is the PDU-format buffer, so the timestamp starts at pb[3]
+ * and everything after the header is in network byte order.
+ */
+int
+__pmLogPmidxAddPDU(__pmLogPmidx *px, int vol, off_t off, int len, const __pmPDU *pb, int version)
+{
+    const __int32_t	*ip = (const __int32_t *)pb;
+    int			nwords = pb[0] / (int)sizeof(__int32_t);
+    int			k = version >= 3 ? 6 : 5;
+    int			numpmid, numval;
+    int			recno;
+    int			i, sts;
+
+    if ((recno = __pmLogPmidxAddRecord(px, vol, off, len)) < 0)
+	return recno;
+    if (k >= nwords)
+	return PM_ERR_IPC;
+    numpmid = ntohl(ip[k++]);
+    if (numpmid == 0)
+	return __pmLogPmidxAddPMID(px, recno, PM_ID_NULL);
+    for (i = 0; i < numpmid; i++) {
+	if (k + 1 >= nwords)
+	    return PM_ERR_IPC;
+	if ((sts = __pmLogPmidxAddPMID(px, recno, __ntohpmID(ip[k]))) < 0)
+	    return sts;
+	numval = ntohl(ip[k+1]);
+	k += 2;
+	if (numval > 0)
+	    k += 1 + 2 * numval;	/* valfmt, then (inst, value) pairs */
+    }
+    return 0;
+}
+
+static int
+metric_cmp(const void *a, const void *b)
+{
+    pmID	pa = (*(const __pmLogPmidxMetric **)a)->pmid;
+    pmID	pb = (*(const __pmLogPmidxMetric **)b)->pmid;
+
+    return pa < pb ? -1 : (pa > pb ? 1 : 0);
+}
+
+static int
+pmidx_write(__pmFILE *f, const void *buf, size_t bytes)
+{
+    if (__pmFwrite((void *)buf, 1, bytes, f) != bytes)
+	return -oserror();
+    return 0;
+}
+
+/*
+ * (Re)write <base>.pmidx for the records added so far ... written to a
+ * temporary file and renamed, so readers never see a partial sidecar.
+ */
+int
+__pmLogPutPmidx(const char *base, const __pmLogLabel *lp, __pmLogPmidx *px)
+{
+    char		fname[MAXPATHLEN];
+    char		tmpname[MAXPATHLEN];
+    __pmFILE		*f;
+    __pmPmidxHdr	hdr;
+    __pmPmidxRec	rec;
+    __pmLogPmidxMetric	**order;
+    __int32_t		buf[2];
+    __int64_t		off;
+    int			i, j;
+    int			sts = 0;
+
+    pmsprintf(fname, sizeof(fname), "%s.pmidx", base);
+    pmsprintf(tmpname, sizeof(tmpname), "%s.pmidx.tmp", base);
+    if ((order = (__pmLogPmidxMetric **)malloc((px->nmetric + 1) * sizeof(*order))) == NULL)
+	return -oserror();
+    for (i = 0; i < px->nmetric; i++)
+	order[i] = &px->metric[i];
+    qsort(order, px->nmetric, sizeof(*order), metric_cmp);
+
+    if ((f = __pmFopen(tmpname, "w")) == NULL) {
+	sts = -oserror();
+	free(order);
+	return sts;
+    }
+
+    hdr.magic = htonl(PM_LOG_PMIDX_MAGIC);
+    hdr.version = htonl(PM_LOG_PMIDX_VERS);
+    hdr.pid = htonl(lp->pid);
+    __pmPutTimestamp(&lp->start, &hdr.start[0]);
+    hdr.nrec = htonl(px->nrec);
+    hdr.nmetric = htonl(px->nmetric);
+    sts = pmidx_write(f, &hdr, sizeof(hdr));
+
+    for (i = 0; sts == 0 && i < px->nrec; i++) {
+	rec.vol = htonl(px->rec[i].vol);
+	rec.len = htonl(px->rec[i].len);
+	off = px->rec[i].off;
+	memcpy((void *)&rec.off[0], (void *)&off, sizeof(off));
+	__htonll((char *)&rec.off[0]);
+	sts = pmidx_write(f, &rec, sizeof(rec));
+    }
+
+    for (i = 0; sts == 0 && i < px->nmetric; i++) {
+	buf[0] = __htonpmID(order[i]->pmid);
+	buf[1] = htonl(order[i]->nrun);
+	sts = pmidx_write(f, buf, sizeof(buf));
+	for (j = 0; sts == 0 && j < order[i]->nrun; j++) {
+	    buf[0] = htonl(order[i]->run[j].first);
+	    buf[1] = htonl(order[i]->run[j].count);
+	    sts = pmidx_write(f, buf, sizeof(buf));
+	}
+    }
+    free(order);
+
+    if (__pmFclose(f) != 0 && sts == 0)
+	sts = -oserror();
+    if (sts == 0 && rename(tmpname, fname) < 0)
+	sts = -oserror();
+    if (sts < 0)
+	unlink(tmpname);
+
+    if (pmDebugOptions.log) {
+	char	errmsg[PM_MAXERRMSGLEN];
+
+	fprintf(stderr, "__pmLogPutPmidx(%s): %d records, %d metrics: %s\n",
+		fname, px->nrec, px->nmetric,
+		sts < 0 ? pmErrStr_r(sts, errmsg, sizeof(errmsg)) : "ok");
+    }
+    return sts;
+}
+
+void
+__pmLogFreePmidx(__pmLogPmidx *px)
+{
+    int		i;
+
+    for (i = 0; i < px->nmetric; i++)
+	free(px->metric[i].run);
+    free(px->metric);
+    free(px->rec);
+    free(px->want);
+    free(px->sel);
+    __pmFlatHashFree(&px->hash);
+    memset(px, 0, sizeof(*px));
+}
+
+/*
+ * Decode and sanity check the sidecar image in buf[0..bytes-1].
+ */
+static int
+pmidx_decode(__pmLogCtl *lcp, __pmLogPmidx *px, char *buf, size_t bytes)
+{
+    __pmPmidxHdr	*hp = (__pmPmidxHdr *)buf;
+    __pmPmidxRec	*rp;
+    __pmLogPmidxRec	*recp;
+    __pmLogPmidxMetric	*mp;
+    __pmTimestamp	start;
+    __int32_t		*ip, *end;
+    __int64_t		off;
+    int			nrec, nmetric;
+    int			i, j, last;
+
+    if (bytes < sizeof(*hp) ||
+	ntohl(hp->magic) != PM_LOG_PMIDX_MAGIC ||
+	ntohl(hp->version) != PM_LOG_PMIDX_VERS)
+	return PM_ERR_LOGREC;
+    __pmLoadTimestamp(&hp->start[0], &start);
+    if (ntohl(hp->pid) != lcp->label.pid ||
+	start.sec != lcp->label.start.sec || start.nsec != lcp->label.start.nsec)
+	return PM_ERR_LABEL;		/* stale, for some other archive */
+
+    nrec = ntohl(hp->nrec);
+    nmetric = ntohl(hp->nmetric);
+    if (nrec < 0 || nmetric < 0 ||
+	(bytes - sizeof(*hp)) / sizeof(*rp) < (size_t)nrec)
+	return PM_ERR_LOGREC;
+
+    if ((px->rec = (__pmLogPmidxRec *)malloc((nrec + 1) * sizeof(*recp))) == NULL ||
+	(px->metric = (__pmLogPmidxMetric *)calloc(nmetric + 1, sizeof(*mp))) == NULL)
+	return -oserror();
+    rp = (__pmPmidxRec *)&hp[1];
+    for (i = 0, recp = px->rec; i < nrec; i++, rp++, recp++) {
+	recp->vol = ntohl(rp->vol);
+	recp->len = ntohl(rp->len);
+	__ntohll((char *)&rp->off[0]);
+	memcpy((void *)&off, (void *)&rp->off[0], sizeof(off));
+	recp->off = off;
+	if (recp->off < __pmLogLabelSize(lcp) || recp->len < 4 * (int)sizeof(__int32_t))
+	    return PM_ERR_LOGREC;
+	if (i > 0 && (recp->vol < recp[-1].vol ||
+	    (recp->vol == recp[-1].vol && recp->off < recp[-1].off + recp[-1].len)))
+	    return PM_ERR_LOGREC;
+	px->nrec++;
+    }
+
+    ip = (__int32_t *)rp;
+    end = (__int32_t *)&buf[bytes];
+    for (i = 0, mp = px->metric; i < nmetric; i++, mp++) {
+	if (end - ip < 2)
+	    return PM_ERR_LOGREC;
+	mp->pmid = __ntohpmID(ip[0]);
+	mp->nrun = ntohl(ip[1]);
+	ip += 2;
+	if (i > 0 && mp->pmid <= mp[-1].pmid)
+	    return PM_ERR_LOGREC;
+	if (mp->nrun < 0 || (end - ip) / 2 < mp->nrun)
+	    return PM_ERR_LOGREC;
+	if ((mp->run = (__pmLogPmidxRun *)malloc((mp->nrun + 1) * sizeof(*mp->run))) == NULL)
+	    return -oserror();
+	px->nmetric++;
+	for (j = 0, last = 0; j < mp->nrun; j++, ip += 2) {
+	    mp->run[j].first = ntohl(ip[0]);
+	    mp->run[j].count = ntohl(ip[1]);
+	    if (mp->run[j].first < last || mp->run[j].count < 1 ||
+		mp->run[j].count > nrec - mp->run[j].first)
+		return PM_ERR_LOGREC;
+	    last = mp->run[j].first + mp->run[j].count;
+	}
+	mp->maxrun = mp->nrun;
+    }
+    px->maxrec = px->nrec;
+    px->maxmetric = px->nmetric;
+    return 0;
+}
+
+/*
+ * Load <archive>.pmidx if there is one and it belongs to this archive.
+ * Not finding a sidecar is not an error.
+ */
+int
+__pmLogLoadPmidx(__pmLogCtl *lcp)
+{
+    char		fname[MAXPATHLEN];
+    __pmLogPmidx	*px;
+    __pmFILE		*f;
+    struct stat		sbuf;
+    char		*buf;
+    int			sts;
+
+    lcp->pmidx = NULL;
+    pmsprintf(fname, sizeof(fname), "%s.pmidx", lcp->name);
+    if (access(fname, R_OK) < 0)
+	return 0;
+    if ((f = __pmFopen(fname, "r")) == NULL)
+	return -oserror();
+    if (__pmFstat(f, &sbuf) < 0) {
+	sts = -oserror();
+	__pmFclose(f);
+	return sts;
+    }
+    if ((buf = (char *)malloc(sbuf.st_size + 1)) == NULL) {
+	sts = -oserror();
+	__pmFclose(f);
+	return sts;
+    }
+    if (__pmFread(buf, 1, sbuf.st_size, f) != (size_t)sbuf.st_size) {
+	sts = __pmFerror(f) ? -oserror() : PM_ERR_LOGREC;
+	__pmFclose(f);
+	free(buf);
+	return sts;
+    }
+    __pmFclose(f);
+
+    if ((px = (__pmLogPmidx *)calloc(1, sizeof(*px))) == NULL) {
+	sts = -oserror();
+	free(buf);
+	return sts;
+    }
+    sts = pmidx_decode(lcp, px, buf, sbuf.st_size);
+    free(buf);
+    if (sts < 0) {
+	__pmLogFreePmidx(px);
+	free(px);
+	return sts;
+    }
+    if (pmDebugOptions.log)
+	fprintf(stderr, "__pmLogLoadPmidx(%s): %d records, %d metrics\n",
+		fname, px->nrec, px->nmetric);
+    lcp->pmidx = px;
+    return 0;
+}
+
+static int
+run_cmp(const void *a, const void *b)
+{
+    const __pmLogPmidxRun	*ra = (const __pmLogPmidxRun *)a;
+    const __pmLogPmidxRun	*rb = (const __pmLogPmidxRun *)b;
+
+    return ra->first - rb->first;
+}
+
+static __pmLogPmidxMetric *
+find_metric(__pmLogPmidx *px, pmID pmid)
+{
+    int		lo = 0, hi = px->nmetric - 1, mid;
+
+    while (lo <= hi) {
+	mid = (lo + hi) / 2;
+	if (px->metric[mid].pmid == pmid)
+	    return &px->metric[mid];
+	if (px->metric[mid].pmid < pmid)
+	    lo = mid + 1;
+	else
+	    hi = mid - 1;
+    }
+    return NULL;
+}
+
+/*
+ * Merge the runs for the wanted PMIDs (and <mark> records, which
+ * always matter) into px->sel[], unless we already have this set.
+ */
+static int
+select_records(__pmLogPmidx *px, int nwant, const pmID *want)
+{
+    __pmLogPmidxMetric	*mp;
+    __pmLogPmidxRun	*sel;
+    pmID		*copy;
+    int			nrun, n;
+    int			i, j;
+
+    if (px->nwant == nwant && memcmp(px->want, want, nwant * sizeof(pmID)) == 0)
+	return 0;
+
+    nrun = (mp = find_metric(px, PM_ID_NULL)) != NULL ? mp->nrun : 0;
+    for (i = 0; i < nwant; i++) {
+	if (want[i] != PM_ID_NULL && (mp = find_metric(px, want[i])) != NULL)
+	    nrun += mp->nrun;
+    }
+    if ((sel = (__pmLogPmidxRun *)malloc((nrun + 1) * sizeof(*sel))) == NULL)
+	return -oserror();
+    if ((copy = (pmID *)malloc((nwant + 1) * sizeof(*copy))) == NULL) {
+	free(sel);
+	return -oserror();
+    }
+    memcpy(copy, want, nwant * sizeof(pmID));
+
+    n = 0;
+    if ((mp = find_metric(px, PM_ID_NULL)) != NULL) {
+	memcpy(&sel[n], mp->run, mp->nrun * sizeof(*sel));
+	n += mp->nrun;
+    }
+    for (i = 0; i < nwant; i++) {
+	if (want[i] != PM_ID_NULL && (mp = find_metric(px, want[i])) != NULL) {
+	    memcpy(&sel[n], mp->run, mp->nrun * sizeof(*sel));
+	    n += mp->nrun;
+	}
+    }
+    qsort(sel, n, sizeof(*sel), run_cmp);
+    for (i = 0, j = -1; i < n; i++) {
+	if (j >= 0 && sel[i].first <= sel[j].first + sel[j].count) {
+	    if (sel[i].first + sel[i].count > sel[j].first + sel[j].count)
+		sel[j].count = sel[i].first + sel[i].count - sel[j].first;
+	}
+	else
+	    sel[++j] = sel[i];
+    }
+
+    free(px->sel);
+    free(px->want);
+    px->sel = sel;
+    px->nsel = j + 1;
+    px->want = copy;
+    px->nwant = nwant;
+    return 0;
+}
+
+/*
+ * Index into px->sel[] of the last run starting at or before recno,
+ * or -1 if there is none.
+ */
+static int
+find_run(__pmLogPmidx *px, int recno)
+{
+    int		lo = 0, hi = px->nsel - 1, mid;
+
+    while (lo <= hi) {
+	mid = (lo + hi) / 2;
+	if (px->sel[mid].first <= recno)
+	    lo = mid + 1;
+	else
+	    hi = mid - 1;
+    }
+    return hi;
+}
+
+/*
+ * Record no. of the record in vol starting (end == 0) or ending
+ * (end != 0) at offset, else -1.
+ */
+static int
+find_record(__pmLogPmidx *px, int vol, long offset, int end)
+{
+    int		lo = 0, hi = px->nrec - 1, mid;
+    off_t	off;
+
+    while (lo <= hi) {
+	mid = (lo + hi) / 2;
+	off = px->rec[mid].off;
+	if (end)
+	    off += px->rec[mid].len;
+	if (px->rec[mid].vol == vol && off == offset)
+	    return mid;
+	if (px->rec[mid].vol < vol || (px->rec[mid].vol == vol && off < offset))
+	    lo = mid + 1;
+	else
+	    hi = mid - 1;
+    }
+    return -1;
+}
+
+/*
+ * Check the record length word at posn is what the sidecar claims.
+ */
+static int
+check_len(__pmFILE *f, off_t posn, int len)
+{
+    __int32_t	word;
+
+    if (__pmFseek(f, (long)posn, SEEK_SET) < 0)
+	return 0;
+    if (__pmFread(&word, 1, sizeof(word), f) != sizeof(word)) {
+	__pmClearerr(f);
+	return 0;
+    }
+    return ntohl(word) == len;
+}
+
+/*
+ * For the fetch in progress, move f from offset (a record boundary in
+ * the current volume) past any records that hold none of the wanted
+ * PMIDs, in direction mode.  Returns the new offset, which is offset
+ * itself when the sidecar does not help or cannot be trusted.
+ */
+long
+__pmLogPmidxSkip(__pmArchCtl *acp, int mode, __pmFILE *f, long offset)
+{
+    __pmLogPmidx	*px = acp->ac_log->pmidx;
+    __pmLogPmidxRec	*rp;
+    int			vol = acp->ac_curvol;
+    int			r, w, i, nskip;
+    off_t		target, check;
+    int			len;
+
+    if (px == NULL || px->stale || acp->ac_pmidx_nwant <= 0)
+	return offset;
+    if (select_records(px, acp->ac_pmidx_nwant, acp->ac_pmidx_want) < 0)
+	return offset;
+
+    if (mode == PM_MODE_FORW) {
+	if ((r = find_record(px, vol, offset, 0)) < 0)
+	    return offset;
+	i = find_run(px, r);
+	if (i >= 0 && r < px->sel[i].first + px->sel[i].count)
+	    return offset;		/* this one is wanted */
+	w = i + 1 < px->nsel ? px->sel[i+1].first : px->nrec;
+	if (w < px->nrec && px->rec[w].vol == vol) {
+	    rp = &px->rec[w];
+	    target = check = rp->off;
+	    nskip = w - r;
+	}
+	else {
+	    /* nothing more in this volume, go to the last record's end */
+	    for (w = r; w + 1 < px->nrec && px->rec[w+1].vol == vol; w++)
+		;
+	    rp = &px->rec[w];
+	    target = rp->off + rp->len;
+	    check = target - sizeof(__int32_t);
+	    nskip = w - r + 1;
+	}
+	len = rp->len;
+    }
+    else {
+	if ((r = find_record(px, vol, offset, 1)) < 0)
+	    return offset;
+	i = find_run(px, r);
+	if (i >= 0 && r < px->sel[i].first + px->sel[i].count)
+	    return offset;
+	w = i >= 0 ? px->sel[i].first + px->sel[i].count - 1 : -1;
+	if (w >= 0 && px->rec[w].vol == vol) {
+	    rp = &px->rec[w];
+	    target = rp->off + rp->len;
+	    check = target - sizeof(__int32_t);
+	    nskip = r - w;
+	}
+	else {
+	    /* nothing earlier in this volume, go to the first record */
+	    for (w = r; w > 0 && px->rec[w-1].vol == vol; w--)
+		;
+	    rp = &px->rec[w];
+	    target = check = rp->off;
+	    nskip = r - w + 1;
+	}
+	len = rp->len;
+    }
+
+    if (!check_len(f, check, len)) {
+	if (pmDebugOptions.log)
+	    fprintf(stderr, "__pmLogPmidxSkip: %s.pmidx stale at vol=%d posn=%ld, ignored\n",
+		    acp->ac_log->name, vol, (long)check);
+	px->stale = 1;
+	__pmFseek(f, offset, SEEK_SET);
+	return offset;
+    }
+    __pmFseek(f, (long)target, SEEK_SET);
+    if (pmDebugOptions.log)
+	fprintf(stderr, "pmidx skip %d to posn=%ld ", nskip, (long)target);
+    return (long)target;
+}
@@ -61,6 +61,39 @@ struct __pmFetchGroupConversionSpec {
 };
 typedef struct __pmFetchGroupConversionSpec *pmFGC;
 
+/*
+ * An instance and its position in a pmValueSet vlist[], for visiting
+ * value sets that are not in instance order in instance order.
+ */
+struct __pmFetchGroupOrder {
+    int inst;
+    int k;			/* index into vset->vlist[] */
+};
+
+/*
+ * One metric (column) of a pmExtendFetchGroup_columns request.  The
+ * unit conversion is linear, so it is reduced to a single multiplier
+ * when the column is added.
+ */
+struct __pmFetchGroupColumn {
+    pmID metric_pmid;
+    pmDesc metric_desc;
+    struct __pmFetchGroupConversionSpec conv;
+    double factor;		/* unit conversion, incl. output_multiplier */
+    const pmValueSet *vset;	/* in the current result, during pmFetchGroup */
+    const struct __pmFetchGroupOrder *sorted; /* NULL if vset is in order */
+    int sts;			/* error for the whole column, ditto */
+    int next;			/* next vset->vlist[] to merge, ditto */
+    struct __pmFetchGroupOrder *order;	/* scratch for sorted, maxorder */
+    int maxorder;
+};
+
+/* Instance and value of the k'th instance of vset, in instance order. */
+#define PMFG_INST(vset, sorted, k) \
+	((sorted) ? (sorted)[k].inst : (vset)->vlist[k].inst)
+#define PMFG_VALUE(vset, sorted, k) \
+	(&(vset)->vlist[(sorted) ? (sorted)[k].k : (k)])
+
 /*
  * An instance of __pmFetchGroupItem stores copies of all the metadata
  * corresponding to one pmExtendFetchGroup* request.  It's organized
@@ -69,7 +102,8 @@ typedef struct __pmFetchGroupConversionSpec *pmFGC;
  */
 struct __pmFetchGroupItem {
     struct __pmFetchGroupItem *next;
-    enum { pmfg_item, pmfg_indom, pmfg_event, pmfg_timeval, pmfg_timespec } type;
+    enum { pmfg_item, pmfg_indom, pmfg_event, pmfg_timeval, pmfg_timespec,
+	   pmfg_columns } type;
 
     union {
 	struct {
@@ -111,6 +145,24 @@ struct __pmFetchGroupItem {
 	    unsigned output_maxnum;
 	    unsigned *output_num;	/* NB: may be NULL */
 	} event;
+	struct {
+	    unsigned int nmetrics;
+	    struct __pmFetchGroupColumn *columns;
+	    int *output_inst_codes;	/* NB: may be NULL */
+	    char **output_inst_names;	/* NB: may be NULL */
+	    void *output_values;	/* NB: may be NULL */
+	    int output_type;	/* PM_TYPE_DOUBLE or PM_TYPE_64 */
+	    int *output_stss;	/* NB: may be NULL */
+	    int *output_sts;	/* NB: may be NULL */
+	    unsigned output_maxnum;
+	    unsigned *output_num;	/* NB: may be NULL */
+	    int *insts;		/* scratch, output_maxnum of each */
+	    int *stss;
+	    double *values;
+	    double *prev;
+	    struct __pmFetchGroupOrder *prevorder; /* scratch, prev result */
+	    int maxprevorder;
+	} columns;
 	struct {
 	    struct timespec *output_value;	/* NB: may be NULL */
 	} timespec;
@@ -197,25 +249,25 @@ pmfg_lookup_item(const char *metric, const char *instance, pmFGI item)
 
 /* Same for a whole indom.  Add the whole instance profile.  */
 static int
-pmfg_lookup_indom(pmFG pmfg, const char *metric, pmFGI item)
+pmfg_lookup_indom(pmFG pmfg, const char *metric, pmID *pmid, pmDesc *desc)
 {
     struct __pmInDomCache *indoms;
     pmInDom indom;
     size_t size;
     int i, sts;
 
-    assert(item != NULL);
-    assert(item->type == pmfg_indom);
+    assert(pmid != NULL);
+    assert(desc != NULL);
 
-    sts = pmLookupName(1, &metric, &item->u.indom.metric_pmid);
+    sts = pmLookupName(1, &metric, pmid);
     if (sts != 1)
 	return sts;
-    sts = pmLookupDesc(item->u.indom.metric_pmid, &item->u.indom.metric_desc);
+    sts = pmLookupDesc(*pmid, desc);
     if (sts < 0)
 	return sts;
 
     /* As a convenience to users, we also accept non-indom'd metrics */
-    if ((indom = item->u.indom.metric_desc.indom) == PM_INDOM_NULL)
+    if ((indom = desc->indom) == PM_INDOM_NULL)
 	return 0;
 
     /*
@@ -649,6 +701,60 @@ pmfg_reinit_event(pmFGI item)
     }
 }
 
+static void
+pmfg_reinit_columns(pmFGI item)
+{
+    size_t i, n;
+
+    assert(item != NULL);
+    assert(item->type == pmfg_columns);
+
+    n = (size_t)item->u.columns.nmetrics * item->u.columns.output_maxnum;
+    if (item->u.columns.output_values) {
+	if (item->u.columns.output_type == PM_TYPE_DOUBLE) {
+	    double *values = item->u.columns.output_values;
+
+	    for (i = 0; i < n; i++)
+		values[i] = (double)0.0 / (double)0.0; /* nan(""); */
+	}
+	else
+	    memset(item->u.columns.output_values, -1, n * sizeof(__int64_t));
+    }
+
+    if (item->u.columns.output_inst_codes)
+	for (i = 0; i < item->u.columns.output_maxnum; i++)
+	    item->u.columns.output_inst_codes[i] = PM_IN_NULL;
+
+    if (item->u.columns.output_inst_names)
+	for (i = 0; i < item->u.columns.output_maxnum; i++)
+	    item->u.columns.output_inst_names[i] = NULL;	/* ptr into names[] */
+
+    if (item->u.columns.output_stss)
+	for (i = 0; i < n; i++)
+	    item->u.columns.output_stss[i] = PM_ERR_VALUE;
+
+    if (item->u.columns.output_num)
+	*item->u.columns.output_num = 0;
+}
+
+static void
+pmfg_free_columns(pmFGI item)
+{
+    unsigned int m;
+
+    assert(item->type == pmfg_columns);
+
+    if (item->u.columns.columns)
+	for (m = 0; m < item->u.columns.nmetrics; m++)
+	    free(item->u.columns.columns[m].order);
+    free(item->u.columns.columns);
+    free(item->u.columns.prevorder);
+    free(item->u.columns.insts);
+    free(item->u.columns.stss);
+    free(item->u.columns.values);
+    free(item->u.columns.prev);
+}
+
 /*
  * Find the pmValue corresponding to the item within the given
  * valueset.  Convert it to given output type, including possible
@@ -730,6 +836,77 @@ pmfg_unwrap_counter(pmFG pmfg, int type, double *value)
     return PM_ERR_VALUE;
 }
 
+/*
+ * Extract a numeric value as a double (or as a 64-bit integer, for
+ * integer metrics without conversion), decoding the common encodings
+ * directly and leaving the rest to pmExtractValue.
+ */
+static inline int
+pmfg_value_double(int valfmt, const pmValue *vp, int type, double *value)
+{
+    const pmValueBlock *vbp;
+    pmAtomValue av;
+    int sts;
+
+    if (valfmt == PM_VAL_INSITU) {
+	if (type == PM_TYPE_32) {
+	    *value = vp->value.lval;
+	    return 0;
+	}
+	if (type == PM_TYPE_U32) {
+	    *value = (__uint32_t)vp->value.lval;
+	    return 0;
+	}
+    }
+    else if ((vbp = vp->value.pval)->vtype == type &&
+	     vbp->vlen == PM_VAL_HDR_SIZE + sizeof(__int64_t)) {
+	memcpy(&av, vbp->vbuf, sizeof(__int64_t));
+	switch (type) {
+	    case PM_TYPE_64:
+		*value = av.ll;
+		return 0;
+	    case PM_TYPE_U64:
+		*value = av.ull;
+		return 0;
+	    case PM_TYPE_DOUBLE:
+		*value = av.d;
+		return 0;
+	}
+    }
+    if ((sts = pmExtractValue(valfmt, vp, type, &av, PM_TYPE_DOUBLE)) < 0)
+	return sts;
+    *value = av.d;
+    return 0;
+}
+
+static inline int
+pmfg_value_int64(int valfmt, const pmValue *vp, int type, __int64_t *value)
+{
+    const pmValueBlock *vbp;
+    pmAtomValue av;
+    int sts;
+
+    if (valfmt == PM_VAL_INSITU) {
+	if (type == PM_TYPE_32) {
+	    *value = vp->value.lval;
+	    return 0;
+	}
+	if (type == PM_TYPE_U32) {
+	    *value = (__uint32_t)vp->value.lval;
+	    return 0;
+	}
+    }
+    else if ((vbp = vp->value.pval)->vtype == PM_TYPE_64 && type == PM_TYPE_64 &&
+	     vbp->vlen == PM_VAL_HDR_SIZE + sizeof(__int64_t)) {
+	memcpy(value, vbp->vbuf, sizeof(__int64_t));
+	return 0;
+    }
+    if ((sts = pmExtractValue(valfmt, vp, type, &av, PM_TYPE_64)) < 0)
+	return sts;
+    *value = av.ll;
+    return 0;
+}
+
 static int
 pmfg_extract_convert_item(pmFG pmfg, pmID metric_pmid, int metric_inst,
 			  int first_vset, const pmDesc *desc, const pmFGC conv,
@@ -887,14 +1064,73 @@ pmfg_fetch_timeval(pmFG pmfg, pmFGI item, pmHighResResult *newResult)
     }
 }
 
+/*
+ * Find the instance domain cache for the given indom, if any.
+ */
+static struct __pmInDomCache *
+pmfg_find_indom_cache(pmFG pmfg, pmInDom indom)
+{
+    unsigned int j;
+
+    for (j = 0; j < pmfg->num_unique_indoms; j++) {
+	if (indom == pmfg->unique_indoms[j].indom)
+	    return &pmfg->unique_indoms[j];
+    }
+    return NULL;
+}
+
+/*
+ * Return the index of an instance in the cache, or -1 if not there.
+ * Instances are mostly looked up in the order pmGetInDom returned
+ * them, so the search starts after the previous match (*hint).
+ */
+static int
+pmfg_search_indom_cache(const struct __pmInDomCache *cache, int inst,
+			unsigned int *hint)
+{
+    unsigned int k, n;
+
+    for (n = 0, k = *hint; n < cache->size; n++, k++) {
+	if (k >= cache->size)
+	    k = 0;
+	if (cache->codes[k] == inst) {
+	    *hint = k + 1;
+	    return k;
+	}
+    }
+    return -1;
+}
+
+static void
+pmfg_refresh_indom_cache(struct __pmInDomCache *cache)
+{
+    int sts;
+
+    cache->refreshed = 1;
+
+    free(cache->codes);
+    free(cache->names);
+    cache->codes = NULL;
+    cache->names = NULL;
+
+    sts = pmGetInDom(cache->indom, &cache->codes, &cache->names);
+    if (sts < 1) {
+	if (sts < 0)
+	    cache->refreshed = 0;
+	cache->size = 0;
+    }
+    else {
+	cache->size = sts;
+    }
+}
+
 static void
 pmfg_fetch_indom(pmFG pmfg, pmFGI item, pmHighResResult *newResult)
 {
-    int i, sts = 0;
-    unsigned int j, k;
+    int i, k, sts = 0;
+    unsigned int j, hint = 0;
     struct __pmInDomCache *cache;
     const pmValueSet *iv;
-    pmInDom indom;
 
     assert(item != NULL);
     assert(item->type == pmfg_indom);
@@ -936,50 +1172,23 @@ pmfg_fetch_indom(pmFG pmfg, pmFGI item, pmHighResResult *newResult)
      * Analyze newResult to see whether it only contains instances we
      * already know.
      */
-    cache = NULL;
-    indom = item->u.indom.metric_desc.indom;
-    for (j = 0; j < pmfg->num_unique_indoms; j++) {
-	if (indom != pmfg->unique_indoms[j].indom)
-	    continue;
-	cache = &pmfg->unique_indoms[j];
-	break;
-    }
+    cache = pmfg_find_indom_cache(pmfg, item->u.indom.metric_desc.indom);
     if (cache && cache->refreshed &&
 	item->u.indom.output_inst_names) {	/* Caller interested at all? */
 	for (j = 0; j < (unsigned int)iv->numval; j++) {
-	    for (k = 0; k < cache->size; k++)
-		if (cache->codes[k] == iv->vlist[j].inst)
-		    break;
-	    if (k >= cache->size) {
+	    if (pmfg_search_indom_cache(cache, iv->vlist[j].inst, &hint) < 0) {
 		cache->refreshed = 0;
 		break;
 	    }
 	}
     }
-    if (cache && !cache->refreshed) {
-	cache->refreshed = 1;
-
-	free(cache->codes);
-	free(cache->names);
-	cache->codes = NULL;
-	cache->names = NULL;
-
-	sts = pmGetInDom(indom, &cache->codes, &cache->names);
-	if (sts < 1) {
-	    if (sts < 0)
-		cache->refreshed = 0;
-	    cache->size = 0;
-	}
-	else {
-	    cache->size = sts;
-	}
-	/*
-	 * NB: Even if the pmGetInDom failed, we can proceed with
-	 * decoding the instance values.  At worst, they won't get
-	 * supplied with instance names.
-	 */
-	sts = 0;
-    }
+    /*
+     * NB: Even if the pmGetInDom failed, we can proceed with
+     * decoding the instance values.  At worst, they won't get
+     * supplied with instance names.
+     */
+    if (cache && !cache->refreshed)
+	pmfg_refresh_indom_cache(cache);
 
     /*
      * Process each instance element in the pmValueSet.	 We persevere
@@ -1008,18 +1217,13 @@ pmfg_fetch_indom(pmFG pmfg, pmFGI item, pmHighResResult *newResult)
 	if (item->u.indom.output_inst_names) {
 	    if (cache == NULL)
 		item->u.indom.output_inst_names[j] = NULL;
-	    else {
-	        for (k = 0; k < cache->size; k++) {
-		    if (cache->codes[k] == jv->inst) {
-			/*
-			 * NB: copy the indom name char* by value.
-			 * User may not modify / free this pointer,
-			 * nor use it after subsequent fetch / delete.
-			 */
-			item->u.indom.output_inst_names[j] = cache->names[k];
-			break;
-		    }
-		}
+	    else if ((k = pmfg_search_indom_cache(cache, jv->inst, &hint)) >= 0) {
+		/*
+		 * NB: copy the indom name char* by value.
+		 * User may not modify / free this pointer,
+		 * nor use it after subsequent fetch / delete.
+		 */
+		item->u.indom.output_inst_names[j] = cache->names[k];
 	    }
 	}
 
@@ -1061,6 +1265,335 @@ out:
 	*item->u.indom.output_sts = sts;
 }
 
+static int
+pmfg_order_compare(const void *a, const void *b)
+{
+    const struct __pmFetchGroupOrder *oa = a, *ob = b;
+
+    if (oa->inst != ob->inst)
+	return oa->inst < ob->inst ? -1 : 1;
+    return oa->k < ob->k ? -1 : (oa->k > ob->k);
+}
+
+/*
+ * PMDAs and archives usually return instances in increasing order,
+ * but that is not guaranteed.  Set *sorted to NULL if vset is in
+ * strictly increasing instance order, else sort (instance, index)
+ * pairs into the *order scratch array and point *sorted at that.
+ */
+static int
+pmfg_sort_vset(const pmValueSet *vset, struct __pmFetchGroupOrder **order,
+	       int *maxorder, const struct __pmFetchGroupOrder **sorted)
+{
+    struct __pmFetchGroupOrder *neworder;
+    int k;
+
+    *sorted = NULL;
+    for (k = 1; k < vset->numval; k++) {
+	if (vset->vlist[k].inst <= vset->vlist[k-1].inst)
+	    break;
+    }
+    if (k >= vset->numval)
+	return 0;
+
+    if (vset->numval > *maxorder) {
+	neworder = realloc(*order, vset->numval * sizeof(*neworder));
+	if (neworder == NULL)
+	    return -ENOMEM;
+	*order = neworder;
+	*maxorder = vset->numval;
+    }
+    for (k = 0; k < vset->numval; k++) {
+	(*order)[k].inst = vset->vlist[k].inst;
+	(*order)[k].k = k;
+    }
+    qsort(*order, vset->numval, sizeof(**order), pmfg_order_compare);
+    *sorted = *order;
+    return 0;
+}
+
+/*
+ * Merge the instances of a value set, in instance order (see
+ * pmfg_sort_vset), with the (sorted) rows of a columns item,
+ * extracting the values for rows that have no error yet.
+ */
+static void
+pmfg_gather_column(const pmValueSet *vset,
+		   const struct __pmFetchGroupOrder *sorted, int type,
+		   const int *insts, unsigned int numrows, double *values,
+		   int *stss)
+{
+    unsigned int j;
+    int k = 0;
+
+    for (j = 0; j < numrows; j++) {
+	if (stss[j] != 0)
+	    continue;
+	while (k < vset->numval && PMFG_INST(vset, sorted, k) < insts[j])
+	    k++;
+	if (k >= vset->numval || PMFG_INST(vset, sorted, k) != insts[j]) {
+	    stss[j] = PM_ERR_VALUE;
+	    continue;
+	}
+	stss[j] = pmfg_value_double(vset->valfmt, PMFG_VALUE(vset, sorted, k),
+				    type, &values[j]);
+	k++;
+    }
+}
+
+/* Same, for integer metrics going to PM_TYPE_64 without conversion.  */
+static void
+pmfg_gather_column_int64(const pmValueSet *vset,
+		   const struct __pmFetchGroupOrder *sorted, int type,
+		   const int *insts, unsigned int numrows, __int64_t *values,
+		   int *stss)
+{
+    __int64_t unused;
+    unsigned int j;
+    int k = 0;
+
+    for (j = 0; j < numrows; j++) {
+	if (stss[j] != 0)
+	    continue;
+	while (k < vset->numval && PMFG_INST(vset, sorted, k) < insts[j])
+	    k++;
+	if (k >= vset->numval || PMFG_INST(vset, sorted, k) != insts[j]) {
+	    stss[j] = PM_ERR_VALUE;
+	    continue;
+	}
+	stss[j] = pmfg_value_int64(vset->valfmt, PMFG_VALUE(vset, sorted, k),
+				   type, values ? &values[j] : &unused);
+	k++;
+    }
+}
+
+/*
+ * Rate convert a column of values in place, against the same metric
+ * and instances in the previous result.  Each step is a separate pass
+ * over the column, so the arithmetic is straight-line code.
+ */
+static void
+pmfg_rate_column(pmFG pmfg, pmFGI item, const struct __pmFetchGroupColumn *col,
+		 const struct timespec *timestamp, const int *insts,
+		 unsigned int numrows, double *values, double *prev, int *stss)
+{
+    const pmHighResResult *prev_r = pmfg->prevResult;
+    const pmValueSet *pvset = NULL;
+    const struct __pmFetchGroupOrder *psorted = NULL;
+    const double epsilon = 0.000000001;	/* 1 nanosecond */
+    double deltaT, scale, wrap = 0.0;
+    unsigned int j;
+    int i, sts;
+
+    if (prev_r == NULL)		/* no previous result */
+	sts = PM_ERR_AGAIN;
+    else {
+	sts = PM_ERR_VALUE;
+	for (i = 0; i < prev_r->numpmid; i++) {
+	    if (prev_r->vset[i]->pmid == col->metric_pmid) {
+		pvset = prev_r->vset[i];
+		sts = pvset->numval < 0 ? pvset->numval : 0;
+		break;
+	    }
+	}
+	if (sts == 0)
+	    sts = pmfg_sort_vset(pvset, &item->u.columns.prevorder,
+			    &item->u.columns.maxprevorder, &psorted);
+    }
+    if (sts < 0) {
+	for (j = 0; j < numrows; j++)
+	    if (stss[j] == 0)
+		stss[j] = sts;
+	return;
+    }
+    pmfg_gather_column(pvset, psorted, col->metric_desc.type, insts, numrows,
+		       prev, stss);
+
+    deltaT = pmtimespecSub(timestamp, &prev_r->timestamp);
+    if (deltaT < epsilon)	/* avoid division by zero */
+	deltaT = epsilon;	/* (chose not to PM_ERR_CONV here) */
+    scale = (col->conv.unit_convert ? col->factor : 1.0) / deltaT;
+
+    if (pmfg->wrap) {
+	switch (col->metric_desc.type) {
+	    case PM_TYPE_32:
+	    case PM_TYPE_U32:
+		wrap = (double)UINT_MAX+1;
+		break;
+	    case PM_TYPE_64:
+	    case PM_TYPE_U64:
+		wrap = (double)ULONGLONG_MAX+1;
+		break;
+	}
+    }
+
+    for (j = 0; j < numrows; j++)
+	values[j] -= prev[j];
+    for (j = 0; j < numrows; j++) {
+	if (values[j] < 0.0 && stss[j] == 0) {
+	    if (pmfg->wrap)
+		values[j] += wrap;
+	    else
+		stss[j] = PM_ERR_VALUE;
+	}
+    }
+    for (j = 0; j < numrows; j++)
+	values[j] *= scale;
+}
+
+static void
+pmfg_fetch_columns(pmFG pmfg, pmFGI item, pmHighResResult *newResult)
+{
+    struct __pmFetchGroupColumn *col;
+    struct __pmInDomCache *cache;
+    const pmValueSet *vset;
+    const unsigned int maxnum = item->u.columns.output_maxnum;
+    const int otype = item->u.columns.output_type;
+    int *insts = item->u.columns.insts;
+    int *stss = item->u.columns.stss;
+    double *values = item->u.columns.values;
+    unsigned int numrows = 0, hint = 0, j, m;
+    int i, k, inst = 0, found, sts = 0;
+
+    assert(item != NULL);
+    assert(item->type == pmfg_columns);
+    assert(newResult != NULL);
+
+    /* Find each metric in newResult; its error code applies to all rows. */
+    for (m = 0; m < item->u.columns.nmetrics; m++) {
+	col = &item->u.columns.columns[m];
+	col->vset = NULL;
+	col->sorted = NULL;
+	col->sts = PM_ERR_VALUE;
+	col->next = 0;
+	for (i = 0; i < newResult->numpmid; i++) {
+	    if (newResult->vset[i]->pmid == col->metric_pmid) {
+		col->vset = newResult->vset[i];
+		col->sts = col->vset->numval < 0 ? col->vset->numval : 0;
+		break;
+	    }
+	}
+	if (col->sts == 0)
+	    col->sts = pmfg_sort_vset(col->vset, &col->order, &col->maxorder,
+				      &col->sorted);
+    }
+
+    /*
+     * The rows are the union of the instances of all the metrics,
+     * merged in one pass over the value sets in instance order.
+     */
+    for (;;) {
+	found = 0;
+	for (m = 0; m < item->u.columns.nmetrics; m++) {
+	    col = &item->u.columns.columns[m];
+	    if (col->sts != 0 || col->next >= col->vset->numval)
+		continue;
+	    k = PMFG_INST(col->vset, col->sorted, col->next);
+	    if (!found || k < inst) {
+		inst = k;
+		found = 1;
+	    }
+	}
+	if (!found)
+	    break;
+	if (numrows >= maxnum) {	/* too many instances! */
+	    sts = PM_ERR_TOOBIG;
+	    break;
+	}
+	insts[numrows++] = inst;
+	for (m = 0; m < item->u.columns.nmetrics; m++) {
+	    col = &item->u.columns.columns[m];
+	    /* skip any duplicates of this instance too */
+	    while (col->sts == 0 && col->next < col->vset->numval &&
+		PMFG_INST(col->vset, col->sorted, col->next) == inst)
+		col->next++;
+	}
+    }
+
+    if (item->u.columns.output_inst_codes)
+	memcpy(item->u.columns.output_inst_codes, insts, numrows * sizeof(int));
+
+    if (item->u.columns.output_inst_names) {
+	cache = pmfg_find_indom_cache(pmfg, item->u.columns.columns[0].metric_desc.indom);
+	if (cache && cache->refreshed) {
+	    for (j = 0; j < numrows; j++) {
+		if (pmfg_search_indom_cache(cache, insts[j], &hint) < 0) {
+		    cache->refreshed = 0;
+		    break;
+		}
+	    }
+	}
+	if (cache && !cache->refreshed)
+	    pmfg_refresh_indom_cache(cache);
+	for (j = 0; cache && j < numrows; j++) {
+	    if ((k = pmfg_search_indom_cache(cache, insts[j], &hint)) >= 0)
+		item->u.columns.output_inst_names[j] = cache->names[k];
+	}
+    }
+
+    /* Then each metric is extracted and converted a column at a time. */
+    for (m = 0; m < item->u.columns.nmetrics; m++) {
+	size_t base = (size_t)m * maxnum;
+
+	col = &item->u.columns.columns[m];
+	vset = col->vset;
+	for (j = 0; j < numrows; j++)
+	    stss[j] = col->sts;
+
+	if (otype == PM_TYPE_64 && !col->conv.rate_convert &&
+	    !col->conv.unit_convert && col->metric_desc.type != PM_TYPE_FLOAT &&
+	    col->metric_desc.type != PM_TYPE_DOUBLE) {
+	    __int64_t *out = item->u.columns.output_values;
+
+	    if (col->sts == 0)
+		pmfg_gather_column_int64(vset, col->sorted,
+				col->metric_desc.type, insts, numrows,
+				out ? out + base : NULL, stss);
+	}
+	else {
+	    if (col->sts == 0)
+		pmfg_gather_column(vset, col->sorted, col->metric_desc.type,
+				insts, numrows, values, stss);
+	    if (col->conv.rate_convert)
+		pmfg_rate_column(pmfg, item, col, &newResult->timestamp, insts,
+				numrows, values, item->u.columns.prev, stss);
+	    else if (col->conv.unit_convert) {
+		for (j = 0; j < numrows; j++)
+		    values[j] *= col->factor;
+	    }
+
+	    if (otype == PM_TYPE_DOUBLE) {
+		double *out = item->u.columns.output_values;
+
+		for (j = 0; out && j < numrows; j++)
+		    if (stss[j] == 0)
+			out[base + j] = values[j];
+	    }
+	    else {
+		__int64_t *out = item->u.columns.output_values;
+
+		for (j = 0; j < numrows; j++) {
+		    if (stss[j] != 0)
+			continue;
+		    if (values[j] > (double)LONGLONG_MAX ||
+			values[j] < (double)(-LONGLONG_MAX-1L))
+			stss[j] = PM_ERR_TRUNC;
+		    else if (out)
+			out[base + j] = values[j];
+		}
+	    }
+	}
+
+	if (item->u.columns.output_stss)
+	    memcpy(item->u.columns.output_stss + base, stss, numrows * sizeof(int));
+    }
+
+    if (item->u.columns.output_num)
+	*item->u.columns.output_num = numrows;
+    if (item->u.columns.output_sts)
+	*item->u.columns.output_sts = sts;
+}
+
 static int
 pmfg_fetch_event_field(pmFG pmfg, pmFGI item, unsigned int *output_num,
 		pmValueSet **vsets, int numpmid, const struct timespec *timestamp)
@@ -1495,7 +2028,8 @@ pmExtendFetchGroup_indom(pmFG pmfg,
 
     item->type = pmfg_indom;
 
-    sts = pmfg_lookup_indom(pmfg, metric, item);
+    sts = pmfg_lookup_indom(pmfg, metric, &item->u.indom.metric_pmid,
+			    &item->u.indom.metric_desc);
     if (sts != 0)
 	goto out;
 
@@ -1534,6 +2068,112 @@ out:
     return sts;
 }
 
+/*
+ * Extend the fetchgroup with several metrics over one instance domain,
+ * with the values delivered as dense columns of doubles or 64-bit
+ * integers: out_values[m * out_maxnum + j] is metric m for the j-th
+ * instance (row), and out_stss has the same layout.
+ */
+int
+pmExtendFetchGroup_columns(pmFG pmfg,
+		unsigned int nmetrics, const char *metrics[],
+		const char *scales[], int out_inst_codes[],
+		char *out_inst_names[], void *out_values, int out_type,
+		int out_stss[], unsigned int out_maxnum,
+		unsigned int *out_num, int *out_sts)
+{
+    struct __pmFetchGroupColumn *col;
+    pmAtomValue one, factor;
+    unsigned int m;
+    int sts;
+    pmFGI item;
+
+    if (pmfg == NULL || metrics == NULL || nmetrics == 0 || out_maxnum == 0)
+	return -EINVAL;
+    if (out_type != PM_TYPE_DOUBLE && out_type != PM_TYPE_64)
+	return PM_ERR_TYPE;
+
+    sts = pmUseContext(pmfg->ctx);
+    if (sts != 0)
+	return sts;
+
+    item = calloc(1, sizeof(*item));
+    if (item == NULL)
+	return -ENOMEM;
+
+    item->type = pmfg_columns;
+    item->u.columns.nmetrics = nmetrics;
+    item->u.columns.output_maxnum = out_maxnum;
+
+    if ((item->u.columns.columns = calloc(nmetrics, sizeof(*col))) == NULL ||
+	(item->u.columns.insts = calloc(out_maxnum, sizeof(int))) == NULL ||
+	(item->u.columns.stss = calloc(out_maxnum, sizeof(int))) == NULL ||
+	(item->u.columns.values = calloc(out_maxnum, sizeof(double))) == NULL ||
+	(item->u.columns.prev = calloc(out_maxnum, sizeof(double))) == NULL) {
+	sts = -ENOMEM;
+	goto out;
+    }
+
+    for (m = 0; m < nmetrics; m++) {
+	col = &item->u.columns.columns[m];
+	if (metrics[m] == NULL) {
+	    sts = -EINVAL;
+	    goto out;
+	}
+	sts = pmfg_lookup_indom(pmfg, metrics[m], &col->metric_pmid,
+				&col->metric_desc);
+	if (sts != 0)
+	    goto out;
+
+	/* All the columns share the rows, so must share an indom. */
+	if (col->metric_desc.indom != item->u.columns.columns[0].metric_desc.indom) {
+	    sts = PM_ERR_INDOM;
+	    goto out;
+	}
+	if (col->metric_desc.type == PM_TYPE_STRING) {
+	    sts = PM_ERR_TYPE;
+	    goto out;
+	}
+
+	sts = pmfg_prep_conversion(&col->metric_desc, scales ? scales[m] : NULL,
+				   &col->conv, out_type);
+	if (sts != 0)
+	    goto out;
+	col->factor = 1.0;
+	if (col->conv.unit_convert) {
+	    one.d = 1.0;
+	    sts = pmConvScale(PM_TYPE_DOUBLE, &one, &col->metric_desc.units,
+			      &factor, &col->conv.output_units);
+	    if (sts < 0)
+		goto out;
+	    col->factor = factor.d * col->conv.output_multiplier;
+	}
+
+	sts = pmfg_add_pmid(pmfg, col->metric_pmid);
+	if (sts < 0)
+	    goto out;
+    }
+
+    item->u.columns.output_inst_codes = out_inst_codes;
+    item->u.columns.output_inst_names = out_inst_names;
+    item->u.columns.output_values = out_values;
+    item->u.columns.output_type = out_type;
+    item->u.columns.output_stss = out_stss;
+    item->u.columns.output_sts = out_sts;
+    item->u.columns.output_num = out_num;
+    pmfg_reinit_columns(item);
+
+    /* link in */
+    item->next = pmfg->items;
+    pmfg->items = item;
+    return 0;
+
+out:
+    pmfg_free_columns(item);
+    free(item);
+    return sts;
+}
+
 int
 pmExtendFetchGroup_event(pmFG pmfg,
 		const char *metric, const char *instance,
@@ -1690,6 +2330,9 @@ pmFetchGroup(pmFG pmfg)
 		if (item->u.indom.metric_desc.sem != PM_SEM_DISCRETE)
 		    pmfg_reinit_indom(item); /* preserve DISCRETE */
 		break;
+	    case pmfg_columns:
+		pmfg_reinit_columns(item);
+		break;
 	    case pmfg_event:
 		/* DISCRETE mode doesn't make sense for an event vector */
 		pmfg_reinit_event(item);
@@ -1733,6 +2376,9 @@ pmFetchGroup(pmFG pmfg)
 	    case pmfg_indom:
 		pmfg_fetch_indom(pmfg, item, newResult);
 		break;
+	    case pmfg_columns:
+		pmfg_fetch_columns(pmfg, item, newResult);
+		break;
 	    case pmfg_event:
 		pmfg_fetch_event(pmfg, item, newResult);
 		break;
@@ -1783,6 +2429,10 @@ pmClearFetchGroup(pmFG pmfg)
 	    case pmfg_event:
 		pmfg_reinit_event(item);
 		break;
+	    case pmfg_columns:
+		pmfg_reinit_columns(item);
+		pmfg_free_columns(item);
+		break;
 	    case pmfg_timespec:
 	    case pmfg_timeval:
 		/* no dynamically allocated content. */
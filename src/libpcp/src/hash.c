@@ -252,3 +252,369 @@ __pmHashFree(__pmHashCtl *hcp)
 
     __pmHashClear(hcp);
 }
+
+/*
+ * Open-addressing ("flat") hash tables.
+ *
+ * Same usage model as the __pmHash* chained tables above, but the
+ * nodes live in one contiguous array of slots, so there is no malloc
+ * per insert and no pointer chasing on lookup.  Collisions are
+ * resolved by linear probing with Robin Hood displacement (an entry
+ * that is further from its home slot steals the slot from one that
+ * is closer to home), and deletion uses backward shifting, so there
+ * are no tombstones and probe sequences stay short up to high load.
+ *
+ * Unlike the chained tables, a __pmFlatHashNode pointer is only valid
+ * until the next __pmFlatHashAdd() or __pmFlatHashDel() on the same
+ * table, because both may move entries between slots.
+ */
+
+#define FLATHASH_MINSIZE	8
+
+/*
+ * Keys are often PMIDs or InDoms with most of their entropy in a few
+ * bit fields, so mix the key before masking to the table size.
+ */
+static inline unsigned int
+flathash_home(unsigned int key, int hsize)
+{
+    key ^= key >> 16;
+    key *= 0x85ebca6bU;
+    key ^= key >> 13;
+    key *= 0xc2b2ae35U;
+    key ^= key >> 16;
+    return key & (hsize - 1);
+}
+
+/* true when adding one more node would exceed a load factor of 3/4 */
+static inline int
+flathash_full(int nodes, int hsize)
+{
+    return (nodes + 1) * 4 > hsize * 3;
+}
+
+static int
+flathash_roundup(int hsize)
+{
+    int		size = FLATHASH_MINSIZE;
+
+    while (flathash_full(hsize - 1, size)) {
+	if (size > INT_MAX / 2)
+	    return -1;
+	size <<= 1;
+    }
+    return size;
+}
+
+/*
+ * Robin Hood insertion of a node known not to need a resize.
+ */
+static void
+flathash_insert(unsigned int key, void *data, __pmFlatHashCtl *hcp)
+{
+    __pmFlatHashNode	node, swap, *sp;
+    unsigned int	mask = hcp->hsize - 1;
+    unsigned int	i;
+
+    node.key = key;
+    node.dist = 1;
+    node.data = data;
+    i = flathash_home(key, hcp->hsize);
+    for (;;) {
+	sp = &hcp->hash[i];
+	if (sp->dist == 0) {
+	    *sp = node;
+	    return;
+	}
+	if (sp->dist < node.dist) {
+	    /* steal the slot from a node closer to its home */
+	    swap = *sp;
+	    *sp = node;
+	    node = swap;
+	}
+	node.dist++;
+	i = (i + 1) & mask;
+    }
+}
+
+static int
+flathash_resize(int hsize, __pmFlatHashCtl *hcp)
+{
+    __pmFlatHashNode	*old = hcp->hash;
+    int			oldsize = hcp->hsize;
+    int			i;
+
+    if ((hcp->hash = (__pmFlatHashNode *)calloc(hsize, sizeof(__pmFlatHashNode))) == NULL) {
+	hcp->hash = old;
+	return -oserror();
+    }
+    hcp->hsize = hsize;
+    for (i = 0; i < oldsize; i++) {
+	if (old[i].dist != 0)
+	    flathash_insert(old[i].key, old[i].data, hcp);
+    }
+    free(old);
+    /* any walk in progress is no longer meaningful */
+    hcp->index = hcp->hsize;
+    return 0;
+}
+
+void
+__pmFlatHashInit(__pmFlatHashCtl *hcp)
+{
+    memset(hcp, 0, sizeof(*hcp));
+    /* NB: as for __pmHashInit, an all-zeroes struct is a valid empty table */
+}
+
+/*
+ * Used to preallocate the slot array when the number of entries is
+ * known ahead of time, avoiding any rehashing as the table fills.
+ */
+int
+__pmFlatHashPreAlloc(int hsize, __pmFlatHashCtl *hcp)
+{
+    int		size;
+
+    if (hcp->hash != NULL) {
+	/* too late, or already done before */
+	return -1;
+    }
+    if ((size = flathash_roundup(hsize)) < 0)
+	return -ENOMEM;
+    if ((hcp->hash = (__pmFlatHashNode *)calloc(size, sizeof(__pmFlatHashNode))) == NULL)
+	return -oserror();
+
+    hcp->hsize = size;
+    hcp->index = size;
+    return 0; /* ok */
+}
+
+__pmFlatHashNode *
+__pmFlatHashSearch(unsigned int key, __pmFlatHashCtl *hcp)
+{
+    __pmFlatHashNode	*sp;
+    unsigned int	mask, dist, i;
+
+    if (hcp->nodes == 0)
+	return NULL;
+
+    mask = hcp->hsize - 1;
+    i = flathash_home(key, hcp->hsize);
+    for (dist = 1; ; dist++) {
+	sp = &hcp->hash[i];
+	/*
+	 * Robin Hood invariant: once we reach an entry closer to its home
+	 * than we are to ours (or an empty slot), the key is not present.
+	 */
+	if (sp->dist < dist)
+	    return NULL;
+	if (sp->key == key)
+	    return sp;
+	i = (i + 1) & mask;
+    }
+}
+
+/*
+ * As for __pmHashAdd, duplicate keys are allowed; __pmFlatHashSearch
+ * returns one of them and __pmFlatHashDel matches on both key and data.
+ * Tables must not be added to during a walk.
+ */
+int
+__pmFlatHashAdd(unsigned int key, void *data, __pmFlatHashCtl *hcp)
+{
+    int		sts;
+
+    if (hcp->hsize == 0 || flathash_full(hcp->nodes, hcp->hsize)) {
+	int	hsize = hcp->hsize ? hcp->hsize : FLATHASH_MINSIZE / 2;
+
+	if (hsize > INT_MAX / 2)
+	    return -ENOMEM;
+	if ((sts = flathash_resize(hsize * 2, hcp)) < 0)
+	    return sts;
+    }
+    flathash_insert(key, data, hcp);
+    hcp->nodes++;
+
+    return 1;
+}
+
+/*
+ * Remove the node in slot i by shifting the remainder of its probe
+ * run back one slot; returns the index of the last slot vacated.
+ */
+static unsigned int
+flathash_remove(unsigned int i, __pmFlatHashCtl *hcp)
+{
+    unsigned int	mask = hcp->hsize - 1;
+    unsigned int	next;
+
+    for (;;) {
+	next = (i + 1) & mask;
+	if (hcp->hash[next].dist <= 1)
+	    break;
+	hcp->hash[i] = hcp->hash[next];
+	hcp->hash[i].dist--;
+	i = next;
+    }
+    memset(&hcp->hash[i], 0, sizeof(__pmFlatHashNode));
+    hcp->nodes--;
+    return i;
+}
+
+/*
+ * Walk position of slot i, relative to the (empty) slot the current
+ * walk started from.
+ */
+static inline unsigned int
+flathash_walkpos(unsigned int i, const __pmFlatHashCtl *hcp)
+{
+    return (i - hcp->start) & (hcp->hsize - 1);
+}
+
+int
+__pmFlatHashDel(unsigned int key, void *data, __pmFlatHashCtl *hcp)
+{
+    __pmFlatHashNode	*sp;
+    unsigned int	mask, dist, i, last;
+
+    if (hcp->nodes == 0)
+	return 0;
+
+    mask = hcp->hsize - 1;
+    i = flathash_home(key, hcp->hsize);
+    for (dist = 1; ; dist++) {
+	sp = &hcp->hash[i];
+	if (sp->dist < dist)
+	    return 0;
+	if (sp->key == key && sp->data == data)
+	    break;
+	i = (i + 1) & mask;
+    }
+
+    last = flathash_remove(i, hcp);
+
+    /*
+     * If a __pmFlatHashWalk is in progress and the backward shift moved
+     * a node not yet visited into an already-visited slot, step back so
+     * that node is still returned.  Walks start at an empty slot, so no
+     * probe run wraps across the walk origin.
+     */
+    if (hcp->index < (unsigned int)hcp->hsize &&
+	flathash_walkpos(i, hcp) < hcp->index &&
+	flathash_walkpos(last, hcp) >= hcp->index)
+	hcp->index--;
+
+    return 1;
+}
+
+void
+__pmFlatHashClear(__pmFlatHashCtl *hcp)
+{
+    if (hcp->hsize != 0) {
+	free(hcp->hash);
+	hcp->hash = NULL;
+	hcp->hsize = 0;
+	hcp->nodes = 0;
+	hcp->index = 0;
+    }
+}
+
+/*
+ * There are no per-node allocations, so this is the same as
+ * __pmFlatHashClear and is only provided for symmetry with
+ * __pmHashFree.
+ */
+void
+__pmFlatHashFree(__pmFlatHashCtl *hcp)
+{
+    __pmFlatHashClear(hcp);
+}
+
+static unsigned int
+flathash_origin(const __pmFlatHashCtl *hcp)
+{
+    unsigned int	i;
+
+    /* load factor is bounded, so there is always an empty slot */
+    for (i = 0; i < (unsigned int)hcp->hsize; i++) {
+	if (hcp->hash[i].dist == 0)
+	    break;
+    }
+    return i;
+}
+
+/*
+ * Iterate over the entire hash table, with the same callback protocol
+ * as __pmHashWalkCB.  The callback function must not modify the table.
+ */
+void
+__pmFlatHashWalkCB(__pmFlatHashWalkCallback cb, void *cdata, const __pmFlatHashCtl *hcp)
+{
+    __pmFlatHashCtl	*ctl = (__pmFlatHashCtl *)hcp;
+    __pmFlatHashNode	*sp;
+    unsigned int	mask, start, pos, i;
+
+    if (hcp->nodes == 0)
+	return;
+
+    mask = hcp->hsize - 1;
+    start = flathash_origin(hcp);
+    for (pos = 0; pos < (unsigned int)hcp->hsize; ) {
+	i = (start + pos) & mask;
+	sp = &hcp->hash[i];
+	if (sp->dist == 0) {
+	    pos++;
+	    continue;
+	}
+	switch ((*cb)(sp, cdata)) {
+	case PM_HASH_WALK_DELETE_STOP:
+	    flathash_remove(i, ctl);
+	    return;
+
+	case PM_HASH_WALK_NEXT:
+	    pos++;
+	    break;
+
+	case PM_HASH_WALK_DELETE_NEXT:
+	    /*
+	     * NB: do not advance; the backward shift may have moved the
+	     * next (unvisited) node of this probe run into slot i.
+	     */
+	    flathash_remove(i, ctl);
+	    break;
+
+	case PM_HASH_WALK_STOP:
+	default:
+	    return;
+	}
+    }
+}
+
+/*
+ * Walk a hash table; state flow is START ... NEXT ... NEXT ...
+ * The node returned may be deleted with __pmFlatHashDel before
+ * asking for the NEXT one.
+ */
+__pmFlatHashNode *
+__pmFlatHashWalk(__pmFlatHashCtl *hcp, __pmHashWalkState state)
+{
+    __pmFlatHashNode	*sp;
+    unsigned int	mask;
+
+    if (hcp->nodes == 0)
+	return NULL;
+
+    if (state == PM_HASH_WALK_START) {
+	hcp->start = flathash_origin(hcp);
+	hcp->index = 0;
+    }
+
+    mask = hcp->hsize - 1;
+    while (hcp->index < (unsigned int)hcp->hsize) {
+	sp = &hcp->hash[(hcp->start + hcp->index) & mask];
+	hcp->index++;
+	if (sp->dist != 0)
+	    return sp;
+    }
+    return NULL;
+}
@@ -409,6 +409,13 @@ extern int __pmLogFetchInterp(__pmContext *, int, pmID *, __pmResult **) _PCP_HI
 extern __pmTimestamp *__pmLogStartTime(__pmArchCtl *) _PCP_HIDDEN;
 extern int __pmLogSetTime(__pmContext *) _PCP_HIDDEN;
 extern void __pmLogResetInterp(__pmContext *) _PCP_HIDDEN;
+extern int __pmLogLoadPmidx(__pmLogCtl *) _PCP_HIDDEN;
+extern int __pmLogPmidxAddPDU(__pmLogPmidx *, int, off_t, int, const __pmPDU *, int) _PCP_HIDDEN;
+extern long __pmLogPmidxSkip(__pmArchCtl *, int, __pmFILE *, long) _PCP_HIDDEN;
+extern void __pmLogReadAheadInit(__pmArchCtl *) _PCP_HIDDEN;
+extern int __pmLogReadAhead(__pmArchCtl *, const char *) _PCP_HIDDEN;
+extern void __pmLogReadAheadSchedule(__pmArchCtl *, int) _PCP_HIDDEN;
+extern void __pmLogReadAheadFree(__pmArchCtl *) _PCP_HIDDEN;
 extern void __pmArchCtlFree(__pmArchCtl *) _PCP_HIDDEN;
 extern int __pmLogChangeToNextArchive(__pmLogCtl **) _PCP_HIDDEN;
 extern int __pmLogChangeToPreviousArchive(__pmLogCtl **) _PCP_HIDDEN;
@@ -429,7 +436,7 @@ extern int __pmTimevalCmp(const pmTimeval *, const pmTimeval *) _PCP_HIDDEN;
 
 extern int __pmSecureServerSetup(void) _PCP_HIDDEN;
 
-extern pmInDomProfile *__pmFindProfile(pmInDom, const pmProfile *) _PCP_HIDDEN;
+extern int __pmSortProfileInstances(int *, int) _PCP_HIDDEN;
 extern int __pmEquivInDom(pmInDom, pmInDom) _PCP_HIDDEN;
 
 extern void __pmFreeInterpData(__pmContext *) _PCP_HIDDEN;
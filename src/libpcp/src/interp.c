@@ -100,12 +100,41 @@ typedef struct instcntl {		/* metric-instance control */
     struct pmidcntl	*metric;	/* back to metric control */
 } instcntl_t;
 
+/*
+ * choice of value for each instance in the result, see batch_pick()
+ */
+#define PICK_NONE	0	/* no value */
+#define PICK_PRIOR	1	/* value at t_prior */
+#define PICK_NEXT	2	/* value at t_next */
+#define PICK_INTERP	3	/* interpolate between t_prior and t_next */
+#define PICK_WRAP	4	/* as PICK_INTERP, but 32-bit counter wrapped */
+
+/*
+ * Per-metric scratch space for building the result.  The instances
+ * in the result are gathered here first, then the value for every
+ * instance is chosen in one pass, and the counters that need it are
+ * interpolated in one pass over contiguous arrays (indexed by the
+ * PICK_INTERP and PICK_WRAP instances only) that the compiler can
+ * vectorize.  Kept from one fetch to the next to avoid reallocation.
+ */
+typedef struct {
+    int			nalloc;		/* size of all arrays */
+    struct instcntl	**icp;		/* instances in this result */
+    int			*pick;		/* PICK_* for each instance */
+    double		*t_prior;	/* from here on, interpolation only */
+    double		*t_next;
+    double		*base;		/* value to interpolate from */
+    double		*delta;		/* change from t_prior to t_next */
+    double		*out;		/* interpolated value */
+} batch_t;
+
 typedef struct pmidcntl {		/* metric control */
     pmDesc		desc;
     int			valfmt;		/* used to build result */
     int			numval;		/* number of instances in this result */
     int			last_numval;	/* number of instances in previous result */
     __pmHashCtl		hc;		/* metric-instances */
+    batch_t		batch;		/* used to build result */
 } pmidcntl_t;
 
 typedef struct {
@@ -117,6 +146,7 @@ typedef struct {
     long	tail_posn;	/* posn in file after forwards __pmLogRead */
     int		mode;		/* PM_MODE_FORW or PM_MODE_BACK */
     int		used;		/* used count for LFU replacement */
+    struct shared *sp;		/* rp is shared, see shared_t below */
 } cache_t;
 
 #define NUMCACHE 4
@@ -128,6 +158,352 @@ typedef struct {
 static long	nr_cache[PM_MODE_BACK+1];
 static long	nr[PM_MODE_BACK+1];
 
+/*
+ * Process-wide cache of decoded archive records, shared by all of the
+ * contexts that are reading the same archive, e.g. the many pmwebapi
+ * clients replaying one archive in pmproxy.
+ *
+ * Entries are keyed by archive (name and label), volume and the file
+ * offsets of both ends of the record, so a record can be found when
+ * reading in either direction.  Each cache_t slot using an entry holds
+ * a reference; entries with no references are kept in LRU order and
+ * discarded once the cache is over its size limit.  The limit is zero
+ * (cache disabled) unless set by $PCP_ARCHIVE_CACHE_SIZE (bytes) or
+ * __pmLogCacheSetLimit().
+ */
+typedef struct shared {
+    struct shared	*h_next;	/* hash chain, by head_posn */
+    struct shared	*t_next;	/* hash chain, by tail_posn */
+    struct shared	*lru_prev;	/* unreferenced entries ... */
+    struct shared	*lru_next;	/* ... oldest first */
+    char		*name;		/* archive */
+    int			pid;		/* from archive label */
+    __pmTimestamp	start;		/* from archive label */
+    int			vol;
+    long		head_posn;
+    long		tail_posn;
+    __pmResult		*rp;
+    size_t		size;		/* approx bytes held by rp */
+    int			refcnt;
+} shared_t;
+
+static shared_t		**shared_head;
+static shared_t		**shared_tail;
+static unsigned int	shared_nhash;
+static shared_t		*lru_first;
+static shared_t		*lru_last;
+static int		shared_init;
+static __pmLogCacheStats shared_stats;
+
+#ifdef PM_MULTI_THREAD
+static pthread_mutex_t	shared_lock = PTHREAD_MUTEX_INITIALIZER;
+#else
+void			*shared_lock;
+#endif
+
+/*
+ * called with shared_lock held
+ */
+static void
+shared_setup(void)
+{
+    char	*val;
+    char	*end;
+    long long	limit;
+
+    if (shared_init)
+	return;
+    shared_init = 1;
+    PM_LOCK(__pmLock_extcall);
+    if ((val = getenv("PCP_ARCHIVE_CACHE_SIZE")) != NULL) {	/* THREADSAFE */
+	limit = strtoll(val, &end, 10);
+	if (*end == '\0' && limit > 0)
+	    shared_stats.limit = limit;
+    }
+    PM_UNLOCK(__pmLock_extcall);
+}
+
+static unsigned int
+shared_hash(const char *name, int vol, long posn)
+{
+    unsigned int	h = vol;
+
+    while (*name)
+	h = h * 31 + (unsigned char)*name++;
+    h ^= (unsigned int)posn * 2654435761U;
+    return h & (shared_nhash - 1);
+}
+
+static int
+shared_match(const shared_t *sp, const __pmLogCtl *lcp, int vol)
+{
+    return sp->vol == vol && sp->pid == lcp->label.pid &&
+	   sp->start.sec == lcp->label.start.sec &&
+	   sp->start.nsec == lcp->label.start.nsec &&
+	   strcmp(sp->name, lcp->name) == 0;
+}
+
+static void
+lru_unlink(shared_t *sp)
+{
+    if (sp->lru_prev)
+	sp->lru_prev->lru_next = sp->lru_next;
+    else
+	lru_first = sp->lru_next;
+    if (sp->lru_next)
+	sp->lru_next->lru_prev = sp->lru_prev;
+    else
+	lru_last = sp->lru_prev;
+    sp->lru_prev = sp->lru_next = NULL;
+}
+
+/*
+ * double the hash tables (or create them) ... on failure, carry on
+ * with longer chains
+ */
+static void
+shared_rehash(void)
+{
+    shared_t		**head, **tail;
+    shared_t		*sp, *next;
+    unsigned int	old = shared_nhash;
+    unsigned int	i, h;
+
+    shared_nhash = old ? old * 2 : 256;
+    head = (shared_t **)calloc(shared_nhash, sizeof(shared_t *));
+    tail = (shared_t **)calloc(shared_nhash, sizeof(shared_t *));
+    if (head == NULL || tail == NULL) {
+	free(head);
+	free(tail);
+	shared_nhash = old;
+	return;
+    }
+    for (i = 0; i < old; i++) {
+	for (sp = shared_head[i]; sp != NULL; sp = next) {
+	    next = sp->h_next;
+	    h = shared_hash(sp->name, sp->vol, sp->head_posn);
+	    sp->h_next = head[h];
+	    head[h] = sp;
+	}
+	for (sp = shared_tail[i]; sp != NULL; sp = next) {
+	    next = sp->t_next;
+	    h = shared_hash(sp->name, sp->vol, sp->tail_posn);
+	    sp->t_next = tail[h];
+	    tail[h] = sp;
+	}
+    }
+    free(shared_head);
+    free(shared_tail);
+    shared_head = head;
+    shared_tail = tail;
+}
+
+static void
+shared_evict(shared_t *sp)
+{
+    shared_t	**spp;
+
+    for (spp = &shared_head[shared_hash(sp->name, sp->vol, sp->head_posn)]; *spp != sp; spp = &(*spp)->h_next)
+	;
+    *spp = sp->h_next;
+    for (spp = &shared_tail[shared_hash(sp->name, sp->vol, sp->tail_posn)]; *spp != sp; spp = &(*spp)->t_next)
+	;
+    *spp = sp->t_next;
+    lru_unlink(sp);
+    shared_stats.entries--;
+    shared_stats.bytes -= sp->size;
+    __pmFreeResult(sp->rp);
+    free(sp->name);
+    free(sp);
+}
+
+/*
+ * discard unreferenced entries until within the limit,
+ * called with shared_lock held
+ */
+static void
+shared_trim(void)
+{
+    while (shared_stats.bytes > shared_stats.limit && lru_first != NULL) {
+	shared_evict(lru_first);
+	shared_stats.evictions++;
+    }
+}
+
+/*
+ * find the record starting (PM_MODE_FORW) or ending (PM_MODE_BACK)
+ * at posn, and take a reference to it
+ */
+static shared_t *
+shared_lookup(__pmArchCtl *acp, int mode, long posn)
+{
+    shared_t	*sp = NULL;
+
+    PM_LOCK(shared_lock);
+    shared_setup();
+    if (shared_stats.limit == 0 || shared_nhash == 0)
+	goto done;
+    if (mode == PM_MODE_FORW) {
+	for (sp = shared_head[shared_hash(acp->ac_log->name, acp->ac_vol, posn)]; sp != NULL; sp = sp->h_next) {
+	    if (sp->head_posn == posn && shared_match(sp, acp->ac_log, acp->ac_vol))
+		break;
+	}
+    }
+    else {
+	for (sp = shared_tail[shared_hash(acp->ac_log->name, acp->ac_vol, posn)]; sp != NULL; sp = sp->t_next) {
+	    if (sp->tail_posn == posn && shared_match(sp, acp->ac_log, acp->ac_vol))
+		break;
+	}
+    }
+    if (sp != NULL) {
+	if (sp->refcnt++ == 0)
+	    lru_unlink(sp);
+	shared_stats.hits++;
+    }
+    else
+	shared_stats.misses++;
+done:
+    PM_UNLOCK(shared_lock);
+    return sp;
+}
+
+/*
+ * add a record that has just been read, returns the new entry with
+ * one reference, else NULL if the record is not to be shared and
+ * remains private to the caller
+ */
+static shared_t *
+shared_add(__pmArchCtl *acp, long head_posn, long tail_posn, __pmResult *rp)
+{
+    shared_t		*sp = NULL;
+    shared_t		*xp;
+    unsigned int	h;
+    size_t		size;
+    int			i;
+
+    /* decoded result, plus the PDU buffer it references */
+    size = sizeof(*sp) + sizeof(*rp) + (tail_posn - head_posn) +
+	   rp->numpmid * sizeof(pmValueSet *);
+    for (i = 0; i < rp->numpmid; i++)
+	size += sizeof(pmValueSet) + rp->vset[i]->numval * sizeof(pmValue);
+
+    PM_LOCK(shared_lock);
+    shared_setup();
+    if (size > shared_stats.limit)
+	goto done;
+    h = shared_hash(acp->ac_log->name, acp->ac_vol, head_posn);
+    for (xp = shared_nhash ? shared_head[h] : NULL; xp != NULL; xp = xp->h_next) {
+	/* another context got here first */
+	if (xp->head_posn == head_posn && shared_match(xp, acp->ac_log, acp->ac_vol))
+	    goto done;
+    }
+    if ((sp = (shared_t *)calloc(1, sizeof(shared_t))) == NULL)
+	goto done;
+    if ((sp->name = strdup(acp->ac_log->name)) == NULL) {
+	free(sp);
+	sp = NULL;
+	goto done;
+    }
+    sp->pid = acp->ac_log->label.pid;
+    sp->start = acp->ac_log->label.start;
+    sp->vol = acp->ac_vol;
+    sp->head_posn = head_posn;
+    sp->tail_posn = tail_posn;
+    sp->rp = rp;
+    sp->size = size;
+    sp->refcnt = 1;
+
+    if (shared_stats.entries >= 2 * shared_nhash)
+	shared_rehash();
+    if (shared_nhash == 0) {
+	free(sp->name);
+	free(sp);
+	sp = NULL;
+	goto done;
+    }
+    h = shared_hash(sp->name, sp->vol, sp->head_posn);
+    sp->h_next = shared_head[h];
+    shared_head[h] = sp;
+    h = shared_hash(sp->name, sp->vol, sp->tail_posn);
+    sp->t_next = shared_tail[h];
+    shared_tail[h] = sp;
+    shared_stats.entries++;
+    shared_stats.bytes += size;
+    shared_trim();
+done:
+    PM_UNLOCK(shared_lock);
+    return sp;
+}
+
+static void
+shared_release(shared_t *sp)
+{
+    PM_LOCK(shared_lock);
+    assert(sp->refcnt > 0);
+    if (--sp->refcnt == 0) {
+	sp->lru_prev = lru_last;
+	if (lru_last)
+	    lru_last->lru_next = sp;
+	else
+	    lru_first = sp;
+	lru_last = sp;
+	shared_trim();
+    }
+    PM_UNLOCK(shared_lock);
+}
+
+/*
+ * Try to avoid excessive copying/freeing of the archive name.
+ */
+static void
+cache_setname(cache_t *cp, const char *name)
+{
+    if (cp->c_name != NULL && strcmp(cp->c_name, name) != 0) {
+	free(cp->c_name);
+	cp->c_name = NULL;
+    }
+    if (cp->c_name == NULL) {
+	if ((cp->c_name = strdup(name)) == NULL) {
+	    pmNoMem("__pmLogFetchInterp.name",
+		      strlen(name) + 1, PM_FATAL_ERR);
+	}
+    }
+}
+
+/*
+ * drop the result held in a read cache slot
+ */
+static void
+cache_release(cache_t *cp)
+{
+    if (cp->sp != NULL) {
+	shared_release(cp->sp);
+	cp->sp = NULL;
+    }
+    else if (cp->rp != NULL)
+	__pmFreeResult(cp->rp);
+    cp->rp = NULL;
+}
+
+void
+__pmLogCacheSetLimit(size_t limit)
+{
+    PM_LOCK(shared_lock);
+    shared_setup();
+    shared_stats.limit = limit;
+    shared_trim();
+    PM_UNLOCK(shared_lock);
+}
+
+void
+__pmLogCacheGetStats(__pmLogCacheStats *stats)
+{
+    PM_LOCK(shared_lock);
+    shared_setup();
+    *stats = shared_stats;
+    PM_UNLOCK(shared_lock);
+}
+
 /*
  * called with the context lock held
  */
@@ -139,6 +515,7 @@ cache_read(__pmContext *ctxp, int mode, __pmResult **rp)
     cache_t	*cp;
     cache_t	*lfup;
     cache_t	*cache;
+    shared_t	*sp;
     char	*save_curlog_name;
     int		sts;
     int		save_curvol;
@@ -158,6 +535,14 @@ cache_read(__pmContext *ctxp, int mode, __pmResult **rp)
     if (acp->ac_vol == acp->ac_curvol) {
 	posn = __pmFtell(acp->ac_mfp);
 	assert(posn >= 0);
+	if (acp->ac_pmidx_nwant > 0) {
+	    /*
+	     * skip unwanted records now, so posn is the start (or end)
+	     * of the record __pmLogRead_ctx() would return, whatever
+	     * metrics were wanted when the cached records were read
+	     */
+	    posn = __pmLogPmidxSkip(acp, mode, acp->ac_mfp, posn);
+	}
     }
     else
 	posn = 0;
@@ -214,8 +599,29 @@ cache_read(__pmContext *ctxp, int mode, __pmResult **rp)
 	fprintf(stderr, "miss\n");
     nr[mode]++;
 
-    if (lfup->rp != NULL)
-	__pmFreeResult(lfup->rp);
+    cache_release(lfup);
+
+    if (posn != 0 && (sp = shared_lookup(acp, mode, posn)) != NULL) {
+	/* another context has read this record */
+	*rp = lfup->rp = sp->rp;
+	lfup->sp = sp;
+	lfup->sts = 0;
+	lfup->mode = mode;
+	lfup->vol = acp->ac_vol;
+	lfup->used = 1;
+	cache_setname(lfup, acp->ac_log->name);
+	lfup->head_posn = sp->head_posn;
+	lfup->tail_posn = sp->tail_posn;
+	if (mode == PM_MODE_FORW)
+	    __pmFseek(acp->ac_mfp, sp->tail_posn, SEEK_SET);
+	else
+	    __pmFseek(acp->ac_mfp, sp->head_posn, SEEK_SET);
+	if (pmDebugOptions.log && pmDebugOptions.desperate)
+	    fprintf(stderr, "cache_read: shared hit, cache[%d] head=%ld tail=%ld\n",
+		(int)(lfup - cache), (long)lfup->head_posn, (long)lfup->tail_posn);
+	acp->ac_mark_done = 0;
+	return 0;
+    }
 
     /*
      * We need to know when we cross archive or volume boundaries.
@@ -256,17 +662,7 @@ cache_read(__pmContext *ctxp, int mode, __pmResult **rp)
 	lfup->mode = mode;
 	lfup->vol = acp->ac_vol;
 	lfup->used = 1;
-	/* Try to avoid excessive copying/freeing of the archive name. */
-	if (lfup->c_name != NULL && strcmp(lfup->c_name, acp->ac_log->name) != 0) {
-	    free(lfup->c_name);
-	    lfup->c_name = NULL;
-	}
-	if (lfup->c_name == NULL) {
-	    if ((lfup->c_name = strdup(acp->ac_log->name)) == NULL) {
-		pmNoMem("__pmLogFetchInterp.name",
-			  strlen(acp->ac_log->name) + 1, PM_FATAL_ERR);
-	    }
-	}
+	cache_setname(lfup, acp->ac_log->name);
 	if (mode == PM_MODE_FORW) {
 	    lfup->head_posn = posn;
 	    lfup->tail_posn = __pmFtell(acp->ac_mfp);
@@ -277,6 +673,8 @@ cache_read(__pmContext *ctxp, int mode, __pmResult **rp)
 	    lfup->head_posn = __pmFtell(acp->ac_mfp);
 	    assert(lfup->head_posn >= 0);
 	}
+	if (lfup->rp != NULL)
+	    lfup->sp = shared_add(acp, lfup->head_posn, lfup->tail_posn, lfup->rp);
 	if (pmDebugOptions.log && pmDebugOptions.desperate) {
 	    fprintf(stderr, "cache_read: reload cache[%d] vol=%d (curvol=%d) head=%ld tail=%ld ",
 		(int)(lfup - cache), lfup->vol, acp->ac_curvol,
@@ -293,6 +691,32 @@ cache_read(__pmContext *ctxp, int mode, __pmResult **rp)
     return lfup->sts;
 }
 
+/*
+ * empty the read cache
+ */
+static void
+cache_flush(__pmArchCtl *acp)
+{
+    cache_t	*cache = (cache_t *)acp->ac_cache;
+    cache_t	*cp;
+
+    for (cp = cache; cp < &cache[NUMCACHE]; cp++) {
+	if (pmDebugOptions.log && pmDebugOptions.interp) {
+	    fprintf(stderr, "read cache entry "
+		    PRINTF_P_PFX "%p: c_name=%s rp="
+		    PRINTF_P_PFX "%p\n",
+		    cp, cp->c_name ? cp->c_name : "(none)",
+		    cp->rp);
+	}
+	if (cp->c_name != NULL) {
+	    free(cp->c_name);
+	    cp->c_name = NULL;
+	}
+	cache_release(cp);
+	cp->used = 0;
+    }
+}
+
 /*
  * prior == 1 for ?_prior fields, else use ?_next fields
  */
@@ -1016,6 +1440,409 @@ time_caliper(__pmContext *ctxp, instcntl_t *icp)
     return;
 }
 
+static void
+batch_free(batch_t *bp)
+{
+    free(bp->icp);
+    free(bp->pick);
+    free(bp->t_prior);
+    free(bp->t_next);
+    free(bp->base);
+    free(bp->delta);
+    free(bp->out);
+    memset(bp, 0, sizeof(*bp));
+}
+
+static int
+batch_realloc(void **pp, int n, size_t size)
+{
+    void	*p;
+
+    if ((p = realloc(*pp, n * size)) == NULL)
+	return -oserror();
+    *pp = p;
+    return 0;
+}
+
+static int
+batch_alloc(batch_t *bp, int need)
+{
+    int		n;
+    int		sts;
+
+    for (n = bp->nalloc > 0 ? bp->nalloc : 8; n < need; n *= 2)
+	;
+    if ((sts = batch_realloc((void **)&bp->icp, n, sizeof(bp->icp[0]))) < 0 ||
+	(sts = batch_realloc((void **)&bp->pick, n, sizeof(bp->pick[0]))) < 0 ||
+	(sts = batch_realloc((void **)&bp->t_prior, n, sizeof(double))) < 0 ||
+	(sts = batch_realloc((void **)&bp->t_next, n, sizeof(double))) < 0 ||
+	(sts = batch_realloc((void **)&bp->base, n, sizeof(double))) < 0 ||
+	(sts = batch_realloc((void **)&bp->delta, n, sizeof(double))) < 0 ||
+	(sts = batch_realloc((void **)&bp->out, n, sizeof(double))) < 0)
+	return sts;
+    bp->nalloc = n;
+    return 0;
+}
+
+/*
+ * gather the instances that will be in the result, returns the
+ * number of instances or a negative error code
+ */
+static int
+batch_gather(pmidcntl_t *pcp, int verbose)
+{
+    batch_t		*bp = &pcp->batch;
+    __pmHashNode	*ihp;
+    instcntl_t		*icp;
+    int			k, n, sts;
+
+    if (pcp->numval > bp->nalloc && (sts = batch_alloc(bp, pcp->numval)) < 0)
+	return sts;
+
+    n = 0;
+    for (k = 0; k < pcp->hc.hsize; k++) {
+	for (ihp = pcp->hc.hash[k]; ihp != NULL; ihp = ihp->next) {
+	    icp = (instcntl_t *)ihp->data;
+	    if (!icp->inresult || n == pcp->numval)
+		continue;
+	    if (verbose) {
+		char	strbuf[20];
+		fprintf(stderr, "pmid %s inst %d prior: t=%.6f",
+			pmIDStr_r(pcp->desc.pmid, strbuf, sizeof(strbuf)), icp->inst, icp->t_prior);
+		dumpval(stderr, pcp->desc.type, pcp->valfmt, 1, icp);
+		fprintf(stderr, " next: t=%.6f", icp->t_next);
+		dumpval(stderr, pcp->desc.type, pcp->valfmt, 0, icp);
+		fprintf(stderr, " t_first=%.6f t_last=%.6f\n",
+			icp->t_first, icp->t_last);
+	    }
+	    bp->icp[n++] = icp;
+	}
+    }
+    return n;
+}
+
+/*
+ * choose the value to be returned for each instance, returns the
+ * number of instances to be interpolated
+ */
+static int
+batch_pick(pmidcntl_t *pcp, int n, double t_req)
+{
+    batch_t		*bp = &pcp->batch;
+    instcntl_t		*icp;
+    int			k, m = 0;
+
+    switch (pcp->desc.type) {
+	case PM_TYPE_32:
+	case PM_TYPE_U32:
+	case PM_TYPE_64:
+	case PM_TYPE_U64:
+	case PM_TYPE_FLOAT:
+	case PM_TYPE_DOUBLE:
+	    break;
+
+	case PM_TYPE_AGGREGATE:
+	case PM_TYPE_EVENT:
+	case PM_TYPE_HIGHRES_EVENT:
+	case PM_TYPE_STRING:
+	    /* no interpolation, always the prior value */
+	    for (k = 0; k < n; k++)
+		bp->pick[k] = bp->icp[k]->t_prior >= 0 ? PICK_PRIOR : PICK_NONE;
+	    return 0;
+
+	default:
+	    /* unknown type - skip it, else junk in result */
+	    for (k = 0; k < n; k++)
+		bp->pick[k] = PICK_NONE;
+	    return 0;
+    }
+
+    for (k = 0; k < n; k++) {
+	icp = bp->icp[k];
+	if (icp->t_prior == t_req)
+	    bp->pick[k] = PICK_PRIOR;
+	else if (icp->t_next == t_req)
+	    bp->pick[k] = PICK_NEXT;
+	else if (pcp->desc.sem == PM_SEM_DISCRETE) {
+	    if (icp->t_prior < 0)
+		bp->pick[k] = PICK_NONE;
+	    else if (!IS_VALUE(icp->s_next) || t_req <= (icp->t_prior + icp->t_next)/2)
+		bp->pick[k] = PICK_PRIOR;
+	    else
+		bp->pick[k] = PICK_NEXT;
+	}
+	else if (icp->t_prior < 0 || icp->t_next < 0)
+	    bp->pick[k] = PICK_NONE;
+	else if (pcp->desc.sem == PM_SEM_INSTANT) {
+	    if (t_req <= (icp->t_prior + icp->t_next)/2)
+		bp->pick[k] = PICK_PRIOR;
+	    else
+		bp->pick[k] = PICK_NEXT;
+	}
+	else {
+	    /* assume COUNTER */
+	    bp->pick[k] = PICK_INTERP;
+	    m++;
+	}
+    }
+    return m;
+}
+
+#if !defined(HAVE_CAST_U64_DOUBLE)
+static double
+u64_to_double(__uint64_t ull)
+{
+    if (SIGN_64_MASK & ull)
+	return (double)(__int64_t)(ull & (~SIGN_64_MASK)) + (__uint64_t)SIGN_64_MASK;
+    return (double)(__int64_t)ull;
+}
+#else
+#define u64_to_double(ull) ((double)(ull))
+#endif
+
+/*
+ * for each PICK_INTERP instance, load the value to interpolate from
+ * and the change in value (taking counter wrap into account) as
+ * doubles into the contiguous arrays, returns the number loaded
+ */
+static int
+batch_load(pmidcntl_t *pcp, int n, int dowrap)
+{
+    batch_t		*bp = &pcp->batch;
+    instcntl_t		*icp;
+    pmAtomValue		*avp_prior;
+    pmAtomValue		*avp_next;
+    pmAtomValue		prior;
+    pmAtomValue		next;
+    float		f;
+    int			k, m = 0;
+
+    for (k = 0; k < n; k++) {
+	if (bp->pick[k] != PICK_INTERP)
+	    continue;
+	icp = bp->icp[k];
+	bp->t_prior[m] = icp->t_prior;
+	bp->t_next[m] = icp->t_next;
+	switch (pcp->desc.type) {
+	    case PM_TYPE_32:
+		if (icp->v_next.lval >= icp->v_prior.lval || dowrap == 0) {
+		    bp->base[m] = icp->v_prior.lval;
+		    bp->delta[m] = icp->v_next.lval - icp->v_prior.lval;
+		}
+		else {
+		    /* not monotonic increasing and want wrap */
+		    bp->base[m] = 0;
+		    bp->delta[m] = (__int32_t)(UINT_MAX - icp->v_prior.lval + 1 + icp->v_next.lval);
+		    bp->pick[k] = PICK_WRAP;
+		}
+		break;
+
+	    case PM_TYPE_U32:
+		avp_prior = (pmAtomValue *)&icp->v_prior.lval;
+		avp_next = (pmAtomValue *)&icp->v_next.lval;
+		if (avp_next->ul >= avp_prior->ul) {
+		    bp->base[m] = avp_prior->ul;
+		    bp->delta[m] = avp_next->ul - avp_prior->ul;
+		}
+		else if (dowrap) {
+		    /* not monotonic increasing and want wrap */
+		    bp->base[m] = 0;
+		    bp->delta[m] = (__uint32_t)(UINT_MAX - avp_prior->ul + 1 + avp_next->ul);
+		    bp->pick[k] = PICK_WRAP;
+		}
+		else {
+		    /* not monotonic increasing */
+		    bp->base[m] = avp_prior->ul;
+		    bp->delta[m] = -(double)(avp_prior->ul - avp_next->ul);
+		}
+		break;
+
+	    case PM_TYPE_64:
+		memcpy((void *)&prior.ll, (void *)icp->v_prior.pval->vbuf, sizeof(prior.ll));
+		memcpy((void *)&next.ll, (void *)icp->v_next.pval->vbuf, sizeof(next.ll));
+		bp->base[m] = (double)prior.ll;
+		if (next.ll >= prior.ll || dowrap == 0)
+		    bp->delta[m] = (double)(next.ll - prior.ll);
+		else
+		    /* not monotonic increasing and want wrap */
+		    bp->delta[m] = (double)(__int64_t)(ULONGLONG_MAX - prior.ll + 1 + next.ll);
+		break;
+
+	    case PM_TYPE_U64:
+		/* compared and converted as signed, as always */
+		memcpy((void *)&prior.ll, (void *)icp->v_prior.pval->vbuf, sizeof(prior.ll));
+		memcpy((void *)&next.ll, (void *)icp->v_next.pval->vbuf, sizeof(next.ll));
+		bp->base[m] = (double)prior.ll;
+		if (next.ll >= prior.ll)
+		    bp->delta[m] = u64_to_double((__uint64_t)(next.ll - prior.ll));
+		else if (dowrap)
+		    /* not monotonic increasing and want wrap */
+		    bp->delta[m] = u64_to_double(ULONGLONG_MAX - prior.ll + 1 + next.ll);
+		else
+		    /* not monotonic increasing */
+		    bp->delta[m] = -u64_to_double((__uint64_t)prior.ll - (__uint64_t)next.ll);
+		break;
+
+	    case PM_TYPE_FLOAT:
+		if (pcp->valfmt == PM_VAL_INSITU) {
+		    /* OLD style FLOAT insitu */
+		    avp_prior = (pmAtomValue *)&icp->v_prior.lval;
+		    avp_next = (pmAtomValue *)&icp->v_next.lval;
+		    prior.f = avp_prior->f;
+		    next.f = avp_next->f;
+		}
+		else {
+		    memcpy((void *)&prior.f, (void *)icp->v_prior.pval->vbuf, sizeof(prior.f));
+		    memcpy((void *)&next.f, (void *)icp->v_next.pval->vbuf, sizeof(next.f));
+		}
+		/* difference in float precision */
+		f = next.f - prior.f;
+		bp->base[m] = prior.f;
+		bp->delta[m] = f;
+		break;
+
+	    case PM_TYPE_DOUBLE:
+		memcpy((void *)&prior.d, (void *)icp->v_prior.pval->vbuf, sizeof(prior.d));
+		memcpy((void *)&next.d, (void *)icp->v_next.pval->vbuf, sizeof(next.d));
+		bp->base[m] = prior.d;
+		bp->delta[m] = next.d - prior.d;
+		break;
+	}
+	m++;
+    }
+    return m;
+}
+
+/*
+ * linear interpolation of m values at t_req, rounded for the integer
+ * types ... no branches and no pointer chasing
+ */
+static void
+batch_interp(batch_t *bp, int m, double t_req, int round)
+{
+    const double	*t_prior = bp->t_prior;
+    const double	*t_next = bp->t_next;
+    const double	*base = bp->base;
+    const double	*delta = bp->delta;
+    double		*out = bp->out;
+    int			k;
+
+    if (round) {
+	for (k = 0; k < m; k++)
+	    out[k] = 0.5 + base[k] + (t_req - t_prior[k]) * delta[k] / (t_next[k] - t_prior[k]);
+    }
+    else {
+	for (k = 0; k < m; k++)
+	    out[k] = base[k] + (t_req - t_prior[k]) * delta[k] / (t_next[k] - t_prior[k]);
+    }
+}
+
+/*
+ * fill in vsp->vlist[] from the chosen and interpolated values,
+ * *ip is the number of values added so far (for error recovery)
+ */
+static int
+batch_emit(pmidcntl_t *pcp, int n, pmValueSet *vsp, int *ip)
+{
+    batch_t		*bp = &pcp->batch;
+    instcntl_t		*icp;
+    pmValueBlock	*vp;
+    pmAtomValue		av;
+    value		*vsrc;
+    int			need;
+    int			k, m = 0;
+
+    switch (pcp->desc.type) {
+	case PM_TYPE_32:
+	case PM_TYPE_U32:
+	    need = 0;
+	    break;
+	case PM_TYPE_FLOAT:
+	    need = pcp->valfmt == PM_VAL_INSITU ? 0 : sizeof(float);
+	    break;
+	case PM_TYPE_64:
+	case PM_TYPE_U64:
+	    need = sizeof(__int64_t);
+	    break;
+	case PM_TYPE_DOUBLE:
+	    need = sizeof(double);
+	    break;
+	default:
+	    need = -1;	/* copy whole pmValueBlock */
+	    break;
+    }
+    if (need > 0 && n > 0)
+	vsp->valfmt = PM_VAL_DPTR;
+
+    for (k = 0; k < n; k++) {
+	if (bp->pick[k] == PICK_NONE)
+	    continue;
+	icp = bp->icp[k];
+	vsrc = bp->pick[k] == PICK_NEXT ? &icp->v_next : &icp->v_prior;
+	vsp->vlist[*ip].inst = icp->inst;
+
+	if (need == 0) {
+	    /* insitu */
+	    if (bp->pick[k] == PICK_PRIOR || bp->pick[k] == PICK_NEXT)
+		vsp->vlist[*ip].value.lval = vsrc->lval;
+	    else if (pcp->desc.type == PM_TYPE_32) {
+		vsp->vlist[*ip].value.lval = bp->out[m++];
+		if (bp->pick[k] == PICK_WRAP)
+		    vsp->vlist[*ip].value.lval += icp->v_prior.lval;
+	    }
+	    else if (pcp->desc.type == PM_TYPE_U32) {
+		av.ul = bp->out[m++];
+		if (bp->pick[k] == PICK_WRAP)
+		    av.ul += ((pmAtomValue *)&icp->v_prior.lval)->ul;
+		vsp->vlist[*ip].value.lval = av.ul;
+	    }
+	    else {
+		/* yes this IS correct ... */
+		av.f = bp->out[m++];
+		vsp->vlist[*ip].value.lval = av.l;
+	    }
+	    (*ip)++;
+	    continue;
+	}
+
+	if (need < 0) {
+	    /* aggregate, event or string */
+	    if ((vp = (pmValueBlock *)malloc(vsrc->pval->vlen)) == NULL)
+		return -oserror();
+	    memcpy((void *)vp, vsrc->pval, vsrc->pval->vlen);
+	    vsp->valfmt = PM_VAL_DPTR;
+	    vsp->vlist[(*ip)++].value.pval = vp;
+	    continue;
+	}
+
+	if ((vp = (pmValueBlock *)malloc(PM_VAL_HDR_SIZE + need)) == NULL)
+	    return -oserror();
+	vp->vlen = PM_VAL_HDR_SIZE + need;
+	vp->vtype = pcp->desc.type;
+	if (bp->pick[k] == PICK_PRIOR || bp->pick[k] == PICK_NEXT)
+	    memcpy((void *)vp->vbuf, (void *)vsrc->pval->vbuf, need);
+	else {
+	    switch (pcp->desc.type) {
+		case PM_TYPE_FLOAT:
+		    av.f = bp->out[m++];
+		    break;
+		case PM_TYPE_64:
+		    av.ll = (__int64_t)bp->out[m++];
+		    break;
+		case PM_TYPE_U64:
+		    av.ull = (__uint64_t)bp->out[m++];
+		    break;
+		case PM_TYPE_DOUBLE:
+		    av.d = bp->out[m++];
+		    break;
+	    }
+	    memcpy((void *)vp->vbuf, (void *)&av, need);
+	}
+	vsp->vlist[(*ip)++].value.pval = vp;
+    }
+    return 0;
+}
+
 /*
  * classes of "unbound" list instcntl_t scanning effort ...
  * counted in nuis[] below
@@ -1029,10 +1856,10 @@ time_caliper(__pmContext *ctxp, instcntl_t *icp)
 #define NUIS_LAST_FORGET	6
 #define NUIS_LAST_TRIM		7
 
-int
-__pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult **result)
+static int
+fetch_interp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult **result)
 {
-    int			i, j, k, sts;
+    int			i, j, m, n, sts;
     double		t_req, t_this;
     __pmResult		*rp, *logrp;
     __pmHashCtl		*hcp = &ctxp->c_archctl->ac_pmid_hc;
@@ -1120,6 +1947,7 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
 	    pcp->valfmt = -1;
 	    pcp->last_numval = -1;
 	    __pmHashInit(&pcp->hc);
+	    memset(&pcp->batch, 0, sizeof(pcp->batch));
 	    sts = __pmHashAdd((int)pmidlist[j], (void *)pcp, hcp);
 	    if (sts < 0) {
 		free(pcp);
@@ -1689,444 +2517,18 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":1", PM_FAULT_CALL);
 
 	i = 0;
 	if (pcp->numval > 0) {
-	    for (k = 0; k < pcp->hc.hsize; k++) {
-		for (ihp = pcp->hc.hash[k]; ihp != NULL; ihp = ihp->next) {
-		    icp = (instcntl_t *)ihp->data;
-		    if (!icp->inresult)
-			continue;
-		    if (pmDebugOptions.interp && done_roll) {
-			char	strbuf[20];
-			fprintf(stderr, "pmid %s inst %d prior: t=%.6f",
-				pmIDStr_r(pmidlist[j], strbuf, sizeof(strbuf)), icp->inst, icp->t_prior);
-			dumpval(stderr, pcp->desc.type, icp->metric->valfmt, 1, icp);
-			fprintf(stderr, " next: t=%.6f", icp->t_next);
-			dumpval(stderr, pcp->desc.type, icp->metric->valfmt, 0, icp);
-			fprintf(stderr, " t_first=%.6f t_last=%.6f\n",
-				icp->t_first, icp->t_last);
-		    }
-		    rp->vset[j]->vlist[i].inst = icp->inst;
-		    if (pcp->desc.type == PM_TYPE_32 || pcp->desc.type == PM_TYPE_U32) {
-			if (icp->t_prior == t_req)
-			    rp->vset[j]->vlist[i++].value.lval = icp->v_prior.lval;
-			else if (icp->t_next == t_req)
-			    rp->vset[j]->vlist[i++].value.lval = icp->v_next.lval;
-			else {
-			    if (pcp->desc.sem == PM_SEM_DISCRETE) {
-				if (icp->t_prior >= 0) {
-				    if (!IS_VALUE(icp->s_next) || t_req <= (icp->t_prior + icp->t_next)/2)
-					rp->vset[j]->vlist[i++].value.lval = icp->v_prior.lval;
-				    else
-					rp->vset[j]->vlist[i++].value.lval = icp->v_next.lval;
-				}
-			    }
-			    else if (pcp->desc.sem == PM_SEM_INSTANT) {
-				if (icp->t_prior >= 0 && icp->t_next >= 0) {
-				    if (t_req <= (icp->t_prior + icp->t_next)/2)
-					rp->vset[j]->vlist[i++].value.lval = icp->v_prior.lval;
-				    else
-					rp->vset[j]->vlist[i++].value.lval = icp->v_next.lval;
-				}
-			    }
-			    else {
-				/* assume COUNTER */
-				if (icp->t_prior >= 0 && icp->t_next >= 0) {
-				    if (pcp->desc.type == PM_TYPE_32) {
-					if (icp->v_next.lval >= icp->v_prior.lval ||
-					    dowrap == 0) {
-					    rp->vset[j]->vlist[i++].value.lval = 0.5 +
-						icp->v_prior.lval + (t_req - icp->t_prior) *
-						(icp->v_next.lval - icp->v_prior.lval) /
-						(icp->t_next - icp->t_prior);
-					}
-					else {
-					    /* not monotonic increasing and want wrap */
-					    rp->vset[j]->vlist[i++].value.lval = 0.5 +
-						(t_req - icp->t_prior) *
-						(__int32_t)(UINT_MAX - icp->v_prior.lval + 1 + icp->v_next.lval) /
-						(icp->t_next - icp->t_prior);
-					    rp->vset[j]->vlist[i].value.lval += icp->v_prior.lval;
-					}
-				    }
-				    else {
-					pmAtomValue     av;
-					pmAtomValue     *avp_prior = (pmAtomValue *)&icp->v_prior.lval;
-					pmAtomValue     *avp_next = (pmAtomValue *)&icp->v_next.lval;
-					if (avp_next->ul >= avp_prior->ul) {
-					    av.ul = 0.5 + avp_prior->ul +
-						(t_req - icp->t_prior) *
-						(avp_next->ul - avp_prior->ul) /
-						(icp->t_next - icp->t_prior);
-					}
-					else {
-					    /* not monotonic increasing */
-					    if (dowrap) {
-						av.ul = 0.5 +
-						    (t_req - icp->t_prior) *
-						    (__uint32_t)(UINT_MAX - avp_prior->ul + 1 + avp_next->ul ) /
-						    (icp->t_next - icp->t_prior);
-						av.ul += avp_prior->ul;
-					    }
-					    else {
-						__uint32_t	ul;
-						ul = avp_prior->ul - avp_next->ul;
-						av.ul = 0.5 + avp_prior->ul -
-						    (t_req - icp->t_prior) * ul /
-						    (icp->t_next - icp->t_prior);
-					    }
-					}
-					rp->vset[j]->vlist[i++].value.lval = av.ul;
-				    }
-				}
-			    }
-			}
-		    }
-		    else if (pcp->desc.type == PM_TYPE_FLOAT && icp->metric->valfmt == PM_VAL_INSITU) {
-			/* OLD style FLOAT insitu */
-			if (icp->t_prior == t_req)
-			    rp->vset[j]->vlist[i++].value.lval = icp->v_prior.lval;
-			else if (icp->t_next == t_req)
-			    rp->vset[j]->vlist[i++].value.lval = icp->v_next.lval;
-			else {
-			    if (pcp->desc.sem == PM_SEM_DISCRETE) {
-				if (icp->t_prior >= 0) {
-				    if (!IS_VALUE(icp->s_next) || t_req <= (icp->t_prior + icp->t_next)/2)
-					rp->vset[j]->vlist[i++].value.lval = icp->v_prior.lval;
-				    else
-					rp->vset[j]->vlist[i++].value.lval = icp->v_next.lval;
-				}
-			    }
-			    else if (pcp->desc.sem == PM_SEM_INSTANT) {
-				if (icp->t_prior >= 0 && icp->t_next >= 0) {
-				    if (t_req <= (icp->t_prior + icp->t_next)/2)
-					rp->vset[j]->vlist[i++].value.lval = icp->v_prior.lval;
-				    else
-					rp->vset[j]->vlist[i++].value.lval = icp->v_next.lval;
-				}
-			    }
-			    else {
-				/* assume COUNTER */
-				pmAtomValue	av;
-				pmAtomValue	*avp_prior = (pmAtomValue *)&icp->v_prior.lval;
-				pmAtomValue	*avp_next = (pmAtomValue *)&icp->v_next.lval;
-				if (icp->t_prior >= 0 && icp->t_next >= 0) {
-				    av.f = avp_prior->f + (t_req - icp->t_prior) *
-					(avp_next->f - avp_prior->f) /
-					(icp->t_next - icp->t_prior);
-				    /* yes this IS correct ... */
-				    rp->vset[j]->vlist[i++].value.lval = av.l;
-				}
-			    }
-			}
-		    }
-		    else if (pcp->desc.type == PM_TYPE_FLOAT) {
-			/* NEW style FLOAT in pmValueBlock */
-			int			need;
-			pmValueBlock	*vp;
-			int			ok = 1;
-
-			need = PM_VAL_HDR_SIZE + sizeof(float);
-			if ((vp = (pmValueBlock *)malloc(need)) == NULL) {
-			    sts = -oserror();
-			    goto bad_alloc;
-			}
-			vp->vlen = need;
-			vp->vtype = PM_TYPE_FLOAT;
-			rp->vset[j]->valfmt = PM_VAL_DPTR;
-			rp->vset[j]->vlist[i++].value.pval = vp;
-			if (icp->t_prior == t_req)
-			    memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(float));
-			else if (icp->t_next == t_req)
-			    memcpy((void *)vp->vbuf, (void *)icp->v_next.pval->vbuf, sizeof(float));
-			else {
-			    if (pcp->desc.sem == PM_SEM_DISCRETE) {
-				if (icp->t_prior >= 0) {
-				    if (!IS_VALUE(icp->s_next) || t_req <= (icp->t_prior + icp->t_next)/2)
-					memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(float));
-				    else
-					memcpy((void *)vp->vbuf, (void *)icp->v_next.pval->vbuf, sizeof(float));
-				}
-				else
-				    ok = 0;
-			    }
-			    else if (pcp->desc.sem == PM_SEM_INSTANT) {
-				if (icp->t_prior >= 0 && icp->t_next >= 0) {
-				    if (t_req <= (icp->t_prior + icp->t_next)/2)
-					memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(float));
-				    else
-					memcpy((void *)vp->vbuf, (void *)icp->v_next.pval->vbuf, sizeof(float));
-				}
-				else
-				    ok = 0;
-			    }
-			    else {
-				/* assume COUNTER */
-				if (icp->t_prior >= 0 && icp->t_next >= 0) {
-				    pmAtomValue	av;
-				    void		*avp_prior = icp->v_prior.pval->vbuf;
-				    void		*avp_next = icp->v_next.pval->vbuf;
-				    float	f_prior;
-				    float	f_next;
-
-				    memcpy((void *)&av.f, avp_prior, sizeof(av.f));
-				    f_prior = av.f;
-				    memcpy((void *)&av.f, avp_next, sizeof(av.f));
-				    f_next = av.f;
-				    
-				    av.f = f_prior + (t_req - icp->t_prior) *
-					(f_next - f_prior) /
-					(icp->t_next - icp->t_prior);
-				    memcpy((void *)vp->vbuf, (void *)&av.f, sizeof(av.f));
-				}
-				else
-				    ok = 0;
-			    }
-			}
-			if (!ok) {
-			    i--;
-			    free(vp);
-			}
-		    }
-		    else if (pcp->desc.type == PM_TYPE_64 || pcp->desc.type == PM_TYPE_U64) {
-			int			need;
-			pmValueBlock	*vp;
-			int			ok = 1;
-			
-			need = PM_VAL_HDR_SIZE + sizeof(__int64_t);
-			if ((vp = (pmValueBlock *)malloc(need)) == NULL) {
-			    sts = -oserror();
-			    goto bad_alloc;
-			}
-			vp->vlen = need;
-			if (pcp->desc.type == PM_TYPE_64)
-			    vp->vtype = PM_TYPE_64;
-			else
-			    vp->vtype = PM_TYPE_U64;
-			rp->vset[j]->valfmt = PM_VAL_DPTR;
-			rp->vset[j]->vlist[i++].value.pval = vp;
-			if (icp->t_prior == t_req)
-			    memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(__int64_t));
-			else if (icp->t_next == t_req)
-			    memcpy((void *)vp->vbuf, (void *)icp->v_next.pval->vbuf, sizeof(__int64_t));
-			else {
-			    if (pcp->desc.sem == PM_SEM_DISCRETE) {
-				if (icp->t_prior >= 0) {
-				    if (!IS_VALUE(icp->s_next) || t_req <= (icp->t_prior + icp->t_next)/2)
-					memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(__int64_t));
-				    else
-					memcpy((void *)vp->vbuf, (void *)icp->v_next.pval->vbuf, sizeof(__int64_t));
-				}
-				else
-				    ok = 0;
-			    }
-			    else if (pcp->desc.sem == PM_SEM_INSTANT) {
-				if (icp->t_prior >= 0 && icp->t_next >= 0) {
-				    if (t_req <= (icp->t_prior + icp->t_next)/2)
-					memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(__int64_t));
-				    else
-					memcpy((void *)vp->vbuf, (void *)icp->v_next.pval->vbuf, sizeof(__int64_t));
-				}
-				else
-				    ok = 0;
-			    }
-			    else {
-				/* assume COUNTER */
-				if (icp->t_prior >= 0 && icp->t_next >= 0) {
-				    pmAtomValue	av;
-				    void		*avp_prior = (void *)icp->v_prior.pval->vbuf;
-				    void		*avp_next = (void *)icp->v_next.pval->vbuf;
-				    if (pcp->desc.type == PM_TYPE_64) {
-					__int64_t	ll_prior;
-					__int64_t	ll_next;
-					memcpy((void *)&av.ll, avp_prior, sizeof(av.ll));
-					ll_prior = av.ll;
-					memcpy((void *)&av.ll, avp_next, sizeof(av.ll));
-					ll_next = av.ll;
-					if (ll_next >= ll_prior || dowrap == 0)
-					    av.ll = ll_next - ll_prior;
-					else
-					    /* not monotonic increasing and want wrap */
-					    av.ll = (__int64_t)(ULONGLONG_MAX - ll_prior + 1 +  ll_next);
-					av.ll = (__int64_t)(0.5 + (double)ll_prior +
-							    (t_req - icp->t_prior) * (double)av.ll / (icp->t_next - icp->t_prior));
-					memcpy((void *)vp->vbuf, (void *)&av.ll, sizeof(av.ll));
-				    }
-				    else {
-					__int64_t	ull_prior;
-					__int64_t	ull_next;
-					memcpy((void *)&av.ull, avp_prior, sizeof(av.ull));
-					ull_prior = av.ull;
-					memcpy((void *)&av.ull, avp_next, sizeof(av.ull));
-					ull_next = av.ull;
-					if (ull_next >= ull_prior) {
-					    av.ull = ull_next - ull_prior;
-#if !defined(HAVE_CAST_U64_DOUBLE)
-					    {
-						double tmp;
-						
-						if (SIGN_64_MASK & av.ull)
-						    tmp = (double)(__int64_t)(av.ull & (~SIGN_64_MASK)) + (__uint64_t)SIGN_64_MASK;
-						else
-						    tmp = (double)(__int64_t)av.ull;
-						
-						av.ull = (__uint64_t)(0.5 + (double)ull_prior +
-								      (t_req - icp->t_prior) * tmp /
-								      (icp->t_next - icp->t_prior));
-					    }
-#else
-					    av.ull = (__uint64_t)(0.5 + (double)ull_prior +
-								  (t_req - icp->t_prior) * (double)av.ull /
-								  (icp->t_next - icp->t_prior));
-#endif
-					}
-					else {
-					    /* not monotonic increasing */
-					    if (dowrap) {
-						av.ull = ULONGLONG_MAX - ull_prior + 1 +
-						    ull_next;
-#if !defined(HAVE_CAST_U64_DOUBLE)
-						{
-						    double tmp;
-						    
-						    if (SIGN_64_MASK & av.ull)
-							tmp = (double)(__int64_t)(av.ull & (~SIGN_64_MASK)) + (__uint64_t)SIGN_64_MASK;
-						    else
-							tmp = (double)(__int64_t)av.ull;
-						    
-						    av.ull = (__uint64_t)(0.5 + (double)ull_prior +
-									  (t_req - icp->t_prior) * tmp /
-									  (icp->t_next - icp->t_prior));
-						}
-#else
-						av.ull = (__uint64_t)(0.5 + (double)ull_prior +
-								      (t_req - icp->t_prior) * (double)av.ull /
-								      (icp->t_next - icp->t_prior));
-#endif
-					    }
-					    else {
-						__uint64_t	ull;
-						ull = ull_prior - ull_next;
-#if !defined(HAVE_CAST_U64_DOUBLE)
-						{
-						    double xull;
-						    
-						    if (SIGN_64_MASK & av.ull)
-							xull = (double)(__int64_t)(ull & (~SIGN_64_MASK)) + (__uint64_t)SIGN_64_MASK;
-						    else
-							xull = (double)(__int64_t)ull;
-						    
-						    av.ull = (__uint64_t)(0.5 + (double)ull_prior -
-									  (t_req - icp->t_prior) * xull /
-									  (icp->t_next - icp->t_prior));
-						}
-#else
-						av.ull = (__uint64_t)(0.5 + (double)ull_prior -
-								      (t_req - icp->t_prior) * (double)ull /
-								      (icp->t_next - icp->t_prior));
-#endif
-					    }
-					}
-					memcpy((void *)vp->vbuf, (void *)&av.ull, sizeof(av.ull));
-				    }
-				}
-				else
-				    ok = 0;
-			    }
-			}
-			if (!ok) {
-			    i--;
-			    free(vp);
-			}
-		    }
-		    else if (pcp->desc.type == PM_TYPE_DOUBLE) {
-			pmValueBlock	*vp;
-			int		need;
-			int		ok = 1;
-			
-			need = PM_VAL_HDR_SIZE + sizeof(double);
-			if ((vp = (pmValueBlock *)malloc(need)) == NULL) {
-			    sts = -oserror();
-			    goto bad_alloc;
-			}
-			vp->vlen = need;
-			vp->vtype = PM_TYPE_DOUBLE;
-			rp->vset[j]->valfmt = PM_VAL_DPTR;
-			rp->vset[j]->vlist[i++].value.pval = vp;
-			if (icp->t_prior == t_req)
-			    memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(double));
-			else if (icp->t_next == t_req)
-			    memcpy((void *)vp->vbuf, (void *)icp->v_next.pval->vbuf, sizeof(double));
-			else {
-			    if (pcp->desc.sem == PM_SEM_DISCRETE) {
-				if (icp->t_prior >= 0) {
-				    if (!IS_VALUE(icp->s_next) || t_req <= (icp->t_prior + icp->t_next)/2)
-					memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(double));
-				    else
-					memcpy((void *)vp->vbuf, (void *)icp->v_next.pval->vbuf, sizeof(double));
-				}
-				else
-				    ok = 0;
-			    }
-			    else if (pcp->desc.sem == PM_SEM_INSTANT) {
-				if (icp->t_prior >= 0 && icp->t_next >= 0) {
-				    if (t_req <= (icp->t_prior + icp->t_next)/2)
-					memcpy((void *)vp->vbuf, (void *)icp->v_prior.pval->vbuf, sizeof(double));
-				    else
-					memcpy((void *)vp->vbuf, (void *)icp->v_next.pval->vbuf, sizeof(double));
-				}
-				else
-				    ok = 0;
-			    }
-			    else {
-				/* assume COUNTER */
-				if (icp->t_prior >= 0 && icp->t_next >= 0) {
-				    pmAtomValue	av;
-				    void	*avp_prior = (void *)icp->v_prior.pval->vbuf;
-				    void	*avp_next = (void *)icp->v_next.pval->vbuf;
-				    double	d_prior;
-				    double	d_next;
-				    memcpy((void *)&av.d, avp_prior, sizeof(av.d));
-				    d_prior = av.d;
-				    memcpy((void *)&av.d, avp_next, sizeof(av.d));
-				    d_next = av.d;
-				    av.d = d_prior + (t_req - icp->t_prior) *
-					(d_next - d_prior) /
-					(icp->t_next - icp->t_prior);
-				    memcpy((void *)vp->vbuf, (void *)&av.d, sizeof(av.d));
-				}
-				else
-				    ok = 0;
-			    }
-			}
-			if (!ok) {
-			    i--;
-			    free(vp);
-			}
-		    }
-		    else if ((pcp->desc.type == PM_TYPE_AGGREGATE ||
-			      pcp->desc.type == PM_TYPE_EVENT ||
-			      pcp->desc.type == PM_TYPE_HIGHRES_EVENT ||
-			      pcp->desc.type == PM_TYPE_STRING) &&
-			     icp->t_prior >= 0) {
-			int		need;
-			pmValueBlock	*vp;
-			
-			need = icp->v_prior.pval->vlen;
-			
-			vp = (pmValueBlock *)malloc(need);
-			if (vp == NULL) {
-			    sts = -oserror();
-			    goto bad_alloc;
-			}
-			rp->vset[j]->valfmt = PM_VAL_DPTR;
-			rp->vset[j]->vlist[i++].value.pval = vp;
-			memcpy((void *)vp, icp->v_prior.pval, need);
-		    }
-		    else {
-			/* unknown type - skip it, else junk in result */
-			i--;
-		    }
-		}
+	    if ((n = batch_gather(pcp, pmDebugOptions.interp && done_roll)) < 0) {
+		sts = n;
+		goto bad_alloc;
+	    }
+	    if ((m = batch_pick(pcp, n, t_req)) > 0) {
+		m = batch_load(pcp, n, dowrap);
+		batch_interp(&pcp->batch, m, t_req,
+			     pcp->desc.type != PM_TYPE_FLOAT &&
+			     pcp->desc.type != PM_TYPE_DOUBLE);
 	    }
+	    if ((sts = batch_emit(pcp, n, rp->vset[j], &i)) < 0)
+		goto bad_alloc;
 	}
 	pcp->last_numval = pcp->numval;
     }
@@ -2301,6 +2703,7 @@ __pmFreeInterpData(__pmContext *ctxp)
 		    pcp->hc.hash = NULL;
 		}
 		pcp->hc.hsize = 0;
+		batch_free(&pcp->batch);
 		if (last_hp != NULL) {
 		    if (last_hp->data != NULL)
 			free(last_hp->data);
@@ -2324,26 +2727,54 @@ __pmFreeInterpData(__pmContext *ctxp)
 
     if (ctxp->c_archctl->ac_cache != NULL) {
 	/* read cache allocated, work to be done */
-	cache_t		*cache = (cache_t *)ctxp->c_archctl->ac_cache;
-	cache_t		*cp;
-
-	for (cp = cache; cp < &cache[NUMCACHE]; cp++) {
-	    if (pmDebugOptions.log && pmDebugOptions.interp) {
-		fprintf(stderr, "read cache entry "
-			PRINTF_P_PFX "%p: c_name=%s rp="
-			PRINTF_P_PFX "%p\n",
-			cp, cp->c_name ? cp->c_name : "(none)",
-			cp->rp);
-	    }
-	    if (cp->c_name != NULL) {
-		free(cp->c_name);
-		cp->c_name = NULL;
-	    }
-	    if (cp->rp != NULL) {
-		__pmFreeResult(cp->rp);
-		cp->rp = NULL;
+	cache_flush(ctxp->c_archctl);
+    }
+}
+
+/*
+ * Records that hold none of the metrics this context has ever asked
+ * for (and are not <mark> records) cannot change any of the bounds
+ * above, so let __pmLogRead_ctx() skip them if the archive has a PMID
+ * sidecar index.  The set only grows, but cached reads were made with
+ * the old set and may have skipped records we now need, so the cache
+ * must go when a new metric appears.
+ */
+int
+__pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult **result)
+{
+    __pmArchCtl		*acp = ctxp->c_archctl;
+    __pmHashCtl		*hcp = &acp->ac_pmid_hc;
+    __pmHashNode	*hp;
+    pmID		*want;
+    int			nwant = 0;
+    int			added = 0;
+    int			j, sts;
+
+    want = (pmID *)malloc((hcp->nodes + numpmid + 1) * sizeof(pmID));
+    if (want != NULL) {
+	for (hp = __pmHashWalk(hcp, PM_HASH_WALK_START); hp != NULL;
+	     hp = __pmHashWalk(hcp, PM_HASH_WALK_NEXT)) {
+	    if (!IS_DERIVED((pmID)hp->key))
+		want[nwant++] = (pmID)hp->key;
+	}
+	for (j = 0; j < numpmid; j++) {
+	    if (pmidlist[j] == PM_ID_NULL || IS_DERIVED(pmidlist[j]))
+		continue;
+	    if (__pmHashSearch((int)pmidlist[j], hcp) == NULL) {
+		want[nwant++] = pmidlist[j];
+		added = 1;
 	    }
-	    cp->used = 0;
 	}
+	if (added && acp->ac_cache != NULL)
+	    cache_flush(acp);
+	acp->ac_pmidx_want = want;
+	acp->ac_pmidx_nwant = nwant;
     }
+
+    sts = fetch_interp(ctxp, numpmid, pmidlist, result);
+
+    acp->ac_pmidx_want = NULL;
+    acp->ac_pmidx_nwant = 0;
+    free(want);
+    return sts;
 }
@@ -20,6 +20,9 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include "config.h"
+#ifndef IS_MINGW
+#include <sys/uio.h>
+#endif
 #include "pmapi.h"
 #include "libpcp.h"
 #include "internal.h"
@@ -28,6 +31,12 @@ extern __pm_fops __pm_stdio;
 #if HAVE_TRANSPARENT_DECOMPRESSION && HAVE_LZMA_DECOMPRESSION
 extern __pm_fops __pm_xz;
 #endif
+#if HAVE_TRANSPARENT_DECOMPRESSION && HAVE_ZSTD_DECOMPRESSION
+extern __pm_fops __pm_zstd;
+#endif
+#if HAVE_TRANSPARENT_DECOMPRESSION && HAVE_GZIP_DECOMPRESSION
+extern __pm_fops __pm_gz;
+#endif
 
 /*
  * Suffixes and associated compresssion application for compressed filenames.
@@ -46,6 +55,16 @@ extern __pm_fops __pm_xz;
 #else
 #define TRANSPARENT_XZ NULL
 #endif
+#if HAVE_TRANSPARENT_DECOMPRESSION && HAVE_ZSTD_DECOMPRESSION
+#define TRANSPARENT_ZSTD (&__pm_zstd)
+#else
+#define TRANSPARENT_ZSTD NULL
+#endif
+#if HAVE_TRANSPARENT_DECOMPRESSION && HAVE_GZIP_DECOMPRESSION
+#define TRANSPARENT_GZIP (&__pm_gz)
+#else
+#define TRANSPARENT_GZIP NULL
+#endif
 
 static const struct {
     const char	*suffix;
@@ -56,10 +75,10 @@ static const struct {
     { ".lzma",	USE_XZ,		NULL },
     { ".bz2",	USE_BZIP2,	NULL },
     { ".bz",	USE_BZIP2,	NULL },
-    { ".gz",	USE_GZIP,	NULL },
+    { ".gz",	USE_GZIP,	TRANSPARENT_GZIP },
     { ".Z",	USE_GZIP,	NULL },
     { ".z",	USE_GZIP,	NULL },
-    { ".zst",	USE_ZSTD,	NULL },
+    { ".zst",	USE_ZSTD,	TRANSPARENT_ZSTD },
 };
 static const int ncompress = sizeof(compress_ctl) / sizeof(compress_ctl[0]);
 
@@ -448,7 +467,8 @@ __pmAccess(const char *path, int amode)
  * Open a PCP file with given mode and return a __pmFILE. An i/o
  * handler is automatically chosen based on filename suffix, e.g. .xz, .gz,
  * etc. The stdio pass-thru handler will be chosen for other files.
- * The stdio handler is the only handler currently supporting write operations.
+ * Apart from the stdio handler, only the zstd handler supports write
+ * operations (mode "w" only, see io_zstd.c).
  * Return a valid __pmFILE pointer on success or NULL on failure.
  */
 __pmFILE *
@@ -487,8 +507,13 @@ __pmFopen(const char *path, const char *mode)
     }
     if (compress_ix >= 0) {
 	if (mode[0] != 'r' || mode[1] != '\0') {
-	    /* We don't (yet) support opening compressed files for writing. */
-	    return NULL;
+	    /* Of the compressed formats, only zstd can (yet) be written. */
+	    if (mode[0] != 'w' || mode[1] != '\0' ||
+		compress_ctl[compress_ix].appl != USE_ZSTD ||
+		compress_ctl[compress_ix].handler == NULL) {
+		setoserror(EOPNOTSUPP);
+		return NULL;
+	    }
 	}
 
 	/* Use the compressed file name and select a handler. */
@@ -618,6 +643,28 @@ __pmFwrite(void *ptr, size_t size, size_t nmemb, __pmFILE *f)
     return f->fops->__pmwrite(ptr, size, nmemb, f);
 }
 
+/*
+ * Gather write of iovcnt buffers, returning the number of bytes written.
+ * Handlers without a __pmwritev (the compressed ones) get one
+ * __pmFwrite per buffer.
+ */
+size_t
+__pmFwritev(const struct iovec *iov, int iovcnt, __pmFILE *f)
+{
+    size_t	n, sts = 0;
+    int		i;
+
+    if (f->fops->__pmwritev != NULL)
+	return f->fops->__pmwritev(iov, iovcnt, f);
+    for (i = 0; i < iovcnt; i++) {
+	n = f->fops->__pmwrite(iov[i].iov_base, 1, iov[i].iov_len, f);
+	sts += n;
+	if (n != iov[i].iov_len)
+	    break;
+    }
+    return sts;
+}
+
 int
 __pmFflush(__pmFILE *f)
 {
@@ -0,0 +1,614 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * In-process, random access decompression of gzip'd files.
+ *
+ * gzip has no index, so one is built as the file is read: inflation
+ * proceeds a span (PCP_GZ_SPAN bytes of uncompressed data) at a time
+ * from the furthest point reached so far, and the inflate state at the
+ * start of each span is saved with inflateCopy().  Spans are kept in a
+ * small LRU cache, in the same way as the xz handler caches uncompressed
+ * blocks, and going back to an earlier span resumes inflation from its
+ * checkpoint.  Only seeking relative to the end, or asking for the size,
+ * needs the rest of the file to be inflated.  Multi-member gzip files
+ * are handled.
+ */
+#include "config.h"
+#if HAVE_GZIP_DECOMPRESSION
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <zlib.h>
+#include "pmapi.h"
+#include "libpcp.h"
+
+#ifndef PCP_GZ_CACHE_BLOCKS
+#define PCP_GZ_CACHE_BLOCKS 4		/* 4 spans in the cache, for now */
+#endif
+#ifndef PCP_GZ_SPAN
+#define PCP_GZ_SPAN	(1024*1024)	/* uncompressed bytes between checkpoints */
+#endif
+#define GZ_INBUFSIZE	(64*1024)
+
+/* inflate state at the start of a span of uncompressed data */
+typedef struct checkpoint {
+    z_stream	*strm;		/* copy of the inflate state, must not move */
+    off_t	in_offset;	/* compressed offset to resume reading from */
+} checkpoint;
+
+/* A buffer of uncompressed data, one span */
+typedef struct block {
+    __uint64_t	start;
+    __uint64_t	size;
+    __uint64_t	current_offset;
+    char	*data;
+} block;
+
+typedef struct gzfile {
+    int		fd;
+    checkpoint	*points;	/* start of each span inflated so far */
+    int		npoints;
+    z_stream	front;		/* inflate state after the last span */
+    off_t	front_in;	/* ... and its compressed offset */
+    int		done;		/* all of the data has been inflated */
+    block	cache[PCP_GZ_CACHE_BLOCKS];
+    off_t	uncompressed_offset;
+    __uint64_t	uncompressed_size;	/* so far, unless done */
+    int		members;	/* complete gzip members seen */
+    unsigned char inbuf[GZ_INBUFSIZE];
+} gzfile;
+
+static block *reposition(gzfile *);
+
+static void
+gz_debug(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (pmDebugOptions.compress) {
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	fputc('\n', stderr);
+	va_end(ap);
+    }
+}
+
+/*
+ * Refill the input buffer from *in_offset, after any input not yet
+ * consumed, return bytes read, 0 at end of file or -1 on error.
+ */
+static ssize_t
+gz_fill(gzfile *gz, z_stream *strm, off_t *in_offset)
+{
+    uInt	left = strm->avail_in;
+    ssize_t	n;
+
+    if (left > 0)
+	memmove(gz->inbuf, strm->next_in, left);
+    n = pread(gz->fd, gz->inbuf + left, sizeof(gz->inbuf) - left, *in_offset);
+    if (n < 0) {
+	gz_debug("%s(%d, ...): pread: %m", __func__, gz->fd);
+	return -1;
+    }
+    *in_offset += n;
+    strm->next_in = gz->inbuf;
+    strm->avail_in = left + n;
+    return n;
+}
+
+/*
+ * Inflate up to avail_out bytes into next_out of strm, continuing over
+ * gzip member boundaries.  Return the number of bytes produced, which is
+ * only less than requested at the end of the compressed data, or -1 on
+ * error.
+ */
+static ssize_t
+gz_inflate(gzfile *gz, z_stream *strm, off_t *in_offset)
+{
+    uInt	want = strm->avail_out;
+    ssize_t	n;
+    int		sts;
+
+    while (strm->avail_out > 0) {
+	if (strm->avail_in == 0) {
+	    if ((n = gz_fill(gz, strm, in_offset)) < 0)
+		return -1;
+	    if (n == 0)
+		break;
+	}
+	sts = inflate(strm, Z_NO_FLUSH);
+	if (sts == Z_STREAM_END) {
+	    gz->members++;
+	    /*
+	     * End of a gzip member ... there may be another one, else
+	     * stop (trailing zero padding is tolerated, like gzip -d) ...
+	     * the next member may start right at the end of the buffer,
+	     * so make sure both bytes of its magic number are there
+	     */
+	    if (strm->avail_in < 2) {
+		if (gz_fill(gz, strm, in_offset) < 0)
+		    return -1;
+	    }
+	    if (strm->avail_in < 2 ||
+		strm->next_in[0] != 0x1f || strm->next_in[1] != 0x8b)
+		break;
+	    inflateReset(strm);
+	    continue;
+	}
+	if (sts != Z_OK && sts != Z_BUF_ERROR) {
+	    gz_debug("%s(%d, ...): inflate: %s (error %d)", __func__, gz->fd,
+			strm->msg ? strm->msg : "?", sts);
+	    return -1;
+	}
+	if (sts == Z_BUF_ERROR && strm->avail_in != 0)
+	    return -1;
+    }
+    return want - strm->avail_out;
+}
+
+/*
+ * Inflate the next span from the front into data (PCP_GZ_SPAN bytes),
+ * saving a checkpoint at its start.  Return the number of bytes in the
+ * span, which is less than PCP_GZ_SPAN only for the last one, or -1 on
+ * error.
+ */
+static ssize_t
+advance(gzfile *gz, char *data)
+{
+    z_stream	*strm = &gz->front;
+    checkpoint	*cp;
+    ssize_t	n;
+
+    if ((cp = realloc(gz->points, (gz->npoints + 1) * sizeof(*cp))) == NULL)
+	return -1;
+    gz->points = cp;
+    cp = &gz->points[gz->npoints];
+    if ((cp->strm = calloc(1, sizeof(z_stream))) == NULL)
+	return -1;
+    if (inflateCopy(cp->strm, strm) != Z_OK) {
+	free(cp->strm);
+	return -1;
+    }
+    cp->in_offset = gz->front_in;
+    gz->npoints++;
+
+    strm->next_out = (Bytef *)data;
+    strm->avail_out = PCP_GZ_SPAN;
+    n = gz_inflate(gz, strm, &gz->front_in);
+    /* unconsumed input will be re-read from the file on resume */
+    gz->front_in -= strm->avail_in;
+    strm->next_in = NULL;
+    strm->avail_in = 0;
+    if (n < 0) {
+	/* no going further, and this span has no valid start */
+	gz->done = 1;
+	gz->npoints--;
+	inflateEnd(cp->strm);
+	free(cp->strm);
+	return -1;
+    }
+
+    gz->uncompressed_size += n;
+    if (n < PCP_GZ_SPAN) {
+	gz->done = 1;
+	gz_debug("%s(%d, ...): %llu bytes, %d members, %d checkpoints",
+		__func__, gz->fd, (unsigned long long)gz->uncompressed_size,
+		gz->members, gz->npoints);
+	if (n == 0 && gz->npoints > 1) {
+	    /* last checkpoint is redundant */
+	    gz->npoints--;
+	    inflateEnd(gz->points[gz->npoints].strm);
+	    free(gz->points[gz->npoints].strm);
+	}
+    }
+    return n;
+}
+
+/*
+ * Inflate through to the end of the data, for the total size.
+ */
+static int
+advance_to_end(gzfile *gz)
+{
+    char	*scratch;
+    int		sts = 0;
+
+    if (gz->done)
+	return 0;
+    if ((scratch = malloc(PCP_GZ_SPAN)) == NULL) {
+	gz_debug("%s(%d, ...): malloc(%d bytes) failed", __func__, gz->fd, PCP_GZ_SPAN);
+	return -1;
+    }
+    while (!gz->done) {
+	if (advance(gz, scratch) < 0) {
+	    sts = -1;
+	    break;
+	}
+    }
+    free(scratch);
+    return sts;
+}
+
+static void
+gz_free(gzfile *gz)
+{
+    int		i;
+
+    for (i = 0; i < gz->npoints; i++) {
+	inflateEnd(gz->points[i].strm);
+	free(gz->points[i].strm);
+    }
+    free(gz->points);
+    inflateEnd(&gz->front);
+    for (i = 0; i < PCP_GZ_CACHE_BLOCKS; i++)
+	free(gz->cache[i].data);
+    free(gz);
+}
+
+static void *
+gz_fdopen(__pmFILE *f, int fd, const char *mode)
+{
+    gzfile	*gz;
+
+    if ((gz = calloc(1, sizeof(*gz))) == NULL) {
+	pmNoMem("gz_fdopen", sizeof(*gz), PM_FATAL_ERR);
+	return NULL;
+    }
+    gz->fd = fd;
+    if (inflateInit2(&gz->front, 15 + 16) != Z_OK) {
+	free(gz);
+	return NULL;
+    }
+    f->priv = gz;
+    /* inflate the first span, so an empty or bad file fails now */
+    if (reposition(gz) == NULL && (gz->npoints == 0 || gz->members == 0)) {
+	if (gz->npoints > 0)
+	    /* empty or truncated file */
+	    setoserror(-PM_ERR_LOGREC);
+	gz_free(gz);
+	f->priv = NULL;
+	return NULL;
+    }
+    return gz;
+}
+
+static void *
+gz_open(__pmFILE *f, const char *path, const char *mode)
+{
+    void	*priv;
+    int		fd;
+
+    if ((fd = open(path, O_RDONLY)) < 0) {
+	gz_debug("%s(..., %s, ...): open: %m", __func__, path);
+	return NULL;
+    }
+    gz_debug("%s(..., %s, ...): fd=%d", __func__, path, fd);
+    if ((priv = gz_fdopen(f, fd, mode)) == NULL)
+	close(fd);
+    return priv;
+}
+
+static int
+gz_seek(__pmFILE *f, off_t offset, int whence)
+{
+    gzfile	*gz = (gzfile *)f->priv;
+    __int64_t	new_offset;
+
+    switch (whence) {
+    case SEEK_SET:
+	new_offset = offset;
+	break;
+    case SEEK_CUR:
+	new_offset = gz->uncompressed_offset + offset;
+	break;
+    case SEEK_END:
+	if (advance_to_end(gz) < 0) {
+	    errno = EIO;
+	    return -1;
+	}
+	new_offset = gz->uncompressed_size + offset;
+	break;
+    default:
+	errno = EINVAL;
+	return -1;
+    }
+    if (new_offset < 0) {
+	errno = EINVAL;
+	return -1;
+    }
+
+    /* Don't actually seek to the requested offset now. Just record it. */
+    gz->uncompressed_offset = new_offset;
+    return 0;
+}
+
+static off_t
+gz_lseek(__pmFILE *f, off_t offset, int whence)
+{
+    if (gz_seek(f, offset, whence) < 0)
+	return -1;
+    return ((gzfile *)f->priv)->uncompressed_offset;
+}
+
+static void
+gz_rewind(__pmFILE *f)
+{
+    gzfile	*gz = (gzfile *)f->priv;
+
+    gz->uncompressed_offset = 0;
+}
+
+static off_t
+gz_tell(__pmFILE *f)
+{
+    gzfile	*gz = (gzfile *)f->priv;
+
+    return gz->uncompressed_offset;
+}
+
+static block *
+cache_block_used(gzfile *gz, int slot)
+{
+    /* Move this block into the first slot, if it is not already there */
+    if (slot != 0) {
+	block	used = gz->cache[slot];
+	int	i;
+
+	for (i = slot; i > 0; --i)
+	    gz->cache[i] = gz->cache[i - 1];
+	gz->cache[0] = used;
+    }
+    return &gz->cache[0];
+}
+
+/*
+ * Inflate the span containing the current uncompressed offset into
+ * the given cache slot.
+ */
+static block *
+read_new_block(gzfile *gz, int slot)
+{
+    z_stream	strm;
+    checkpoint	*cp;
+    block	*blk;
+    off_t	in_offset;
+    ssize_t	n;
+    char	*data;
+    int		i;
+
+    i = gz->uncompressed_offset / PCP_GZ_SPAN;
+    if (i >= gz->npoints && gz->done)
+	return NULL;
+
+    blk = &gz->cache[slot];
+    if ((data = blk->data) == NULL && (data = malloc(PCP_GZ_SPAN)) == NULL) {
+	gz_debug("%s(%d, ...): malloc(%d bytes) failed", __func__, gz->fd, PCP_GZ_SPAN);
+	return NULL;
+    }
+    blk->data = data;
+    blk->size = 0;
+
+    if (i >= gz->npoints) {
+	/* not reached yet, inflate forwards (via this slot) */
+	n = 0;
+	while (i >= gz->npoints && !gz->done) {
+	    if ((n = advance(gz, data)) < 0)
+		return NULL;
+	}
+	if (i >= gz->npoints || n <= 0)
+	    return NULL;
+    }
+    else {
+	cp = &gz->points[i];
+	memset(&strm, 0, sizeof(strm));
+	if (inflateCopy(&strm, cp->strm) != Z_OK)
+	    return NULL;
+	in_offset = cp->in_offset;
+	strm.next_out = (Bytef *)data;
+	strm.avail_out = PCP_GZ_SPAN;
+	n = gz_inflate(gz, &strm, &in_offset);
+	inflateEnd(&strm);
+	if (n <= 0)
+	    return NULL;
+    }
+
+    blk->start = (__uint64_t)i * PCP_GZ_SPAN;
+    blk->size = n;
+    blk->current_offset = gz->uncompressed_offset - blk->start;
+    if (blk->current_offset >= blk->size)
+	return NULL;	/* past end of data */
+
+    /* Mark this block as most recently used */
+    return cache_block_used(gz, slot);
+}
+
+/*
+ * Find the block containing the current uncompressed offset and update the
+ * current offset within that block.
+ */
+static block *
+reposition(gzfile *gz)
+{
+    block	*blk;
+    int		slot;
+
+    for (slot = 0; slot < PCP_GZ_CACHE_BLOCKS; ++slot) {
+	blk = &gz->cache[slot];
+	if (blk->size == 0)
+	    break; /* end of cache */
+	if (gz->uncompressed_offset >= blk->start &&
+	    gz->uncompressed_offset < blk->start + blk->size) {
+	    blk->current_offset = gz->uncompressed_offset - blk->start;
+	    return cache_block_used(gz, slot);
+	}
+    }
+    if (slot >= PCP_GZ_CACHE_BLOCKS)
+	slot = PCP_GZ_CACHE_BLOCKS - 1;
+    return read_new_block(gz, slot);
+}
+
+static int
+gz_getc(__pmFILE *f)
+{
+    gzfile	*gz = (gzfile *)f->priv;
+    block	*blk;
+    int		c;
+
+    if ((blk = reposition(gz)) == NULL)
+	return EOF;
+    c = *(unsigned char *)(blk->data + blk->current_offset);
+    ++gz->uncompressed_offset;
+    ++blk->current_offset;
+    return c;
+}
+
+static size_t
+gz_read(void *ptr, size_t size, size_t nmemb, __pmFILE *f)
+{
+    gzfile	*gz = (gzfile *)f->priv;
+    block	*blk;
+    size_t	n;
+    size_t	copied = 0;
+
+    size *= nmemb;
+    while (size > 0) {
+	if ((blk = reposition(gz)) == NULL)
+	    break;
+	n = size;
+	if (n > blk->size - blk->current_offset)
+	    n = blk->size - blk->current_offset;
+	memcpy(ptr, blk->data + blk->current_offset, n);
+	copied += n;
+	gz->uncompressed_offset += n;
+	blk->current_offset += n;
+	ptr = ((char *)ptr) + n;
+	size -= n;
+    }
+    return copied;
+}
+
+static size_t
+gz_write(void *ptr, size_t size, size_t nmemb, __pmFILE *f)
+{
+    gz_debug("libpcp internal error: %s not implemented\n", __func__);
+    return 0;
+}
+
+static int
+gz_flush(__pmFILE *f)
+{
+    gz_debug("libpcp internal error: %s not implemented\n", __func__);
+    return EOF;
+}
+
+static int
+gz_fsync(__pmFILE *f)
+{
+    gz_debug("libpcp internal error: %s not implemented\n", __func__);
+    return -1;
+}
+
+static int
+gz_fileno(__pmFILE *f)
+{
+    gzfile	*gz = (gzfile *)f->priv;
+
+    return gz->fd;
+}
+
+static int
+gz_fstat(__pmFILE *f, struct stat *buf)
+{
+    gzfile	*gz = (gzfile *)f->priv;
+    int		rc = fstat(gz->fd, buf);
+
+    /* What the caller really wants for st_size is the uncompressed size. */
+    if (rc != -1) {
+	if (advance_to_end(gz) < 0) {
+	    errno = EIO;
+	    return -1;
+	}
+	buf->st_size = gz->uncompressed_size;
+    }
+    return rc;
+}
+
+static int
+gz_feof(__pmFILE *f)
+{
+    gzfile	*gz = (gzfile *)f->priv;
+
+    if (gz->uncompressed_offset < gz->uncompressed_size)
+	return 0;
+    /* at or beyond the front, is there any more? */
+    return reposition(gz) == NULL;
+}
+
+static int
+gz_ferror(__pmFILE *f)
+{
+    return 0;
+}
+
+static void
+gz_clearerr(__pmFILE *f)
+{
+}
+
+static int
+gz_setvbuf(__pmFILE *f, char *buf, int mode, size_t size)
+{
+    gz_debug("libpcp internal error: %s not implemented\n", __func__);
+    return -1;
+}
+
+static int
+gz_close(__pmFILE *f)
+{
+    gzfile	*gz = (gzfile *)f->priv;
+    int		sts;
+
+    sts = close(gz->fd);
+    gz_free(gz);
+    return sts;
+}
+
+__pm_fops __pm_gz = {
+    /*
+     * gzip decompression
+     */
+    .__pmopen = gz_open,
+    .__pmfdopen = gz_fdopen,
+    .__pmseek = gz_seek,
+    .__pmrewind = gz_rewind,
+    .__pmtell = gz_tell,
+    .__pmfgetc = gz_getc,
+    .__pmread = gz_read,
+    .__pmwrite = gz_write,
+    .__pmflush = gz_flush,
+    .__pmfsync = gz_fsync,
+    .__pmfileno = gz_fileno,
+    .__pmlseek = gz_lseek,
+    .__pmfstat = gz_fstat,
+    .__pmfeof = gz_feof,
+    .__pmferror = gz_ferror,
+    .__pmclearerr = gz_clearerr,
+    .__pmsetvbuf = gz_setvbuf,
+    .__pmclose = gz_close
+};
+#endif /* HAVE_GZIP_DECOMPRESSION */
@@ -18,6 +18,9 @@
 #include <inttypes.h>
 #include <sys/stat.h>
 #include "pmapi.h"
+#ifndef IS_MINGW
+#include <sys/uio.h>
+#endif
 #include "libpcp.h"
 #include "internal.h"
 
@@ -95,6 +98,40 @@ stdio_write(void *ptr, size_t size, size_t nmemb, __pmFILE *f)
     return n;
 }
 
+#ifndef IS_MINGW
+/*
+ * Anything stdio has buffered goes first, then one writev(2) for the
+ * lot, which for an unbuffered archive volume saves a system call per
+ * buffer.  The trailing fseek() resynchronizes stdio with the file
+ * offset, and stdio finishes off any short write.
+ */
+static size_t
+stdio_writev(const struct iovec *iov, int iovcnt, __pmFILE *f)
+{
+    FILE	*fp = (FILE *)f->priv;
+    ssize_t	n;
+    size_t	done, off, skip;
+    int		i;
+
+    if (fflush(fp) != 0)
+	return 0;
+    if ((n = writev(fileno(fp), iov, iovcnt)) < 0)
+	n = 0;
+    fseek(fp, 0, SEEK_CUR);
+    done = n;
+    for (i = 0, off = 0; i < iovcnt; off += iov[i].iov_len, i++) {
+	if (off + iov[i].iov_len <= (size_t)n)
+	    continue;
+	skip = off < (size_t)n ? n - off : 0;
+	done += fwrite((char *)iov[i].iov_base + skip, 1, iov[i].iov_len - skip, fp);
+	if (ferror(fp))
+	    break;
+    }
+    f->position = ftell(fp);
+    return done;
+}
+#endif
+
 static int
 stdio_flush(__pmFILE *f)
 {
@@ -177,6 +214,9 @@ __pm_fops __pm_stdio = {
     .__pmfgetc = stdio_getc,
     .__pmread = stdio_read,
     .__pmwrite = stdio_write,
+#ifndef IS_MINGW
+    .__pmwritev = stdio_writev,
+#endif
     .__pmflush = stdio_flush,
     .__pmfsync = stdio_fsync,
     .__pmfileno = stdio_fileno,
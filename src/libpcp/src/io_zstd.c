@@ -0,0 +1,875 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * In-process, random access decompression of zstd'd files.
+ *
+ * Files in the zstd seekable format (a sequence of independent frames
+ * followed by a skippable frame holding a seek table, as written by
+ * "zstd --seekable" or pmlogger) are indexed from the seek table alone.
+ * For any other zstd file the frame boundaries are found with a single
+ * streaming pass at open time.  Each frame is then decompressed on
+ * demand into a small LRU cache, just like the blocks of an xz file.
+ *
+ * Files opened for writing are append-only.  Data is buffered until the
+ * next __pmFflush() (or the buffer becomes large) and then emitted as one
+ * independent frame, so frame boundaries fall at the offsets recorded in
+ * the temporal index by __pmLogPutIndex().  __pmFclose() appends the seek
+ * table.  A file still being written has no seek table, so readers scan
+ * it, and rescan the tail whenever they reach the end of the known data.
+ */
+#include "config.h"
+#if HAVE_ZSTD_DECOMPRESSION
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <zstd.h>
+#include "pmapi.h"
+#include "libpcp.h"
+
+#ifndef PCP_ZSTD_CACHE_BLOCKS
+#define PCP_ZSTD_CACHE_BLOCKS 4		/* 4 frames in the cache, for now */
+#endif
+#ifndef PCP_ZSTD_FRAME_MAX
+#define PCP_ZSTD_FRAME_MAX (1024*1024)	/* start a new frame beyond this */
+#endif
+#ifndef PCP_ZSTD_LEVEL
+#define PCP_ZSTD_LEVEL 3		/* ZSTD_CLEVEL_DEFAULT, cheap and fast */
+#endif
+
+/*
+ * Seekable format, see contrib/seekable_format/zstd_seekable.h and
+ * zstd_seekable_compression_format.md in the zstd sources.
+ */
+#define SEEKABLE_MAGIC		0x8F92EAB1
+#define SEEKABLE_SKIPPABLE	0x184D2A5E
+#define SEEKABLE_FOOTER_SIZE	9
+#define SEEKABLE_CHECKSUM_FLAG	0x80
+
+/* One independently decompressible frame */
+typedef struct frame {
+    off_t	comp_offset;	/* compressed offset in the file */
+    size_t	comp_size;
+    __uint64_t	start;		/* uncompressed offset */
+    __uint64_t	size;
+} frame;
+
+/* A buffer of uncompressed data, one frame */
+typedef struct block {
+    __uint64_t	start;
+    __uint64_t	size;
+    __uint64_t	current_offset;
+    char	*data;
+} block;
+
+typedef struct zstdfile {
+    int		fd;
+    ZSTD_DCtx	*dctx;
+    frame	*frames;
+    int		nframes;
+    int		maxframes;
+    block	cache[PCP_ZSTD_CACHE_BLOCKS];
+    off_t	uncompressed_offset;
+    __uint64_t	uncompressed_size;	/* in frames[] */
+    off_t	scanned;	/* compressed offset after last frame */
+    ZSTD_CCtx	*cctx;		/* writing only, from here down */
+    char	*wbuf;		/* pending, starts at uncompressed_size */
+    size_t	wlen;
+    size_t	wmax;
+    char	*cbuf;
+    size_t	cmax;
+} zstdfile;
+
+static void
+zstd_debug(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (pmDebugOptions.compress) {
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	fputc('\n', stderr);
+	va_end(ap);
+    }
+}
+
+static unsigned int
+get_le32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static void
+put_le32(unsigned char *p, unsigned int v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+}
+
+static int
+add_frame(zstdfile *zf, off_t comp_offset, size_t comp_size, __uint64_t size)
+{
+    frame	*fp;
+
+    zf->scanned = comp_offset + comp_size;
+    if (size == 0)
+	return 0;	/* skippable, or empty */
+    if (zf->nframes == zf->maxframes) {
+	int	need = zf->maxframes ? 2 * zf->maxframes : 16;
+
+	if ((fp = realloc(zf->frames, need * sizeof(*fp))) == NULL) {
+	    pmNoMem("zstd add_frame", need * sizeof(*fp), PM_RECOV_ERR);
+	    return -1;
+	}
+	zf->frames = fp;
+	zf->maxframes = need;
+    }
+    fp = &zf->frames[zf->nframes++];
+    fp->comp_offset = comp_offset;
+    fp->comp_size = comp_size;
+    fp->start = zf->uncompressed_size;
+    fp->size = size;
+    zf->uncompressed_size += size;
+    return 0;
+}
+
+/*
+ * Try to index the file from a trailing seek table.  Return 1 if this
+ * worked, 0 if the file is not in the seekable format, -1 on error.
+ */
+static int
+parse_seektable(zstdfile *zf, off_t filesize)
+{
+    unsigned char	footer[SEEKABLE_FOOTER_SIZE];
+    unsigned char	*table, *p;
+    unsigned int	nentries, i;
+    size_t		entsize, tablesize;
+    off_t		offset;
+    int			sts = 0;
+
+    if (filesize < SEEKABLE_FOOTER_SIZE + 8)
+	return 0;
+    if (pread(zf->fd, footer, sizeof(footer), filesize - sizeof(footer)) != sizeof(footer))
+	return 0;
+    if (get_le32(&footer[5]) != SEEKABLE_MAGIC)
+	return 0;
+    nentries = get_le32(&footer[0]);
+    entsize = (footer[4] & SEEKABLE_CHECKSUM_FLAG) ? 12 : 8;
+    tablesize = nentries * entsize + SEEKABLE_FOOTER_SIZE + 8;
+    if (nentries == 0 || tablesize > filesize)
+	return 0;
+
+    if ((table = malloc(tablesize)) == NULL) {
+	pmNoMem("zstd seek table", tablesize, PM_RECOV_ERR);
+	return -1;
+    }
+    offset = filesize - tablesize;
+    if (pread(zf->fd, table, tablesize, offset) != tablesize ||
+	get_le32(&table[0]) != SEEKABLE_SKIPPABLE ||
+	get_le32(&table[4]) != tablesize - 8) {
+	zstd_debug("%s(%d, ...): bad seek table at %lld",
+		    __func__, zf->fd, (long long)offset);
+	goto done;
+    }
+
+    offset = 0;
+    for (i = 0, p = &table[8]; i < nentries; i++, p += entsize) {
+	if (add_frame(zf, offset, get_le32(&p[0]), get_le32(&p[4])) < 0) {
+	    sts = -1;
+	    goto done;
+	}
+	offset += get_le32(&p[0]);
+    }
+    if (offset != filesize - tablesize) {
+	/* table does not describe this file, fall back to a full scan */
+	zstd_debug("%s(%d, ...): seek table covers %lld of %lld bytes",
+		    __func__, zf->fd, (long long)offset,
+		    (long long)(filesize - tablesize));
+	zf->nframes = 0;
+	zf->uncompressed_size = 0;
+	zf->scanned = 0;
+	goto done;
+    }
+    zf->scanned = filesize;
+    sts = 1;
+
+done:
+    free(table);
+    return sts;
+}
+
+/*
+ * Not seekable format ... stream through the file once (output discarded)
+ * to find the frame boundaries and their uncompressed sizes.  Starts from
+ * the end of the last frame found, so this is also used to pick up frames
+ * appended to a file that is still being written.
+ */
+static int
+scan_frames(zstdfile *zf)
+{
+    ZSTD_inBuffer	in;
+    ZSTD_outBuffer	out;
+    void		*inbuf, *outbuf;
+    size_t		insize = ZSTD_DStreamInSize();
+    size_t		outsize = ZSTD_DStreamOutSize();
+    size_t		sts = 1;
+    off_t		offset = zf->scanned, frame_offset = zf->scanned;
+    __uint64_t		frame_size = 0;
+    ssize_t		n;
+    int			rc = -1;
+
+    inbuf = malloc(insize);
+    outbuf = malloc(outsize);
+    if (inbuf == NULL || outbuf == NULL)
+	goto done;
+
+    ZSTD_DCtx_reset(zf->dctx, ZSTD_reset_session_only);
+    in.src = inbuf;
+    in.size = in.pos = 0;
+    out.size = outsize;
+    out.pos = 0;
+    for ( ; ; ) {
+	/* only read more once all pending output has been flushed */
+	if (in.pos == in.size && out.pos < out.size) {
+	    if ((n = pread(zf->fd, inbuf, insize, offset)) < 0) {
+		zstd_debug("%s(%d, ...): pread: %m", __func__, zf->fd);
+		goto done;
+	    }
+	    if (n == 0)
+		break;
+	    offset += n;
+	    in.size = n;
+	    in.pos = 0;
+	}
+	out.dst = outbuf;
+	out.pos = 0;
+	sts = ZSTD_decompressStream(zf->dctx, &out, &in);
+	if (ZSTD_isError(sts)) {
+	    zstd_debug("%s(%d, ...): %s", __func__, zf->fd, ZSTD_getErrorName(sts));
+	    goto done;
+	}
+	frame_size += out.pos;
+	if (sts == 0) {
+	    /* end of a frame, and all of its output has been flushed */
+	    off_t	end = offset - (in.size - in.pos);
+
+	    if (add_frame(zf, frame_offset, end - frame_offset, frame_size) < 0)
+		goto done;
+	    frame_offset = end;
+	    frame_size = 0;
+	}
+    }
+    if (sts != 0) {
+	zstd_debug("%s(%d, ...): truncated frame at %lld",
+		    __func__, zf->fd, (long long)frame_offset);
+	if (frame_offset == 0) {
+	    setoserror(-PM_ERR_LOGREC);
+	    goto done;
+	}
+	/* else most likely a frame being written right now, retry later */
+    }
+    rc = 0;
+
+done:
+    free(inbuf);
+    free(outbuf);
+    return rc;
+}
+
+static int
+init(zstdfile *zf)
+{
+    struct stat	sbuf;
+    int		sts;
+
+    if (fstat(zf->fd, &sbuf) < 0)
+	return -1;
+    if ((zf->dctx = ZSTD_createDCtx()) == NULL)
+	return -1;
+    if ((sts = parse_seektable(zf, sbuf.st_size)) < 0)
+	return -1;
+    if (sts == 0 && scan_frames(zf) < 0)
+	return -1;
+
+    zstd_debug("%s(%d, ...): %s, %d frames, %llu bytes",
+		__func__, zf->fd, sts ? "seekable" : "scanned", zf->nframes,
+		(unsigned long long)zf->uncompressed_size);
+    return 0;
+}
+
+/*
+ * At the end of the known data ... if the file has grown since it was
+ * indexed (a live archive volume), pick up any new frames.
+ */
+static void
+refresh(zstdfile *zf)
+{
+    struct stat	sbuf;
+    int		nframes = zf->nframes;
+
+    if (zf->cctx != NULL)
+	return;
+    if (fstat(zf->fd, &sbuf) < 0 || sbuf.st_size <= zf->scanned)
+	return;
+    if (scan_frames(zf) == 0 && zf->nframes > nframes)
+	zstd_debug("%s(%d, ...): %d new frames, %llu bytes",
+		    __func__, zf->fd, zf->nframes - nframes,
+		    (unsigned long long)zf->uncompressed_size);
+}
+
+static int
+init_writer(zstdfile *zf)
+{
+    if ((zf->cctx = ZSTD_createCCtx()) == NULL)
+	return -1;
+    if (ZSTD_isError(ZSTD_CCtx_setParameter(zf->cctx, ZSTD_c_compressionLevel, PCP_ZSTD_LEVEL)))
+	return -1;
+    zstd_debug("%s(%d, ...): level %d", __func__, zf->fd, PCP_ZSTD_LEVEL);
+    return 0;
+}
+
+static void
+zstd_free(zstdfile *zf)
+{
+    int		i;
+
+    for (i = 0; i < PCP_ZSTD_CACHE_BLOCKS; i++)
+	free(zf->cache[i].data);
+    free(zf->frames);
+    free(zf->wbuf);
+    free(zf->cbuf);
+    ZSTD_freeDCtx(zf->dctx);
+    ZSTD_freeCCtx(zf->cctx);
+    free(zf);
+}
+
+static void *
+zstd_fdopen(__pmFILE *f, int fd, const char *mode)
+{
+    zstdfile	*zf;
+
+    if ((zf = calloc(1, sizeof(*zf))) == NULL) {
+	pmNoMem("zstd_fdopen", sizeof(*zf), PM_FATAL_ERR);
+	return NULL;
+    }
+    zf->fd = fd;
+    if ((mode[0] == 'w' ? init_writer(zf) : init(zf)) < 0) {
+	zstd_free(zf);
+	return NULL;
+    }
+    f->priv = zf;
+    return zf;
+}
+
+static void *
+zstd_open(__pmFILE *f, const char *path, const char *mode)
+{
+    void	*priv;
+    int		fd;
+
+    if (mode[0] == 'w')
+	fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+    else
+	fd = open(path, O_RDONLY);
+    if (fd < 0) {
+	zstd_debug("%s(..., %s, ...): open: %m", __func__, path);
+	return NULL;
+    }
+    zstd_debug("%s(..., %s, ...): fd=%d", __func__, path, fd);
+    if ((priv = zstd_fdopen(f, fd, mode)) == NULL)
+	close(fd);
+    return priv;
+}
+
+static int
+zstd_seek(__pmFILE *f, off_t offset, int whence)
+{
+    zstdfile	*zf = (zstdfile *)f->priv;
+    __int64_t	new_offset;
+
+    switch (whence) {
+    case SEEK_SET:
+	new_offset = offset;
+	break;
+    case SEEK_CUR:
+	new_offset = zf->uncompressed_offset + offset;
+	break;
+    case SEEK_END:
+	new_offset = zf->uncompressed_size + zf->wlen + offset;
+	break;
+    default:
+	errno = EINVAL;
+	return -1;
+    }
+    if (new_offset < 0) {
+	errno = EINVAL;
+	return -1;
+    }
+
+    /* Don't actually seek to the requested offset now. Just record it. */
+    zf->uncompressed_offset = new_offset;
+    return 0;
+}
+
+static off_t
+zstd_lseek(__pmFILE *f, off_t offset, int whence)
+{
+    if (zstd_seek(f, offset, whence) < 0)
+	return -1;
+    return ((zstdfile *)f->priv)->uncompressed_offset;
+}
+
+static void
+zstd_rewind(__pmFILE *f)
+{
+    zstdfile	*zf = (zstdfile *)f->priv;
+
+    zf->uncompressed_offset = 0;
+}
+
+static off_t
+zstd_tell(__pmFILE *f)
+{
+    zstdfile	*zf = (zstdfile *)f->priv;
+
+    return zf->uncompressed_offset;
+}
+
+static block *
+cache_block_used(zstdfile *zf, int slot)
+{
+    /* Move this block into the first slot, if it is not already there */
+    if (slot != 0) {
+	block	used = zf->cache[slot];
+	int	i;
+
+	for (i = slot; i > 0; --i)
+	    zf->cache[i] = zf->cache[i - 1];
+	zf->cache[0] = used;
+    }
+    return &zf->cache[0];
+}
+
+/* binary search for the frame containing an uncompressed offset */
+static frame *
+locate_frame(zstdfile *zf, __uint64_t offset)
+{
+    int		lo = 0, hi = zf->nframes - 1, mid;
+    frame	*fp;
+
+    while (lo <= hi) {
+	mid = (lo + hi) / 2;
+	fp = &zf->frames[mid];
+	if (offset < fp->start)
+	    hi = mid - 1;
+	else if (offset >= fp->start + fp->size)
+	    lo = mid + 1;
+	else
+	    return fp;
+    }
+    return NULL;
+}
+
+/*
+ * Decompress the frame containing the current uncompressed offset into
+ * the given cache slot.
+ */
+static block *
+read_new_block(zstdfile *zf, int slot)
+{
+    frame	*fp;
+    block	*blk;
+    void	*src;
+    char	*data;
+    size_t	sts;
+
+    if ((fp = locate_frame(zf, zf->uncompressed_offset)) == NULL) {
+	zstd_debug("%s(%d, ...): cannot find offset %lld - eof?",
+		    __func__, zf->fd, (long long)zf->uncompressed_offset);
+	return NULL;
+    }
+
+    if ((src = malloc(fp->comp_size)) == NULL) {
+	zstd_debug("%s(%d, ...): malloc(%zu bytes): %m", __func__, zf->fd, fp->comp_size);
+	return NULL;
+    }
+    if (pread(zf->fd, src, fp->comp_size, fp->comp_offset) != fp->comp_size) {
+	zstd_debug("%s(%d, ...): short read of frame at %lld",
+		    __func__, zf->fd, (long long)fp->comp_offset);
+	free(src);
+	return NULL;
+    }
+
+    blk = &zf->cache[slot];
+    if ((data = realloc(blk->data, fp->size)) == NULL) {
+	zstd_debug("%s(%d, ...): malloc(%llu bytes): %m\n"
+		   "NOTE: If this error occurs, you need to recompress your zstd files as seekable.  Use: 'zstd --seekable ...'.",
+		   __func__, zf->fd, (unsigned long long)fp->size);
+	free(src);
+	return NULL;
+    }
+    blk->data = data;
+    blk->size = 0;
+    sts = ZSTD_decompressDCtx(zf->dctx, data, fp->size, src, fp->comp_size);
+    free(src);
+    if (ZSTD_isError(sts) || sts != fp->size) {
+	zstd_debug("%s(%d, ...): frame at %lld: %s", __func__, zf->fd,
+		    (long long)fp->comp_offset,
+		    ZSTD_isError(sts) ? ZSTD_getErrorName(sts) : "size mismatch");
+	return NULL;
+    }
+    blk->start = fp->start;
+    blk->size = fp->size;
+    blk->current_offset = zf->uncompressed_offset - blk->start;
+
+    /* Mark this block as most recently used */
+    return cache_block_used(zf, slot);
+}
+
+/*
+ * Find the block containing the current uncompressed offset and update the
+ * current offset within that block.
+ */
+static block *
+reposition(zstdfile *zf)
+{
+    block	*blk;
+    int		slot;
+
+    if (zf->dctx == NULL)
+	return NULL;	/* opened for writing */
+    for (slot = 0; slot < PCP_ZSTD_CACHE_BLOCKS; ++slot) {
+	blk = &zf->cache[slot];
+	if (blk->size == 0)
+	    break; /* end of cache */
+	if (zf->uncompressed_offset >= blk->start &&
+	    zf->uncompressed_offset < blk->start + blk->size) {
+	    blk->current_offset = zf->uncompressed_offset - blk->start;
+	    return cache_block_used(zf, slot);
+	}
+    }
+    if (slot >= PCP_ZSTD_CACHE_BLOCKS)
+	slot = PCP_ZSTD_CACHE_BLOCKS - 1;
+    return read_new_block(zf, slot);
+}
+
+static int
+zstd_getc(__pmFILE *f)
+{
+    zstdfile	*zf = (zstdfile *)f->priv;
+    block	*blk;
+    int		c;
+
+    if (zf->uncompressed_offset >= zf->uncompressed_size)
+	refresh(zf);
+    if (zf->uncompressed_offset >= zf->uncompressed_size)
+	return EOF;
+    if ((blk = reposition(zf)) == NULL)
+	return EOF;
+    c = *(unsigned char *)(blk->data + blk->current_offset);
+    ++zf->uncompressed_offset;
+    ++blk->current_offset;
+    return c;
+}
+
+static size_t
+zstd_read(void *ptr, size_t size, size_t nmemb, __pmFILE *f)
+{
+    zstdfile	*zf = (zstdfile *)f->priv;
+    block	*blk;
+    size_t	n;
+    size_t	copied = 0;
+
+    size *= nmemb;
+    if (zf->uncompressed_offset + size > zf->uncompressed_size)
+	refresh(zf);
+    while (size > 0 && zf->uncompressed_offset < zf->uncompressed_size) {
+	if ((blk = reposition(zf)) == NULL)
+	    break;
+	n = size;
+	if (n > blk->size - blk->current_offset)
+	    n = blk->size - blk->current_offset;
+	memcpy(ptr, blk->data + blk->current_offset, n);
+	copied += n;
+	zf->uncompressed_offset += n;
+	blk->current_offset += n;
+	ptr = ((char *)ptr) + n;
+	size -= n;
+    }
+    return copied;
+}
+
+static int
+write_all(zstdfile *zf, const void *buf, size_t len)
+{
+    const char	*p = (const char *)buf;
+    ssize_t	n;
+
+    while (len > 0) {
+	if ((n = write(zf->fd, p, len)) < 0) {
+	    if (errno == EINTR)
+		continue;
+	    zstd_debug("%s(%d, ...): write: %m", __func__, zf->fd);
+	    return -1;
+	}
+	p += n;
+	len -= n;
+    }
+    return 0;
+}
+
+/*
+ * Compress the first len bytes of pending data as one frame, append it
+ * to the file and remember it for the seek table.
+ */
+static int
+write_frame(zstdfile *zf, size_t len)
+{
+    size_t	bound = ZSTD_compressBound(len);
+    size_t	sts;
+    char	*cbuf;
+
+    if (bound > zf->cmax) {
+	if ((cbuf = realloc(zf->cbuf, bound)) == NULL) {
+	    pmNoMem("zstd write_frame", bound, PM_RECOV_ERR);
+	    return -1;
+	}
+	zf->cbuf = cbuf;
+	zf->cmax = bound;
+    }
+    sts = ZSTD_compress2(zf->cctx, zf->cbuf, bound, zf->wbuf, len);
+    if (ZSTD_isError(sts)) {
+	zstd_debug("%s(%d, ...): %s", __func__, zf->fd, ZSTD_getErrorName(sts));
+	errno = EIO;
+	return -1;
+    }
+    if (write_all(zf, zf->cbuf, sts) < 0)
+	return -1;
+    zstd_debug("%s(%d, ...): frame at %lld, %zu -> %zu bytes", __func__,
+		zf->fd, (long long)zf->uncompressed_size, len, sts);
+    if (add_frame(zf, zf->scanned, sts, len) < 0)
+	return -1;
+    zf->wlen -= len;
+    if (zf->wlen > 0)
+	memmove(zf->wbuf, zf->wbuf + len, zf->wlen);
+    return 0;
+}
+
+/*
+ * Append, or overwrite data not yet flushed into a frame.  Anything
+ * before the start of the pending data is already compressed, and
+ * writing there is an error.
+ */
+static size_t
+zstd_write(void *ptr, size_t size, size_t nmemb, __pmFILE *f)
+{
+    zstdfile	*zf = (zstdfile *)f->priv;
+    __uint64_t	end = zf->uncompressed_size + zf->wlen;
+    size_t	pos, need;
+    char	*wbuf;
+
+    if (zf->cctx == NULL) {
+	errno = EBADF;
+	return 0;
+    }
+    if (zf->uncompressed_offset < zf->uncompressed_size ||
+	zf->uncompressed_offset > end) {
+	zstd_debug("%s(%d, ...): offset %lld outside pending data [%llu,%llu]",
+		    __func__, zf->fd, (long long)zf->uncompressed_offset,
+		    (unsigned long long)zf->uncompressed_size,
+		    (unsigned long long)end);
+	errno = ESPIPE;
+	return 0;
+    }
+    /* only start a new frame between writes, never mid-record */
+    if (zf->uncompressed_offset == end && zf->wlen >= PCP_ZSTD_FRAME_MAX &&
+	write_frame(zf, zf->wlen) < 0)
+	return 0;
+
+    size *= nmemb;
+    pos = zf->uncompressed_offset - zf->uncompressed_size;
+    if ((need = pos + size) > zf->wmax) {
+	if (need < 2 * zf->wmax)
+	    need = 2 * zf->wmax;
+	if ((wbuf = realloc(zf->wbuf, need)) == NULL) {
+	    pmNoMem("zstd_write", need, PM_RECOV_ERR);
+	    return 0;
+	}
+	zf->wbuf = wbuf;
+	zf->wmax = need;
+    }
+    memcpy(zf->wbuf + pos, ptr, size);
+    if (pos + size > zf->wlen)
+	zf->wlen = pos + size;
+    zf->uncompressed_offset += size;
+    return nmemb;
+}
+
+/*
+ * End the current frame at the current offset, so a following read of
+ * the temporal index offset (__pmFtell) is also the start of a frame.
+ * Pending data after the current offset (after a backwards seek) stays
+ * buffered for the next frame.
+ */
+static int
+zstd_flush(__pmFILE *f)
+{
+    zstdfile	*zf = (zstdfile *)f->priv;
+    __uint64_t	end = zf->uncompressed_size + zf->wlen;
+
+    if (zf->cctx == NULL)
+	return 0;
+    if (end > zf->uncompressed_offset)
+	end = zf->uncompressed_offset;
+    if (end <= zf->uncompressed_size)
+	return 0;
+    return write_frame(zf, end - zf->uncompressed_size) < 0 ? EOF : 0;
+}
+
+static int
+zstd_fsync(__pmFILE *f)
+{
+    zstdfile	*zf = (zstdfile *)f->priv;
+
+    return fsync(zf->fd);
+}
+
+/*
+ * Flush any pending data and append the seek table (no checksums).
+ */
+static int
+write_seektable(zstdfile *zf)
+{
+    unsigned char	*table, *p;
+    size_t		tablesize;
+    int			i, sts;
+
+    if (zf->wlen > 0 && write_frame(zf, zf->wlen) < 0)
+	return -1;
+    if (zf->nframes == 0) {
+	/* nothing written, leave a valid (empty) zstd file */
+	if (write_frame(zf, 0) < 0)
+	    return -1;
+	return 0;
+    }
+
+    tablesize = zf->nframes * 8 + SEEKABLE_FOOTER_SIZE + 8;
+    if ((table = malloc(tablesize)) == NULL) {
+	pmNoMem("zstd seek table", tablesize, PM_RECOV_ERR);
+	return -1;
+    }
+    put_le32(&table[0], SEEKABLE_SKIPPABLE);
+    put_le32(&table[4], tablesize - 8);
+    for (i = 0, p = &table[8]; i < zf->nframes; i++, p += 8) {
+	put_le32(&p[0], zf->frames[i].comp_size);
+	put_le32(&p[4], zf->frames[i].size);
+    }
+    put_le32(&p[0], zf->nframes);
+    p[4] = 0;
+    put_le32(&p[5], SEEKABLE_MAGIC);
+    sts = write_all(zf, table, tablesize);
+    free(table);
+    return sts;
+}
+
+static int
+zstd_fileno(__pmFILE *f)
+{
+    zstdfile	*zf = (zstdfile *)f->priv;
+
+    return zf->fd;
+}
+
+static int
+zstd_fstat(__pmFILE *f, struct stat *buf)
+{
+    zstdfile	*zf = (zstdfile *)f->priv;
+    int		rc;
+
+    refresh(zf);
+    /* What the caller really wants for st_size is the uncompressed size. */
+    if ((rc = fstat(zf->fd, buf)) != -1)
+	buf->st_size = zf->uncompressed_size + zf->wlen;
+    return rc;
+}
+
+static int
+zstd_feof(__pmFILE *f)
+{
+    zstdfile	*zf = (zstdfile *)f->priv;
+
+    return zf->uncompressed_offset >= zf->uncompressed_size + zf->wlen;
+}
+
+static int
+zstd_ferror(__pmFILE *f)
+{
+    return 0;
+}
+
+static void
+zstd_clearerr(__pmFILE *f)
+{
+}
+
+static int
+zstd_setvbuf(__pmFILE *f, char *buf, int mode, size_t size)
+{
+    /* writes are always buffered until the next frame boundary */
+    return 0;
+}
+
+static int
+zstd_close(__pmFILE *f)
+{
+    zstdfile	*zf = (zstdfile *)f->priv;
+    int		sts = 0;
+
+    if (zf->cctx != NULL && write_seektable(zf) < 0)
+	sts = EOF;
+    if (close(zf->fd) < 0)
+	sts = EOF;
+    zstd_free(zf);
+    return sts;
+}
+
+__pm_fops __pm_zstd = {
+    /*
+     * zstd decompression, and seekable compression for writing
+     */
+    .__pmopen = zstd_open,
+    .__pmfdopen = zstd_fdopen,
+    .__pmseek = zstd_seek,
+    .__pmrewind = zstd_rewind,
+    .__pmtell = zstd_tell,
+    .__pmfgetc = zstd_getc,
+    .__pmread = zstd_read,
+    .__pmwrite = zstd_write,
+    .__pmflush = zstd_flush,
+    .__pmfsync = zstd_fsync,
+    .__pmfileno = zstd_fileno,
+    .__pmlseek = zstd_lseek,
+    .__pmfstat = zstd_fstat,
+    .__pmfeof = zstd_feof,
+    .__pmferror = zstd_ferror,
+    .__pmclearerr = zstd_clearerr,
+    .__pmsetvbuf = zstd_setvbuf,
+    .__pmclose = zstd_close
+};
+#endif /* HAVE_ZSTD_DECOMPRESSION */
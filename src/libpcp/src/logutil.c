@@ -23,6 +23,9 @@
 #include <assert.h>
 #include <sys/stat.h>
 #include "pmapi.h"
+#ifndef IS_MINGW
+#include <sys/uio.h>
+#endif
 #include "libpcp.h"
 #include "internal.h"
 
@@ -241,6 +244,35 @@ __pmLogName(const char *base, int vol)
     return __pmLogName_r(base, vol, tbuf, sizeof(tbuf));
 }
 
+/*
+ * Compression suffix for new data volumes, see __pmLogSetCompress() ...
+ * set once by single-threaded writers like pmlogger before creating
+ * the archive.
+ */
+static const char	*log_compress;
+
+/*
+ * Ask __pmLogNewFile() to create data volumes (not the metadata or
+ * temporal index) compressed on-the-fly.  Only ".zst" is supported,
+ * and then only if built with zstd; NULL or "" reverts to the default
+ * of no compression.
+ */
+int
+__pmLogSetCompress(const char *suffix)
+{
+    if (suffix == NULL || suffix[0] == '\0') {
+	log_compress = NULL;
+	return 0;
+    }
+#if HAVE_TRANSPARENT_DECOMPRESSION && HAVE_ZSTD_DECOMPRESSION
+    if (strcmp(suffix, ".zst") == 0) {
+	log_compress = ".zst";
+	return 0;
+    }
+#endif
+    return -EOPNOTSUPP;
+}
+
 __pmFILE *
 __pmLogNewFile(const char *base, int vol)
 {
@@ -250,7 +282,8 @@ __pmLogNewFile(const char *base, int vol)
 
     __pmLogName_r(base, vol, fname, sizeof(fname));
 
-    if (access(fname, R_OK) != -1) {
+    /* also refuse to replace a compressed version of this file */
+    if (__pmAccess(fname, R_OK) != -1) {
 	/* exists and readable ... */
 	pmprintf("__pmLogNewFile: \"%s\" already exists, not over-written\n", fname);
 	pmflush();
@@ -258,6 +291,9 @@ __pmLogNewFile(const char *base, int vol)
 	return NULL;
     }
 
+    if (vol >= 0 && log_compress != NULL)
+	pmstrncat(fname, sizeof(fname), log_compress);
+
     if ((f = __pmFopen(fname, "w")) == NULL) {
 	char	errmsg[PM_MAXERRMSGLEN];
 	save_error = oserror();
@@ -301,6 +337,7 @@ __pmLogCreate(const char *host, const char *base, int log_version,
     lcp->hashlabels.nodes = lcp->hashlabels.hsize = 0;
     lcp->hashtext.nodes = lcp->hashtext.hsize = 0;
     lcp->tifp = lcp->mdfp = acp->ac_mfp = NULL;
+    lcp->pmidx = NULL;
 
     if ((lcp->tifp = __pmLogNewFile(base, PM_LOG_VOL_TI)) != NULL) {
 	if ((lcp->mdfp = __pmLogNewFile(base, PM_LOG_VOL_META)) != NULL) {
@@ -607,6 +644,11 @@ __pmLogClose(__pmArchCtl *acp)
     }
     if (lcp->ti != NULL)
 	free(lcp->ti);
+    if (lcp->pmidx != NULL) {
+	__pmLogFreePmidx(lcp->pmidx);
+	free(lcp->pmidx);
+	lcp->pmidx = NULL;
+    }
 }
 
 int
@@ -693,6 +735,7 @@ __pmLogFindOpen(__pmArchCtl *acp, const char *name)
     lcp->minvol = -1;
     lcp->tifp = lcp->mdfp = acp->ac_mfp = NULL;
     lcp->ti = NULL;
+    lcp->pmidx = NULL;
     lcp->numseen = 0; lcp->seen = NULL;
 
     blen = (int)strlen(base);
@@ -796,16 +839,25 @@ cleanup:
     return sts;
 }
 
-int
-__pmLogOpen(const char *name, __pmContext *ctxp)
+/*
+ * First stage of opening an archive for reading ... find the files,
+ * open the first data volume and check the labels.
+ *
+ * This and logOpenIndex() use nothing beyond acp and acp->ac_log, so
+ * they can also be run on a scratch __pmArchCtl for archive read-ahead
+ * (see below).
+ *
+ * On success, label is the label from the metadata file.  On failure,
+ * everything has been cleaned up.
+ */
+static int
+logOpenFiles(__pmArchCtl *acp, const char *name, __pmLogLabel *label)
 {
-    __pmArchCtl	*acp = ctxp->c_archctl;
-    __pmLogCtl	*lcp = ctxp->c_archctl->ac_log;
-    __pmLogLabel label = {0};
+    __pmLogCtl	*lcp = acp->ac_log;
     int		version;
     int		sts;
 
-    if ((sts = __pmLogFindOpen(ctxp->c_archctl, name)) < 0) {
+    if ((sts = __pmLogFindOpen(acp, name)) < 0) {
 	if (pmDebugOptions.log) {
 	    char	errmsg[PM_MAXERRMSGLEN];
 	    fprintf(stderr, "__pmLogOpen(..., %s, ...): __pmLogFindOpen: %s\n",
@@ -827,10 +879,8 @@ __pmLogOpen(const char *name, __pmContext *ctxp)
 	else
 	    version = sts;
 
-	ctxp->c_origin = lcp->label.start;
-
 	if (lcp->tifp) {
-	    sts = __pmLogChkLabel(acp, lcp->tifp, &label, PM_LOG_VOL_TI);
+	    sts = __pmLogChkLabel(acp, lcp->tifp, label, PM_LOG_VOL_TI);
 	    if (sts < 0) {
 		if (pmDebugOptions.log) {
 		    char	errmsg[PM_MAXERRMSGLEN];
@@ -845,16 +895,16 @@ __pmLogOpen(const char *name, __pmContext *ctxp)
 		goto cleanup;
 	    }
 
-	    if (lcp->label.pid != label.pid ||
-		    strcmp(lcp->label.hostname, label.hostname) != 0) {
+	    if (lcp->label.pid != label->pid ||
+		    strcmp(lcp->label.hostname, label->hostname) != 0) {
 		sts = PM_ERR_LABEL;
 		goto cleanup;
 	    }
 	    /* label is the one from the TI file via __pmLogChkLabel() */
-	    __pmLogFreeLabel(&label);
+	    __pmLogFreeLabel(label);
 	}
 
-	if ((sts = __pmLogChkLabel(acp, lcp->mdfp, &label, PM_LOG_VOL_META)) < 0) {
+	if ((sts = __pmLogChkLabel(acp, lcp->mdfp, label, PM_LOG_VOL_META)) < 0) {
 	    if (pmDebugOptions.log) {
 		char	errmsg[PM_MAXERRMSGLEN];
 		fprintf(stderr, "__pmLogOpen(..., %s, ...): __pmLogChkLabel META: %s\n",
@@ -866,22 +916,9 @@ __pmLogOpen(const char *name, __pmContext *ctxp)
 	    sts = PM_ERR_LABEL;
 	    goto cleanup;
 	}
-
-	/*
-	 * Perform consistency checks between this label and the labels of other
-	 * archives possibly making up this context.
-	 */
-	if ((sts = checkLabelConsistency(ctxp, &lcp->label)) < 0) {
-	    if (pmDebugOptions.log) {
-		char	errmsg[PM_MAXERRMSGLEN];
-		fprintf(stderr, "__pmLogOpen(..., %s, ...): checkLabelConsistency: %s\n",
-		    name, pmErrStr_r(sts, errmsg, sizeof(errmsg)));
-	    }
-	    goto cleanup;
-	}
     }
     else {
-	if ((sts = __pmLogLoadLabel(lcp->mdfp, &label)) < 0) {
+	if ((sts = __pmLogLoadLabel(lcp->mdfp, label)) < 0) {
 	    if (pmDebugOptions.log) {
 		char	errmsg[PM_MAXERRMSGLEN];
 		fprintf(stderr, "__pmLogOpen(..., %s, ...): [PM_CTXFLAG_METADATA_ONLY] __pmLogLoadLabel: %s\n",
@@ -894,31 +931,352 @@ __pmLogOpen(const char *name, __pmContext *ctxp)
 	 * label to NULL so that __pmLogFreeLabel() does not free()
 	 * them
 	 */
-	lcp->label = label;
-	label.hostname = NULL;
-	label.timezone = NULL;
-	label.zoneinfo = NULL;
+	lcp->label = *label;
+	label->hostname = NULL;
+	label->timezone = NULL;
+	label->zoneinfo = NULL;
     }
 
-    if ((sts = __pmLogLoadMeta(acp)) < 0) {
-	if (pmDebugOptions.log && pmDebugOptions.desperate) {
+    return 0;
+
+cleanup:
+    __pmLogClose(acp);
+    /* label is last one loaded via __pmLogChkLabel() before the error */
+    __pmLogFreeLabel(label);
+    logFreeMeta(lcp);
+    return sts;
+}
+
+/*
+ * Last stage of opening an archive for reading, load the temporal
+ * index and the optional PMID sidecar index.  On failure, everything
+ * has been cleaned up.
+ */
+static int
+logOpenIndex(__pmArchCtl *acp, const char *name, __pmLogLabel *label)
+{
+    __pmLogCtl	*lcp = acp->ac_log;
+    int		sts;
+
+    if ((sts = __pmLogLoadIndex(lcp)) < 0) {
+	if (pmDebugOptions.log) {
 	    char	errmsg[PM_MAXERRMSGLEN];
-	    fprintf(stderr, "__pmLogOpen(..., %s, ...): __pmLogLoadMeta: %s\n",
+	    fprintf(stderr, "__pmLogOpen(..., %s, ...): __pmLogLoadIndex: %s\n",
 		name, pmErrStr_r(sts, errmsg, sizeof(errmsg)));
 	}
-	goto cleanup;
+	__pmLogClose(acp);
+	__pmLogFreeLabel(label);
+	logFreeMeta(lcp);
+	return sts;
+    }
+
+    /* optional, so failure here just means no record skipping */
+    if ((sts = __pmLogLoadPmidx(lcp)) < 0) {
+	if (pmDebugOptions.log) {
+	    char	errmsg[PM_MAXERRMSGLEN];
+	    fprintf(stderr, "__pmLogOpen(..., %s, ...): __pmLogLoadPmidx: %s\n",
+		name, pmErrStr_r(sts, errmsg, sizeof(errmsg)));
+	}
+    }
+
+    return 0;
+}
+
+/*
+ * Archive read-ahead for multi-archive contexts.
+ *
+ * While one archive is being read, the next $PCP_ARCHIVE_READAHEAD
+ * archives (in the direction of reading) are opened on background
+ * threads by logOpenFiles() and logOpenIndex() using scratch controls,
+ * and __pmLogOpen() adopts the result rather than opening the archive
+ * itself.  The metadata is not involved here, as that is loaded (and
+ * merged) for all of the archives when the context is created.
+ */
+#define READAHEAD_MAX	32
+
+typedef struct {
+    char		*name;		/* archive, NULL if slot is free */
+    int			sts;		/* result from the worker thread */
+    __pmArchCtl		ac;		/* scratch controls for the worker */
+    __pmLogCtl		lc;
+    __pmLogLabel	label;		/* metadata label, see logOpenFiles() */
+#ifdef PM_MULTI_THREAD
+    pthread_t		tid;
+#endif
+} readahead_slot_t;
+
+typedef struct {
+    int			depth;		/* from $PCP_ARCHIVE_READAHEAD */
+    readahead_slot_t	*slot;		/* depth of these */
+} readahead_t;
+
+void
+__pmLogReadAheadInit(__pmArchCtl *acp)
+{
+    acp->ac_readahead = NULL;
+#ifdef PM_MULTI_THREAD
+    {
+	readahead_t	*rap;
+	char		*p;
+	char		*end;
+	long		depth = 0;
+
+	PM_LOCK(__pmLock_extcall);
+	if ((p = getenv("PCP_ARCHIVE_READAHEAD")) != NULL) {	/* THREADSAFE */
+	    depth = strtol(p, &end, 10);
+	    if (*end != '\0')
+		depth = 0;
+	}
+	PM_UNLOCK(__pmLock_extcall);
+	if (depth <= 0)
+	    return;
+	if (depth > READAHEAD_MAX)
+	    depth = READAHEAD_MAX;
+
+	if ((rap = (readahead_t *)malloc(sizeof(*rap))) == NULL)
+	    return;
+	if ((rap->slot = (readahead_slot_t *)calloc(depth, sizeof(rap->slot[0]))) == NULL) {
+	    free(rap);
+	    return;
+	}
+	rap->depth = depth;
+	acp->ac_readahead = rap;
     }
+#endif
+}
+
+#ifdef PM_MULTI_THREAD
+static void *
+readahead_worker(void *arg)
+{
+    readahead_slot_t	*sp = (readahead_slot_t *)arg;
+
+    if ((sp->sts = logOpenFiles(&sp->ac, sp->name, &sp->label)) < 0)
+	return NULL;
+    if (sp->ac.ac_flags & PM_CTXFLAG_METADATA_ONLY)
+	return NULL;
+    sp->sts = logOpenIndex(&sp->ac, sp->name, &sp->label);
+    return NULL;
+}
+#endif
+
+/*
+ * Wait for a read-ahead to finish and release everything it opened.
+ */
+static void
+readahead_discard(readahead_slot_t *sp)
+{
+#ifdef PM_MULTI_THREAD
+    pthread_join(sp->tid, NULL);
+#endif
+    if (pmDebugOptions.log)
+	fprintf(stderr, "__pmLogReadAhead: discard %s\n", sp->name);
+    if (sp->sts >= 0) {
+	__pmLogClose(&sp->ac);
+	__pmLogFreeLabel(&sp->lc.label);
+	__pmLogFreeLabel(&sp->label);
+    }
+    free(sp->name);
+    sp->name = NULL;
+}
 
+/*
+ * Start opening the named archive in the background, unless that is
+ * already in progress.  Returns 0 if read-ahead is disabled or all of
+ * the read-ahead slots are busy, else 1.
+ */
+int
+__pmLogReadAhead(__pmArchCtl *acp, const char *name)
+{
+    readahead_t		*rap = (readahead_t *)acp->ac_readahead;
+    readahead_slot_t	*sp = NULL;
+    int			i;
+
+    if (rap == NULL)
+	return 0;
+    for (i = 0; i < rap->depth; i++) {
+	if (rap->slot[i].name == NULL) {
+	    if (sp == NULL)
+		sp = &rap->slot[i];
+	}
+	else if (strcmp(rap->slot[i].name, name) == 0)
+	    return 1;
+    }
+    if (sp == NULL)
+	return 0;
+
+    memset(sp, 0, sizeof(*sp));
+    if ((sp->name = strdup(name)) == NULL)
+	return 0;
+    sp->ac.ac_log = &sp->lc;
+    sp->ac.ac_flags = acp->ac_flags;
+    sp->ac.ac_curvol = -1;
+#ifdef PM_MULTI_THREAD
+    if (pthread_create(&sp->tid, NULL, readahead_worker, sp) != 0) {
+	free(sp->name);
+	sp->name = NULL;
+	return 0;
+    }
+#endif
+    if (pmDebugOptions.log)
+	fprintf(stderr, "__pmLogReadAhead: start %s\n", name);
+    return 1;
+}
+
+/*
+ * Keep read-ahead going for the archives following the current one in
+ * the direction of reading, and drop any others.
+ */
+void
+__pmLogReadAheadSchedule(__pmArchCtl *acp, int mode)
+{
+    readahead_t	*rap = (readahead_t *)acp->ac_readahead;
+    int		dir = mode == PM_MODE_BACK ? -1 : 1;
+    int		i;
+    int		j;
+    int		k;
+
+    if (rap == NULL || acp->ac_num_logs < 2)
+	return;
+
+    for (i = 0; i < rap->depth; i++) {
+	if (rap->slot[i].name == NULL)
+	    continue;
+	for (j = 1; j <= rap->depth; j++) {
+	    k = acp->ac_cur_log + dir * j;
+	    if (k < 0 || k >= acp->ac_num_logs)
+		break;
+	    if (strcmp(rap->slot[i].name, acp->ac_log_list[k]->name) == 0)
+		break;
+	}
+	if (j > rap->depth || k < 0 || k >= acp->ac_num_logs)
+	    readahead_discard(&rap->slot[i]);
+    }
+
+    for (j = 1; j <= rap->depth; j++) {
+	k = acp->ac_cur_log + dir * j;
+	if (k < 0 || k >= acp->ac_num_logs)
+	    break;
+	__pmLogReadAhead(acp, acp->ac_log_list[k]->name);
+    }
+}
+
+/*
+ * If the named archive has been opened in the background, take over
+ * the files, labels and indexes for acp.
+ */
+static int
+readahead_adopt(__pmArchCtl *acp, const char *name, __pmLogLabel *label)
+{
+    readahead_t		*rap = (readahead_t *)acp->ac_readahead;
+    readahead_slot_t	*sp = NULL;
+    __pmLogCtl		*lcp = acp->ac_log;
+    int			i;
+
+    if (rap == NULL)
+	return 0;
+    for (i = 0; i < rap->depth; i++) {
+	if (rap->slot[i].name != NULL && strcmp(rap->slot[i].name, name) == 0) {
+	    sp = &rap->slot[i];
+	    break;
+	}
+    }
+    if (sp == NULL)
+	return 0;
+
+#ifdef PM_MULTI_THREAD
+    pthread_join(sp->tid, NULL);
+#endif
+    free(sp->name);
+    sp->name = NULL;
+    if (sp->sts < 0) {
+	/* open again in the foreground, for the same error and diagnostics */
+	return 0;
+    }
+    if (pmDebugOptions.log)
+	fprintf(stderr, "__pmLogOpen(..., %s, ...): using read-ahead\n", name);
+
+    lcp->name = sp->lc.name;
+    lcp->tifp = sp->lc.tifp;
+    lcp->mdfp = sp->lc.mdfp;
+    lcp->minvol = sp->lc.minvol;
+    lcp->maxvol = sp->lc.maxvol;
+    lcp->numseen = sp->lc.numseen;
+    lcp->seen = sp->lc.seen;
+    __pmLogFreeLabel(&lcp->label);
+    lcp->label = sp->lc.label;		/* struct assignment */
+    lcp->numti = sp->lc.numti;
+    lcp->ti = sp->lc.ti;
+    lcp->tisorted = sp->lc.tisorted;
+    lcp->pmidx = sp->lc.pmidx;
+    acp->ac_mfp = sp->ac.ac_mfp;
+    acp->ac_curvol = sp->ac.ac_curvol;
+    *label = sp->label;			/* struct assignment */
+
+    return 1;
+}
+
+void
+__pmLogReadAheadFree(__pmArchCtl *acp)
+{
+    readahead_t	*rap = (readahead_t *)acp->ac_readahead;
+    int		i;
+
+    if (rap == NULL)
+	return;
+    for (i = 0; i < rap->depth; i++) {
+	if (rap->slot[i].name != NULL)
+	    readahead_discard(&rap->slot[i]);
+    }
+    free(rap->slot);
+    free(rap);
+    acp->ac_readahead = NULL;
+}
+
+int
+__pmLogOpen(const char *name, __pmContext *ctxp)
+{
+    __pmArchCtl	*acp = ctxp->c_archctl;
+    __pmLogCtl	*lcp = ctxp->c_archctl->ac_log;
+    __pmLogLabel label = {0};
+    int		prepared;
+    int		sts;
+
+    if ((prepared = readahead_adopt(acp, name, &label)) == 0) {
+	if ((sts = logOpenFiles(acp, name, &label)) < 0)
+	    return sts;
+    }
 
     if (! (acp->ac_flags & PM_CTXFLAG_METADATA_ONLY)) {
-	if ((sts = __pmLogLoadIndex(lcp)) < 0) {
+	ctxp->c_origin = lcp->label.start;
+
+	/*
+	 * Perform consistency checks between this label and the labels of other
+	 * archives possibly making up this context.
+	 */
+	if ((sts = checkLabelConsistency(ctxp, &lcp->label)) < 0) {
 	    if (pmDebugOptions.log) {
 		char	errmsg[PM_MAXERRMSGLEN];
-		fprintf(stderr, "__pmLogOpen(..., %s, ...): __pmLogLoadIndex: %s\n",
+		fprintf(stderr, "__pmLogOpen(..., %s, ...): checkLabelConsistency: %s\n",
 		    name, pmErrStr_r(sts, errmsg, sizeof(errmsg)));
 	    }
 	    goto cleanup;
 	}
+    }
+
+    if ((sts = __pmLogLoadMeta(acp)) < 0) {
+	if (pmDebugOptions.log && pmDebugOptions.desperate) {
+	    char	errmsg[PM_MAXERRMSGLEN];
+	    fprintf(stderr, "__pmLogOpen(..., %s, ...): __pmLogLoadMeta: %s\n",
+		name, pmErrStr_r(sts, errmsg, sizeof(errmsg)));
+	}
+	goto cleanup;
+    }
+
+
+    if (! (acp->ac_flags & PM_CTXFLAG_METADATA_ONLY)) {
+	if (!prepared && (sts = logOpenIndex(acp, name, &label)) < 0)
+	    return sts;
 
 	if (lcp->label.pid != label.pid ||
 	    strcmp(lcp->label.hostname, label.hostname) != 0) {
@@ -949,6 +1307,28 @@ cleanup:
     return sts;
 }
 
+/*
+ * first result, do the label records
+ */
+static void
+logputlabels(int version, __pmArchCtl *acp, __pmPDU *pb)
+{
+    __pmLogCtl		*lcp = acp->ac_log;
+
+    /* pb[3] => 3 __int32_t's before the timestamp starts */
+    if (version >= 3)
+	__pmLoadTimestamp((__int32_t *)&pb[3], &lcp->label.start);
+    else
+	__pmLoadTimeval((__int32_t *)&pb[3], &lcp->label.start);
+    lcp->label.vol = PM_LOG_VOL_TI;
+    __pmLogWriteLabel(lcp->tifp, &lcp->label);
+    lcp->label.vol = PM_LOG_VOL_META;
+    __pmLogWriteLabel(lcp->mdfp, &lcp->label);
+    lcp->label.vol = 0;
+    __pmLogWriteLabel(acp->ac_mfp, &lcp->label);
+    lcp->state = PM_LOG_STATE_INIT;
+}
+
 static int
 logputresult(int version, __pmArchCtl *acp, __pmPDU *pb)
 {
@@ -980,30 +1360,16 @@ logputresult(int version, __pmArchCtl *acp, __pmPDU *pb)
     int			sz;
     int			sts = 0;
     int			save_from;
+    off_t		offset;
 
-    if (lcp->state == PM_LOG_STATE_NEW) {
-	/*
-	 * first result, do the label record
-	 *
-	 * pb[3] => 3 __int32_t's before the timestamp starts
-	 */
-	if (version >= 3)
-	    __pmLoadTimestamp((__int32_t *)&pb[3], &lcp->label.start);
-	else
-	    __pmLoadTimeval((__int32_t *)&pb[3], &lcp->label.start);
-	lcp->label.vol = PM_LOG_VOL_TI;
-	__pmLogWriteLabel(lcp->tifp, &lcp->label);
-	lcp->label.vol = PM_LOG_VOL_META;
-	__pmLogWriteLabel(lcp->mdfp, &lcp->label);
-	lcp->label.vol = 0;
-	__pmLogWriteLabel(acp->ac_mfp, &lcp->label);
-	lcp->state = PM_LOG_STATE_INIT;
-    }
+    if (lcp->state == PM_LOG_STATE_NEW)
+	logputlabels(version, acp, pb);
 
     sz = pb[0] - (int)sizeof(__pmPDUHdr) + 2 * (int)sizeof(int);
+    offset = __pmFtell(acp->ac_mfp);
 
     if (pmDebugOptions.log) {
-	fprintf(stderr, "logputresult: pdubuf=" PRINTF_P_PFX "%p input len=%d output len=%d posn=%ld\n", pb, pb[0], sz, (long)__pmFtell(acp->ac_mfp));
+	fprintf(stderr, "logputresult: pdubuf=" PRINTF_P_PFX "%p input len=%d output len=%d posn=%ld\n", pb, pb[0], sz, (long)offset);
     }
 
     save_from = start[0];
@@ -1042,6 +1408,17 @@ logputresult(int version, __pmArchCtl *acp, __pmPDU *pb)
     /* restore and unswab */
     start[0] = save_from;
 
+    if (sts >= 0 && lcp->pmidx != NULL) {
+	int	lsts;
+
+	if ((lsts = __pmLogPmidxAddPDU(lcp->pmidx, acp->ac_curvol, offset, sz, pb, version)) < 0 &&
+	    pmDebugOptions.log) {
+	    char	errmsg[PM_MAXERRMSGLEN];
+	    fprintf(stderr, "logputresult: __pmLogPmidxAddPDU: %s\n",
+		pmErrStr_r(lsts, errmsg, sizeof(errmsg)));
+	}
+    }
+
     return sts;
 }
 
@@ -1075,6 +1452,91 @@ __pmLogPutResult3(__pmArchCtl *acp, __pmPDU *pb)
     return logputresult(3, acp, pb);
 }
 
+/*
+ * Batched sibling of __pmLogPutResult2 and __pmLogPutResult3, for
+ * records already encoded for the archive version (__pmEncodeResult
+ * or __pmEncodeResultView).  Each record is reformatted in its PDU
+ * buffer as for logputresult(), then the records are written with one
+ * __pmFwritev() per PUTRESULTV_MAX records.
+ *
+ * Returns the number of records written, else a negative error code,
+ * and the PDU buffers are unchanged.
+ */
+#define PUTRESULTV_MAX	64
+
+int
+__pmLogPutResultv(__pmArchCtl *acp, int numpdu, __pmPDU **pbs)
+{
+    __pmLogCtl		*lcp = acp->ac_log;
+    struct iovec	iov[PUTRESULTV_MAX];
+    __pmPDU		save_from[PUTRESULTV_MAX];
+    __pmPDU		*start;
+    int			version;
+    int			done = 0;
+    int			n, i, sz;
+    int			err = 0;
+    size_t		need, sts;
+    off_t		offset;
+
+    version = (__pmLogVersion(lcp) >= PM_LOG_VERS03) ? 3 : 2;
+    if (numpdu > 0 && lcp->state == PM_LOG_STATE_NEW)
+	logputlabels(version, acp, pbs[0]);
+
+    while (done < numpdu) {
+	n = numpdu - done;
+	if (n > PUTRESULTV_MAX)
+	    n = PUTRESULTV_MAX;
+	offset = __pmFtell(acp->ac_mfp);
+	need = 0;
+	for (i = 0; i < n; i++) {
+	    sz = pbs[done+i][0] - (int)sizeof(__pmPDUHdr) + 2 * (int)sizeof(int);
+	    start = &pbs[done+i][2];
+	    save_from[i] = start[0];
+	    start[0] = htonl(sz);	/* swab */
+	    start[(sz-1)/sizeof(__pmPDU)] = start[0];
+	    iov[i].iov_base = (void *)start;
+	    iov[i].iov_len = sz;
+	    need += sz;
+	}
+
+	if (pmDebugOptions.log) {
+	    fprintf(stderr, "__pmLogPutResultv: %d records len=%zd posn=%ld\n",
+		n, need, (long)offset);
+	}
+
+	if ((sts = __pmFwritev(iov, n, acp->ac_mfp)) != need) {
+	    char	errmsg[PM_MAXERRMSGLEN];
+	    err = oserror() ? -oserror() : -EIO;
+	    pmprintf("__pmLogPutResultv: write failed: returns %zd expecting %zd: %s\n",
+		sts, need, osstrerror_r(errmsg, sizeof(errmsg)));
+	    pmflush();
+	}
+
+	/* restore and unswab, then index what was written */
+	for (i = 0; i < n; i++) {
+	    start = &pbs[done+i][2];
+	    start[0] = save_from[i];
+	    if (sts == need && lcp->pmidx != NULL) {
+		int	lsts;
+
+		if ((lsts = __pmLogPmidxAddPDU(lcp->pmidx, acp->ac_curvol, offset,
+				iov[i].iov_len, pbs[done+i], version)) < 0 &&
+		    pmDebugOptions.log) {
+		    char	errmsg[PM_MAXERRMSGLEN];
+		    fprintf(stderr, "__pmLogPutResultv: __pmLogPmidxAddPDU: %s\n",
+			pmErrStr_r(lsts, errmsg, sizeof(errmsg)));
+		}
+	    }
+	    offset += iov[i].iov_len;
+	}
+	if (sts != need)
+	    return err;
+	done += n;
+    }
+
+    return done;
+}
+
 /*
  * check if PDU buffer seems even half-way reasonable ...
  * only used when trying to locate end of archive.
@@ -1360,6 +1822,7 @@ __pmLogWriteMark(__pmArchCtl *acp, const __pmTimestamp *last_stamp, const __pmTi
     size_t		rlen;
     int			k = 0;
     int			sts;
+    off_t		offset;
     __pmTimestamp	stamp;
 
     stamp = *last_stamp;		/* struct assignment */
@@ -1389,6 +1852,7 @@ __pmLogWriteMark(__pmArchCtl *acp, const __pmTimestamp *last_stamp, const __pmTi
     buf[k++] = 0;		/* numpmid */
     buf[k] = buf[0];		/* trailer len */
 
+    offset = __pmFtell(acp->ac_mfp);
     sts = (int)__pmFwrite((__pmPDU *)buf, 1, rlen, acp->ac_mfp);
     if (sts != rlen) {
 	if (pmDebugOptions.log) {
@@ -1398,8 +1862,15 @@ __pmLogWriteMark(__pmArchCtl *acp, const __pmTimestamp *last_stamp, const __pmTi
 	}
 	sts = -oserror();
     }
-    else
+    else {
 	sts = 0;
+	if (acp->ac_log->pmidx != NULL) {
+	    __pmLogPmidx	*px = acp->ac_log->pmidx;
+
+	    if ((k = __pmLogPmidxAddRecord(px, acp->ac_curvol, offset, rlen)) >= 0)
+		__pmLogPmidxAddPMID(px, k, PM_ID_NULL);
+	}
+    }
 
     return sts;
 }
@@ -1461,6 +1932,8 @@ __pmLogRead_ctx(__pmContext *ctxp, int mode, __pmFILE *peekf, __pmResult **resul
 
     if (mode == PM_MODE_BACK) {
        for ( ; ; ) {
+	   if (peekf == NULL && acp->ac_pmidx_nwant > 0)
+		offset = __pmLogPmidxSkip(acp, mode, f, offset);
 	   if (offset <= __pmLogLabelSize(lcp)) {
 		if (pmDebugOptions.log)
 		    fprintf(stderr, "BEFORE start\n");
@@ -1525,6 +1998,13 @@ __pmLogRead_ctx(__pmContext *ctxp, int mode, __pmFILE *peekf, __pmResult **resul
     }
 
 again:
+    if (peekf == NULL && mode == PM_MODE_FORW && acp->ac_pmidx_nwant > 0) {
+	/*
+	 * may have changed volume since offset was set, so any
+	 * "AFTER end" reposition below must be relative to here
+	 */
+	offset = __pmLogPmidxSkip(acp, mode, f, __pmFtell(f));
+    }
     n = (int)__pmFread(&head, 1, sizeof(head), f);
     head = ntohl(head); /* swab head */
     if (n != sizeof(head)) {
@@ -1857,6 +2337,11 @@ __pmLogFetch(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult **resul
     }
 
     all_derived = check_all_derived(numpmid, pmidlist);
+    if (!all_derived) {
+	/* only records with one of these PMIDs (or a <mark>) matter */
+	ctxp->c_archctl->ac_pmidx_want = pmidlist;
+	ctxp->c_archctl->ac_pmidx_nwant = numpmid;
+    }
 
     /* re-establish position */
     sts = __pmLogChangeVol(ctxp->c_archctl, ctxp->c_archctl->ac_vol);
@@ -2122,6 +2607,8 @@ more:
     ctxp->c_archctl->ac_vol = ctxp->c_archctl->ac_curvol;
 
 func_return:
+    ctxp->c_archctl->ac_pmidx_want = NULL;
+    ctxp->c_archctl->ac_pmidx_nwant = 0;
 
     if (ctx_ctl.need_ctx_unlock)
 	PM_UNLOCK(ctx_ctl.ctxp->c_lock);
@@ -2166,6 +2653,136 @@ VolSkip(__pmArchCtl *acp, int mode, int j)
     return PM_ERR_EOL;
 }
 
+/*
+ * Size of the last volume, for the truncated volume check when
+ * positioning with the temporal index.
+ */
+static off_t
+TIMaxVolSize(__pmArchCtl *acp)
+{
+    __pmLogCtl	*lcp = acp->ac_log;
+    __pmFILE	*f;
+    struct stat	sbuf;
+    int		vol = lcp->maxvol;
+
+    sbuf.st_size = 0;
+    if (vol >= 0 && vol < lcp->numseen && lcp->seen[vol])
+	__pmFstat(acp->ac_mfp, &sbuf);
+    else if ((f = _logpeek(acp, lcp->maxvol)) != NULL) {
+	__pmFstat(f, &sbuf);
+	__pmFclose(f);
+    }
+    return sbuf.st_size;
+}
+
+/*
+ * Find the first temporal index entry at or after the origin, skipping
+ * missing preliminary volumes and stopping early at the first entry past
+ * the end of a truncated last volume (toobig).  Returns numti if there
+ * is no such entry.
+ *
+ * TIScan is the linear search, needed when ti[] is not ordered.
+ */
+static int
+TIScan(__pmArchCtl *acp, const __pmTimestamp *origin, int *toobig, int *match)
+{
+    __pmLogCtl	*lcp = acp->ac_log;
+    __pmLogTI	*tip = lcp->ti;
+    off_t	size = -1;
+    double	t_hi;
+    int		i;
+
+    for (i = 0; i < lcp->numti; i++, tip++) {
+	if (tip->vol < lcp->minvol)
+	    /* skip missing preliminary volumes */
+	    continue;
+	if (tip->vol == lcp->maxvol) {
+	    /* truncated check for last volume */
+	    if (size < 0)
+		size = TIMaxVolSize(acp);
+	    if (tip->off_data > size) {
+		(*toobig)++;
+		return i;
+	    }
+	}
+	t_hi = __pmTimestampSub(&tip->stamp, origin);
+	if (t_hi > 0)
+	    return i;
+	else if (t_hi == 0) {
+	    *match = 1;
+	    return i;
+	}
+    }
+    return lcp->numti;
+}
+
+/* first ti[] entry in [lo,hi) with vol >= vol */
+static int
+TIFirstVol(const __pmLogCtl *lcp, int lo, int hi, int vol)
+{
+    int		mid;
+
+    while (lo < hi) {
+	mid = lo + (hi - lo) / 2;
+	if (lcp->ti[mid].vol < vol)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return lo;
+}
+
+/*
+ * TISearch is the same search as TIScan, but binary searching an ordered
+ * ti[] ... O(log n) rather than O(n) for archives with very large indexes.
+ */
+static int
+TISearch(__pmArchCtl *acp, const __pmTimestamp *origin, int *toobig, int *match)
+{
+    __pmLogCtl	*lcp = acp->ac_log;
+    off_t	size;
+    int		start, end;
+    int		lo, hi, mid;
+    int		j;
+
+    start = TIFirstVol(lcp, 0, lcp->numti, lcp->minvol);
+
+    /* first entry at or after the origin */
+    lo = start;
+    hi = lcp->numti;
+    while (lo < hi) {
+	mid = lo + (hi - lo) / 2;
+	if (__pmTimestampSub(&lcp->ti[mid].stamp, origin) < 0)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    j = lo;
+
+    /* truncated check for last volume, only for entries up to j */
+    lo = TIFirstVol(lcp, start, lcp->numti, lcp->maxvol);
+    if (lo <= j && lo < lcp->numti && lcp->ti[lo].vol == lcp->maxvol) {
+	end = TIFirstVol(lcp, lo, lcp->numti, lcp->maxvol + 1);
+	size = TIMaxVolSize(acp);
+	hi = end;
+	while (lo < hi) {
+	    mid = lo + (hi - lo) / 2;
+	    if (lcp->ti[mid].off_data <= size)
+		lo = mid + 1;
+	    else
+		hi = mid;
+	}
+	if (lo < end && lo <= j) {
+	    (*toobig)++;
+	    return lo;
+	}
+    }
+
+    if (j < lcp->numti && __pmTimestampSub(&lcp->ti[j].stamp, origin) == 0)
+	*match = 1;
+    return j;
+}
+
 int
 __pmLogSetTime(__pmContext *ctxp)
 {
@@ -2223,58 +2840,18 @@ __pmLogSetTime(__pmContext *ctxp)
 
     if (lcp->numti) {
 	/* we have a temporal index, use it! */
-	int		j = -1;
+	int		j;
 	int		try;
 	int		toobig = 0;
 	int		match = 0;
-	int		tivol;
-	int		vol;
 	int		numti = lcp->numti;
 	off_t		tilog;
-	__pmFILE	*f;
-	__pmLogTI	*tip = lcp->ti;
 	double		t_lo;
-	struct stat	sbuf;
-
-	sbuf.st_size = -1;
 
-	for (i = 0; i < numti; i++, tip++) {
-	    tivol = tip->vol;
-	    tilog = tip->off_data;
-	    if (tivol < lcp->minvol)
-		/* skip missing preliminary volumes */
-		continue;
-	    if (tivol == lcp->maxvol) {
-		/* truncated check for last volume */
-		if (sbuf.st_size < 0) {
-		    sbuf.st_size = 0;
-		    vol = lcp->maxvol;
-		    if (vol >= 0 && vol < lcp->numseen && lcp->seen[vol])
-			__pmFstat(acp->ac_mfp, &sbuf);
-		    else if ((f = _logpeek(acp, lcp->maxvol)) != NULL) {
-			__pmFstat(f, &sbuf);
-			__pmFclose(f);
-		    }
-		}
-		if (tilog > sbuf.st_size) {
-		    j = i;
-		    toobig++;
-		    break;
-		}
-	    }
-	    t_hi = __pmTimestampSub(&tip->stamp, &ctxp->c_origin);
-	    if (t_hi > 0) {
-		j = i;
-		break;
-	    }
-	    else if (t_hi == 0) {
-		j = i;
-		match = 1;
-		break;
-	    }
-	}
-	if (i == numti)
-	    j = numti;
+	if (lcp->tisorted)
+	    j = TISearch(acp, &ctxp->c_origin, &toobig, &match);
+	else
+	    j = TIScan(acp, &ctxp->c_origin, &toobig, &match);
 
 	acp->ac_serial = 1;
 
@@ -3036,6 +3613,8 @@ LogChangeToNextArchive(__pmContext *ctxp)
     acp->ac_offset = __pmLogLabelSize(lcp);
     acp->ac_vol = acp->ac_curvol;
 
+    __pmLogReadAheadSchedule(acp, PM_MODE_FORW);
+
     /*
      * Check for temporal overlap here. Do this last in case the API client
      * chooses to keep reading anyway.
@@ -3121,6 +3700,8 @@ LogChangeToPreviousArchive(__pmContext *ctxp)
     ctxp->c_origin = save_origin;
     ctxp->c_mode = save_mode;
 
+    __pmLogReadAheadSchedule(acp, PM_MODE_BACK);
+
     /*
      * We need the current end time of the new archive in order to compare
      * with the start time of the previous one.
@@ -3195,6 +3776,9 @@ __pmArchCtlFree(__pmArchCtl *acp)
      */
     __pmLogCtl *lcp = acp->ac_log;
 
+    /* Any archives still being opened in the background. */
+    __pmLogReadAheadFree(acp);
+
     if (lcp != NULL) {
 	PM_LOCK(lcp->lc_lock);
 	if (--lcp->refcnt == 0) {
@@ -235,6 +235,9 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":3", PM_FAULT_ALLOC);
 		    }
 		    prof->instances[j] = ntohl(*p);
 		}
+		/* sort once here, so membership checks are a binary search */
+		prof->instances_len = __pmSortProfileInstances(prof->instances,
+						prof->instances_len);
 	    }
 	    else if (prof->instances_len < 0) {
 		if (pmDebugOptions.pdu) {
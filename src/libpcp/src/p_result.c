@@ -30,6 +30,10 @@
  * pointers back into the input PDU buffer, this will be pinned _twice_
  * so the pmFreeResult() and __pmUnpinPDUBuf() calls will still be
  * required.
+ *
+ * __pmDecodeResultView() also accepts a pinned buffer and pins it again
+ * for the view, so __pmUnpinPDUBuf() for the input PDU buffer is still
+ * needed, as is __pmReleaseResultView() when done with the view.
  */
 
 #include <ctype.h>
@@ -1057,3 +1061,368 @@ __pmDecodeHighResResult(__pmPDU *pdubuf, __pmResult **result)
 {
     return __pmDecodeHighResResult_ctx(NULL, pdubuf, result);
 }
+
+/*
+ * Result views ... a read-only alternative to __pmDecodeResult() and
+ * __pmDecodeHighResResult() for consumers that only inspect a result
+ * on the way through (and may write it out again), where building a
+ * pmResult with all its pmValueSets is wasted effort.
+ *
+ * The PDU is validated with the same checks as __pmDecodeValueSet(),
+ * but the PDU buffer is left untouched (still in network byte order)
+ * and only the offset of each vlist_t is recorded in the view, the
+ * accessors below doing the byte swapping as values are used.
+ *
+ * Enter with pdubuf pinned, and like __pmDecodeResult() the view pins
+ * the buffer again, so the caller unpins the input PDU buffer as usual
+ * and calls __pmReleaseResultView() when done with the view.  The view
+ * must be zeroed before first use, any previous PDU it holds is released
+ * and its vset[] array is reused ... __pmFreeResultView() frees that too.
+ *
+ * Value blocks of type PM_TYPE_EVENT or PM_TYPE_HIGHRES_EVENT are only
+ * checked to lie within the PDU, the event records are not validated.
+ */
+int
+__pmDecodeResultView(__pmPDU *pdubuf, __pmResultView *view)
+{
+    int			len = pdubuf[0];
+    int			type = pdubuf[1];
+    char		*pduend = (char *)pdubuf + len;
+    char		*vsplit;	/* vlist/valueblock division point */
+    __pmPDU		*data;
+    __pmTimestamp	stamp;
+    vlist_t		*vlp;
+    pmValueBlock	vb;
+    size_t		preamble;
+    size_t		check;
+    int			vsize;		/* size of vlist_t's in PDU buffer */
+    int			vbsize;		/* size of pmValueBlocks */
+    int			numpmid;
+    int			numval;
+    int			valfmt;
+    int			vindex;
+    int			i, j;
+
+    __pmReleaseResultView(view);
+
+    if (type == PDU_HIGHRES_RESULT)
+	preamble = sizeof(highres_result_t) - (sizeof(__pmPDU) * 2);
+    else if (type == PDU_RESULT)
+	preamble = sizeof(result_t) - sizeof(__pmPDU);
+    else {
+	if (pmDebugOptions.pdu)
+	    fprintf(stderr, "__pmDecodeResultView: PM_ERR_IPC: PDU type %d not a result\n",
+		type);
+	return PM_ERR_IPC;
+    }
+    if (len < preamble) {
+	if (pmDebugOptions.pdu)
+	    fprintf(stderr, "__pmDecodeResultView: PM_ERR_IPC: short PDU %d < min size %d\n",
+		len, (int)preamble);
+	return PM_ERR_IPC;
+    }
+
+    if (type == PDU_HIGHRES_RESULT) {
+	highres_result_t	*pp = (highres_result_t *)pdubuf;
+	__int64_t		sec, nsec;
+
+	memcpy(&sec, &pp->timestamp.tv_sec, sizeof(sec));
+	memcpy(&nsec, &pp->timestamp.tv_nsec, sizeof(nsec));
+	__ntohll((char *)&sec);
+	__ntohll((char *)&nsec);
+	stamp.sec = sec;
+	stamp.nsec = nsec;
+	numpmid = ntohl(pp->numpmid);
+	data = pp->data;
+    }
+    else {
+	result_t	*pp = (result_t *)pdubuf;
+
+	__pmLoadTimeval((__int32_t *)&pp->timestamp, &stamp);
+	numpmid = ntohl(pp->numpmid);
+	data = pp->data;
+    }
+    if (numpmid < 0 || numpmid > len) {
+	if (pmDebugOptions.pdu)
+	    fprintf(stderr, "__pmDecodeResultView: PM_ERR_IPC: numpmid=%d negative or not smaller than PDU len %d\n",
+		numpmid, len);
+	return PM_ERR_IPC;
+    }
+
+    if (numpmid > view->maxpmid) {
+	int	*vset;
+
+	if ((vset = (int *)realloc(view->vset, numpmid * sizeof(int))) == NULL)
+	    return -oserror();
+	view->vset = vset;
+	view->maxpmid = numpmid;
+    }
+
+    vsplit = pduend;	/* smallest observed value block pointer */
+    vsize = vbsize = 0;
+    for (i = 0; i < numpmid; i++) {
+	vlp = (vlist_t *)&data[vsize/sizeof(__pmPDU)];
+
+	check = sizeof(vlp->pmid) + sizeof(vlp->numval);
+	if (check > (pduend - (char *)vlp)) {
+	    if (pmDebugOptions.pdu)
+		fprintf(stderr, "__pmDecodeResultView: PM_ERR_IPC: pmid[%d] outer vlp past end of PDU buffer\n",
+		    i);
+	    return PM_ERR_IPC;
+	}
+	view->vset[i] = (int)((__pmPDU *)vlp - pdubuf);
+	vsize += check;
+
+	/* numval may be negative - it holds an error code in that case */
+	numval = ntohl(vlp->numval);
+	if (numval > len) {
+	    if (pmDebugOptions.pdu)
+		fprintf(stderr, "__pmDecodeResultView: PM_ERR_IPC: pmid[%d] numval=%d > len=%d\n",
+		    i, numval, len);
+	    return PM_ERR_IPC;
+	}
+	if (numval <= 0)
+	    continue;
+	if (numval >= (INT_MAX - sizeof(*vlp)) / sizeof(__pmValue_PDU)) {
+	    if (pmDebugOptions.pdu)
+		fprintf(stderr, "__pmDecodeResultView: PM_ERR_IPC: pmid[%d] numval=%d > max=%ld\n",
+		    i, numval, (long)((INT_MAX - sizeof(*vlp)) / sizeof(__pmValue_PDU)));
+	    return PM_ERR_IPC;
+	}
+
+	check += sizeof(vlp->valfmt) + numval * sizeof(__pmValue_PDU);
+	if (check > (pduend - (char *)vlp)) {
+	    if (pmDebugOptions.pdu)
+		fprintf(stderr, "__pmDecodeResultView: PM_ERR_IPC: pmid[%d] inner vlp past end of PDU buffer\n",
+		    i);
+	    return PM_ERR_IPC;
+	}
+	vsize += sizeof(vlp->valfmt) + numval * sizeof(__pmValue_PDU);
+
+	valfmt = ntohl(vlp->valfmt);
+	if (valfmt == PM_VAL_INSITU)
+	    continue;
+	if (valfmt != PM_VAL_DPTR && valfmt != PM_VAL_SPTR) {
+	    if (pmDebugOptions.pdu)
+		fprintf(stderr, "__pmDecodeResultView: PM_ERR_IPC: pmid[%d] valfmt=%d\n",
+		    i, valfmt);
+	    return PM_ERR_IPC;
+	}
+	for (j = 0; j < numval; j++) {
+	    vindex = ntohl(vlp->vlist[j].value.lval);
+	    if (vindex < 0 || (char *)&pdubuf[vindex] >= pduend) {
+		if (pmDebugOptions.pdu)
+		    fprintf(stderr, "__pmDecodeResultView: PM_ERR_IPC: pmid[%d] value[%d] vindex=%d (max=%ld)\n",
+			i, j, vindex, (long)((pduend-(char *)pdubuf) / sizeof(pdubuf[0])-1));
+		return PM_ERR_IPC;
+	    }
+	    if (vsplit > (char *)&pdubuf[vindex])
+		vsplit = (char *)&pdubuf[vindex];
+	    check = (size_t)(pduend - (char *)&pdubuf[vindex]);
+	    if (sizeof(unsigned int) > check) {
+		if (pmDebugOptions.pdu)
+		    fprintf(stderr, "__pmDecodeResultView: PM_ERR_IPC: pmid[%d] value[%d] second pduvp past end of PDU buffer\n",
+			i, j);
+		return PM_ERR_IPC;
+	    }
+	    memcpy(&vb, &pdubuf[vindex], sizeof(unsigned int));
+	    __ntohpmValueBlock_hdr(&vb);
+	    if (vb.vlen < PM_VAL_HDR_SIZE || vb.vlen > check) {
+		if (pmDebugOptions.pdu)
+		    fprintf(stderr, "__pmDecodeResultView: PM_ERR_IPC: pmid[%d] value[%d] vlen=%d\n",
+			i, j, vb.vlen);
+		return PM_ERR_IPC;
+	    }
+	    vbsize += PM_PDU_SIZE_BYTES(vb.vlen);
+	}
+    }
+
+    if (numpmid > 0 &&
+	(preamble + vsize != len - (pduend - vsplit) ||
+	 preamble + vsize + vbsize != len)) {
+	if (pmDebugOptions.pdu)
+	    fprintf(stderr, "__pmDecodeResultView: PM_ERR_IPC: vlists (%d) and value blocks (%d) do not match PDU len %d\n",
+		(int)(preamble + vsize), vbsize, len);
+	return PM_ERR_IPC;
+    }
+
+    /* pinned again, the caller still unpins the input buffer */
+    __pmPinPDUBuf(pdubuf);
+    view->pdubuf = pdubuf;
+    view->type = type;
+    view->numpmid = numpmid;
+    view->timestamp = stamp;
+    return 0;
+}
+
+/*
+ * Done with the PDU behind a view, keeping vset[] for the next decode.
+ */
+void
+__pmReleaseResultView(__pmResultView *view)
+{
+    if (view->pdubuf != NULL) {
+	__pmUnpinPDUBuf(view->pdubuf);
+	view->pdubuf = NULL;
+    }
+    view->numpmid = 0;
+}
+
+void
+__pmFreeResultView(__pmResultView *view)
+{
+    __pmReleaseResultView(view);
+    free(view->vset);
+    view->vset = NULL;
+    view->maxpmid = 0;
+}
+
+#define VIEW_VLIST(view, i) ((vlist_t *)&(view)->pdubuf[(view)->vset[i]])
+
+pmID
+__pmResultViewPMID(const __pmResultView *view, int i)
+{
+    return __ntohpmID(VIEW_VLIST(view, i)->pmid);
+}
+
+int
+__pmResultViewNumval(const __pmResultView *view, int i)
+{
+    return ntohl(VIEW_VLIST(view, i)->numval);
+}
+
+/*
+ * There is no valfmt in the PDU unless numval > 0, PM_VAL_INSITU
+ * is returned in that case.
+ */
+int
+__pmResultViewValfmt(const __pmResultView *view, int i)
+{
+    vlist_t	*vlp = VIEW_VLIST(view, i);
+
+    if ((int)ntohl(vlp->numval) <= 0)
+	return PM_VAL_INSITU;
+    return ntohl(vlp->valfmt);
+}
+
+int
+__pmResultViewInst(const __pmResultView *view, int i, int j)
+{
+    return ntohl(VIEW_VLIST(view, i)->vlist[j].inst);
+}
+
+/*
+ * pmExtractValue() for the j-th value of the i-th metric in a view ...
+ * pointer values are byte swapped into a private copy of the value
+ * block, leaving the PDU as is.  Event records cannot be extracted
+ * (and pmExtractValue() does not handle them anyway).
+ */
+int
+__pmResultViewExtract(const __pmResultView *view, int i, int j,
+		int type, pmAtomValue *oval, int otype)
+{
+    vlist_t		*vlp = VIEW_VLIST(view, i);
+    pmValueBlock	*vbp;
+    pmValue		val;
+    union {
+	pmValueBlock	vb;
+	char		buf[PM_VAL_HDR_SIZE + 4 * sizeof(__int64_t)];
+    } local;
+    int			valfmt = ntohl(vlp->valfmt);
+    int			sts;
+
+    val.inst = ntohl(vlp->vlist[j].inst);
+    if (valfmt == PM_VAL_INSITU) {
+	val.value.lval = ntohl(vlp->vlist[j].value.lval);
+	return pmExtractValue(valfmt, &val, type, oval, otype);
+    }
+
+    vbp = (pmValueBlock *)&view->pdubuf[ntohl(vlp->vlist[j].value.lval)];
+    memcpy(&local.vb, vbp, sizeof(unsigned int));
+    __ntohpmValueBlock_hdr(&local.vb);
+    if (local.vb.vtype == PM_TYPE_EVENT || local.vb.vtype == PM_TYPE_HIGHRES_EVENT)
+	return PM_ERR_CONV;
+    if (local.vb.vlen <= sizeof(local))
+	val.value.pval = &local.vb;
+    else if ((val.value.pval = (pmValueBlock *)malloc(local.vb.vlen)) == NULL)
+	return -oserror();
+    memcpy(val.value.pval, vbp, local.vb.vlen);
+    __ntohpmValueBlock(val.value.pval);
+
+    sts = pmExtractValue(valfmt, &val, type, oval, otype);
+    if (val.value.pval != &local.vb)
+	free(val.value.pval);
+    return sts;
+}
+
+/*
+ * Like __pmEncodeResult() but from a view, building the archive
+ * record for __pmLogPutResult2() or __pmLogPutResult3() ... the vlists
+ * and value blocks are copied across as is, only the preamble is
+ * rebuilt for the archive version and, when its size differs from
+ * that of the PDU, the value block offsets are adjusted to match.
+ *
+ * Returns with the new PDU buffer pinned, as for __pmEncodeResult().
+ */
+int
+__pmEncodeResultView(const __pmLogCtl *lcp, const __pmResultView *view, __pmPDU **pdu)
+{
+    __pmPDU	*pdubuf;
+    vlist_t	*vlp;
+    size_t	from;		/* preamble bytes in the PDU */
+    size_t	to;		/* preamble bytes in the archive record */
+    size_t	body;		/* vlists and value blocks */
+    int		delta;		/* value block offset change, __pmPDU units */
+    int		v3 = (lcp != NULL && __pmLogVersion(lcp) == PM_LOG_VERS03);
+    int		numval;
+    int		i, j;
+
+    if (view->type == PDU_HIGHRES_RESULT)
+	from = sizeof(highres_result_t) - (sizeof(__pmPDU) * 2);
+    else
+	from = sizeof(result_t) - sizeof(__pmPDU);
+    if (v3)
+	to = sizeof(log_result_v3_t) - sizeof(__int32_t);
+    else
+	to = sizeof(result_t) - sizeof(__pmPDU);
+    body = view->pdubuf[0] - from;
+
+    /* additional space for trailer, see __pmEncodeResult() */
+    if ((pdubuf = __pmFindPDUBuf((int)(to + body + sizeof(int)))) == NULL)
+	return -oserror();
+    if (v3) {
+	log_result_v3_t	*lrp = (log_result_v3_t *)pdubuf;
+
+	lrp->len = (int)(to + body);
+	lrp->from = 0;			/* not used for log records */
+	lrp->type = PDU_RESULT;		/* not used for log records */
+	__pmPutTimestamp(&view->timestamp, &lrp->sec[0]);
+	lrp->numpmid = htonl(view->numpmid);
+    }
+    else {
+	result_t	*pp = (result_t *)pdubuf;
+
+	pp->hdr.len = (int)(to + body);
+	pp->hdr.type = PDU_RESULT;
+	__pmPutTimeval(&view->timestamp, (__int32_t *)&pp->timestamp);
+	pp->numpmid = htonl(view->numpmid);
+    }
+    memcpy(&pdubuf[to/sizeof(__pmPDU)], &view->pdubuf[from/sizeof(__pmPDU)], body);
+
+    delta = ((int)to - (int)from) / (int)sizeof(__pmPDU);
+    if (delta != 0) {
+	for (i = 0; i < view->numpmid; i++) {
+	    vlp = (vlist_t *)&pdubuf[view->vset[i] + delta];
+	    numval = ntohl(vlp->numval);
+	    if (numval <= 0 || ntohl(vlp->valfmt) == PM_VAL_INSITU)
+		continue;
+	    for (j = 0; j < numval; j++)
+		vlp->vlist[j].value.lval =
+			htonl(ntohl(vlp->vlist[j].value.lval) + delta);
+	}
+    }
+
+    /* Note PDU remains pinned ... see thread-safe comments above */
+    *pdu = pdubuf;
+    return 0;
+}
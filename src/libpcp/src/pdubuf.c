@@ -26,21 +26,97 @@
 #include <search.h>
 #include <stdint.h>
 
+/*
+ * Pooled PDU buffers
+ *
+ * Buffers up to 2^PDUBUF_MAXSHIFT bytes come from power-of-2 size classes.
+ * Each such buffer is allocated aligned to its own size, so the buffer
+ * containing any (possibly interior) address can be found in O(1) by
+ * rounding the address down to each class size and probing a small
+ * open-addressing registry keyed by buffer address ... no range-compare
+ * tree walk, and no dereferencing of addresses that are not ours.
+ *
+ * Pinning and unpinning a pooled buffer does not take pdubuf_lock.
+ * The registry is only changed with the lock held; deleted slots become
+ * tombstones rather than being shifted, and a registry that is grown is
+ * replaced by a new table.  Readers publish the table they are probing
+ * as a per-thread hazard pointer, and old tables are only freed once no
+ * thread is probing them.  Pin counts are updated atomically.
+ *
+ * When the last pin on a pooled buffer is dropped, it goes onto a
+ * per-thread free list for its size class (bounded to PDUBUF_POOLBYTES
+ * bytes per class) rather than back to malloc, so steady-state PDU
+ * traffic in pmcd, pmproxy and friends recycles the same few buffers.
+ *
+ * Larger buffers (and all buffers on platforms without posix_memalign)
+ * are individually malloc'd and tracked in a tsearch(3) tree as before.
+ */
+
+#define PDUBUF_MINSHIFT		10	/* 1 Kbyte */
+#define PDUBUF_MAXSHIFT		16	/* 64 Kbyte */
+#define PDUBUF_NCLASS		(PDUBUF_MAXSHIFT - PDUBUF_MINSHIFT + 1)
+#define PDUBUF_POOLBYTES	(128 * 1024)
+#define PDUBUF_OVERSIZE		-1	/* bc_class for tree-managed buffers */
+
 typedef struct bufctl
 {
     int		bc_pincnt;
-    int		bc_size;
+    int		bc_size;	/* as requested, not the size class */
     char	*bc_buf;
-    /* The actual buffer happens to follow this struct. */
+    int		bc_class;	/* size class index, or PDUBUF_OVERSIZE */
+    struct bufctl *bc_next;	/* free list linkage */
+    /* For oversize buffers, the actual buffer happens to follow this struct. */
 } bufctl_t;
 
+/*
+ * Registry slot - the buffer address with the size class in the low
+ * bits, so probes can match without dereferencing pcp, which may be
+ * a buffer that some other thread is releasing.
+ */
+#define REG_EMPTY	((uintptr_t)0)
+#define REG_TOMBSTONE	((uintptr_t)1 << (PDUBUF_MINSHIFT - 1))
+#define REG_CLASSMASK	(((uintptr_t)1 << PDUBUF_MINSHIFT) - 1)
+
+typedef struct regslot
+{
+    volatile uintptr_t	key;
+    bufctl_t		*pcp;
+} regslot_t;
+
+typedef struct regtable
+{
+    unsigned int	size;		/* always a power of 2 */
+    struct regtable	*next;		/* retired tables awaiting free */
+    regslot_t		slot[1];
+} regtable_t;
+
+/* per-thread free lists */
+typedef struct bufpool
+{
+    bufctl_t		*free[PDUBUF_NCLASS];
+    int			nfree[PDUBUF_NCLASS];
+    regtable_t		*hazard;	/* registry table being probed */
+    struct bufpool	*next;		/* all pools, for reg_reclaim() */
+} bufpool_t;
+
 /* Protected by the pdubuf_lock mutex. */
 static void *buf_tree;
+static regtable_t	*registry;	/* pooled buffers, keyed by bc_buf */
+static unsigned int	reg_count;	/* live registry slots */
+static unsigned int	reg_used;	/* live and tombstone registry slots */
+static regtable_t	*retired;	/* replaced registry tables */
+static bufpool_t	*pools;		/* every thread's pool */
+static __uint64_t	nalloc;		/* new buffers from malloc */
+static __uint64_t	nreuse;		/* buffers recycled, updated atomically */
 
 #ifdef PM_MULTI_THREAD
 static pthread_mutex_t	pdubuf_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t	pool_key;
+static pthread_once_t	pool_once = PTHREAD_ONCE_INIT;
+static int		pool_key_ok;
 #else
 void			*pdubuf_lock;
+static bufpool_t	*pool_single;
 #endif
 
 #if defined(PM_MULTI_THREAD) && defined(PM_MULTI_THREAD_DEBUG)
@@ -65,20 +141,44 @@ pdubufdump1(const void *nodep, const VISIT which, const int depth)
 		pcp->bc_pincnt);
 }
 
+static inline int
+reg_live(uintptr_t key)
+{
+    return key != REG_EMPTY && key != REG_TOMBSTONE;
+}
+
 static void
 pdubufdump(void)
 {
+    regtable_t		*tab;
+    bufctl_t		*pcp;
+    unsigned int	i;
+    int			header = 0;
+
     /*
-     * There is no longer a pdubuf free list, ergo no
-     * fprintf(stderr, "   free pdubuf[size]:\n");
+     * Buffers on the per-thread free lists are not reported here,
+     * see __pmCountPDUBuf for those.
      */
     PM_LOCK(pdubuf_lock);
+    for (i = 0, tab = registry; tab != NULL && i < tab->size; i++) {
+	if (!reg_live(tab->slot[i].key))
+	    continue;
+	if ((pcp = tab->slot[i].pcp)->bc_pincnt == 0)
+	    continue;
+	if (header++ == 0)
+	    fprintf(stderr, "   pinned pdubuf[size](pincnt):");
+	fprintf(stderr, " " PRINTF_P_PFX "%p...%p[%d](%d)",
+		pcp->bc_buf, &pcp->bc_buf[pcp->bc_size - 1], pcp->bc_size,
+		pcp->bc_pincnt);
+    }
     if (buf_tree != NULL) {
-	fprintf(stderr, "   pinned pdubuf[size](pincnt):");
+	if (header++ == 0)
+	    fprintf(stderr, "   pinned pdubuf[size](pincnt):");
 	/* THREADSAFE - no locks acquired in pdubufdump1() */
 	twalk(buf_tree, &pdubufdump1);
-	fprintf(stderr, "\n");
     }
+    if (header)
+	fprintf(stderr, "\n");
     PM_UNLOCK(pdubuf_lock);
 }
 
@@ -99,18 +199,389 @@ bufctl_t_compare(const void *a, const void *b)
     return 0;		/* overlap */
 }
 
-__pmPDU *
-__pmFindPDUBuf(int need)
+/*
+ * Registry of pooled buffers - linear probing keyed on buffer address.
+ * Changes need pdubuf_lock; lookups need either the lock, or the table
+ * published as the caller's hazard pointer, see reg_enter().
+ */
+static inline unsigned int
+reg_home(uintptr_t addr, unsigned int size)
+{
+    /* low bits are always zero due to alignment */
+    addr >>= PDUBUF_MINSHIFT;
+    addr ^= addr >> 17;
+    addr *= 0x9e3779b1U;
+    return (unsigned int)(addr ^ (addr >> 15)) & (size - 1);
+}
+
+static inline uintptr_t
+reg_key(const bufctl_t *pcp)
+{
+    return (uintptr_t)pcp->bc_buf | (uintptr_t)pcp->bc_class;
+}
+
+/*
+ * Find the registered buffer at addr, if its size class covers the
+ * 2^shift byte block containing the handle being looked up.
+ */
+static bufctl_t *
+reg_lookup(const regtable_t *tab, uintptr_t addr, int shift)
+{
+    uintptr_t		key;
+    unsigned int	i, mask = tab->size - 1;
+
+    /* acquire pairs with the release in reg_insert(), so pcp is current */
+    for (i = reg_home(addr, tab->size);
+	 (key = __atomic_load_n(&tab->slot[i].key, __ATOMIC_ACQUIRE)) != REG_EMPTY;
+	 i = (i + 1) & mask) {
+	if ((key & ~REG_CLASSMASK) != addr)
+	    continue;
+	if ((key & REG_CLASSMASK) + PDUBUF_MINSHIFT < shift)
+	    return NULL;
+	return tab->slot[i].pcp;
+    }
+    return NULL;
+}
+
+/* returns 1 if an empty (rather than tombstone) slot was used */
+static int
+reg_insert(regtable_t *tab, uintptr_t key, bufctl_t *pcp)
+{
+    regslot_t		*sp;
+    unsigned int	i, mask = tab->size - 1;
+    int			used;
+
+    for (i = reg_home(key & ~REG_CLASSMASK, tab->size); reg_live(tab->slot[i].key); )
+	i = (i + 1) & mask;
+    sp = &tab->slot[i];
+    used = (sp->key == REG_EMPTY);
+    sp->pcp = pcp;
+    __atomic_store_n(&sp->key, key, __ATOMIC_RELEASE);
+    return used;
+}
+
+/* free retired tables that no thread is probing any more */
+static void
+reg_reclaim(void)
+{
+    regtable_t	*tab, **tpp;
+    bufpool_t	*pool;
+
+    /* new registry visible before hazard checks, pairs with reg_enter() */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    for (tpp = &retired; (tab = *tpp) != NULL; ) {
+	for (pool = pools; pool != NULL; pool = pool->next) {
+	    if (__atomic_load_n(&pool->hazard, __ATOMIC_SEQ_CST) == tab)
+		break;
+	}
+	if (pool == NULL) {
+	    *tpp = tab->next;
+	    free(tab);
+	}
+	else
+	    tpp = &tab->next;
+    }
+}
+
+static int
+reg_add(bufctl_t *pcp)
+{
+    regtable_t		*tab = registry, *newtab;
+    unsigned int	j, size;
+
+    if (tab == NULL || (reg_used + 1) * 2 > tab->size) {
+	/* grow, or just clear out tombstones, in a new table */
+	size = tab ? tab->size : 64;
+	if ((reg_count + 1) * 4 > size)
+	    size *= 2;
+	newtab = (regtable_t *)calloc(1, sizeof(regtable_t) + (size - 1) * sizeof(regslot_t));
+	if (newtab == NULL)
+	    return -ENOMEM;
+	newtab->size = size;
+	for (j = 0; tab != NULL && j < tab->size; j++) {
+	    if (reg_live(tab->slot[j].key))
+		reg_insert(newtab, tab->slot[j].key, tab->slot[j].pcp);
+	}
+	/* table filled before it is published */
+	__atomic_store_n(&registry, newtab, __ATOMIC_RELEASE);
+	reg_used = reg_count;
+	if (tab != NULL) {
+	    tab->next = retired;
+	    retired = tab;
+	    reg_reclaim();
+	}
+	tab = newtab;
+    }
+    reg_used += reg_insert(tab, reg_key(pcp), pcp);
+    reg_count++;
+    return 0;
+}
+
+static void
+reg_del(bufctl_t *pcp)
+{
+    regtable_t		*tab = registry;
+    unsigned int	i, mask = tab->size - 1;
+    uintptr_t		key = reg_key(pcp);
+
+    for (i = reg_home(key & ~REG_CLASSMASK, tab->size); tab->slot[i].key != key; )
+	i = (i + 1) & mask;
+    tab->slot[i].key = REG_TOMBSTONE;
+    reg_count--;
+
+    /*
+     * Tombstones at the end of a probe run can be emptied, as no
+     * lookup in progress could need to probe beyond them.
+     */
+    if (tab->slot[(i + 1) & mask].key != REG_EMPTY)
+	return;
+    while (tab->slot[i].key == REG_TOMBSTONE) {
+	tab->slot[i].key = REG_EMPTY;
+	reg_used--;
+	i = (i - 1) & mask;
+    }
+}
+
+/*
+ * Find the pooled buffer containing handle in registry table tab.
+ * Buffers sitting on a free list are not "in the pool" as far as
+ * callers of __pmPinPDUBuf and __pmUnpinPDUBuf are concerned.
+ */
+static bufctl_t *
+reg_find(const regtable_t *tab, void *handle)
 {
     bufctl_t	*pcp;
+    int		shift;
+
+    if (tab == NULL)
+	return NULL;
+    for (shift = PDUBUF_MINSHIFT; shift <= PDUBUF_MAXSHIFT; shift++) {
+	uintptr_t	base = (uintptr_t)handle & ~(((uintptr_t)1 << shift) - 1);
+
+	if ((pcp = reg_lookup(tab, base, shift)) == NULL)
+	    continue;
+	if (pcp->bc_pincnt == 0 ||
+	    (char *)handle >= &pcp->bc_buf[pcp->bc_size])
+	    return NULL;
+	return pcp;
+    }
+    return NULL;
+}
+
+/*
+ * Find the tree-managed buffer containing handle, if any ... caller
+ * holds pdubuf_lock.
+ */
+static bufctl_t *
+tree_find(void *handle)
+{
+    bufctl_t	*pcp, pcp_search;
     void	*bcp;
 
-    if (unlikely(need < 0)) {
-	/* special diagnostic case ... dump buffer state */
-	fprintf(stderr, "__pmFindPDUBuf(DEBUG)\n");
-	pdubufdump();
+    if (buf_tree == NULL)
+	return NULL;
+
+    /*
+     * Initialize a dummy bufctl_t to use only as search key;
+     * only its bc_buf & bc_size fields need to be set, as that's
+     * all that bufctl_t_compare will look at.
+     */
+    pcp_search.bc_buf = handle;
+    pcp_search.bc_size = 1;
+    /* THREADSAFE - no locks acquired in bufctl_t_compare() */
+    if ((bcp = tfind(&pcp_search, &buf_tree, &bufctl_t_compare)) == NULL)
+	return NULL;
+    pcp = *(bufctl_t **)bcp;
+    assert((&pcp->bc_buf[0] <= (char *)handle) &&
+	   ((char *)handle < &pcp->bc_buf[pcp->bc_size]));
+    return pcp;
+}
+
+static void
+pdubuf_release(bufctl_t *pcp)
+{
+    PM_LOCK(pdubuf_lock);
+    reg_del(pcp);
+    PM_UNLOCK(pdubuf_lock);
+    free(pcp->bc_buf);
+    free(pcp);
+}
+
+#ifdef PM_MULTI_THREAD
+static void
+pool_destroy(void *arg)
+{
+    bufpool_t	*pool = (bufpool_t *)arg;
+    bufpool_t	**pp;
+    bufctl_t	*pcp;
+    int		c;
+
+    for (c = 0; c < PDUBUF_NCLASS; c++) {
+	while ((pcp = pool->free[c]) != NULL) {
+	    pool->free[c] = pcp->bc_next;
+	    pdubuf_release(pcp);
+	}
+    }
+    PM_LOCK(pdubuf_lock);
+    for (pp = &pools; *pp != pool; pp = &(*pp)->next)
+	;
+    *pp = pool->next;
+    PM_UNLOCK(pdubuf_lock);
+    free(pool);
+}
+
+static void
+pool_init(void)
+{
+    pool_key_ok = (pthread_key_create(&pool_key, pool_destroy) == 0);
+}
+#endif
+
+/*
+ * This thread's buffer pool, created on first use ... NULL if that
+ * is not possible, in which case buffers are simply not recycled.
+ */
+static bufpool_t *
+pool_get(void)
+{
+    bufpool_t	*pool;
+
+#ifdef PM_MULTI_THREAD
+    pthread_once(&pool_once, pool_init);
+    if (!pool_key_ok)
+	return NULL;
+    if ((pool = (bufpool_t *)pthread_getspecific(pool_key)) != NULL)
+	return pool;
+#else
+    if ((pool = pool_single) != NULL)
+	return pool;
+#endif
+    if ((pool = (bufpool_t *)calloc(1, sizeof(*pool))) == NULL)
+	return NULL;
+#ifdef PM_MULTI_THREAD
+    if (pthread_setspecific(pool_key, pool) != 0) {
+	free(pool);
+	return NULL;
+    }
+#else
+    pool_single = pool;
+#endif
+    PM_LOCK(pdubuf_lock);
+    pool->next = pools;
+    pools = pool;
+    PM_UNLOCK(pdubuf_lock);
+    return pool;
+}
+
+/*
+ * Lookups without pdubuf_lock - publish the current registry table as
+ * this thread's hazard, so reg_reclaim() will not free it under us.
+ */
+static regtable_t *
+reg_enter(bufpool_t *pool)
+{
+    regtable_t	*tab;
+
+    do {
+	tab = __atomic_load_n(&registry, __ATOMIC_ACQUIRE);
+	__atomic_store_n(&pool->hazard, tab, __ATOMIC_SEQ_CST);
+    } while (tab != __atomic_load_n(&registry, __ATOMIC_SEQ_CST));
+    return tab;
+}
+
+static void
+reg_leave(bufpool_t *pool)
+{
+    __atomic_store_n(&pool->hazard, NULL, __ATOMIC_RELEASE);
+}
+
+/*
+ * Find the pooled buffer containing handle, if any.  Threads without
+ * a pool of their own (allocation failures only) use pdubuf_lock.
+ */
+static bufctl_t *
+pdubuf_lookup(void *handle)
+{
+    bufpool_t	*pool;
+    bufctl_t	*pcp;
+
+    if ((pool = pool_get()) == NULL) {
+	PM_LOCK(pdubuf_lock);
+	pcp = reg_find(registry, handle);
+	PM_UNLOCK(pdubuf_lock);
+    }
+    else {
+	pcp = reg_find(reg_enter(pool), handle);
+	reg_leave(pool);
+    }
+    return pcp;
+}
+
+static int
+pdubuf_class(int need)
+{
+    int		c;
+
+    for (c = 0; c < PDUBUF_NCLASS; c++) {
+	if (need <= (1 << (PDUBUF_MINSHIFT + c)))
+	    return c;
+    }
+    return PDUBUF_OVERSIZE;
+}
+
+/*
+ * Get a pinned buffer from the size class pools, either recycled from
+ * this thread's free list or freshly allocated and registered.
+ */
+static bufctl_t *
+pdubuf_pooled(int need, int c)
+{
+    bufpool_t	*pool;
+    bufctl_t	*pcp;
+    void	*buf;
+    int		size = 1 << (PDUBUF_MINSHIFT + c);
+
+    if ((pool = pool_get()) != NULL && (pcp = pool->free[c]) != NULL) {
+	/* free list itself is private to this thread, no lock needed */
+	pool->free[c] = pcp->bc_next;
+	pool->nfree[c]--;
+	pcp->bc_next = NULL;
+	pcp->bc_size = need;
+	pcp->bc_pincnt = 1;
+	__sync_fetch_and_add(&nreuse, 1);
+	return pcp;
+    }
+
+    if ((pcp = (bufctl_t *)malloc(sizeof(*pcp))) == NULL)
+	return NULL;
+    if (posix_memalign(&buf, size, size) != 0) {
+	free(pcp);
 	return NULL;
     }
+    pcp->bc_pincnt = 1;
+    pcp->bc_size = need;
+    pcp->bc_buf = (char *)buf;
+    pcp->bc_class = c;
+    pcp->bc_next = NULL;
+
+    PM_LOCK(pdubuf_lock);
+    if (unlikely(reg_add(pcp) < 0)) {	/* ENOMEM */
+	PM_UNLOCK(pdubuf_lock);
+	free(buf);
+	free(pcp);
+	return NULL;
+    }
+    nalloc++;
+    PM_UNLOCK(pdubuf_lock);
+    return pcp;
+}
+
+/* Get a pinned, individually malloc'd buffer tracked in the tree. */
+static bufctl_t *
+pdubuf_oversize(int need)
+{
+    bufctl_t	*pcp;
+    void	*bcp;
 
     if ((pcp = (bufctl_t *)malloc(sizeof(*pcp) + need)) == NULL) {
 	return NULL;
@@ -119,6 +590,8 @@ __pmFindPDUBuf(int need)
     pcp->bc_pincnt = 1;
     pcp->bc_size = need;
     pcp->bc_buf = ((char *)pcp) + sizeof(*pcp);
+    pcp->bc_class = PDUBUF_OVERSIZE;
+    pcp->bc_next = NULL;
 
     PM_LOCK(pdubuf_lock);
     /* Insert the node in the tree. */
@@ -129,8 +602,37 @@ __pmFindPDUBuf(int need)
 	free(pcp);
 	return NULL;
     }
+    nalloc++;
     PM_UNLOCK(pdubuf_lock);
 
+    return pcp;
+}
+
+__pmPDU *
+__pmFindPDUBuf(int need)
+{
+    bufctl_t	*pcp;
+    int		c;
+
+    if (unlikely(need < 0)) {
+	/* special diagnostic case ... dump buffer state */
+	fprintf(stderr, "__pmFindPDUBuf(DEBUG)\n");
+	pdubufdump();
+	return NULL;
+    }
+
+#ifdef HAVE_POSIX_MEMALIGN
+    c = pdubuf_class(need);
+#else
+    c = PDUBUF_OVERSIZE;
+#endif
+    if (c == PDUBUF_OVERSIZE)
+	pcp = pdubuf_oversize(need);
+    else
+	pcp = pdubuf_pooled(need, c);
+    if (pcp == NULL)
+	return NULL;
+
     if (unlikely(pmDebugOptions.pdubuf)) {
 	fprintf(stderr, "__pmFindPDUBuf(%d) -> " PRINTF_P_PFX "%p\n",
 		need, pcp->bc_buf);
@@ -143,72 +645,79 @@ __pmFindPDUBuf(int need)
 void
 __pmPinPDUBuf(void *handle)
 {
-    bufctl_t	*pcp, pcp_search;
-    void	*bcp;
+    bufctl_t	*pcp;
+    int		pincnt;
 
     assert(((__psint_t)handle % sizeof(int)) == 0);
-    /*
-     * Initialize a dummy bufctl_t to use only as search key;
-     * only its bc_buf & bc_size fields need to be set, as that's
-     * all that bufctl_t_compare will look at.
-     */
-    pcp_search.bc_buf = handle;
-    pcp_search.bc_size = 1;
 
-    PM_LOCK(pdubuf_lock);
-    /* THREADSAFE - no locks acquired in bufctl_t_compare() */
-    bcp = tfind(&pcp_search, &buf_tree, &bufctl_t_compare);
-    /*
-     * NB: don't release the lock until final disposition of this object;
-     * we don't want to play TOCTOU.
-     */
-    if (likely(bcp != NULL)) {
-	pcp = *(bufctl_t **)bcp;
-	assert((&pcp->bc_buf[0] <= (char *)handle) &&
-	       ((char *)handle < &pcp->bc_buf[pcp->bc_size]));
-	pcp->bc_pincnt++;
-    } else {
+    if (likely((pcp = pdubuf_lookup(handle)) != NULL)) {
+	pincnt = __sync_add_and_fetch(&pcp->bc_pincnt, 1);
+    }
+    else {
+	PM_LOCK(pdubuf_lock);
+	/*
+	 * NB: don't release the lock until final disposition of this
+	 * object; we don't want to play TOCTOU.
+	 */
+	if ((pcp = tree_find(handle)) == NULL) {
+	    PM_UNLOCK(pdubuf_lock);
+	    pmNotifyErr(LOG_WARNING, "__pmPinPDUBuf: " PRINTF_P_PFX "%p not in pool!", handle);
+	    if (pmDebugOptions.pdubuf)
+		pdubufdump();
+	    return;
+	}
+	pincnt = ++pcp->bc_pincnt;
 	PM_UNLOCK(pdubuf_lock);
-	pmNotifyErr(LOG_WARNING, "__pmPinPDUBuf: " PRINTF_P_PFX "%p not in pool!", handle);
-	if (pmDebugOptions.pdubuf)
-	    pdubufdump();
-	return;
     }
 
     if (unlikely(pmDebugOptions.pdubuf))
 	fprintf(stderr, "__pmPinPDUBuf(" PRINTF_P_PFX "%p) -> pdubuf="
 			PRINTF_P_PFX "%p, pincnt=%d\n", handle,
-		pcp->bc_buf, pcp->bc_pincnt);
-
-    PM_UNLOCK(pdubuf_lock);
+		pcp->bc_buf, pincnt);
 }
 
 int
 __pmUnpinPDUBuf(void *handle)
 {
-    bufctl_t	*pcp, pcp_search;
-    void	*bcp;
+    bufpool_t	*pool;
+    bufctl_t	*pcp;
+    int		c, pincnt;
 
     assert(((__psint_t)handle % sizeof(int)) == 0);
-    PM_LOCK(pdubuf_lock);
 
-    /*
-     * Initialize a dummy bufctl_t to use only as search key;
-     * only its bc_buf & bc_size fields need to be set, as that's
-     * all that bufctl_t_compare will look at.
-     */
-    pcp_search.bc_buf = handle;
-    pcp_search.bc_size = 1;
+    if (likely((pcp = pdubuf_lookup(handle)) != NULL)) {
+	pincnt = __sync_sub_and_fetch(&pcp->bc_pincnt, 1);
+	if (unlikely(pmDebugOptions.pdubuf))
+	    fprintf(stderr, "__pmUnpinPDUBuf(" PRINTF_P_PFX "%p) -> pdubuf="
+			PRINTF_P_PFX "%p, pincnt=%d\n", handle,
+		    pcp->bc_buf, pincnt);
+	if (likely(pincnt > 0))
+	    return 1;
+
+	/*
+	 * Recycle via this thread's free list (which may not be the
+	 * thread that allocated the buffer), up to the per-class limit.
+	 */
+	c = pcp->bc_class;
+	pool = pool_get();
+	if (pool != NULL &&
+	    pool->nfree[c] < (PDUBUF_POOLBYTES >> (PDUBUF_MINSHIFT + c))) {
+	    pcp->bc_next = pool->free[c];
+	    pool->free[c] = pcp;
+	    pool->nfree[c]++;
+	}
+	else {
+	    pdubuf_release(pcp);
+	}
+	return 1;
+    }
 
-    /* THREADSAFE - no locks acquired in bufctl_t_compare() */
-    bcp = tfind(&pcp_search, &buf_tree, &bufctl_t_compare);
+    PM_LOCK(pdubuf_lock);
     /*
      * NB: don't release the lock until final disposition of this object;
      * we don't want to play TOCTOU.
      */
-    if (likely(bcp != NULL)) {
-	pcp = *(bufctl_t **)bcp;
-    } else {
+    if (unlikely((pcp = tree_find(handle)) == NULL)) {
 	PM_UNLOCK(pdubuf_lock);
 	if (pmDebugOptions.pdubuf) {
 	    fprintf(stderr, "__pmUnpinPDUBuf(" PRINTF_P_PFX "%p) -> fails\n",
@@ -223,19 +732,15 @@ __pmUnpinPDUBuf(void *handle)
 			PRINTF_P_PFX "%p, pincnt=%d\n", handle,
 		pcp->bc_buf, pcp->bc_pincnt - 1);
 
-    assert((&pcp->bc_buf[0] <= (char*)handle) &&
-	   ((char*)handle < &pcp->bc_buf[pcp->bc_size]));
-
-    if (likely(--pcp->bc_pincnt == 0)) {
-	/* THREADSAFE - no locks acquired in bufctl_t_compare() */
-	tdelete(pcp, &buf_tree, &bufctl_t_compare);
-	PM_UNLOCK(pdubuf_lock);
-	free(pcp);
-    }
-    else {
+    if (likely(--pcp->bc_pincnt > 0)) {
 	PM_UNLOCK(pdubuf_lock);
+	return 1;
     }
 
+    /* THREADSAFE - no locks acquired in bufctl_t_compare() */
+    tdelete(pcp, &buf_tree, &bufctl_t_compare);
+    PM_UNLOCK(pdubuf_lock);
+    free(pcp);
     return 1;
 }
 
@@ -256,18 +761,50 @@ pdubufcount(const void *nodep, const VISIT which, const int depth)
 	    pdu_bufcnt++;
 }
 
+/*
+ * Report the number of pinned (alloc) and pooled-but-idle (free)
+ * PDU buffers of at least need bytes.
+ */
 void
 __pmCountPDUBuf(int need, int *alloc, int *free)
 {
+    regtable_t		*tab;
+    bufctl_t		*pcp;
+    unsigned int	i;
+    int			nfree = 0;
+
     PM_LOCK(pdubuf_lock);
 
     pdu_bufcnt_need = need;
     pdu_bufcnt = 0;
     /* THREADSAFE - no locks acquired in pdubufcount() */
     twalk(buf_tree, &pdubufcount);
+
+    for (i = 0, tab = registry; tab != NULL && i < tab->size; i++) {
+	if (!reg_live(tab->slot[i].key))
+	    continue;
+	if ((pcp = tab->slot[i].pcp)->bc_pincnt > 0) {
+	    if (pcp->bc_size >= need)
+		pdu_bufcnt++;
+	}
+	else if ((1 << (PDUBUF_MINSHIFT + pcp->bc_class)) >= need)
+	    nfree++;
+    }
     *alloc = pdu_bufcnt;
+    *free = nfree;
 
-    *free = 0;			/* We don't retain freed nodes. */
+    PM_UNLOCK(pdubuf_lock);
+}
 
+/*
+ * Cumulative counts of __pmFindPDUBuf requests satisfied by a new
+ * allocation (allocs) and by recycling a pooled buffer (reuses).
+ */
+void
+__pmCountPDUBufReuse(__uint64_t *allocs, __uint64_t *reuses)
+{
+    PM_LOCK(pdubuf_lock);
+    *allocs = nalloc;
+    *reuses = nreuse;
     PM_UNLOCK(pdubuf_lock);
 }
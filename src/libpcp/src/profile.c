@@ -16,10 +16,52 @@
 #include "libpcp.h"
 #include "internal.h"
 
+static int
+_instcmp(const void *a, const void *b)
+{
+    int		x = *(const int *)a;
+    int		y = *(const int *)b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * Sort an instance list into ascending order and squeeze out any
+ * duplicates, returning the new length.  All the instance lists in
+ * a profile are kept this way, so __pmInProfile() can use a binary
+ * search and PMDAs can walk an inclusion list in instance order.
+ */
+int
+__pmSortProfileInstances(int *list, int len)
+{
+    int		i, j;
+
+    if (len < 2)
+	return len;
+    qsort(list, len, sizeof(int), _instcmp);
+    for (i = 1, j = 0; i < len; i++) {
+	if (list[i] != list[j])
+	    list[++j] = list[i];
+    }
+    return j + 1;
+}
+
 static int *
-_subtract(int *list, int *list_len, int *arg, int arg_len)
+_sorted(int *arg, int *arg_len)
 {
     int		*new;
+
+    if ((new = (int *)malloc(*arg_len * sizeof(int))) == NULL)
+	return NULL;
+    memcpy((void *)new, (void *)arg, *arg_len * sizeof(int));
+    *arg_len = __pmSortProfileInstances(new, *arg_len);
+    return new;
+}
+
+static int *
+_subtract(int *list, int *list_len, int *arg, int arg_len)
+{
+    int		*sarg;
     int		len = *list_len;
     int		new_len = 0;
     int		i, j;
@@ -28,51 +70,59 @@ _subtract(int *list, int *list_len, int *arg, int arg_len)
 	/* noop */
 	return NULL;
 
-    new = (int *)malloc(len * sizeof(int));
-    if (new == NULL)
+    if ((sarg = _sorted(arg, &arg_len)) == NULL)
 	return NULL;
 
-    for (i=0; i < len; i++) {
-	for (j=0; j < arg_len; j++)
-	    if (list[i] == arg[j])
-		break;
-	if (j == arg_len)
+    /* both lists are sorted, so merge in place */
+    for (i = 0, j = 0; i < len; i++) {
+	while (j < arg_len && sarg[j] < list[i])
+	    j++;
+	if (j == arg_len || sarg[j] != list[i])
 	    /* this instance survived */
-	    new[new_len++] = list[i];
+	    list[new_len++] = list[i];
     }
-    free(list);
+    free(sarg);
     *list_len = new_len;
-    return new;
+    return list;
 }
 
 static int *
 _union(int *list, int *list_len, int *arg, int arg_len)
 {
     int		*new;
+    int		*sarg;
     int		len = *list_len;
-    int		new_len = *list_len;
+    int		new_len = 0;
     int		i, j;
 
+    if ((sarg = _sorted(arg, &arg_len)) == NULL)
+	return NULL;
+
     if (list == NULL) {
-	list = (int *)malloc(arg_len * sizeof(int));
-	memcpy((void *)list, (void *)arg, arg_len * sizeof(int));
 	*list_len = arg_len;
-	return list;
+	return sarg;
     }
 
-    new = (int *)realloc((void *)list, (len + arg_len) * sizeof(int));
-    if (new == NULL)
+    new = (int *)malloc((len + arg_len) * sizeof(int));
+    if (new == NULL) {
+	free(sarg);
 	return NULL;
+    }
 
-    for (i=0; i < arg_len; i++) {
-	for (j=0; j < new_len; j++) {
-	    if (arg[i] == new[j])
-		break;
+    /* both lists are sorted, so merge without duplicates */
+    for (i = 0, j = 0; i < len || j < arg_len; ) {
+	if (j == arg_len || (i < len && list[i] < sarg[j]))
+	    new[new_len++] = list[i++];
+	else if (i == len || sarg[j] < list[i])
+	    new[new_len++] = sarg[j++];
+	else {
+	    /* instance is already in the list */
+	    new[new_len++] = list[i++];
+	    j++;
 	}
-	if (j == new_len)
-	    /* instance is not already in the list */
-	    new[new_len++] = arg[i];
     }
+    free(sarg);
+    free(list);
     *list_len = new_len;
     return new;
 }
@@ -155,7 +205,7 @@ int
 __pmInProfile(pmInDom indom, const pmProfile *prof, int inst)
 {
     pmInDomProfile	*p;
-    int			*in, *in_end;
+    int			lo, hi, mid;
 
     if (prof == NULL)
 	/* default if no profile for any instance domains */
@@ -165,10 +215,19 @@ __pmInProfile(pmInDom indom, const pmProfile *prof, int inst)
 	/* no profile for this indom => use global default */
 	return (prof->state == PM_PROFILE_INCLUDE) ? 1 : 0;
 
-    for (in=p->instances, in_end=in+p->instances_len; in < in_end; in++)
-	if (*in == inst)
+    /* instance list is sorted, see __pmSortProfileInstances() */
+    lo = 0;
+    hi = p->instances_len - 1;
+    while (lo <= hi) {
+	mid = lo + (hi - lo) / 2;
+	if (p->instances[mid] < inst)
+	    lo = mid + 1;
+	else if (p->instances[mid] > inst)
+	    hi = mid - 1;
+	else
 	    /* present in the list => inverse of default for this indom */
 	    return (p->state == PM_PROFILE_INCLUDE) ? 0 : 1;
+    }
 
     /* not in the list => use default for this indom */
     return (p->state == PM_PROFILE_INCLUDE) ? 1 : 0;
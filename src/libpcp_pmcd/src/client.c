@@ -19,7 +19,7 @@
 
 PMCD_DATA ClientInfo	*client;
 PMCD_DATA int		nClients;	/* Number in array, (not all in use) */
-PMCD_DATA int		this_client_id;
+PMCD_DATA PMCD_TLS int	this_client_id;
 
 /*
  * Expose ClientInfo struct for client #n
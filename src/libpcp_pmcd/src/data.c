@@ -38,6 +38,12 @@ PMCD_DATA unsigned maxinpdusize;	/* Max input PDU size (bytes) */
 PMCD_DATA unsigned maxmetrics = 32 * 1024;	/* Max number of PMIDs per pmFetch */
 PMCD_DATA unsigned maxctx = 64;		/* Max number of contexts per client */
 
+PMCD_DATA int	pmcd_fetchcache;	/* Fetch result sharing window (msec) */
+PMCD_DATA unsigned pmcd_fetchcache_epoch;	/* Bumped when window is changed */
+PMCD_DATA __uint64_t pmcd_fetchcache_hits;	/* Agent fetches served from cache */
+PMCD_DATA __uint64_t pmcd_fetchcache_misses;	/* Agent fetches sent to the PMDA */
+PMCD_DATA __uint64_t pmcd_fetchcache_coalesced; /* Hits on fetches in progress */
+
 
 /*
  * Return a pointer to the PMDA that is responsible for the given domain.
@@ -38,6 +38,15 @@ typedef struct {
 static tracebuf		*trace;
 static unsigned int	next;
 
+/* pmcd may be tracing from several worker threads at once */
+#ifdef PM_MULTI_THREAD
+static pthread_mutex_t	trace_lock = PTHREAD_MUTEX_INITIALIZER;
+#else
+void			*trace_lock;
+#endif
+
+static void dump_trace(FILE *);
+
 /*
  * by default, circular buffer last 20 events -- change by modify
  * pmcd.control.tracebufs
@@ -48,8 +57,8 @@ static unsigned int	next;
 PMCD_DATA int		pmcd_trace_nbufs = 20;
 PMCD_DATA int		pmcd_trace_mask;
 
-void
-pmcd_init_trace(int n)
+static void
+init_trace(int n)
 {
     if (trace != NULL)
 	free(trace);
@@ -61,6 +70,14 @@ pmcd_init_trace(int n)
     next = 0;
 }
 
+void
+pmcd_init_trace(int n)
+{
+    PM_LOCK(trace_lock);
+    init_trace(n);
+    PM_UNLOCK(trace_lock);
+}
+
 void
 pmcd_trace(int type, int who, int p1, int p2)
 {
@@ -80,10 +97,13 @@ pmcd_trace(int type, int who, int p1, int p2)
 	    break;
     }
 
+    PM_LOCK(trace_lock);
     if (trace == NULL) {
-	pmcd_init_trace(pmcd_trace_nbufs);
-	if (trace == NULL)
+	init_trace(pmcd_trace_nbufs);
+	if (trace == NULL) {
+	    PM_UNLOCK(trace_lock);
 	    return;
+	}
     }
 
     p = (next++) % pmcd_trace_nbufs;
@@ -96,11 +116,20 @@ pmcd_trace(int type, int who, int p1, int p2)
 
     if (pmcd_trace_mask & TR_MASK_NOBUF)
 	/* unbuffered, dump it now */
-	pmcd_dump_trace(stderr);
+	dump_trace(stderr);
+    PM_UNLOCK(trace_lock);
 }
 
 void
 pmcd_dump_trace(FILE *f)
+{
+    PM_LOCK(trace_lock);
+    dump_trace(f);
+    PM_UNLOCK(trace_lock);
+}
+
+static void
+dump_trace(FILE *f)
 {
     int			i;
     int			p;
@@ -62,6 +62,8 @@ __pmdaCntInst(pmInDom indom, pmdaExt *pmda)
  */
 
 static pmdaIndom	last;
+static pmdaIndom	profiled;
+static pmInDomProfile	*lastprof;
 
 /*
  * State between here and __pmdaNextInst is a little strange
@@ -75,6 +77,14 @@ static pmdaIndom	last;
  *      up with the it_indom field (other fields in last are not used),
  *      and pmda->e_idp->it_indom in __pmdaNextInst
  *
+ * for the cache method when the profile is an inclusion list that
+ * is shorter than the cache
+ *    - pmda->e_idp is set here (points into profiled) and lastprof
+ *      is the profile entry for the indom, then __pmdaNextInst walks
+ *      the (sorted) profile instances and checks each in the cache,
+ *      rather than walking the whole cache ... the order of instances
+ *      is the same as a cache walk, as both are sorted by instance
+ *
  * In both cases, pmda->e_ordinal and pmda->e_singular are set here
  * and updated in __pmdaNextInst.
  *
@@ -97,9 +107,17 @@ __pmdaStartInst(pmInDom indom, pmdaExt *pmda)
     }
     else {
 	if (pmdaCacheOp(indom, PMDA_CACHE_CHECK)) {
-	    pmdaCacheOp(indom, PMDA_CACHE_WALK_REWIND);
-	    last.it_indom = indom;
-	    pmda->e_idp = &last;
+	    lastprof = __pmFindProfile(indom, pmda->e_prof);
+	    if (lastprof != NULL && lastprof->state == PM_PROFILE_EXCLUDE &&
+		lastprof->instances_len < pmdaCacheOp(indom, PMDA_CACHE_SIZE)) {
+		profiled.it_indom = indom;
+		pmda->e_idp = &profiled;
+	    }
+	    else {
+		pmdaCacheOp(indom, PMDA_CACHE_WALK_REWIND);
+		last.it_indom = indom;
+		pmda->e_idp = &last;
+	    }
 	    pmda->e_ordinal = 0;
 	}
 	else {
@@ -140,7 +158,22 @@ __pmdaNextInst(int *inst, pmdaExt *pmda)
     }
     if (pmda->e_ordinal >= 0) {
 	/* scan for next value in the profile */
-	if (pmda->e_idp == &last) {
+	if (pmda->e_idp == &profiled) {
+	    /* profile-driven, for a cache-driven indom */
+	    while (pmda->e_ordinal < lastprof->instances_len) {
+		myinst = lastprof->instances[pmda->e_ordinal++];
+		if (pmdaCacheLookup(pmda->e_idp->it_indom, myinst, NULL, NULL) == PMDA_CACHE_ACTIVE) {
+		    *inst = myinst;
+		    if (pmDebugOptions.indom) {
+			char	strbuf[20];
+			fprintf(stderr, "__pmdaNextInst(indom=%s) -> %d e_ordinal=%d (profile)\n",
+			    pmInDomStr_r(pmda->e_idp->it_indom, strbuf, sizeof(strbuf)), myinst, pmda->e_ordinal);
+		    }
+		    return 1;
+		}
+	    }
+	}
+	else if (pmda->e_idp == &last) {
 	    /* cache-driven */
 	    while ((myinst = pmdaCacheOp(pmda->e_idp->it_indom, PMDA_CACHE_WALK_NEXT)) != -1) {
 		pmda->e_ordinal++;
@@ -206,11 +239,11 @@ __pmdaCountInst(pmDesc *dp, pmdaExt *pmda)
  */
 
 static pmdaMetric *
-__pmdaHashedSearch(pmID pmid, __pmHashCtl *hash)
+__pmdaHashedSearch(pmID pmid, __pmFlatHashCtl *hash)
 {
-    __pmHashNode *node;
+    __pmFlatHashNode *node;
 
-    if ((node = __pmHashSearch(pmid, hash)) == NULL)
+    if ((node = __pmFlatHashSearch(pmid, hash)) == NULL)
 	return NULL;
     return (pmdaMetric *)node->data;
 }
@@ -493,9 +526,146 @@ __pmdaEncodeStatus(pmResult *result, unsigned char byte)
 
 #define PMDA_STATUS_CHANGE (PMDA_EXT_LABEL_CHANGE|PMDA_EXT_NAMES_CHANGE)
 
+/*
+ * Report a fetch callback error for one metric instance, or for all
+ * instances of a metric (inst == PM_IN_NULL) from a batch callback
+ */
+static void
+__pmdaFetchError(pmDesc *dp, int inst, int sts)
+{
+    char	strbuf[20];
+
+    pmIDStr_r(dp->pmid, strbuf, sizeof(strbuf));
+    if (sts == PM_ERR_PMID) {
+	pmNotifyErr(LOG_ERR, 
+	    "pmdaFetch: PMID %s not handled by fetch callback\n",
+		    strbuf);
+    }
+    else if (sts == PM_ERR_INST) {
+	pmNotifyErr(LOG_WARNING,
+	    "pmdaFetch: Instance %d of PMID %s not handled by fetch callback\n",
+	    inst, strbuf);
+    }
+    else if (sts == PM_ERR_VALUE ||
+	     sts == PM_ERR_APPVERSION ||
+	     sts == PM_ERR_PERMISSION ||
+	     sts == PM_ERR_AGAIN ||
+	     sts == PM_ERR_NYI) {
+	if (pmDebugOptions.libpmda) {
+	    logmsg(NULL,
+		 "Fetch callback error from metric PMID %s[%d]: %s\n",
+		strbuf, inst, pmErrStr(sts));
+	}
+    }
+    else {
+	pmNotifyErr(LOG_ERR,
+	    "pmdaFetch: Fetch callback error from metric PMID %s[%d]: %s\n",
+		    strbuf, inst, pmErrStr(sts));
+    }
+}
+
+/*
+ * Add the value returned by a fetch callback (sts and atom) for
+ * instance inst as the next value (*jp) in vset.  Returns sts, or
+ * the error from __pmStuffValue.
+ */
+static int
+__pmdaFetchValue(int version, pmDesc *dp, int inst, int sts,
+		pmAtomValue *atom, pmValueSet *vset, int *jp)
+{
+    int		lsts;
+    int		type = dp->type;
+    char	idbuf[20];
+    char	strbuf[20];
+
+    if (sts < 0) {
+	__pmdaFetchError(dp, inst, sts);
+	return sts;
+    }
+
+    /*
+     * PMDA_INTERFACE_2
+     *	>= 0 => OK
+     * PMDA_INTERFACE_3 or PMDA_INTERFACE_4
+     *	== 0 => no values
+     *	> 0  => OK
+     * PMDA_INTERFACE_5 or later
+     *	== 0 (PMDA_FETCH_NOVALUES) => no values
+     *	== 1 (PMDA_FETCH_STATIC) or > 2 => OK
+     *	== 2 (PMDA_FETCH_DYNAMIC) => OK and free(atom.vp)
+     *	     after __pmStuffValue() called
+     */
+    if ((version == PMDA_INTERFACE_2) || (version >= PMDA_INTERFACE_3 && sts > 0)) {
+
+	vset->vlist[*jp].inst = inst;
+	if ((lsts = __pmStuffValue(atom, &vset->vlist[*jp], type)) == PM_ERR_TYPE) {
+	    pmNotifyErr(LOG_ERR, "pmdaFetch: Descriptor type (%s) for metric %s is bad",
+			pmTypeStr_r(type, strbuf, sizeof(strbuf)),
+			pmIDStr_r(dp->pmid, idbuf, sizeof(idbuf)));
+	}
+	else if (lsts >= 0) {
+	    vset->valfmt = lsts;
+	    (*jp)++;
+	}
+	if (version >= PMDA_INTERFACE_5 && sts == PMDA_FETCH_DYNAMIC) {
+	    if (type == PM_TYPE_STRING)
+		free(atom->cp);
+	    else if (type == PM_TYPE_AGGREGATE)
+		free(atom->vbp);
+	    else {
+		pmNotifyErr(LOG_WARNING, "pmdaFetch: Attempt to free value for metric %s of wrong type %s\n",
+			    pmIDStr_r(dp->pmid, idbuf, sizeof(idbuf)),
+			    pmTypeStr_r(type, strbuf, sizeof(strbuf)));
+	    }
+	}
+	if (lsts < 0)
+	    sts = lsts;
+    }
+    return sts;
+}
+
+/*
+ * Gather the instances in the profile for a metric into the batch
+ * arrays, growing them as required.  Returns the number of instances.
+ */
+static int
+__pmdaBatchInst(pmDesc *dp, pmdaExt *pmda, e_ext_t *extp)
+{
+    int		inst, numinst = 0;
+    size_t	need;
+    void	*tmp;
+
+    if (dp->indom == PM_INDOM_NULL)
+	inst = PM_IN_NULL;
+    else {
+	__pmdaStartInst(dp->indom, pmda);
+	if (!__pmdaNextInst(&inst, pmda))
+	    return 0;
+    }
+    do {
+	if (numinst == extp->maxbatch) {
+	    need = extp->maxbatch ? 2 * extp->maxbatch : 64;
+	    if ((tmp = realloc(extp->batchinst, need * sizeof(int))) == NULL)
+		return -oserror();
+	    extp->batchinst = (int *)tmp;
+	    if ((tmp = realloc(extp->batchsts, need * sizeof(int))) == NULL)
+		return -oserror();
+	    extp->batchsts = (int *)tmp;
+	    if ((tmp = realloc(extp->batchatom, need * sizeof(pmAtomValue))) == NULL)
+		return -oserror();
+	    extp->batchatom = (pmAtomValue *)tmp;
+	    extp->maxbatch = need;
+	}
+	extp->batchinst[numinst++] = inst;
+    } while (dp->indom != PM_INDOM_NULL && __pmdaNextInst(&inst, pmda));
+
+    return numinst;
+}
+
 /*
  * Resize the pmResult and call the e_callback for each metric instance
- * required in the profile.
+ * required in the profile, or the batch callback once for all of the
+ * instances of each metric when one has been registered.
  */
 
 int
@@ -503,11 +673,13 @@ pmdaFetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 {
     int			i;		/* over pmidlist[] */
     int			j;		/* over metatab and vset->vlist[] */
+    int			k;		/* over batch instances */
     int			sts;
     int			need;
     int			inst;
     int			numval;
     int			version;
+    int			batch;
     unsigned char	flags;
     pmValueSet		*vset;
     pmValueSet		*tmp_vset;
@@ -515,8 +687,6 @@ pmdaFetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
     pmdaMetric          metabuf;
     pmdaMetric		*metap;
     pmAtomValue		atom;
-    int			type;
-    int			lsts;
     char		idbuf[20];
     char		strbuf[20];
     e_ext_t		*extp = (e_ext_t *)pmda->e_ext;
@@ -569,8 +739,19 @@ pmdaFetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 	 * will be zero
 	 */
 	dp = &(metap->m_desc);
-	if (dp->pmid != 0)
-	    numval = __pmdaCountInst(dp, pmda);
+	batch = 0;
+	if (dp->pmid != 0) {
+	    if (extp->fetchBatchCallBack != NULL) {
+		/* one pass over the profile, sizes vset and builds instlist */
+		if ((numval = __pmdaBatchInst(dp, pmda, extp)) < 0) {
+		    sts = numval;
+		    goto error;
+		}
+		batch = 1;
+	    }
+	    else
+		numval = __pmdaCountInst(dp, pmda);
+	}
 	else {
 	    /* dynamic name metrics may often vanish, avoid log spam */
 	    if (version < PMDA_INTERFACE_4) {
@@ -598,13 +779,34 @@ pmdaFetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 	if (vset->numval <= 0)
 	    continue;
 
+	if (batch) {
+	    sts = (*(extp->fetchBatchCallBack))(metap, numval,
+			extp->batchinst, extp->batchatom, extp->batchsts);
+	    if (sts != PM_ERR_NYI) {
+		if (sts < 0) {
+		    /* error for every instance of this metric */
+		    __pmdaFetchError(dp, PM_IN_NULL, sts);
+		    vset->numval = sts;
+		    continue;
+		}
+		for (j = k = 0; k < numval; k++)
+		    sts = __pmdaFetchValue(version, dp, extp->batchinst[k],
+			    extp->batchsts[k], &extp->batchatom[k], vset, &j);
+		if (j == 0)
+		    vset->numval = sts;
+		else
+		    vset->numval = j;
+		continue;
+	    }
+	    /* else not handled in batch, use the per-instance callback */
+	}
+
 	if (dp->indom == PM_INDOM_NULL)
 	    inst = PM_IN_NULL;
 	else {
 	    __pmdaStartInst(dp->indom, pmda);
 	    __pmdaNextInst(&inst, pmda);
 	}
-	type = dp->type;
 	j = 0;
 	do {
 	    if (j == numval) {
@@ -620,76 +822,8 @@ pmdaFetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 		}
 		vset = tmp_vset;
 	    }
-	    vset->vlist[j].inst = inst;
-
-	    if ((sts = (*(pmda->e_fetchCallBack))(metap, inst, &atom)) < 0) {
-		pmIDStr_r(dp->pmid, strbuf, sizeof(strbuf));
-		if (sts == PM_ERR_PMID) {
-		    pmNotifyErr(LOG_ERR, 
-		        "pmdaFetch: PMID %s not handled by fetch callback\n",
-				strbuf);
-		}
-		else if (sts == PM_ERR_INST) {
-		    pmNotifyErr(LOG_WARNING,
-			"pmdaFetch: Instance %d of PMID %s not handled by fetch callback\n",
-			inst, strbuf);
-		}
-		else if (sts == PM_ERR_VALUE ||
-			 sts == PM_ERR_APPVERSION ||
-			 sts == PM_ERR_PERMISSION ||
-			 sts == PM_ERR_AGAIN ||
-			 sts == PM_ERR_NYI) {
-		    if (pmDebugOptions.libpmda) {
-			logmsg(NULL,
-			     "Fetch callback error from metric PMID %s[%d]: %s\n",
-			    strbuf, inst, pmErrStr(sts));
-		    }
-		}
-		else {
-		    pmNotifyErr(LOG_ERR,
-			"pmdaFetch: Fetch callback error from metric PMID %s[%d]: %s\n",
-				strbuf, inst, pmErrStr(sts));
-		}
-	    }
-	    else {
-		/*
-		 * PMDA_INTERFACE_2
-		 *	>= 0 => OK
-		 * PMDA_INTERFACE_3 or PMDA_INTERFACE_4
-		 *	== 0 => no values
-		 *	> 0  => OK
-		 * PMDA_INTERFACE_5 or later
-		 *	== 0 (PMDA_FETCH_NOVALUES) => no values
-		 *	== 1 (PMDA_FETCH_STATIC) or > 2 => OK
-		 *	== 2 (PMDA_FETCH_DYNAMIC) => OK and free(atom.vp)
-		 *	     after __pmStuffValue() called
-		 */
-		if ((version == PMDA_INTERFACE_2) || (version >= PMDA_INTERFACE_3 && sts > 0)) {
-
-		    if ((lsts = __pmStuffValue(&atom, &vset->vlist[j], type)) == PM_ERR_TYPE) {
-			pmNotifyErr(LOG_ERR, "pmdaFetch: Descriptor type (%s) for metric %s is bad",
-				    pmTypeStr_r(type, strbuf, sizeof(strbuf)),
-				    pmIDStr_r(dp->pmid, idbuf, sizeof(idbuf)));
-		    }
-		    else if (lsts >= 0) {
-			vset->valfmt = lsts;
-			j++;
-		    }
-		    if (version >= PMDA_INTERFACE_5 && sts == PMDA_FETCH_DYNAMIC) {
-			if (type == PM_TYPE_STRING)
-			    free(atom.cp);
-			else if (type == PM_TYPE_AGGREGATE)
-			    free(atom.vbp);
-			else {
-			    pmNotifyErr(LOG_WARNING, "pmdaFetch: Attempt to free value for metric %s of wrong type %s\n",
-					pmIDStr_r(dp->pmid, idbuf, sizeof(idbuf)),
-					pmTypeStr_r(type, strbuf, sizeof(strbuf)));
-			}
-		    }
-		    if (lsts < 0)
-			sts = lsts;
-		}
-	    }
+	    sts = (*(pmda->e_fetchCallBack))(metap, inst, &atom);
+	    sts = __pmdaFetchValue(version, dp, inst, sts, &atom, vset, &j);
 	} while (dp->indom != PM_INDOM_NULL && __pmdaNextInst(&inst, pmda));
 
 	if (j == 0)
@@ -32,11 +32,16 @@ struct dynamic;
 typedef struct {
     pmdaInterface	*dispatch;	/* back pointer to our pmdaInterface */
     pmResult		*res;		/* high-water allocation for */
-    __pmHashCtl		hashpmids;	/* hashed metrictab lookups */
+    __pmFlatHashCtl	hashpmids;	/* hashed metrictab lookups */
     int			maxnpmids;	/* pmResult for each PMDA */
     int			ndynamics;	/* number of dynamics entries, below */
     struct dynamic	*dynamics;	/* dynamic metric manipulation table */
     void		*privdata;	/* private (user) data for this PMDA */
+    pmdaFetchBatchCallBack fetchBatchCallBack; /* all instances of a metric */
+    int			maxbatch;	/* high-water allocation for */
+    int			*batchinst;	/* batch callback instances, */
+    int			*batchsts;	/* per-instance status and */
+    pmAtomValue		*batchatom;	/* values from pmdaFetch */
 } e_ext_t;
 
 /*
@@ -772,6 +772,20 @@ pmdaSetFetchCallBack(pmdaInterface *dispatch, pmdaFetchCallBack callback)
     }
 }
 
+void
+pmdaSetFetchBatchCallBack(pmdaInterface *dispatch, pmdaFetchBatchCallBack callback)
+{
+    if (HAVE_ANY(dispatch->comm.pmda_interface)) {
+	e_ext_t	*extp = (e_ext_t *)dispatch->version.any.ext->e_ext;
+	extp->fetchBatchCallBack = callback;
+    }
+    else {
+	pmNotifyErr(LOG_CRIT, "Unable to set fetch batch callback for PMDA interface version %d.",
+		     dispatch->comm.pmda_interface);
+	dispatch->status = PM_ERR_GENERIC;
+    }
+}
+
 void
 pmdaSetCheckCallBack(pmdaInterface *dispatch, pmdaCheckCallBack callback)
 {
@@ -479,21 +479,6 @@ pmdaUsageMessage(pmdaOptions *opts)
     pmUsageMessage((pmOptions *)opts);
 }
 
-static __pmHashWalkState
-pmdaHashNodeDelete(const __pmHashNode *tp, void *cp)
-{
-    (void)tp;
-    (void)cp;
-    return PM_HASH_WALK_DELETE_NEXT;
-}
-
-static void
-pmdaHashDelete(__pmHashCtl *hashp)
-{
-    __pmHashWalkCB(pmdaHashNodeDelete, NULL, hashp);
-    __pmHashClear(hashp);
-}
-
 /*
  * Recompute the hash table which maps metric PMIDs to metric table
  * offsets.  Provides an optimised lookup alternative when a direct
@@ -503,7 +488,7 @@ void
 pmdaRehash(pmdaExt *pmda, pmdaMetric *metrics, int nmetrics)
 {
     e_ext_t	*extp = (e_ext_t *)pmda->e_ext;
-    __pmHashCtl *hashp = &extp->hashpmids;
+    __pmFlatHashCtl *hashp = &extp->hashpmids;
     pmdaMetric	*metric;
     char	buf[32];
     int		m;
@@ -512,11 +497,12 @@ pmdaRehash(pmdaExt *pmda, pmdaMetric *metrics, int nmetrics)
     pmda->e_metrics = metrics;
     pmda->e_nmetrics = nmetrics;
 
-    pmdaHashDelete(hashp);
+    __pmFlatHashClear(hashp);
+    __pmFlatHashPreAlloc(nmetrics, hashp);
     for (m = 0; m < pmda->e_nmetrics; m++) {
 	metric = &pmda->e_metrics[m];
 
-	if (__pmHashAdd(metric->m_desc.pmid, metric, hashp) < 0) {
+	if (__pmFlatHashAdd(metric->m_desc.pmid, metric, hashp) < 0) {
 	    pmNotifyErr(LOG_WARNING, "pmdaRehash: PMDA %s: "
 			"Hashed mapping for metrics disabled @ metric[%d] %s\n",
 			pmda->e_name, m,
@@ -532,7 +518,7 @@ pmdaRehash(pmdaExt *pmda, pmdaMetric *metrics, int nmetrics)
     }
     else {
 	pmda->e_flags &= ~PMDA_EXT_FLAG_HASHED;
-	pmdaHashDelete(hashp);
+	__pmFlatHashClear(hashp);
     }
 }
 
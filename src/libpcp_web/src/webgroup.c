@@ -32,13 +32,17 @@ static unsigned int default_timeout;	/* timeout in milliseconds */
 #define DEFAULT_BATCHSIZE 256
 static unsigned int default_batchsize;	/* for groups of metrics */
 
+#define DEFAULT_CACHESIZE (32 * 1024 * 1024)
+static size_t default_cachesize;	/* archive records shared by contexts */
+
 /* constant string keys (initialized during setup) */
 static sds PARAM_HOSTNAME, PARAM_HOSTSPEC, PARAM_CTXNUM, PARAM_CTXID,
            PARAM_POLLTIME, PARAM_PREFIX, PARAM_MNAME, PARAM_MNAMES,
            PARAM_PMIDS, PARAM_PMID, PARAM_INDOM, PARAM_INSTANCE,
            PARAM_INAME, PARAM_MVALUE, PARAM_TARGET, PARAM_EXPR, PARAM_MATCH;
 static sds AUTH_USERNAME, AUTH_PASSWORD;
-static sds EMPTYSTRING, LOCALHOST, WORK_TIMER, POLL_TIMEOUT, BATCHSIZE;
+static sds EMPTYSTRING, LOCALHOST, WORK_TIMER, POLL_TIMEOUT, BATCHSIZE,
+           CACHESIZE;
 
 enum matches { MATCH_EXACT, MATCH_GLOB, MATCH_REGEX };
 enum profile { PROFILE_ADD, PROFILE_DEL };
@@ -46,6 +50,11 @@ enum profile { PROFILE_ADD, PROFILE_DEL };
 enum webgroup_metric {
     WEBGROUP_GC_COUNT,
     WEBGROUP_GC_DROPS,
+    WEBGROUP_CACHE_HITS,
+    WEBGROUP_CACHE_MISSES,
+    WEBGROUP_CACHE_EVICTIONS,
+    WEBGROUP_CACHE_ENTRIES,
+    WEBGROUP_CACHE_BYTES,
     NUM_WEBGROUP_METRIC
 };
 
@@ -307,6 +316,7 @@ webgroup_garbage_collect(struct webgroups *groups)
     dictIterator        *iterator;
     dictEntry           *entry;
     context_t		*cp;
+    __pmLogCacheStats	cache;
     unsigned int	count = 0, drops = 0, garbageset = 0, inactiveset = 0;
 
     if (pmDebugOptions.http || pmDebugOptions.libweb)
@@ -351,6 +361,13 @@ webgroup_garbage_collect(struct webgroups *groups)
     mmv_set(groups->map, groups->metrics[WEBGROUP_GC_DROPS], &drops);
     mmv_set(groups->map, groups->metrics[WEBGROUP_GC_COUNT], &count);
 
+    __pmLogCacheGetStats(&cache);
+    mmv_set(groups->map, groups->metrics[WEBGROUP_CACHE_HITS], &cache.hits);
+    mmv_set(groups->map, groups->metrics[WEBGROUP_CACHE_MISSES], &cache.misses);
+    mmv_set(groups->map, groups->metrics[WEBGROUP_CACHE_EVICTIONS], &cache.evictions);
+    mmv_set(groups->map, groups->metrics[WEBGROUP_CACHE_ENTRIES], &cache.entries);
+    mmv_set(groups->map, groups->metrics[WEBGROUP_CACHE_BYTES], &cache.bytes);
+
     if (pmDebugOptions.http || pmDebugOptions.libweb)
 	fprintf(stderr, "%s: finished [%u drops from %u entries,"
 			" %u garbageset, %u inactiveset]\n",
@@ -2288,6 +2305,7 @@ pmWebGroupSetup(pmWebGroupModule *module)
     WORK_TIMER = sdsnew("pmwebapi.work");
     POLL_TIMEOUT = sdsnew("pmwebapi.timeout");
     BATCHSIZE = sdsnew("pmwebapi.batchsize");
+    CACHESIZE = sdsnew("pmwebapi.cachesize");
     AUTH_USERNAME = sdsnew("auth.username");
     AUTH_PASSWORD = sdsnew("auth.password");
 
@@ -2345,6 +2363,16 @@ pmWebGroupSetConfiguration(pmWebGroupModule *module, dict *config)
 	    default_batchsize = DEFAULT_BATCHSIZE;
     }
 
+    if ((value = dictFetchValue(config, CACHESIZE)) == NULL) {
+	default_cachesize = DEFAULT_CACHESIZE;
+    } else {
+	default_cachesize = strtoull(value, &endnum, 0);
+	if (*endnum != '\0')
+	    default_cachesize = DEFAULT_CACHESIZE;
+    }
+    /* archive contexts of all clients share decoded records */
+    __pmLogCacheSetLimit(default_cachesize);
+
     if (groups) {
 	groups->config = config;
 	return 0;
@@ -2358,6 +2386,8 @@ pmWebGroupSetupMetrics(pmWebGroupModule *module)
     struct webgroups	*groups = webgroups_lookup(module);
     pmAtomValue		**ap;
     pmUnits		nounits = MMV_UNITS(0,0,0,0,0,0);
+    pmUnits		countunits = MMV_UNITS(0,0,1,0,0,0);
+    pmUnits		bytesunits = MMV_UNITS(1,0,0,PM_SPACE_BYTE,0,0);
     void		*map;
 
     if (groups == NULL || groups->registry == NULL)
@@ -2373,11 +2403,46 @@ pmWebGroupSetupMetrics(pmWebGroupModule *module)
 	"contexts dropped in last garbage collection",
 	"Contexts dropped during most recent webgroup garbage collection");
 
+    mmv_stats_add_metric(groups->registry, "archive.cache.hits", 3,
+	MMV_TYPE_U64, MMV_SEM_COUNTER, countunits, MMV_INDOM_NULL,
+	"archive records found in the shared cache",
+	"Archive records read by a context that were found in the cache\n"
+	"of decoded records shared by all archive contexts");
+
+    mmv_stats_add_metric(groups->registry, "archive.cache.misses", 4,
+	MMV_TYPE_U64, MMV_SEM_COUNTER, countunits, MMV_INDOM_NULL,
+	"archive records not found in the shared cache",
+	"Archive records read by a context that were not in the cache of\n"
+	"decoded records shared by all archive contexts, and so were read\n"
+	"from the archive");
+
+    mmv_stats_add_metric(groups->registry, "archive.cache.evictions", 5,
+	MMV_TYPE_U64, MMV_SEM_COUNTER, countunits, MMV_INDOM_NULL,
+	"archive records discarded from the shared cache",
+	"Unused archive records discarded from the shared cache to keep\n"
+	"it within the pmwebapi.cachesize limit");
+
+    mmv_stats_add_metric(groups->registry, "archive.cache.entries", 6,
+	MMV_TYPE_U32, MMV_SEM_INSTANT, countunits, MMV_INDOM_NULL,
+	"archive records in the shared cache",
+	"Number of decoded archive records currently in the shared cache");
+
+    mmv_stats_add_metric(groups->registry, "archive.cache.bytes", 7,
+	MMV_TYPE_U64, MMV_SEM_INSTANT, bytesunits, MMV_INDOM_NULL,
+	"memory used by the shared archive record cache",
+	"Approximate memory held by decoded archive records in the shared\n"
+	"cache, limited by pmwebapi.cachesize");
+
     groups->map = map = mmv_stats_start(groups->registry);
 
     ap = groups->metrics;
     ap[WEBGROUP_GC_DROPS] = mmv_lookup_value_desc(map, "gc.context.scans", NULL);
     ap[WEBGROUP_GC_COUNT] = mmv_lookup_value_desc(map, "gc.context.drops", NULL);
+    ap[WEBGROUP_CACHE_HITS] = mmv_lookup_value_desc(map, "archive.cache.hits", NULL);
+    ap[WEBGROUP_CACHE_MISSES] = mmv_lookup_value_desc(map, "archive.cache.misses", NULL);
+    ap[WEBGROUP_CACHE_EVICTIONS] = mmv_lookup_value_desc(map, "archive.cache.evictions", NULL);
+    ap[WEBGROUP_CACHE_ENTRIES] = mmv_lookup_value_desc(map, "archive.cache.entries", NULL);
+    ap[WEBGROUP_CACHE_BYTES] = mmv_lookup_value_desc(map, "archive.cache.bytes", NULL);
 }
 
 
@@ -2438,6 +2503,7 @@ pmWebGroupClose(pmWebGroupModule *module)
     sdsfree(WORK_TIMER);
     sdsfree(POLL_TIMEOUT);
     sdsfree(BATCHSIZE);
+    sdsfree(CACHESIZE);
     sdsfree(AUTH_USERNAME);
     sdsfree(AUTH_PASSWORD);
 }
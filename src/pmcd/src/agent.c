@@ -36,12 +36,24 @@ waitpid_pmcd(int *status)
 #endif
 }
 
+/* serialise PDU exchanges with pmdaroot from worker threads */
+#ifdef PM_MULTI_THREAD
+static pthread_mutex_t	pmdaroot_lock = PTHREAD_MUTEX_INITIALIZER;
+#else
+void			*pmdaroot_lock;
+#endif
+
 static pid_t
 waitpid_pmdaroot(int *status)
 {
+    pid_t	pid;
+
     if (pmdarootfd <= 0)
 	return (pid_t)-1;
-    return pmdaRootProcessWait(pmdarootfd, (pid_t)-1, status);
+    PM_LOCK(pmdaroot_lock);
+    pid = pmdaRootProcessWait(pmdarootfd, (pid_t)-1, status);
+    PM_UNLOCK(pmdaroot_lock);
+    return pid;
 }
 
 static void
@@ -60,6 +72,11 @@ CleanupAgent(AgentInfo* aPtr, int why, int status)
     int		exit_status = status;
     int		reason = 0;
 
+    if (WorkerCleanupAgent(aPtr, why, status))
+	/* deferred, the main thread will be back */
+	return;
+
+    FlushFetchCache(aPtr);
     if (aPtr->ipcType == AGENT_DSO) {
 	if (aPtr->ipc.dso.dlHandle != NULL) {
 #ifdef HAVE_DLOPEN
@@ -24,6 +24,13 @@ __pmFdSet	clientFds;		/* for client select() */
 
 static int	clientSize;
 
+/* status.changes may be updated from several worker threads at once */
+#ifdef PM_MULTI_THREAD
+static pthread_mutex_t	changes_lock = PTHREAD_MUTEX_INITIALIZER;
+#else
+void			*changes_lock;
+#endif
+
 /*
  * For PMDA_INTERFACE_5 or later PMDAs, post a notification that
  * a context has been closed.
@@ -155,6 +162,8 @@ NewClient(void)
 	    break;
 
     if (i == clientSize) {
+	/* client[] is about to move, so wait for worker threads */
+	WorkerQuiesce();
 	clientSize = clientSize ? clientSize * 2 : MIN_CLIENTS_ALLOC;
 	sz = sizeof(ClientInfo) * clientSize;
 	client = (ClientInfo *) realloc(client, sz);
@@ -238,11 +247,28 @@ MarkStateChanges(unsigned int changes)
 {
     int i;
 
+    PM_LOCK(changes_lock);
     for (i = 0; i < nClients; i++) {
 	if (client[i].status.connected == 0)
 	    continue;
 	client[i].status.changes |= changes;
     }
+    PM_UNLOCK(changes_lock);
+}
+
+/*
+ * Return, and reset, the changes to be reported to a client
+ */
+unsigned int
+ClearStateChanges(ClientInfo *cp)
+{
+    unsigned int	changes;
+
+    PM_LOCK(changes_lock);
+    changes = cp->status.changes;
+    cp->status.changes = 0;
+    PM_UNLOCK(changes_lock);
+    return changes;
 }
 
 int
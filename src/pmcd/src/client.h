@@ -40,7 +40,7 @@ PMCD_DATA extern ClientInfo *client;		/* Array of clients */
 PMCD_DATA extern int	nClients;		/* Number of entries in array */
 extern int		maxClientFd;		/* largest fd for a client */
 extern __pmFdSet	clientFds;		/* for client select() */
-PMCD_DATA extern int	this_client_id;		/* client for current request */
+PMCD_DATA extern PMCD_TLS int this_client_id;	/* client for current request */
 
 /* prototypes */
 extern ClientInfo *AcceptNewClient(int);
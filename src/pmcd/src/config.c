@@ -573,6 +573,7 @@ FreeAgent(AgentInfo *ap)
     int		i;
     char	**argv = NULL;
 
+    FlushFetchCache(ap);
     free(ap->pmDomainLabel);
     if (ap->ipcType == AGENT_DSO) {
 	free(ap->ipc.dso.pathName);
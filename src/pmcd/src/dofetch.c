@@ -17,9 +17,12 @@
 #include "libpcp.h"
 #include "pmcd.h"
 
-/* Freq. histogram: pmids for each agent in current fetch request */
+/*
+ * Freq. histogram: pmids for each agent in current fetch request.
+ * This, and the other scratch space below, is per-thread (see worker.c).
+ */
 
-static int	*aFreq;
+static PMCD_TLS int	*aFreq;
 
 /* Routine to break a list of pmIDs up into sublists of metrics within the
  * same metric domain.  The resulting lists are returned via a pointer to an
@@ -39,12 +42,12 @@ static DomPmidList *
 SplitPmidList(int nPmids, pmID *pmidList)
 {
     int			i, j;
-    static int		*resIndex;	/* resIndex[k] = index of agent[k]'s list in result */
-    static int		nDoms;	/* No. of entries in two tables above */
+    static PMCD_TLS int	*resIndex;	/* resIndex[k] = index of agent[k]'s list in result */
+    static PMCD_TLS int	nDoms;	/* No. of entries in two tables above */
     int			nGood;
-    static int		currentSize;
+    static PMCD_TLS int	currentSize;
     int			resultSize;
-    static DomPmidList	*result;
+    static PMCD_TLS DomPmidList	*result;
     pmID		*resultPmids;
 
     /* Allocate the frequency histogram and array for mapping from agent to
@@ -386,6 +389,331 @@ ExtractState(int i, void *timestamp)
     return (int)byte;
 }
 
+/*
+ * Fetch result sharing (-F).
+ *
+ * When many clients fetch the same metrics from an agent at about the
+ * same time (several pmloggers, pmie and pmproxy all sampling on the
+ * same boundary), each request would otherwise make the PMDA collect
+ * all of the values again.  Instead, a result returned by an agent is
+ * kept for pmcd_fetchcache milliseconds and any request for the same
+ * pmID list, with the same instance profile for that agent's indoms,
+ * is answered from it.  With worker threads (-W), requests that were
+ * waiting on the agent lock while the agent fetch was in progress are
+ * answered the same way, so concurrent fetches are coalesced into a
+ * single agent request.
+ *
+ * Results are only shared between clients with the same credentials
+ * and container if the agent is sent client attributes, results with
+ * event records are never cached (event queues are per-client), and
+ * the pmcd PMDA is excluded as it reports on pmcd and its clients.
+ * Each agent's cache is protected by the agent lock.
+ */
+
+#define FC_MAXENTRIES	8	/* cached results per agent */
+#define FC_PMCD_DOMAIN	2	/* the pmcd PMDA, see pmdas/pmcd */
+
+/* result state for each agent in HandleFetch */
+#define FC_CACHED	0x1	/* result is owned by the cache */
+#define FC_STORE	0x2	/* result may be added to the cache */
+#define FC_AGENT	0x4	/* result came from the agent */
+
+/* return values from FetchCacheLookup */
+#define FC_NONE		0	/* caching not used for this agent */
+#define FC_MISS		1
+#define FC_HIT		2
+#define FC_COALESCED	3	/* hit on a fetch that was in progress */
+
+static const int	fc_attrs[] = {
+    PCP_ATTR_USERNAME, PCP_ATTR_USERID, PCP_ATTR_GROUPID, PCP_ATTR_CONTAINER
+};
+#define FC_NATTRS	(int)(sizeof(fc_attrs) / sizeof(fc_attrs[0]))
+
+typedef struct fetchcache {
+    struct fetchcache	*next;
+    struct timeval	stamp;		/* when the agent returned result */
+    unsigned int	epoch;		/* pmcd_fetchcache_epoch at that time */
+    int			numpmid;
+    pmID		*pmidlist;
+    pmProfile		profile;	/* client profile for agent's indoms */
+    char		*attrs[FC_NATTRS]; /* client identity, if agent uses it */
+    pmResult		*result;
+    int			skeleton;	/* result skeleton allocated here */
+} FetchCache;
+
+#ifdef PM_MULTI_THREAD
+static pthread_mutex_t	fetchcache_lock = PTHREAD_MUTEX_INITIALIZER;
+#else
+void			*fetchcache_lock;
+#endif
+
+static void
+FreeFetchCacheEntry(FetchCache *fcp)
+{
+    int		i;
+
+    for (i = 0; i < fcp->profile.profile_len; i++)
+	free(fcp->profile.profile[i].instances);
+    free(fcp->profile.profile);
+    for (i = 0; i < FC_NATTRS; i++)
+	free(fcp->attrs[i]);
+    if (fcp->result != NULL) {
+	if (fcp->skeleton) {
+	    __pmFreeResultValues(fcp->result);
+	    free(fcp->result);
+	}
+	else
+	    pmFreeResult(fcp->result);
+    }
+    free(fcp->pmidlist);
+    free(fcp);
+}
+
+/*
+ * Discard all cached results for an agent, called with the agent
+ * locked (or quiesced) when it is cleaned up, restarted or stored to.
+ */
+void
+FlushFetchCache(AgentInfo *ap)
+{
+    FetchCache	*fcp;
+
+    while ((fcp = ap->fetchCache) != NULL) {
+	ap->fetchCache = fcp->next;
+	FreeFetchCacheEntry(fcp);
+    }
+}
+
+static char *
+ClientAttr(ClientInfo *cp, int attr)
+{
+    __pmHashNode	*hp;
+
+    if ((hp = __pmHashSearch(attr, &cp->attrs)) == NULL)
+	return NULL;
+    return (char *)hp->data;
+}
+
+static int
+AttrsMatch(FetchCache *fcp, AgentInfo *ap, ClientInfo *cp)
+{
+    char	*value;
+    int		i;
+
+    if ((ap->status.flags & (PDU_FLAG_AUTH|PDU_FLAG_CONTAINER)) == 0)
+	return 1;
+    for (i = 0; i < FC_NATTRS; i++) {
+	value = ClientAttr(cp, fc_attrs[i]);
+	if (value == NULL || fcp->attrs[i] == NULL) {
+	    if (value != fcp->attrs[i])
+		return 0;
+	}
+	else if (strcmp(value, fcp->attrs[i]) != 0)
+	    return 0;
+    }
+    return 1;
+}
+
+static int
+InDomProfileMatch(const pmInDomProfile *a, const pmInDomProfile *b)
+{
+    return a->indom == b->indom && a->state == b->state &&
+	   a->instances_len == b->instances_len &&
+	   (a->instances_len == 0 ||
+	    memcmp(a->instances, b->instances,
+		   a->instances_len * sizeof(a->instances[0])) == 0);
+}
+
+/*
+ * Compare the cached (already domain-filtered) profile with the part
+ * of the client profile that applies to this agent's indoms.
+ */
+static int
+ProfileMatch(const pmProfile *cached, const pmProfile *profile, int domain)
+{
+    int		i, n = 0;
+
+    if (cached->state != profile->state)
+	return 0;
+    for (i = 0; i < profile->profile_len; i++) {
+	if (pmInDom_domain(profile->profile[i].indom) != domain)
+	    continue;
+	if (n >= cached->profile_len ||
+	    !InDomProfileMatch(&cached->profile[n], &profile->profile[i]))
+	    return 0;
+	n++;
+    }
+    return n == cached->profile_len;
+}
+
+static int
+ProfileCopy(pmProfile *dest, const pmProfile *profile, int domain)
+{
+    pmInDomProfile	*ip;
+    size_t		need;
+    int			i, n;
+
+    dest->state = profile->state;
+    dest->profile_len = 0;
+    dest->profile = NULL;
+    for (i = n = 0; i < profile->profile_len; i++)
+	if (pmInDom_domain(profile->profile[i].indom) == domain)
+	    n++;
+    if (n == 0)
+	return 0;
+    if ((dest->profile = (pmInDomProfile *)calloc(n, sizeof(*ip))) == NULL)
+	return -ENOMEM;
+    for (i = 0; i < profile->profile_len; i++) {
+	if (pmInDom_domain(profile->profile[i].indom) != domain)
+	    continue;
+	ip = &dest->profile[dest->profile_len++];
+	*ip = profile->profile[i];
+	ip->instances = NULL;
+	if (ip->instances_len == 0)
+	    continue;
+	need = ip->instances_len * sizeof(ip->instances[0]);
+	if ((ip->instances = (int *)malloc(need)) == NULL)
+	    return -ENOMEM;
+	memcpy(ip->instances, profile->profile[i].instances, need);
+    }
+    return 0;
+}
+
+static int
+FetchCacheable(AgentInfo *ap)
+{
+    return ap->pmDomainId != FC_PMCD_DOMAIN && ap->status.connected &&
+	   !ap->status.fenced && !ap->status.notReady;
+}
+
+/*
+ * Find a result for this request that is no older than the sharing
+ * window, relative to when the request arrived.  Stale entries are
+ * discarded along the way.
+ */
+static int
+FetchCacheLookup(DomPmidList *dp, AgentInfo *ap, ClientInfo *cp,
+		pmProfile *profile, struct timeval *arrival, pmResult **resp)
+{
+    FetchCache	*fcp, *prior = NULL, *next;
+
+    if (pmcd_fetchcache <= 0 || !FetchCacheable(ap)) {
+	FlushFetchCache(ap);
+	return FC_NONE;
+    }
+
+    for (fcp = ap->fetchCache; fcp != NULL; fcp = next) {
+	next = fcp->next;
+	if (fcp->epoch != pmcd_fetchcache_epoch ||
+	    pmtimevalSub(arrival, &fcp->stamp) * 1000 >= pmcd_fetchcache) {
+	    if (prior == NULL)
+		ap->fetchCache = next;
+	    else
+		prior->next = next;
+	    FreeFetchCacheEntry(fcp);
+	    continue;
+	}
+	if (fcp->numpmid == dp->listSize &&
+	    memcmp(fcp->pmidlist, dp->list, dp->listSize * sizeof(pmID)) == 0 &&
+	    ProfileMatch(&fcp->profile, profile, ap->pmDomainId) &&
+	    AttrsMatch(fcp, ap, cp)) {
+	    if (prior != NULL) {
+		/* most recently used to the front */
+		prior->next = next;
+		fcp->next = ap->fetchCache;
+		ap->fetchCache = fcp;
+	    }
+	    *resp = fcp->result;
+	    if (pmtimevalSub(&fcp->stamp, arrival) >= 0)
+		return FC_COALESCED;
+	    return FC_HIT;
+	}
+	prior = fcp;
+    }
+    return FC_MISS;
+}
+
+/*
+ * Add an agent's result to its cache.  Returns 1 if the cache has
+ * taken ownership of the result, else 0 and the caller frees it.
+ */
+static int
+FetchCacheStore(DomPmidList *dp, AgentInfo *ap, ClientInfo *cp,
+		pmProfile *profile, pmResult *result)
+{
+    FetchCache		*fcp, *prior, *next;
+    pmValueSet		*vsp;
+    pmValueBlock	*vbp;
+    size_t		need;
+    char		*value;
+    int			i, j;
+
+    for (i = 0; i < result->numpmid; i++) {
+	vsp = result->vset[i];
+	if (vsp->numval <= 0 || vsp->valfmt == PM_VAL_INSITU)
+	    continue;
+	for (j = 0; j < vsp->numval; j++) {
+	    vbp = vsp->vlist[j].value.pval;
+	    if (vbp->vtype == PM_TYPE_EVENT ||
+		vbp->vtype == PM_TYPE_HIGHRES_EVENT)
+		return 0;
+	}
+    }
+
+    if ((fcp = (FetchCache *)calloc(1, sizeof(*fcp))) == NULL)
+	return 0;
+    need = dp->listSize * sizeof(pmID);
+    if ((fcp->pmidlist = (pmID *)malloc(need)) == NULL)
+	goto fail;
+    memcpy(fcp->pmidlist, dp->list, need);
+    fcp->numpmid = dp->listSize;
+    if (ProfileCopy(&fcp->profile, profile, ap->pmDomainId) < 0)
+	goto fail;
+    if (ap->status.flags & (PDU_FLAG_AUTH|PDU_FLAG_CONTAINER)) {
+	for (i = 0; i < FC_NATTRS; i++) {
+	    if ((value = ClientAttr(cp, fc_attrs[i])) != NULL &&
+		(fcp->attrs[i] = strdup(value)) == NULL)
+		goto fail;
+	}
+    }
+    if (ap->ipcType == AGENT_DSO) {
+	/*
+	 * The DSO owns the result skeleton and reuses it on the next
+	 * fetch, but the value sets are ours ... keep a copy of the
+	 * skeleton pointing to them.
+	 */
+	need = sizeof(pmResult) + (result->numpmid - 1) * sizeof(pmValueSet *);
+	if ((fcp->result = (pmResult *)malloc(need)) == NULL)
+	    goto fail;
+	memcpy(fcp->result, result, need);
+	fcp->skeleton = 1;
+    }
+    else
+	fcp->result = result;
+    pmtimevalNow(&fcp->stamp);
+    fcp->epoch = pmcd_fetchcache_epoch;
+
+    fcp->next = ap->fetchCache;
+    ap->fetchCache = fcp;
+
+    /* drop the least recently used beyond the per-agent limit */
+    for (i = 1, prior = fcp; prior->next != NULL; i++, prior = prior->next) {
+	if (i == FC_MAXENTRIES) {
+	    while ((next = prior->next) != NULL) {
+		prior->next = next->next;
+		FreeFetchCacheEntry(next);
+	    }
+	    break;
+	}
+    }
+    return 1;
+
+fail:
+    fcp->result = NULL;
+    FreeFetchCacheEntry(fcp);
+    return 0;
+}
+
 /*
  * Handle both the original and high resolution fetch PDU requests.
  * The input handling and PMDA interactions are the same, difference
@@ -401,12 +729,15 @@ HandleFetch(ClientInfo *cip, __pmPDU* pb, int pdutype)
     unsigned int	changes = 0;
     int			nPmids;
     pmID		*pmidList;
-    static __pmResult	*endResult = NULL;
-    static int		maxnpmids;	/* sizes endResult */
+    static PMCD_TLS __pmResult	*endResult = NULL;
+    static PMCD_TLS int	maxnpmids;	/* sizes endResult */
     DomPmidList		*dList;		/* NOTE: NOT indexed by agent index */
-    static int		nDoms;
-    static pmResult	**results;	/* array of replies from PMDAs */
-    static int		*resIndex;
+    static PMCD_TLS int	nDoms;
+    static PMCD_TLS pmResult	**results;	/* array of replies from PMDAs */
+    static PMCD_TLS int	*resIndex;
+    static PMCD_TLS int	*rstate;	/* FC_* state of each reply */
+    int			hits = 0, misses = 0, coalesced = 0;
+    struct timeval	arrival;
     __pmFdSet		waitFds;
     __pmFdSet		readyFds;
     int			nWait;
@@ -421,15 +752,20 @@ HandleFetch(ClientInfo *cip, __pmPDU* pb, int pdutype)
 	    free(results);
 	if (resIndex != NULL)
 	    free(resIndex);
+	if (rstate != NULL)
+	    free(rstate);
 	results = (pmResult **)malloc((nAgents + 1) * sizeof (pmResult *));
 	resIndex = (int *)malloc((nAgents + 1) * sizeof(int));
-	if (results == NULL || resIndex == NULL) {
-	    pmNoMem("DoFetch.results", (nAgents + 1) * sizeof (pmResult *) + (nAgents + 1) * sizeof(int), PM_FATAL_ERR);
+	rstate = (int *)malloc((nAgents + 1) * sizeof(int));
+	if (results == NULL || resIndex == NULL || rstate == NULL) {
+	    pmNoMem("DoFetch.results", (nAgents + 1) * sizeof (pmResult *) + 2 * (nAgents + 1) * sizeof(int), PM_FATAL_ERR);
 	    /* NOTREACHED */
 	}
 	nDoms = nAgents;
     }
     memset(results, 0, (nAgents + 1) * sizeof(results[0]));
+    memset(rstate, 0, (nAgents + 1) * sizeof(rstate[0]));
+    pmtimevalNow(&arrival);
 
     /* Both PDUs decode the same way, use variant without retired timestamp */
     sts = __pmDecodeHighResFetch(pb, &ctxnum, &nPmids, &pmidList);
@@ -472,18 +808,43 @@ HandleFetch(ClientInfo *cip, __pmPDU* pb, int pdutype)
 
     dList = SplitPmidList(nPmids, pmidList);
 
+    /* all of the agents are needed together, aFreq[] says which ones */
+    LockAgents(aFreq);
+
     /* For each domain in the split pmidList, dispatch the per-domain subset
-     * of pmIDs to the appropriate agent.  For DSO agents, the pmResult will
-     * come back immediately.  If a request cannot be sent to an agent, a
-     * suitable pmResult (containing metric not available values) will be
-     * returned.
+     * of pmIDs to the appropriate agent, unless a recent enough result can
+     * be shared (-F).  For DSO agents, the pmResult will come back
+     * immediately.  If a request cannot be sent to an agent, a suitable
+     * pmResult (containing metric not available values) will be returned.
      */
     __pmFD_ZERO(&waitFds);
     nWait = 0;
     maxFd = -1;
     for (i = 0; dList[i].domain != -1; i++) {
 	j = mapdom[dList[i].domain];
+	if (!agent[j].status.connected) {
+	    /* failed in another request after SplitPmidList */
+	    results[j] = MakeBadResult(dList[i].listSize, dList[i].list,
+					PM_ERR_NOAGENT);
+	    continue;
+	}
+	switch (FetchCacheLookup(&dList[i], &agent[j], cip, profile,
+				&arrival, &results[j])) {
+	    case FC_COALESCED:
+		coalesced++;
+		/* FALLTHROUGH */
+	    case FC_HIT:
+		hits++;
+		rstate[j] = FC_CACHED;
+		continue;
+	    case FC_MISS:
+		misses++;
+		rstate[j] = FC_STORE;
+		break;
+	}
 	results[j] = SendFetch(&dList[i], &agent[j], cip, ctxnum);
+	if (agent[j].ipcType == AGENT_DSO && !agent[j].status.madeDsoResult)
+	    rstate[j] |= FC_AGENT;
 	if (results[j] == NULL) { /* Wait for agent's response */
 	    int fd = agent[j].outFd;
 	    agent[j].status.busy = 1;
@@ -515,7 +876,9 @@ HandleFetch(ClientInfo *cip, __pmPDU* pb, int pdutype)
 
 		/* Timeout, terminate agents with undelivered results */
 		for (i = 0; i < nAgents; i++) {
-		    if (agent[i].status.busy) {
+		    /* other busy agents may belong to other worker threads */
+		    if (agent[i].status.busy &&
+			__pmFD_ISSET(agent[i].outFd, &waitFds)) {
 			/* Find entry in dList for this agent */
 			for (j = 0; dList[j].domain != -1; j++)
 			    if (dList[j].domain == agent[i].pmDomainId)
@@ -558,6 +921,7 @@ HandleFetch(ClientInfo *cip, __pmPDU* pb, int pdutype)
 		    results[i] = __pmOffsetResult(rp);
 		    if (results[i]->numpmid == aFreq[i]) {
 			changes |= ExtractState(i, &rp->timestamp);
+			rstate[i] |= FC_AGENT;
 		    } else {
 			if (pmDebugOptions.appl0)
 			    pmNotifyErr(LOG_ERR, "DoFetch: \"%s\" agent given %d pmIDs, returned %d\n",
@@ -615,6 +979,22 @@ HandleFetch(ClientInfo *cip, __pmPDU* pb, int pdutype)
     if (changes)
 	MarkStateChanges(changes);
 
+    /* Keep the agents' results for sharing with other requests */
+    for (i = 0; dList[i].domain != -1; i++) {
+	j = mapdom[dList[i].domain];
+	if ((rstate[j] & (FC_STORE|FC_AGENT)) == (FC_STORE|FC_AGENT) &&
+	    agent[j].status.connected &&
+	    FetchCacheStore(&dList[i], &agent[j], cip, profile, results[j]))
+	    rstate[j] |= FC_CACHED;
+    }
+    if (hits || misses) {
+	PM_LOCK(fetchcache_lock);
+	pmcd_fetchcache_hits += hits;
+	pmcd_fetchcache_misses += misses;
+	pmcd_fetchcache_coalesced += coalesced;
+	PM_UNLOCK(fetchcache_lock);
+    }
+
     endResult->numpmid = nPmids;
     __pmGetTimestamp(&endResult->timestamp);
 
@@ -632,12 +1012,11 @@ HandleFetch(ClientInfo *cip, __pmPDU* pb, int pdutype)
     pmcd_trace(TR_XMIT_PDU, cip->fd, pdutype, nPmids);
 
     sts = 0;
-    if (cip->status.changes) {
+    if ((changes = ClearStateChanges(cip)) != 0) {
 	/* notify client of PMCD state change */
-	sts = __pmSendError(cip->fd, FROM_ANON, (int)cip->status.changes);
+	sts = __pmSendError(cip->fd, FROM_ANON, (int)changes);
 	if (sts > 0)
 	    sts = 0;
-	cip->status.changes = 0;
     }
     if (sts == 0)
 	sts = (pdutype == PDU_HIGHRES_FETCH) ?
@@ -654,6 +1033,9 @@ HandleFetch(ClientInfo *cip, __pmPDU* pb, int pdutype)
      */
     for (i = 0; dList[i].domain != -1; i++) {
 	j = mapdom[dList[i].domain];
+	if (rstate[j] & FC_CACHED)
+	    /* owned by the agent's fetch cache */
+	    continue;
 	if (agent[j].ipcType == AGENT_DSO && agent[j].status.connected &&
 	    !agent[j].status.madeDsoResult)
 	    /* Living DSO's manage their own pmResult skeleton unless
@@ -65,7 +65,7 @@ DoText(ClientInfo *cp, __pmPDU* pb)
     if ((sts = __pmDecodeTextReq(pb, &ident, &type)) < 0)
 	return sts;
 
-    if ((ap = pmcd_agent(((__pmID_int *)&ident)->domain)) == NULL)
+    if ((ap = LockAgent(pmcd_agent(((__pmID_int *)&ident)->domain))) == NULL)
 	return PM_ERR_PMID;
     if (!ap->status.connected)
 	return PM_ERR_NOAGENT;
@@ -163,10 +163,11 @@ DoProfile(ClientInfo *cp, __pmPDU *pb)
 	 * agents to which the old profile was last sent
 	 */
 	for (i = 0; i < nAgents; i++) {
-	    AgentInfo	*ap = &agent[i];
+	    AgentInfo	*ap = LockAgent(&agent[i]);
 
 	    if (ap->profClient == cp && ap->profIndex == ctxnum)
 		ap->profClient = NULL;
+	    UnlockAgent(ap);
 	}
     }
     return sts;
@@ -175,12 +176,14 @@ DoProfile(ClientInfo *cp, __pmPDU *pb)
 static int
 GetDescs(ClientInfo *cp, int numpmid, pmID *pmids, pmDesc *descs)
 {
-    AgentInfo	*ap;
+    AgentInfo	*ap = NULL;
     int		i, sts = 0, fdfail;
 
     for (i = 0; i < numpmid; i++) {
 
-	if ((ap = pmcd_agent(((__pmID_int *)&pmids[i])->domain)) == NULL) {
+	/* one agent at a time */
+	UnlockAgent(ap);
+	if ((ap = LockAgent(pmcd_agent(((__pmID_int *)&pmids[i])->domain))) == NULL) {
 	    descs[i].pmid = PM_ID_NULL;
 	    sts = PM_ERR_PMID;
 	    continue;
@@ -256,6 +259,8 @@ GetDescs(ClientInfo *cp, int numpmid, pmID *pmids, pmDesc *descs)
 	}
     }
 
+    UnlockAgent(ap);
+
     /* multi-desc variant handles partial success - bad descs use PM_ID_NULL */
     return numpmid > 1 ? 0 : sts;
 }
@@ -329,7 +334,7 @@ DoInstance(ClientInfo *cp, __pmPDU *pb)
     sts = __pmDecodeInstanceReq(pb, &indom, &inst, &name);
     if (sts < 0)
 	return sts;
-    if ((ap = pmcd_agent(((__pmInDom_int *)&indom)->domain)) == NULL) {
+    if ((ap = LockAgent(pmcd_agent(((__pmInDom_int *)&indom)->domain))) == NULL) {
 	if (name != NULL) free(name);
 	return PM_ERR_INDOM;
     }
@@ -453,6 +458,8 @@ GetContextLabels(ClientInfo *cp, pmLabelSet **sets)
     char		buf[PM_MAXLABELJSONLEN];
     int			sts, flags;
 
+    /* pmcd_labels and the static buffers are shared with the pmcd PMDA */
+    LockDsoAgents();
     if ((sts = GetChangedContextLabels(sets, &labelChanged)) >= 0) {
 	host_label = __pmGetLabelConfigHostName(host, sizeof(host));
 	domain_label = __pmGetLabelConfigDomainName(domain, sizeof(domain));
@@ -529,6 +536,7 @@ DoLabel(ClientInfo *cp, __pmPDU *pb)
 	    return PM_ERR_TYPE;
     }
 
+    LockAgent(ap);
     if (!ap->status.connected)
 	return PM_ERR_NOAGENT;
     if (ap->status.fenced)
@@ -668,7 +676,7 @@ DoPMNSIDs(ClientInfo *cp, __pmPDU *pb)
 	 * failure may be a real failure, or could be a metric within a
 	 * dynamic sutree of the PMNS
 	 */
-	if ((ap = pmcd_agent(((__pmID_int *)&idlist[0])->domain)) == NULL) {
+	if ((ap = LockAgent(pmcd_agent(((__pmID_int *)&idlist[0])->domain))) == NULL) {
 	    sts = PM_ERR_NOAGENT;
 	    goto fail;
 	}
@@ -792,7 +800,8 @@ DoPMNSNames(ClientInfo *cp, __pmPDU *pb)
 	 * an error via lsts
 	 */
 	idlist[i] = PM_ID_NULL;	/* default case if cannot translate */
-	if ((ap = pmcd_agent(domain)) == NULL) {
+	UnlockAgent(ap);	/* one agent at a time */
+	if ((ap = LockAgent(pmcd_agent(domain))) == NULL) {
 	    lsts = PM_ERR_NOAGENT;
 	}
 	else if (!ap->status.connected) {
@@ -875,6 +884,8 @@ DoPMNSNames(ClientInfo *cp, __pmPDU *pb)
 	}
     }
 
+    UnlockAgent(ap);
+
     if (sts < 0)
 	/* fatal error or explicit error in the numids == 1 case */
 	goto done;
@@ -921,7 +932,7 @@ DoPMNSChild(ClientInfo *cp, __pmPDU *pb)
     if (sts == 1 && IS_DYNAMIC_ROOT(idlist[0])) {
 	int		domain = pmID_cluster(idlist[0]);
 	AgentInfo	*ap = NULL;
-	if ((ap = pmcd_agent(domain)) == NULL) {
+	if ((ap = LockAgent(pmcd_agent(domain))) == NULL) {
 	    sts = PM_ERR_NOAGENT;
 	    goto done;
 	}
@@ -1032,11 +1043,11 @@ done:
 
 /*************************************************************************/
 
-static char **travNL;     /* list of names for traversal */
-static char *travNL_ptr;  /* pointer into travNL */
-static int travNL_num;    /* number of names in list */
-static int travNL_strlen; /* number of bytes of names */
-static int travNL_i;      /* array index */
+static PMCD_TLS char **travNL;     /* list of names for traversal */
+static PMCD_TLS char *travNL_ptr;  /* pointer into travNL */
+static PMCD_TLS int travNL_num;    /* number of names in list */
+static PMCD_TLS int travNL_strlen; /* number of bytes of names */
+static PMCD_TLS int travNL_i;      /* array index */
 
 static void
 AddLengths(const char *name)
@@ -1077,6 +1088,7 @@ traverse_dynamic(ClientInfo *cp, char *start, int *num_names, char ***names)
     char	*namelist[1];
     pmID	idlist[1];
     int		fake = 0;
+    AgentInfo	*ap = NULL;
 
     /*
      * if we get any errors in the setup (unexpected), simply skip
@@ -1114,8 +1126,8 @@ traverse_dynamic(ClientInfo *cp, char *start, int *num_names, char ***names)
 	    continue;
 	if (IS_DYNAMIC_ROOT(idlist[0])) {
 	    int		domain = pmID_cluster(idlist[0]);
-	    AgentInfo	*ap;
-	    if ((ap = pmcd_agent(domain)) == NULL)
+	    UnlockAgent(ap);	/* one agent at a time */
+	    if ((ap = LockAgent(pmcd_agent(domain))) == NULL)
 		continue;
 	    if (!ap->status.connected)
 		continue;
@@ -1270,6 +1282,8 @@ traverse_dynamic(ClientInfo *cp, char *start, int *num_names, char ***names)
 	}
     }
 
+    UnlockAgent(ap);
+
     if (fake == 1) {
 	/*
 	 * need to undo initial faking as this name is simply not valid!
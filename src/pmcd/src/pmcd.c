@@ -47,6 +47,8 @@ int		labelChanged;		/* For SIGHUP labels check */
 static int	timeToDie;		/* For SIGINT handling */
 static int	restart;		/* For SIGHUP restart */
 static int	maxReqPortFd;		/* Largest request port fd */
+static int	workerFd = -1;		/* Worker thread requests done */
+static int	agentsLocked;		/* HandleReadyAgents skipped an agent */
 static char	configFileName[MAXPATHLEN]; /* path to pmcd.conf */
 static char	*logfile = "pmcd.log";	/* log file name */
 static int	run_daemon = 1;		/* run as a daemon, see -f */
@@ -111,11 +113,13 @@ static pmLongOptions longopts[] = {
     PMAPI_OPTIONS_HEADER("Configuration options"),
     { "maxctx", 1, 'C', "NCTX", "maximum number of contexts per client [default 64]" },
     { "config", 1, 'c', "PATH", "path to configuration file" },
+    { "fetchcache", 1, 'F', "MSEC", "share PMDA fetch results for up to MSEC milliseconds [default 0]" },
     { "maxbytes", 1, 'L', "BYTES", "maximum size for PDUs from clients [default 65536]" },
     { "maxmetric", 1, 'M', "NMETRIC", "maximum number of metrics per pmFetch from clients [default 32768]" },
     { "", 1, 'q', "TIME", "PMDA initial negotiation timeout (seconds) [default 3]" },
     { "", 1, 't', "TIME", "PMDA response timeout (seconds) [default 5]" },
     { "verify", 0, 'v', 0, "check validity of pmcd configuration, then exit" },
+    { "workers", 1, 'W', "N", "process client requests with N worker threads [default 0]" },
     PMAPI_OPTIONS_HEADER("Connection options"),
     { "interface", 1, 'i', "ADDR", "accept connections on this IP address" },
     { "port", 1, 'p', "N", "accept connections on this port" },
@@ -131,7 +135,7 @@ static pmLongOptions longopts[] = {
 
 static pmOptions opts = {
     .flags = PM_OPTFLAG_POSIX,
-    .short_options = "AC:c:D:fH:i:l:L:M:N:n:p:q:Qs:St:T:U:vx:?",
+    .short_options = "AC:c:D:fF:H:i:l:L:M:N:n:p:q:Qs:St:T:U:vW:x:?",
     .long_options = longopts,
 };
 
@@ -190,6 +194,17 @@ ParseOptions(int argc, char *argv[], int *nports)
 		run_daemon = 0;
 		break;
 
+	    case 'F':	/* fetch result sharing window */
+		val = (int)strtol(opts.optarg, &endptr, 10);
+		if (*endptr != '\0' || val < 0) {
+		    pmprintf("%s: -F requires a non-negative numeric argument\n",
+			pmGetProgname());
+		    opts.errors++;
+		} else {
+		    pmcd_fetchcache = val;
+		}
+		break;
+
 	    case 'i':
 		/* one (of possibly several) interfaces for client requests */
 		__pmServerAddInterface(opts.optarg);
@@ -304,6 +319,17 @@ ParseOptions(int argc, char *argv[], int *nports)
 		verify = 1;
 		break;
 
+	    case 'W':	/* size of worker thread pool */
+		val = (int)strtol(opts.optarg, &endptr, 10);
+		if (*endptr != '\0' || val < 0) {
+		    pmprintf("%s: -W requires a non-negative numeric argument\n",
+			pmGetProgname());
+		    opts.errors++;
+		} else {
+		    pmcd_workers = val;
+		}
+		break;
+
 	    case 'x':
 		fatalfile = opts.optarg;
 		break;
@@ -332,8 +358,14 @@ ParseOptions(int argc, char *argv[], int *nports)
     }
 }
 
+#ifdef PM_MULTI_THREAD
+static pthread_mutex_t	hostname_lock = PTHREAD_MUTEX_INITIALIZER;
+#else
+void			*hostname_lock;
+#endif
+
 static void
-CheckHostnameChange(void)
+DoCheckHostnameChange(void)
 {
     static char	host[MAXHOSTNAMELEN];
     static char	*oldhost = NULL;
@@ -384,139 +416,161 @@ CheckHostnameChange(void)
     }
 }
 
+/* may be called from several worker threads at once */
+static void
+CheckHostnameChange(void)
+{
+    PM_LOCK(hostname_lock);
+    DoCheckHostnameChange();
+    PM_UNLOCK(hostname_lock);
+}
+
 /*
- * Determine which clients (if any) have sent data to the server and handle it
- * as required.
+ * Process one PDU from a client, either from HandleClientInput or in
+ * a worker thread (see worker.c).  Caller unpins the PDU buffer.
  */
 void
-HandleClientInput(__pmFdSet *fdsPtr)
+HandleClientPDU(ClientInfo *cp, __pmPDU *pb)
 {
     int		sts;
-    int		i;
-    __pmPDU	*pb;
-    __pmPDUHdr	*php;
-    ClientInfo	*cp;
+    __pmPDUHdr	*php = (__pmPDUHdr *)pb;
 
-    for (i = 0; i < nClients; i++) {
-	int		pinpdu;
-
-	if (!client[i].status.connected || !__pmFD_ISSET(client[i].fd, fdsPtr))
-	    continue;
+    if (__pmVersionIPC(cp->fd) == UNKNOWN_VERSION && php->type != PDU_CREDS) {
+	/* old V1 client protocol, no longer supported */
+	sts = PM_ERR_IPC;
+	CleanupClient(cp, sts);
+	return;
+    }
 
-	cp = &client[i];
-	this_client_id = i;
+    if (pmDebugOptions.appl3)
+	ShowClients(stderr);
 
-	pinpdu = sts = __pmGetPDU(cp->fd, LIMIT_SIZE, pmcd_timeout, &pb);
-	if (sts > 0) {
-	    pmcd_trace(TR_RECV_PDU, cp->fd, sts, (int)((__psint_t)pb & 0xffffffff));
-	} else {
-	    CleanupClient(cp, sts);
-	    continue;
-	}
+    switch (php->type) {
+	case PDU_PROFILE:
+	    CheckHostnameChange();
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoProfile(cp, pb);
+	    break;
 
-	php = (__pmPDUHdr *)pb;
-	if (__pmVersionIPC(cp->fd) == UNKNOWN_VERSION && php->type != PDU_CREDS) {
-	    /* old V1 client protocol, no longer supported */
-	    sts = PM_ERR_IPC;
-	    CleanupClient(cp, sts);
-	    __pmUnpinPDUBuf(pb);
-	    continue;
-	}
+	case PDU_FETCH:
+	    CheckHostnameChange();
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoFetch(cp, pb);
+	    break;
 
-	if (pmDebugOptions.appl3)
-	    ShowClients(stderr);
+	case PDU_HIGHRES_FETCH:
+	    CheckHostnameChange();
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoHighResFetch(cp, pb);
+	    break;
 
-	switch (php->type) {
-	    case PDU_PROFILE:
-		CheckHostnameChange();
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoProfile(cp, pb);
-		break;
+	case PDU_INSTANCE_REQ:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoInstance(cp, pb);
+	    break;
 
-	    case PDU_FETCH:
-		CheckHostnameChange();
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoFetch(cp, pb);
-		break;
+	case PDU_LABEL_REQ:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoLabel(cp, pb);
+	    break;
 
-	    case PDU_HIGHRES_FETCH:
-		CheckHostnameChange();
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoHighResFetch(cp, pb);
-		break;
+	case PDU_DESC_REQ:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoDesc(cp, pb);
+	    break;
 
-	    case PDU_INSTANCE_REQ:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoInstance(cp, pb);
-		break;
+	case PDU_DESC_IDS:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoDescIDs(cp, pb);
+	    break;
 
-	    case PDU_LABEL_REQ:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoLabel(cp, pb);
-		break;
+	case PDU_TEXT_REQ:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoText(cp, pb);
+	    break;
 
-	    case PDU_DESC_REQ:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoDesc(cp, pb);
-		break;
+	case PDU_RESULT:
+	    sts = (cp->denyOps & PMCD_OP_STORE) ?
+		  PM_ERR_PERMISSION : DoStore(cp, pb);
+	    break;
 
-	    case PDU_DESC_IDS:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoDescIDs(cp, pb);
-		break;
+	case PDU_PMNS_IDS:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoPMNSIDs(cp, pb);
+	    break;
 
-	    case PDU_TEXT_REQ:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoText(cp, pb);
-		break;
+	case PDU_PMNS_NAMES:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoPMNSNames(cp, pb);
+	    break;
 
-	    case PDU_RESULT:
-		sts = (cp->denyOps & PMCD_OP_STORE) ?
-		      PM_ERR_PERMISSION : DoStore(cp, pb);
-		break;
+	case PDU_PMNS_CHILD:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoPMNSChild(cp, pb);
+	    break;
 
-	    case PDU_PMNS_IDS:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoPMNSIDs(cp, pb);
-		break;
+	case PDU_PMNS_TRAVERSE:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoPMNSTraverse(cp, pb);
+	    break;
 
-	    case PDU_PMNS_NAMES:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoPMNSNames(cp, pb);
-		break;
+	case PDU_CREDS:
+	    sts = DoCreds(cp, pb);
+	    break;
 
-	    case PDU_PMNS_CHILD:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoPMNSChild(cp, pb);
-		break;
+	default:
+	    sts = PM_ERR_IPC;
+    }
+    if (sts < 0) {
+	if (pmDebugOptions.appl0)
+	    fprintf(stderr, "PDU:  %s client[%d]: %s\n",
+		__pmPDUTypeStr(php->type), (int)(cp - client), pmErrStr(sts));
+	/* Make sure client still alive before sending. */
+	if (cp->status.connected) {
+	    pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_ERROR, sts);
+	    sts = __pmSendError(cp->fd, FROM_ANON, sts);
+	    if (sts < 0)
+		pmNotifyErr(LOG_ERR, "HandleClientInput: "
+		    "error sending Error PDU to client[%d] %s\n",
+		    (int)(cp - client), pmErrStr(sts));
+	}
+    }
+}
 
-	    case PDU_PMNS_TRAVERSE:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoPMNSTraverse(cp, pb);
-		break;
+/*
+ * Determine which clients (if any) have sent data to the server and handle it
+ * as required.
+ */
+void
+HandleClientInput(__pmFdSet *fdsPtr)
+{
+    int		sts;
+    int		i;
+    __pmPDU	*pb;
+    ClientInfo	*cp;
 
-	    case PDU_CREDS:
-		sts = DoCreds(cp, pb);
-		break;
+    for (i = 0; i < nClients; i++) {
+	if (!client[i].status.connected || !__pmFD_ISSET(client[i].fd, fdsPtr))
+	    continue;
 
-	    default:
-		sts = PM_ERR_IPC;
+	cp = &client[i];
+	if (pmcd_workers > 0) {
+	    /* read and processed by a worker thread */
+	    WorkerDispatch(cp);
+	    continue;
 	}
-	if (sts < 0) {
-	    if (pmDebugOptions.appl0)
-		fprintf(stderr, "PDU:  %s client[%d]: %s\n",
-		    __pmPDUTypeStr(php->type), i, pmErrStr(sts));
-	    /* Make sure client still alive before sending. */
-	    if (cp->status.connected) {
-		pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_ERROR, sts);
-		sts = __pmSendError(cp->fd, FROM_ANON, sts);
-		if (sts < 0)
-		    pmNotifyErr(LOG_ERR, "HandleClientInput: "
-			"error sending Error PDU to client[%d] %s\n", i, pmErrStr(sts));
-	    }
+	this_client_id = i;
+
+	sts = __pmGetPDU(cp->fd, LIMIT_SIZE, pmcd_timeout, &pb);
+	if (sts > 0) {
+	    pmcd_trace(TR_RECV_PDU, cp->fd, sts, (int)((__psint_t)pb & 0xffffffff));
+	} else {
+	    CleanupClient(cp, sts);
+	    continue;
 	}
-	if (pinpdu > 0)
-	    __pmUnpinPDUBuf(pb);
+
+	HandleClientPDU(cp, pb);
+	__pmUnpinPDUBuf(pb);
 
 	/*
 	 * May need to send connection attributes to interested PMDAs, if
@@ -721,6 +775,17 @@ HandleReadyAgents(__pmFdSet *readyFds)
 
     for (i = 0; i < nAgents; i++) {
 	ap = &agent[i];
+	if (!ap->status.notReady || !__pmFD_ISSET(ap->outFd, readyFds))
+	    continue;
+	/*
+	 * a worker thread may have been using the agent, so check again,
+	 * but do not wait behind a request ... if the agent is locked,
+	 * the fd stays readable and it is picked up on a later pass
+	 */
+	if (TryLockAgent(ap) == NULL) {
+	    agentsLocked = 1;
+	    continue;
+	}
 	if (ap->status.notReady) {
 	    fd = ap->outFd;
 	    if (__pmFD_ISSET(fd, readyFds)) {
@@ -770,6 +835,7 @@ HandleReadyAgents(__pmFdSet *readyFds)
 		    CleanupAgent(ap, reason, fd);
 	    }
 	}
+	UnlockAgent(ap);
     }
     return ready;
 }
@@ -852,8 +918,11 @@ CheckNewClient(__pmFdSet *fdset, int rfd, int family)
 	        sts = s;
 	    accepted = 0;
 	}
-	if (!accepted)
+	if (!accepted) {
+	    /* talks to every agent, so wait for worker threads */
+	    WorkerQuiesce();
 	    CleanupClient(cp, sts);
+	}
     }
 }
 
@@ -865,6 +934,7 @@ ClientLoop(void)
     int		i, fd, sts;
     int		maxFd;
     int		checkAgents;
+    int		waitWorkers;
     int		reload_namespace = 0;
     int		restartAgents = -1;	/* initial state unknown */
     __pmFdSet	readableFds;
@@ -876,12 +946,21 @@ ClientLoop(void)
 	 */
 	readableFds = clientFds;
 	maxFd = maxClientFd + 1;
+	if (workerFd >= 0) {
+	    __pmFD_SET(workerFd, &readableFds);
+	    if (workerFd >= maxFd)
+		maxFd = workerFd + 1;
+	}
 
 	/* If an agent was not ready, it may send an ERROR PDU to indicate it
 	 * is now ready.  Add such agents to the list of file descriptors.
+	 * If a worker thread had one of them locked last time around, leave
+	 * them out until a request completes, rather than spinning here.
 	 */
 	checkAgents = 0;
-	for (i = 0; i < nAgents; i++) {
+	waitWorkers = agentsLocked && WorkerPending();
+	agentsLocked = 0;
+	for (i = 0; i < nAgents && !waitWorkers; i++) {
 	    AgentInfo	*ap = &agent[i];
 
 	    if (ap->status.notReady) {
@@ -908,12 +987,18 @@ ClientLoop(void)
 	    if (checkAgents)
 		reload_namespace = HandleReadyAgents(&readableFds);
 	    HandleClientInput(&readableFds);
+	    WorkerDone();
 	}
 	else if (sts == -1 && neterror() != EINTR) {
 	    pmNotifyErr(LOG_ERR, "ClientLoop select: %s\n", netstrerror());
 	    break;
 	}
+	/*
+	 * from here on, the worker threads (if any) must be idle before
+	 * anything is changed
+	 */
 	if (AgentDied) {
+	    WorkerQuiesce();
 	    if (restartAgents == -1) {
 		char *args;
 
@@ -938,19 +1023,23 @@ ClientLoop(void)
 	    }
 	}
 	if (restart) {
+	    WorkerQuiesce();
 	    restart = 0;
 	    reload_namespace = 1;
 	    SignalRestart();
 	}
 	if (reload_namespace) {
+	    WorkerQuiesce();
 	    reload_namespace = 0;
 	    SignalReloadPMNS();
 	}
 	if (labelChanged) {
+	    WorkerQuiesce();
 	    labelChanged = 0;
 	    SignalReloadLabels();
 	}
 	if (timeToDie) {
+	    WorkerQuiesce();
 	    SignalShutdown();
 	    break;
 	}
@@ -1217,6 +1306,8 @@ main(int argc, char *argv[])
     fprintf(stderr, "\npmcd: PID = %" FMT_PID, pmcd_pid);
     fprintf(stderr, ", PDU version = %u\n", PDU_VERSION);
     __pmServerDumpRequestPorts(stderr);
+    if ((workerFd = WorkerInit()) >= 0)
+	fprintf(stderr, "pmcd: %d worker threads\n", pmcd_workers);
     fflush(stderr);
 
     /* all the work is done here */
@@ -1286,6 +1377,10 @@ CleanupClient(ClientInfo *cp, int sts)
     int		i, msg;
     int		force;
 
+    if (WorkerCleanupClient(cp, sts))
+	/* in a worker thread, the main thread will finish the job */
+	return;
+
     force = pmDebugOptions.appl3;
 
     if (sts != 0 || force) {
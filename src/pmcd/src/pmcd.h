@@ -36,6 +36,17 @@
 # endif
 #endif
 
+/*
+ * Per-request state that is thread-local when pmcd is built with
+ * support for a pool of worker threads (-W), see worker.c
+ */
+#if defined(PM_MULTI_THREAD) && defined(HAVE___THREAD) && !defined(IS_MINGW)
+# define PMCD_WORKERS 1
+# define PMCD_TLS __thread
+#else
+# define PMCD_TLS
+#endif
+
 #include "client.h"
 
 /*
@@ -102,6 +113,7 @@ typedef struct {
 	SocketInfo socket;
 	PipeInfo   pipe;
     } ipc;
+    struct fetchcache *fetchCache;	/* Recent fetch results (-F) */
 } AgentInfo;
 
 PMCD_DATA extern AgentInfo	*agent;		/* Array of domain agent structs */
@@ -236,10 +248,31 @@ extern void ParseRestartAgents(char *);
 extern void PrintAgentInfo(FILE *);
 extern void CheckLabelChange(void);
 extern void MarkStateChanges(unsigned int);
+extern unsigned int ClearStateChanges(ClientInfo *);
 extern void CleanupClient(ClientInfo *, int);
+extern void HandleClientPDU(ClientInfo *, __pmPDU *);
 extern int ClientsAttributes(AgentInfo *);
 extern int AgentsAttributes(int);
 extern int CheckError(AgentInfo *, int);
+extern void FlushFetchCache(AgentInfo *);
+
+/*
+ * Worker thread pool (-W) and agent serialisation, see worker.c
+ */
+extern int	pmcd_workers;		/* number of worker threads */
+extern int WorkerInit(void);
+extern void WorkerDispatch(ClientInfo *);
+extern void WorkerQuiesce(void);
+extern int WorkerPending(void);
+extern void WorkerDone(void);
+extern int WorkerCleanupClient(ClientInfo *, int);
+extern int WorkerCleanupAgent(AgentInfo *, int, int);
+extern AgentInfo *LockAgent(AgentInfo *);
+extern AgentInfo *TryLockAgent(AgentInfo *);
+extern void UnlockAgent(AgentInfo *);
+extern void LockAgents(int *);
+extern void LockDsoAgents(void);
+extern void UnlockAgents(void);
 
 /*
  * Highest known file descriptor used for a Client or an Agent connection.
@@ -268,4 +301,11 @@ PMCD_DATA extern int pmcd_seqnum;
 /* Flag indicating whether agents are currently fenced */
 PMCD_DATA extern int pmcd_fenced;
 
+/* Fetch result sharing window (msec) from -F, and its statistics */
+PMCD_DATA extern int pmcd_fetchcache;
+PMCD_DATA extern unsigned pmcd_fetchcache_epoch;
+PMCD_DATA extern __uint64_t pmcd_fetchcache_hits;
+PMCD_DATA extern __uint64_t pmcd_fetchcache_misses;
+PMCD_DATA extern __uint64_t pmcd_fetchcache_coalesced;
+
 #endif /* _PMCD_H */
@@ -0,0 +1,593 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * Optional pool of worker threads for client requests (pmcd -W).
+ *
+ * The main thread (ClientLoop) still does all of the select(2) work: it
+ * accepts new clients and handles agents that were not ready.  When a
+ * client socket becomes readable, the fd is removed from clientFds and
+ * the client is queued for a worker, which reads the PDU and calls the
+ * appropriate Do*() routine.  The main thread puts the fd back into
+ * clientFds once the worker is finished (WorkerDone), so there is at most
+ * one request in progress for each client, and each client's requests
+ * are processed in order.
+ *
+ * Daemon PMDAs are serialised with a mutex per agent.  DSO PMDAs share
+ * a single mutex, as libpcp_pmda keeps process-wide state for all of the
+ * DSOs loaded into pmcd.  The Do*() routines call LockAgent() before they
+ * look at the agent's state, and the locks are held until the request is
+ * finished (UnlockAgents), except where a request visits agents one at a
+ * time.  The lock order is the DSO mutex, then daemon PMDAs in agent[]
+ * order, and LockAgents() is used when a request needs more than one
+ * agent at the same time (pmFetch).
+ *
+ * Everything else that changes the client[] or agent[] tables, the PMNS
+ * or state shared by all clients (growing client[], credentials, pmStore,
+ * client cleanup, SIGHUP, agent restarts and shutdown) is done by the
+ * main thread after WorkerQuiesce() has waited for all of the queued
+ * requests to finish.  A PDU_CREDS or PDU_RESULT (pmStore) request is
+ * passed back to the main thread for this reason.
+ *
+ * An agent that fails during a worker's request is only marked as no
+ * longer connected (WorkerCleanupAgent), so no other request uses it,
+ * and CleanupAgent() is called later by the main thread, which may be
+ * selecting on the agent's file descriptors and is the one that reaps
+ * PMDA processes.  The main thread never waits for an agent's lock
+ * while the workers are busy, it uses TryLockAgent() and comes back
+ * to the agent when the next request completes.
+ */
+
+#include "pmcd.h"
+#include <fcntl.h>
+#include <signal.h>
+
+int		pmcd_workers;		/* -W: number of worker threads */
+
+#ifdef PMCD_WORKERS
+
+typedef struct WorkerJob {
+    struct WorkerJob	*next;
+    int			client;		/* index into client[] */
+    unsigned int	seq;		/* client[].seq when queued */
+    int			cleanup;	/* CleanupClient() for main thread */
+    int			sts;		/* ... and its status */
+    __pmPDU		*pb;		/* PDU for main thread, or NULL */
+} WorkerJob;
+
+static pthread_mutex_t	pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	pool_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	pool_idle = PTHREAD_COND_INITIALIZER;
+static WorkerJob	*queue_head;	/* waiting for a worker */
+static WorkerJob	*queue_tail;
+static WorkerJob	*done_head;	/* waiting for the main thread */
+static int		outstanding;	/* queued or in progress */
+static int		wakefd[2] = { -1, -1 };	/* wakes up ClientLoop */
+
+static pthread_mutex_t	dso_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t	**agent_lock;	/* one per agent[] slot */
+static int		nagent_lock;
+
+typedef struct {
+    int			why;		/* AT_* for CleanupAgent, 0 if none */
+    int			status;
+} DeadAgent;
+
+static DeadAgent	*dead;		/* one per agent[] slot, pool_lock */
+static int		ndead;		/* agents waiting for CleanupAgent */
+
+static PMCD_TLS WorkerJob	*self;		/* request for this worker */
+static PMCD_TLS int		dso_held;	/* dso_lock is held */
+static PMCD_TLS char		*held;		/* agent_lock[i] is held */
+static PMCD_TLS int		nheld;		/* size of held[] */
+
+/*
+ * Make sure there is a mutex for each agent[] entry ... the agent table
+ * only grows at startup or after a SIGHUP, and the locks are only ever
+ * added to, with all of the workers idle.
+ */
+static void
+GrowAgentLocks(void)
+{
+    pthread_mutex_t	**tmp;
+    DeadAgent		*dtmp;
+    int			i, need;
+
+    if (nAgents <= nagent_lock)
+	return;
+    WorkerQuiesce();
+    need = nAgents * sizeof(agent_lock[0]);
+    if ((tmp = (pthread_mutex_t **)realloc(agent_lock, need)) == NULL) {
+	pmNoMem("GrowAgentLocks", need, PM_FATAL_ERR);
+	/* NOTREACHED */
+    }
+    agent_lock = tmp;
+    need = nAgents * sizeof(dead[0]);
+    if ((dtmp = (DeadAgent *)realloc(dead, need)) == NULL) {
+	pmNoMem("GrowAgentLocks", need, PM_FATAL_ERR);
+	/* NOTREACHED */
+    }
+    dead = dtmp;
+    memset(&dead[nagent_lock], 0, (nAgents - nagent_lock) * sizeof(dead[0]));
+    for (i = nagent_lock; i < nAgents; i++) {
+	if ((agent_lock[i] = malloc(sizeof(pthread_mutex_t))) == NULL) {
+	    pmNoMem("GrowAgentLocks", sizeof(pthread_mutex_t), PM_FATAL_ERR);
+	    /* NOTREACHED */
+	}
+	pthread_mutex_init(agent_lock[i], NULL);
+    }
+    nagent_lock = nAgents;
+}
+
+static AgentInfo *
+AgentLock(AgentInfo *ap, int wait)
+{
+    int		i;
+
+    if (ap == NULL || pmcd_workers <= 0)
+	return ap;
+    if (ap->ipcType == AGENT_DSO) {
+	if (!dso_held) {
+	    if (wait)
+		PM_LOCK(dso_lock);
+	    else if (pthread_mutex_trylock(&dso_lock) != 0)
+		return NULL;
+	    dso_held = 1;
+	}
+	return ap;
+    }
+    i = ap - agent;
+    if (i >= nagent_lock)
+	/* only the main thread can get here, after a SIGHUP */
+	GrowAgentLocks();
+    if (i >= nheld) {
+	char	*tmp;
+
+	if ((tmp = (char *)realloc(held, nagent_lock)) == NULL) {
+	    pmNoMem("LockAgent", nagent_lock, PM_FATAL_ERR);
+	    /* NOTREACHED */
+	}
+	memset(&tmp[nheld], 0, nagent_lock - nheld);
+	held = tmp;
+	nheld = nagent_lock;
+    }
+    if (!held[i]) {
+	if (wait)
+	    PM_LOCK(*agent_lock[i]);
+	else if (pthread_mutex_trylock(agent_lock[i]) != 0)
+	    return NULL;
+	held[i] = 1;
+    }
+    return ap;
+}
+
+/*
+ * Lock an agent for the current request, returns the agent so this
+ * can be wrapped around a pmcd_agent() lookup.
+ */
+AgentInfo *
+LockAgent(AgentInfo *ap)
+{
+    return AgentLock(ap, 1);
+}
+
+/*
+ * As for LockAgent(), but returns NULL rather than waiting if a
+ * worker has the agent locked ... for the main thread.
+ */
+AgentInfo *
+TryLockAgent(AgentInfo *ap)
+{
+    return AgentLock(ap, 0);
+}
+
+void
+UnlockAgent(AgentInfo *ap)
+{
+    int		i;
+
+    if (ap == NULL || pmcd_workers <= 0)
+	return;
+    if (ap->ipcType == AGENT_DSO) {
+	if (dso_held) {
+	    dso_held = 0;
+	    PM_UNLOCK(dso_lock);
+	}
+	return;
+    }
+    i = ap - agent;
+    if (i < nheld && held[i]) {
+	held[i] = 0;
+	PM_UNLOCK(*agent_lock[i]);
+    }
+}
+
+/*
+ * Lock all of the agents that are needed at the same time for one
+ * request, want[] has an entry for each agent[], non-zero if needed.
+ * Must be called with no agents locked.
+ */
+void
+LockAgents(int *want)
+{
+    int		i;
+
+    if (pmcd_workers <= 0)
+	return;
+    for (i = 0; i < nAgents; i++) {
+	if (want[i] && agent[i].ipcType == AGENT_DSO) {
+	    LockAgent(&agent[i]);
+	    break;
+	}
+    }
+    for (i = 0; i < nAgents; i++) {
+	if (want[i] && agent[i].ipcType != AGENT_DSO)
+	    LockAgent(&agent[i]);
+    }
+}
+
+/*
+ * Lock out the DSO PMDAs, e.g. while changing state that the pmcd
+ * PMDA exports (pmcd_labels).
+ */
+void
+LockDsoAgents(void)
+{
+    if (pmcd_workers <= 0 || dso_held)
+	return;
+    PM_LOCK(dso_lock);
+    dso_held = 1;
+}
+
+/* Release all agents locked for the current request */
+void
+UnlockAgents(void)
+{
+    int		i;
+
+    if (pmcd_workers <= 0)
+	return;
+    for (i = nheld - 1; i >= 0; i--) {
+	if (held[i]) {
+	    held[i] = 0;
+	    PM_UNLOCK(*agent_lock[i]);
+	}
+    }
+    if (dso_held) {
+	dso_held = 0;
+	PM_UNLOCK(dso_lock);
+    }
+}
+
+/*
+ * CleanupClient() changes the client[] table and talks to every agent,
+ * so when called from a worker this is deferred to the main thread.
+ */
+int
+WorkerCleanupClient(ClientInfo *cp, int sts)
+{
+    if (self == NULL)
+	return 0;
+    if (!self->cleanup) {
+	self->cleanup = 1;
+	self->sts = sts;
+    }
+    return 1;
+}
+
+/*
+ * CleanupAgent() closes the agent's file descriptors and reaps the
+ * PMDA process, so when called from a worker the agent (locked by
+ * this worker) is only marked as no longer connected here, and the
+ * main thread finishes off the cleanup (CleanupDeadAgents).
+ */
+int
+WorkerCleanupAgent(AgentInfo *ap, int why, int status)
+{
+    int		i = ap - agent;
+
+    if (self == NULL)
+	return 0;
+    ap->status.connected = 0;
+    ap->status.busy = 0;
+    ap->status.notReady = 0;
+    PM_LOCK(pool_lock);
+    if (dead[i].why == 0) {
+	dead[i].why = why;
+	dead[i].status = status;
+	ndead++;
+    }
+    PM_UNLOCK(pool_lock);
+    return 1;
+}
+
+/*
+ * Main thread cleanup for agents that failed in a worker.  Unless the
+ * workers are idle, skip any agent another request still has locked.
+ */
+static void
+CleanupDeadAgents(int idle)
+{
+    AgentInfo	*ap;
+    int		i, why, status;
+
+    for (i = 0; i < nagent_lock && ndead > 0; i++) {
+	PM_LOCK(pool_lock);
+	why = dead[i].why;
+	status = dead[i].status;
+	PM_UNLOCK(pool_lock);
+	if (why == 0)
+	    continue;
+	ap = &agent[i];
+	if (!idle && TryLockAgent(ap) == NULL)
+	    continue;
+	PM_LOCK(pool_lock);
+	dead[i].why = 0;
+	ndead--;
+	PM_UNLOCK(pool_lock);
+	CleanupAgent(ap, why, status);
+	if (!idle)
+	    UnlockAgent(ap);
+    }
+}
+
+static void
+WorkerRequest(WorkerJob *jp)
+{
+    ClientInfo	*cp = &client[jp->client];
+    __pmPDU	*pb;
+    int		sts;
+
+    this_client_id = jp->client;
+    sts = __pmGetPDU(cp->fd, LIMIT_SIZE, pmcd_timeout, &pb);
+    if (sts > 0) {
+	pmcd_trace(TR_RECV_PDU, cp->fd, sts, (int)((__psint_t)pb & 0xffffffff));
+    } else {
+	CleanupClient(cp, sts);
+	return;
+    }
+
+    if (sts == PDU_CREDS || sts == PDU_RESULT)
+	/* not safe here, leave this one for the main thread */
+	jp->pb = pb;
+    else {
+	HandleClientPDU(cp, pb);
+	__pmUnpinPDUBuf(pb);
+    }
+}
+
+static void *
+Worker(void *arg)
+{
+    WorkerJob	*jp;
+
+    for ( ; ; ) {
+	PM_LOCK(pool_lock);
+	while ((jp = queue_head) == NULL)
+	    pthread_cond_wait(&pool_work, &pool_lock);
+	if ((queue_head = jp->next) == NULL)
+	    queue_tail = NULL;
+	PM_UNLOCK(pool_lock);
+
+	self = jp;
+	WorkerRequest(jp);
+	UnlockAgents();
+	self = NULL;
+
+	PM_LOCK(pool_lock);
+	jp->next = done_head;
+	done_head = jp;
+	if (--outstanding == 0)
+	    pthread_cond_signal(&pool_idle);
+	PM_UNLOCK(pool_lock);
+	if (write(wakefd[1], "", 1) < 0 && oserror() != EAGAIN)
+	    pmNotifyErr(LOG_ERR, "Worker: wakeup write failed: %s\n",
+			osstrerror());
+    }
+    return NULL;
+}
+
+/*
+ * Start the worker threads, returns a file descriptor for ClientLoop
+ * to select on (readable when requests have completed), else -1 if
+ * there are no workers.
+ */
+int
+WorkerInit(void)
+{
+    pthread_t	tid;
+    sigset_t	all, saved;
+    int		i, sts;
+
+    if (pmcd_workers <= 0)
+	return -1;
+
+    if (pipe(wakefd) < 0) {
+	pmNotifyErr(LOG_ERR, "WorkerInit: pipe: %s, worker threads disabled\n",
+			osstrerror());
+	pmcd_workers = 0;
+	return -1;
+    }
+    for (i = 0; i < 2; i++) {
+	fcntl(wakefd[i], F_SETFL, fcntl(wakefd[i], F_GETFL) | O_NONBLOCK);
+	fcntl(wakefd[i], F_SETFD, FD_CLOEXEC);
+    }
+    GrowAgentLocks();
+
+    /* signals are handled by the main thread in ClientLoop */
+    sigfillset(&all);
+    sigdelset(&all, SIGSEGV);
+    sigdelset(&all, SIGBUS);
+    sigdelset(&all, SIGFPE);
+    sigdelset(&all, SIGILL);
+    pthread_sigmask(SIG_BLOCK, &all, &saved);
+    for (i = 0; i < pmcd_workers; i++) {
+	if ((sts = pthread_create(&tid, NULL, Worker, NULL)) != 0) {
+	    pmNotifyErr(LOG_ERR, "WorkerInit: pthread_create: %s\n",
+			pmErrStr(-sts));
+	    break;
+	}
+	pthread_detach(tid);
+    }
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+    if ((pmcd_workers = i) == 0) {
+	close(wakefd[0]);
+	close(wakefd[1]);
+	wakefd[0] = wakefd[1] = -1;
+	return -1;
+    }
+    return wakefd[0];
+}
+
+/* Queue a request from a client whose socket is readable */
+void
+WorkerDispatch(ClientInfo *cp)
+{
+    WorkerJob	*jp;
+
+    GrowAgentLocks();
+    if ((jp = (WorkerJob *)calloc(1, sizeof(*jp))) == NULL) {
+	pmNoMem("WorkerDispatch", sizeof(*jp), PM_FATAL_ERR);
+	/* NOTREACHED */
+    }
+    jp->client = cp - client;
+    jp->seq = cp->seq;
+    __pmFD_CLR(cp->fd, &clientFds);
+
+    PM_LOCK(pool_lock);
+    if (queue_tail)
+	queue_tail->next = jp;
+    else
+	queue_head = jp;
+    queue_tail = jp;
+    outstanding++;
+    pthread_cond_signal(&pool_work);
+    PM_UNLOCK(pool_lock);
+}
+
+/*
+ * Wait until all queued requests have been completed, and clean up
+ * any agents that failed in the meantime.
+ */
+void
+WorkerQuiesce(void)
+{
+    if (pmcd_workers <= 0)
+	return;
+    PM_LOCK(pool_lock);
+    while (outstanding > 0)
+	pthread_cond_wait(&pool_idle, &pool_lock);
+    PM_UNLOCK(pool_lock);
+    if (ndead > 0)
+	CleanupDeadAgents(1);
+}
+
+/*
+ * Are any requests queued or in progress?  If so, workerFd will become
+ * readable when one of them completes.
+ */
+int
+WorkerPending(void)
+{
+    int		sts;
+
+    if (pmcd_workers <= 0)
+	return 0;
+    PM_LOCK(pool_lock);
+    sts = (outstanding > 0);
+    PM_UNLOCK(pool_lock);
+    return sts;
+}
+
+/*
+ * Main thread processing for completed requests, put the client
+ * back into clientFds or finish off anything the worker could not do.
+ */
+void
+WorkerDone(void)
+{
+    WorkerJob	*jp, *next;
+    ClientInfo	*cp;
+    char	buf[64];
+
+    if (pmcd_workers <= 0)
+	return;
+    while (read(wakefd[0], buf, sizeof(buf)) > 0)
+	;
+    PM_LOCK(pool_lock);
+    jp = done_head;
+    done_head = NULL;
+    PM_UNLOCK(pool_lock);
+
+    for ( ; jp != NULL; jp = next) {
+	next = jp->next;
+	cp = &client[jp->client];
+	if (!cp->status.connected || cp->seq != jp->seq) {
+	    /* client has gone away in the meantime */
+	    if (jp->pb)
+		__pmUnpinPDUBuf(jp->pb);
+	}
+	else if (jp->cleanup) {
+	    WorkerQuiesce();
+	    CleanupClient(cp, jp->sts);
+	}
+	else {
+	    if (jp->pb) {
+		WorkerQuiesce();
+		this_client_id = jp->client;
+		HandleClientPDU(cp, jp->pb);
+		__pmUnpinPDUBuf(jp->pb);
+		UnlockAgents();
+	    }
+	    if (cp->status.connected && cp->status.attributes) {
+		WorkerQuiesce();
+		if (pmDebugOptions.appl5)
+		    fprintf(stderr, "Client idx=%d,seq=%d attrs reset\n",
+				    jp->client, cp->seq);
+		AgentsAttributes(jp->client);
+	    }
+	    if (cp->status.connected)
+		__pmFD_SET(cp->fd, &clientFds);
+	}
+	free(jp);
+    }
+    if (ndead > 0)
+	CleanupDeadAgents(0);
+}
+
+#else /* !PMCD_WORKERS */
+
+int
+WorkerInit(void)
+{
+    if (pmcd_workers > 0) {
+	pmNotifyErr(LOG_WARNING, "worker threads not supported, -W ignored\n");
+	pmcd_workers = 0;
+    }
+    return -1;
+}
+
+void WorkerDispatch(ClientInfo *cp) { }
+void WorkerQuiesce(void) { }
+int WorkerPending(void) { return 0; }
+void WorkerDone(void) { }
+int WorkerCleanupClient(ClientInfo *cp, int sts) { return 0; }
+int WorkerCleanupAgent(AgentInfo *ap, int why, int status) { return 0; }
+AgentInfo *LockAgent(AgentInfo *ap) { return ap; }
+AgentInfo *TryLockAgent(AgentInfo *ap) { return ap; }
+void UnlockAgent(AgentInfo *ap) { }
+void LockAgents(int *want) { }
+void LockDsoAgents(void) { }
+void UnlockAgents(void) { }
+
+#endif /* PMCD_WORKERS */
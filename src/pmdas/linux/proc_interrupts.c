@@ -15,6 +15,7 @@
 #include "linux.h"
 #include "filesys.h"
 #include "proc_interrupts.h"
+#include "procscan.h"
 #include <sys/stat.h>
 #include <ctype.h>
 
@@ -53,17 +54,13 @@ setup_buffers(void)
 static int
 map_online_cpus(char *buffer)
 {
-    unsigned int i = 0, cpuid;
-    char *s, *end;
+    unsigned int i = 0;
+    char *s;
 
     for (s = buffer; i < _pm_ncpus && *s != '\0'; s++) {
 	if (!isdigit((int)*s))
 	    continue;
-	cpuid = (unsigned int)strtoul(s, &end, 10);
-	if (end == s)
-	    break;
-	online_cpumap[i++].cpuid = cpuid;
-	s = end;
+	online_cpumap[i++].cpuid = (unsigned int)scan_ull(&s);
     }
     return i;
 }
@@ -124,18 +121,33 @@ extract_interrupt_name(char *buffer, char **suffix)
     return s;
 }
 
+/* a "NAME: count" line, with NAME at the very start of the buffer */
+static int
+extract_interrupt_count(char *buffer, const char *name, unsigned int *count)
+{
+    unsigned long long value;
+
+    if (strncmp(buffer, name, 3) != 0 || buffer[3] != ':')
+	return 0;
+    buffer += 4;
+    if (!scan_u64(&buffer, &value))
+	return 0;
+    *count = value;
+    return 1;
+}
+
 static int
 extract_interrupt_errors(char *buffer)
 {
-    return (sscanf(buffer, "ERR: %u", &irq_err_count) == 1 ||
-	    sscanf(buffer, "Err: %u", &irq_err_count) == 1  ||
-	    sscanf(buffer, "BAD: %u", &irq_err_count) == 1);
+    return (extract_interrupt_count(buffer, "ERR", &irq_err_count) ||
+	    extract_interrupt_count(buffer, "Err", &irq_err_count) ||
+	    extract_interrupt_count(buffer, "BAD", &irq_err_count));
 }
 
 static int
 extract_interrupt_misses(char *buffer)
 {
-    return sscanf(buffer, "MIS: %u", &irq_mis_count) == 1;
+    return extract_interrupt_count(buffer, "MIS", &irq_mis_count);
 }
 
 static int
@@ -157,7 +169,8 @@ extract_interrupt_values(char *name, char *buffer, pmInDom intr, pmInDom cpuintr
 
     ip->total = 0;
     for (i = 0; i < ncolumns; i++) {
-	value = strtoul(s, &end, 10);
+	end = s;
+	value = scan_ull(&end);
 	if (!isspace(*end))
 	    continue;
 	s = end;
@@ -256,7 +269,8 @@ extract_softirq_values(char *name, char *buffer, pmInDom sirq, pmInDom cpusirq,
 
     ip->total = 0;
     for (i = 0; i < ncolumns; i++) {
-	value = strtoul(s, &end, 10);
+	end = s;
+	value = scan_ull(&end);
 	if (!isspace(*end))
 	    continue;
 	s = end;
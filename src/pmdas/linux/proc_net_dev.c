@@ -21,6 +21,7 @@
 #include <sys/ioctl.h>
 #include "namespaces.h"
 #include "proc_net_dev.h"
+#include "procscan.h"
 
 static int
 refresh_inet_socket(linux_container_t *container)
@@ -430,10 +431,11 @@ Inter-|   Receive                                                |  Transmit
 	}
 
 	memset(&netip->ioc, 0, sizeof(netip->ioc));
-	for (p=v, j=0; j < PROC_DEV_COUNTERS_PER_LINE; j++) {
-	    for (; !isdigit((int)*p); p++) {;}
-	    sscanf(p, "%llu", (long long unsigned int *)&netip->counters[j]);
-	    for (; !isspace((int)*p); p++) {;}
+	for (p=v+1, j=0; j < PROC_DEV_COUNTERS_PER_LINE; j++) {
+	    for (; *p && !isdigit((int)*p); p++) {;}
+	    if (*p == '\0')
+		break;
+	    netip->counters[j] = scan_ull(&p);
 	}
     }
 
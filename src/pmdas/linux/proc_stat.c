@@ -17,7 +17,9 @@
  */
 #include "linux.h"
 #include "proc_stat.h"
+#include "procscan.h"
 #include <sys/stat.h>
+#include <stddef.h>
 #include <dirent.h>
 #include <ctype.h>
 
@@ -162,6 +164,45 @@ find_line_format(const char *fmt, int fmtlen, char **bufindex, int nbufindex, in
 
 #define WAITIO_SLOP 100
 
+/* cpuacct_t fields in the order of the values on /proc/stat cpu lines */
+static const size_t cpuacct_fields[] = {
+    offsetof(cpuacct_t, user),
+    offsetof(cpuacct_t, nice),
+    offsetof(cpuacct_t, sys),
+    offsetof(cpuacct_t, idle),
+    offsetof(cpuacct_t, wait),
+    offsetof(cpuacct_t, irq),
+    offsetof(cpuacct_t, sirq),
+    offsetof(cpuacct_t, steal),
+    offsetof(cpuacct_t, guest),
+    offsetof(cpuacct_t, guest_nice),
+};
+#define CPUACCT_FIELDS	(sizeof(cpuacct_fields) / sizeof(cpuacct_fields[0]))
+
+/*
+ * Scan the values of a cpu line, after the name - older kernels have
+ * fewer of them, and the missing fields are left unchanged.
+ */
+static void
+scan_cpuacct(char *p, cpuacct_t *acct)
+{
+    unsigned long long	values[CPUACCT_FIELDS];
+    int			i, n;
+
+    n = scan_u64s(&p, values, CPUACCT_FIELDS);
+    for (i = 0; i < n; i++)
+	*(unsigned long long *)((char *)acct + cpuacct_fields[i]) = values[i];
+}
+
+/* scan the values of a line after its name, returning how many there are */
+static int
+scan_values(char *line, int namelen, unsigned long long *values, int n)
+{
+    char		*p = line + namelen;
+
+    return scan_u64s(&p, values, n);
+}
+
 /*
  * We use /proc/stat as a single source of truth regarding online/offline
  * state for CPUs (its per-CPU stats are for online CPUs only).
@@ -178,6 +219,7 @@ refresh_proc_stat(proc_stat_t *proc_stat)
     char	buf[MAXPATHLEN], *name, *sp, **bp;
     char	cpuname[32];
     int		n = 0, i, size;
+    unsigned long long		values[2];
     static unsigned long long	prev_wait;
 
     static int fd = -1; /* kept open until exit(), unless testing */
@@ -240,28 +282,20 @@ refresh_proc_stat(proc_stat_t *proc_stat)
     }
 
     nbufindex = 0;
-    bufindex[nbufindex] = statbuf;
-    for (i = 0; i < n; i++) {
-	if (statbuf[i] == '\n' || statbuf[i] == '\0') {
-	    statbuf[i] = '\0';
-	    if (nbufindex + 1 >= maxbufindex) {
-		size = (maxbufindex + 4) * sizeof(char *);
-		if ((bp = (char **)realloc(bufindex, size)) == NULL)
-		    return -ENOMEM;
-		bufindex = bp;
-	    	maxbufindex += 4;
-	    }
-	    bufindex[++nbufindex] = statbuf + i + 1;
+    for (sp = statbuf; (name = scan_line(&sp, statbuf + n)) != NULL; ) {
+	if (nbufindex + 1 >= maxbufindex) {
+	    size = (maxbufindex + 4) * sizeof(char *);
+	    if ((bp = (char **)realloc(bufindex, size)) == NULL)
+		return -ENOMEM;
+	    bufindex = bp;
+	    maxbufindex += 4;
 	}
+	bufindex[nbufindex++] = name;
     }
+    bufindex[nbufindex] = sp;	/* empty, at the end of the buffer */
 
-#define ALLCPU_FMT "cpu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu"
-    n = sscanf((const char *)bufindex[0], ALLCPU_FMT,
-	&proc_stat->all.user, &proc_stat->all.nice,
-	&proc_stat->all.sys, &proc_stat->all.idle,
-	&proc_stat->all.wait, &proc_stat->all.irq,
-	&proc_stat->all.sirq, &proc_stat->all.steal,
-	&proc_stat->all.guest, &proc_stat->all.guest_nice);
+    if (strncmp(bufindex[0], "cpu", 3) == 0)
+	scan_cpuacct(bufindex[0] + 3, &proc_stat->all);
     if (proc_stat->all.prev_wait > 0 &&
 	    proc_stat->all.wait < proc_stat->all.prev_wait &&
 	    proc_stat->all.wait > proc_stat->all.prev_wait - WAITIO_SLOP) {
@@ -280,7 +314,6 @@ refresh_proc_stat(proc_stat_t *proc_stat)
     else
 	proc_stat->all.prev_wait = proc_stat->all.wait;
 
-#define PERCPU_FMT "cpu%u %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu"
     /*
      * per-CPU stats
      * e.g. cpu0 95379 4 20053 6502503
@@ -304,7 +337,8 @@ refresh_proc_stat(proc_stat_t *proc_stat)
 		continue;
 	    cp = NULL;
 	    np = NULL;
-	    i = atoi(&bufindex[n][3]);	/* extract CPU identifier */
+	    sp = &bufindex[n][3];
+	    i = scan_ull(&sp);	/* extract CPU identifier */
 	    pmsprintf(cpuname, sizeof(cpuname), "cpu%u", i); /* instance name */
 	    if (pmdaCacheLookupName(cpus, cpuname, &i, (void **)&cp) < 0 || !cp)
 		continue;
@@ -312,11 +346,7 @@ refresh_proc_stat(proc_stat_t *proc_stat)
 	    prev_wait = cp->stat.prev_wait;
 	    memset(&cp->stat, 0, sizeof(cp->stat));
 	    cp->stat.prev_wait = prev_wait;
-	    sscanf(bufindex[n], PERCPU_FMT, &i,
-		    &cp->stat.user, &cp->stat.nice, &cp->stat.sys,
-		    &cp->stat.idle, &cp->stat.wait, &cp->stat.irq,
-		    &cp->stat.sirq, &cp->stat.steal, &cp->stat.guest,
-		    &cp->stat.guest_nice);
+	    scan_cpuacct(sp, &cp->stat);
 	    /* see comment above re kernel waitio */
 	    if (cp->stat.prev_wait > 0 &&
 		    cp->stat.wait < cp->stat.prev_wait &&
@@ -346,39 +376,47 @@ refresh_proc_stat(proc_stat_t *proc_stat)
 
     i = size;
 
-#define PAGE_FMT "page %u %u"	/* NB: moved to /proc/vmstat in 2.6 kernels */
-    if ((i = find_line_format(PAGE_FMT, 5, bufindex, nbufindex, i)) >= 0)
-	sscanf((const char *)bufindex[i], PAGE_FMT,
-		&proc_stat->page[0], &proc_stat->page[1]);
+    /* NB: page and swap moved to /proc/vmstat in 2.6 kernels */
+    if ((i = find_line_format("page ", 5, bufindex, nbufindex, i)) >= 0) {
+	n = scan_values(bufindex[i], 4, values, 2);
+	if (n > 0)
+	    proc_stat->page[0] = values[0];
+	if (n > 1)
+	    proc_stat->page[1] = values[1];
+    }
 
-#define SWAP_FMT "swap %u %u"	/* NB: moved to /proc/vmstat in 2.6 kernels */
-    if ((i = find_line_format(SWAP_FMT, 5, bufindex, nbufindex, i)) >= 0)
-	sscanf((const char *)bufindex[i], SWAP_FMT,
-		&proc_stat->swap[0], &proc_stat->swap[1]);
+    if ((i = find_line_format("swap ", 5, bufindex, nbufindex, i)) >= 0) {
+	n = scan_values(bufindex[i], 4, values, 2);
+	if (n > 0)
+	    proc_stat->swap[0] = values[0];
+	if (n > 1)
+	    proc_stat->swap[1] = values[1];
+    }
 
-#define INTR_FMT "intr %llu"	/* (export 1st 'total interrupts' value only) */
-    if ((i = find_line_format(INTR_FMT, 5, bufindex, nbufindex, i)) >= 0)
-	sscanf((const char *)bufindex[i], INTR_FMT, &proc_stat->intr);
+    /* (export 1st 'total interrupts' value only) */
+    if ((i = find_line_format("intr ", 5, bufindex, nbufindex, i)) >= 0 &&
+	scan_values(bufindex[i], 4, values, 1) == 1)
+	proc_stat->intr = values[0];
 
-#define CTXT_FMT "ctxt %llu"
-    if ((i = find_line_format(CTXT_FMT, 5, bufindex, nbufindex, i)) >= 0)
-	sscanf((const char *)bufindex[i], CTXT_FMT, &proc_stat->ctxt);
+    if ((i = find_line_format("ctxt ", 5, bufindex, nbufindex, i)) >= 0 &&
+	scan_values(bufindex[i], 4, values, 1) == 1)
+	proc_stat->ctxt = values[0];
 
-#define BTIME_FMT "btime %lu"
-    if ((i = find_line_format(BTIME_FMT, 6, bufindex, nbufindex, i)) >= 0)
-	sscanf((const char *)bufindex[i], BTIME_FMT, &proc_stat->btime);
+    if ((i = find_line_format("btime ", 6, bufindex, nbufindex, i)) >= 0 &&
+	scan_values(bufindex[i], 5, values, 1) == 1)
+	proc_stat->btime = values[0];
 
-#define PROCESSES_FMT "processes %lu"
-    if ((i = find_line_format(PROCESSES_FMT, 10, bufindex, nbufindex, i)) >= 0)
-	sscanf((const char *)bufindex[i], PROCESSES_FMT, &proc_stat->processes);
+    if ((i = find_line_format("processes ", 10, bufindex, nbufindex, i)) >= 0 &&
+	scan_values(bufindex[i], 9, values, 1) == 1)
+	proc_stat->processes = values[0];
 
-#define RUNNING_FMT "procs_running %lu"
-    if ((i = find_line_format(RUNNING_FMT, 14, bufindex, nbufindex, i)) >= 0)
-	sscanf((const char *)bufindex[i], RUNNING_FMT, &proc_stat->procs_running);
+    if ((i = find_line_format("procs_running ", 14, bufindex, nbufindex, i)) >= 0 &&
+	scan_values(bufindex[i], 13, values, 1) == 1)
+	proc_stat->procs_running = values[0];
 
-#define BLOCKED_FMT "procs_blocked %lu"
-    if ((i = find_line_format(BLOCKED_FMT, 14, bufindex, nbufindex, i)) >= 0)
-	sscanf((const char *)bufindex[i], BLOCKED_FMT, &proc_stat->procs_blocked);
+    if ((i = find_line_format("procs_blocked ", 14, bufindex, nbufindex, i)) >= 0 &&
+	scan_values(bufindex[i], 13, values, 1) == 1)
+	proc_stat->procs_blocked = values[0];
 
     /* success */
     return 0;
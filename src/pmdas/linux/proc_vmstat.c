@@ -18,6 +18,7 @@
 #include <ctype.h>
 #include "linux.h"
 #include "proc_vmstat.h"
+#include "procscan.h"
 
 static struct {
     const char	*field;
@@ -399,6 +400,53 @@ static struct {
 #define VMSTAT_OFFSET(ii, pp) (int64_t *)((char *)pp + \
     (__psint_t)vmstat_fields[ii].offset - (__psint_t)&_pm_proc_vmstat)
 
+static int	vmstat_nfields;
+static int	*vmstat_order;	/* vmstat_fields indices, sorted by name */
+
+static int
+vmstat_compare(const void *a, const void *b)
+{
+    return strcmp(vmstat_fields[*(const int *)a].field,
+		  vmstat_fields[*(const int *)b].field);
+}
+
+/*
+ * Binary search for a /proc/vmstat name, returning the vmstat_fields
+ * index or -1 - there are a couple of hundred lines in the file, and
+ * as many fields in the table.
+ */
+static int
+vmstat_lookup(const char *name)
+{
+    int		lo = 0, hi = vmstat_nfields - 1, mid, sts;
+
+    while (lo <= hi) {
+	mid = (lo + hi) / 2;
+	if ((sts = strcmp(name, vmstat_fields[vmstat_order[mid]].field)) == 0)
+	    return vmstat_order[mid];
+	if (sts < 0)
+	    hi = mid - 1;
+	else
+	    lo = mid + 1;
+    }
+    return -1;
+}
+
+static int
+vmstat_setup(void)
+{
+    int		i;
+
+    for (i = 0; vmstat_fields[i].field != NULL; i++)
+	;
+    if ((vmstat_order = (int *)malloc(i * sizeof(int))) == NULL)
+	return -ENOMEM;
+    for (vmstat_nfields = 0; vmstat_nfields < i; vmstat_nfields++)
+	vmstat_order[vmstat_nfields] = vmstat_nfields;
+    qsort(vmstat_order, vmstat_nfields, sizeof(int), vmstat_compare);
+    return 0;
+}
+
 void
 proc_vmstat_init(void)
 {
@@ -437,6 +485,9 @@ refresh_proc_vmstat(proc_vmstat_t *proc_vmstat)
     proc_vmstat->pgsteal_total = 0;
     proc_vmstat->pgdemote_total = 0;
 
+    if (vmstat_order == NULL && vmstat_setup() < 0)
+	return -ENOMEM;
+
     if ((fp = linux_statsfile("/proc/vmstat", buf, sizeof(buf))) == NULL)
     	return -oserror();
 
@@ -446,27 +497,22 @@ refresh_proc_vmstat(proc_vmstat_t *proc_vmstat)
 	if ((bufp = strchr(buf, ' ')) == NULL)
 	    continue;
 	*bufp = '\0';
-	for (i = 0; vmstat_fields[i].field != NULL; i++) {
-	    if (strcmp(buf, vmstat_fields[i].field) != 0)
-		continue;
-	    p = VMSTAT_OFFSET(i, proc_vmstat);
-	    for (bufp++; *bufp; bufp++) {
-	    	if (isdigit((int)*bufp)) {
-		    sscanf(bufp, "%llu", (unsigned long long *)p);
-		    break;
-		}
-	    }
-	    if (*bufp == '\0')
-		continue;
-	    else if (strncmp(buf, "pgsteal_", 8) == 0)
-		proc_vmstat->pgsteal_total += *p;
-	    else if (strncmp(buf, "pgscan_kswapd", 13) == 0)
-		proc_vmstat->pgscan_kswapd_total += *p;
-	    else if (strncmp(buf, "pgscan_direct", 13) == 0)
-		proc_vmstat->pgscan_direct_total += *p;
-	    else if (strncmp(buf, "pgdemote_", 9) == 0)
-		proc_vmstat->pgdemote_total += *p;
-	}
+	if ((i = vmstat_lookup(buf)) < 0)
+	    continue;
+	p = VMSTAT_OFFSET(i, proc_vmstat);
+	for (bufp++; *bufp && !isdigit((int)*bufp); bufp++)
+	    ;
+	if (*bufp == '\0')
+	    continue;
+	*p = scan_ull(&bufp);
+	if (strncmp(buf, "pgsteal_", 8) == 0)
+	    proc_vmstat->pgsteal_total += *p;
+	else if (strncmp(buf, "pgscan_kswapd", 13) == 0)
+	    proc_vmstat->pgscan_kswapd_total += *p;
+	else if (strncmp(buf, "pgscan_direct", 13) == 0)
+	    proc_vmstat->pgscan_direct_total += *p;
+	else if (strncmp(buf, "pgdemote_", 9) == 0)
+	    proc_vmstat->pgdemote_total += *p;
     }
     fclose(fp);
 
@@ -0,0 +1,128 @@
+/*
+ * Fast scanning of numbers and lines in /proc text files, shared by
+ * the linux and proc PMDAs.
+ *
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+#ifndef LINUX_PROCSCAN_H
+#define LINUX_PROCSCAN_H
+
+#include <string.h>
+
+/*
+ * These replace sscanf(3) and strtoull(3) in the refresh routines for
+ * the larger /proc files (like /proc/stat and /proc/interrupts on big
+ * machines), which are parsed in full on every sample.  They work in
+ * place on a nul-terminated buffer, never allocate, and only handle
+ * the base 10 numbers the kernel writes, so there is no locale or
+ * format string to consult for each value.
+ *
+ * Each scan takes a cursor (char **) which is moved past the number
+ * scanned.  As with strtoull(3), leading white space and a sign are
+ * accepted, and if there is no number the cursor is not moved and the
+ * value is zero.  Values are not checked for overflow; the kernel only
+ * writes numbers that fit the types used here.
+ */
+
+#define scan_isspace(c)	((c) == ' ' || (unsigned int)((c) - '\t') < 5)
+#define scan_isdigit(c)	((unsigned int)((c) - '0') < 10)
+
+static inline char *
+scan_skip_space(char *p)
+{
+    while (scan_isspace(*p))
+	p++;
+    return p;
+}
+
+/* scan an unsigned long long, returning 1 if there was one or 0 if not */
+static inline int
+scan_u64(char **pp, unsigned long long *vp)
+{
+    unsigned long long	value;
+    char		*p = scan_skip_space(*pp);
+    int			negate = 0;
+
+    if (*p == '-') {
+	negate = 1;
+	p++;
+    }
+    else if (*p == '+')
+	p++;
+    if (!scan_isdigit(*p)) {
+	*vp = 0;
+	return 0;
+    }
+    value = *p++ - '0';
+    while (scan_isdigit(*p))
+	value = value * 10 + (*p++ - '0');
+    *vp = negate ? -value : value;
+    *pp = p;
+    return 1;
+}
+
+/* like strtoull(p, &p, 10) */
+static inline unsigned long long
+scan_ull(char **pp)
+{
+    unsigned long long	value;
+
+    scan_u64(pp, &value);
+    return value;
+}
+
+/* like strtoll(p, &p, 10) */
+static inline long long
+scan_ll(char **pp)
+{
+    return (long long)scan_ull(pp);
+}
+
+/*
+ * Scan up to n space-separated values into v[], returning how many were
+ * found, like a sscanf(3) format with n %llu conversions.
+ */
+static inline int
+scan_u64s(char **pp, unsigned long long *v, int n)
+{
+    int			i;
+
+    for (i = 0; i < n; i++)
+	if (!scan_u64(pp, &v[i]))
+	    break;
+    return i;
+}
+
+/*
+ * Return the line at *pp, terminated in place, moving *pp to the start
+ * of the next line; or NULL when there are no more lines before end.
+ * memchr(3) is vectorised in the C library, so this is much quicker
+ * than looking at each character of long lines.
+ */
+static inline char *
+scan_line(char **pp, const char *end)
+{
+    char		*line = *pp, *nl;
+
+    if (line >= end)
+	return NULL;
+    if ((nl = (char *)memchr(line, '\n', end - line)) != NULL) {
+	*nl = '\0';
+	*pp = nl + 1;
+    }
+    else
+	*pp = (char *)end;
+    return line;
+}
+
+#endif /* LINUX_PROCSCAN_H */
@@ -21,9 +21,17 @@
 #include "clusters.h"
 #include "proc_pid.h"
 #include <sys/stat.h>
+#include <sys/inotify.h>
 #include <ctype.h>
 
 unsigned int	cgroup_version;
+int		cgroup_inotify;		/* -C, track hierarchies with inotify */
+
+static int		cgroup_inotify_fd = -1;
+static __pmHashCtl	cgroup_watches;	/* inotify wd -> cgroup_dir_t */
+static const pmProfile	*cgroup2_profile;
+
+static void cgroup_dir_remove(cgroup_dir_t *);
 
 /*
  * Parts of the following two functions are based on systemd code, see
@@ -250,6 +258,8 @@ refresh_cgroup_filesys(void)
 	if (sts == PMDA_CACHE_INACTIVE) { /* re-activate an old mount */
 	    pmdaCacheStore(mounts, PMDA_CACHE_ADD, path, fs);
 	    if (strcmp(path, fs->path) != 0) {	/* old device, new path */
+		if (fs->dirs)
+		    cgroup_dir_remove(fs->dirs);
 		free(fs->path);
 		fs->path = strdup(path);
 	    }
@@ -504,6 +514,31 @@ check_refresh(const char *cgroup, const char *container, int container_length)
     return 1;
 }
 
+/*
+ * Is this directory entry (from cgpath) a subdirectory, i.e. a cgroup?
+ */
+static int
+cgroup_subdir(const char *cgpath, struct dirent *dp)
+{
+    if (dp->d_type == DT_UNKNOWN) {
+	/*
+	 * This a bit sad, and probably only seen in QA where
+	 * PROC_STATSPATH is set and the test "/proc" files are
+	 * on a file system that does not support d_type from
+	 * readdir() ... go the old-style way with stat()
+	 */
+	int		lsts;
+	struct stat	statbuf;
+	if ((lsts = stat(cgpath, &statbuf)) != 0) {
+	    if (pmDebugOptions.appl0)
+		fprintf(stderr, "cgroup_subdir: stat(%s) -> %d\n", cgpath, lsts);
+	    return 0;
+	}
+	return (statbuf.st_mode & S_IFMT) == S_IFDIR;
+    }
+    return dp->d_type == DT_DIR;
+}
+
 static void
 cgroup_scan(const char *mnt, const char *path, cgroup_refresh_t refresh,
 		const char *container, int container_length, void *arg)
@@ -525,9 +560,12 @@ cgroup_scan(const char *mnt, const char *path, cgroup_refresh_t refresh,
     if ((dirp = opendir(cgpath)) == NULL)
 	return;
 
-    cgname = cgroup_name(cgpath, length);
-    if (check_refresh(cgpath + mntlen, container, container_length))
-	refresh(cgpath, cgname, arg);
+    /* subdirectories are refreshed as they are found, below */
+    if (path[0] == '\0') {
+	cgname = cgroup_name(cgpath, length);
+	if (check_refresh(cgpath + mntlen, container, container_length))
+	    refresh(cgpath, cgname, arg);
+    }
 
     /* descend into subdirectories to find all cgroups */
     while ((dp = readdir(dirp)) != NULL) {
@@ -539,24 +577,7 @@ cgroup_scan(const char *mnt, const char *path, cgroup_refresh_t refresh,
 	else
 	    pmsprintf(cgpath, sizeof(cgpath), "%s%s/%s/%s",
 			proc_statspath, mnt, path, dp->d_name);
-	if (dp->d_type == DT_UNKNOWN) {
-	    /*
-	     * This a bit sad, and probably only seen in QA where
-	     * PROC_STATSPATH is set and the test "/proc" files are
-	     * on a file system that does not support d_type from
-	     * readdir() ... go the old-style way with stat()
-	     */
-	    int		lsts;
-	    struct stat	statbuf;
-	    if ((lsts = stat(cgpath, &statbuf)) != 0) {
-		if (pmDebugOptions.appl0)
-		    fprintf(stderr, "cgroup_scan: stat(%s) -> %d\n", cgpath, lsts);
-		continue;
-	    }
-	    if ((statbuf.st_mode & S_IFMT) != S_IFDIR)
-		continue;
-	}
-	else if (dp->d_type != DT_DIR)
+	if (!cgroup_subdir(cgpath, dp))
 	    continue;
 
 	cgname = cgroup_name(cgpath, length);
@@ -567,6 +588,276 @@ cgroup_scan(const char *mnt, const char *path, cgroup_refresh_t refresh,
     closedir(dirp);
 }
 
+/*
+ * With -C each cgroup hierarchy is read once, and then kept up to date
+ * with inotify(7) watches on every cgroup directory, as cgroups are made
+ * and removed.  Refreshing then walks the tree in memory, instead of
+ * reading all the directories again - on hosts with many thousands of
+ * containers and systemd units that is most of the cost of a refresh.
+ * If inotify cannot be used, or there are too many cgroups to watch,
+ * this falls back to rescanning the hierarchy for each refresh.
+ */
+#define CGROUP_WATCH_EVENTS \
+	(IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR)
+
+static void
+cgroup_dir_path(cgroup_dir_t *dir, char *cgpath, size_t length)
+{
+    pmsprintf(cgpath, length, "%s%s%s", proc_statspath, dir->fs->path, dir->path);
+}
+
+/*
+ * Find the subdirectory of parent with the given name, else return NULL
+ * with *tailp set to the end of the list of subdirectories.
+ */
+static cgroup_dir_t *
+cgroup_dir_find(cgroup_dir_t *parent, const char *name, cgroup_dir_t ***tailp)
+{
+    cgroup_dir_t	*dir, **tail;
+    size_t		length = strlen(parent->path) + 1;
+
+    for (tail = &parent->child; (dir = *tail) != NULL; tail = &dir->next) {
+	if (strcmp(dir->path + length, name) == 0)
+	    return dir;
+    }
+    *tailp = tail;
+    return NULL;
+}
+
+static void
+cgroup_dir_free(cgroup_dir_t *dir)
+{
+    cgroup_dir_t	*child, *next;
+
+    for (child = dir->child; child; child = next) {
+	next = child->next;
+	cgroup_dir_free(child);
+    }
+    if (dir->wd >= 0) {
+	if (cgroup_inotify_fd >= 0)
+	    inotify_rm_watch(cgroup_inotify_fd, dir->wd);
+	__pmHashDel(dir->wd, dir, &cgroup_watches);
+    }
+    free(dir->path);
+    free(dir);
+}
+
+/* remove a directory (and everything below it) from its hierarchy */
+static void
+cgroup_dir_remove(cgroup_dir_t *dir)
+{
+    cgroup_dir_t	**dpp;
+
+    if (dir->parent == NULL)
+	dir->fs->dirs = NULL;
+    else {
+	for (dpp = &dir->parent->child; *dpp; dpp = &(*dpp)->next) {
+	    if (*dpp == dir) {
+		*dpp = dir->next;
+		break;
+	    }
+	}
+    }
+    if (pmDebugOptions.appl0)
+	fprintf(stderr, "cgroup_dir_remove: \"%s%s\"\n", dir->fs->path, dir->path);
+    cgroup_dir_free(dir);
+}
+
+static __pmHashWalkState
+cgroup_dir_release(const __pmHashNode *node, void *arg)
+{
+    cgroup_dir_t	*dir = (cgroup_dir_t *)node->data;
+
+    (void)arg;
+    if (dir->parent == NULL)
+	dir->fs->dirs = NULL;
+    free(dir->path);
+    free(dir);
+    return PM_HASH_WALK_NEXT;
+}
+
+/*
+ * Forget all of the tracked hierarchies, e.g. after the event queue
+ * overflows, so they are read again from scratch.  Every directory is
+ * in the hash of watches, and closing the inotify descriptor removes
+ * all of the watches.
+ */
+static void
+cgroup_dirs_reset(void)
+{
+    if (cgroup_inotify_fd >= 0)
+	close(cgroup_inotify_fd);
+    cgroup_inotify_fd = -1;
+    __pmHashWalkCB(cgroup_dir_release, NULL, &cgroup_watches);
+    __pmHashClear(&cgroup_watches);
+}
+
+/* give up on inotify, e.g. when there are too many cgroups to watch */
+static void
+cgroup_inotify_stop(const char *reason)
+{
+    pmNotifyErr(LOG_WARNING, "cgroups: %s, rescanning cgroup hierarchies", reason);
+    cgroup_dirs_reset();
+    cgroup_inotify = 0;
+}
+
+/*
+ * Watch a cgroup directory, and add it to its hierarchy (at *link, the
+ * end of its parent's list) along with all of the cgroups below it, in
+ * the same order as cgroup_scan() finds them.  The watch is added before
+ * the directory is read, so any subdirectory made meanwhile is seen one
+ * way or the other.
+ */
+static cgroup_dir_t *
+cgroup_dir_add(filesys_t *fs, cgroup_dir_t *parent, const char *name,
+		cgroup_dir_t **link)
+{
+    cgroup_dir_t	*dir, *child, **tail;
+    struct dirent	*dp;
+    DIR			*dirp;
+    char		cgpath[MAXPATHLEN], errmsg[PM_MAXERRMSGLEN];
+
+    if ((dir = (cgroup_dir_t *)calloc(1, sizeof(cgroup_dir_t))) == NULL)
+	return NULL;
+    dir->fs = fs;
+    dir->wd = -1;
+    if (parent == NULL)
+	dir->path = strdup("");
+    else {
+	pmsprintf(cgpath, sizeof(cgpath), "%s/%s", parent->path, name);
+	dir->path = strdup(cgpath);
+    }
+    if (dir->path == NULL) {
+	free(dir);
+	return NULL;
+    }
+    cgroup_dir_path(dir, cgpath, sizeof(cgpath));
+    if ((dir->wd = inotify_add_watch(cgroup_inotify_fd, cgpath,
+					CGROUP_WATCH_EVENTS)) < 0) {
+	if (oserror() == ENOSPC || oserror() == ENOMEM) {
+	    pmsprintf(cgpath, sizeof(cgpath), "cannot watch %s: %s",
+			dir->path, osstrerror_r(errmsg, sizeof(errmsg)));
+	    cgroup_dir_free(dir);
+	    cgroup_inotify_stop(cgpath);	/* frees the whole hierarchy */
+	    return NULL;
+	}
+	/* else it is already gone, or not a directory */
+	cgroup_dir_free(dir);
+	return NULL;
+    }
+    if (__pmHashAdd(dir->wd, dir, &cgroup_watches) < 0) {
+	cgroup_dir_free(dir);
+	return NULL;
+    }
+    dir->parent = parent;
+    *link = dir;
+    if (pmDebugOptions.appl0)
+	fprintf(stderr, "cgroup_dir_add: \"%s%s\" wd=%d\n", fs->path, dir->path, dir->wd);
+
+    if ((dirp = opendir(cgpath)) == NULL)
+	return dir;
+    tail = &dir->child;
+    while ((dp = readdir(dirp)) != NULL) {
+	if (dp->d_name[0] == '.' || dp->d_type == DT_REG)
+	    continue;
+	pmsprintf(cgpath, sizeof(cgpath), "%s%s%s/%s",
+			proc_statspath, fs->path, dir->path, dp->d_name);
+	if (!cgroup_subdir(cgpath, dp))
+	    continue;
+	if ((child = cgroup_dir_add(fs, dir, dp->d_name, tail)) != NULL)
+	    tail = &child->next;
+	else if (cgroup_inotify == 0)
+	    break;	/* fallen back to rescanning, dir is gone */
+    }
+    closedir(dirp);
+    return cgroup_inotify ? dir : NULL;
+}
+
+/*
+ * Apply the queued inotify events to the hierarchies being tracked,
+ * returning 0, or -1 if they have to be read again from scratch.
+ */
+static int
+cgroup_dir_events(void)
+{
+    char		buffer[16 * (sizeof(struct inotify_event) + NAME_MAX + 1)]
+			__attribute__((aligned(__alignof__(struct inotify_event))));
+    struct inotify_event *event;
+    cgroup_dir_t	*dir, *child, **tail;
+    __pmHashNode	*node;
+    ssize_t		bytes;
+    char		*p;
+
+    for (;;) {
+	if ((bytes = read(cgroup_inotify_fd, buffer, sizeof(buffer))) <= 0)
+	    return (bytes < 0 && oserror() != EAGAIN) ? -1 : 0;
+
+	for (p = buffer; p < buffer + bytes;
+	     p += sizeof(struct inotify_event) + event->len) {
+	    event = (struct inotify_event *)p;
+	    if (event->mask & IN_Q_OVERFLOW)
+		return -1;
+	    if ((node = __pmHashSearch(event->wd, &cgroup_watches)) == NULL)
+		continue;
+	    dir = (cgroup_dir_t *)node->data;
+	    if (event->mask & IN_IGNORED) {
+		/* watched directory removed, or its filesystem unmounted */
+		dir->wd = -1;
+		__pmHashDel(event->wd, dir, &cgroup_watches);
+		cgroup_dir_remove(dir);
+		continue;
+	    }
+	    if (!(event->mask & IN_ISDIR) || event->len == 0)
+		continue;
+	    child = cgroup_dir_find(dir, event->name, &tail);
+	    if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+		if (child == NULL &&
+		    cgroup_dir_add(dir->fs, dir, event->name, tail) == NULL &&
+		    cgroup_inotify == 0)
+		    return -1;
+	    }
+	    else if (child != NULL)	/* IN_DELETE or IN_MOVED_FROM */
+		cgroup_dir_remove(child);
+	}
+    }
+}
+
+/* refresh each cgroup in a tracked hierarchy */
+static void
+cgroup_dir_walk(cgroup_dir_t *dir, cgroup_refresh_t refresh,
+		const char *container, int container_length, void *arg)
+{
+    int		mntlen = strlen(dir->fs->path) + 1;
+    char	cgpath[MAXPATHLEN];
+
+    for (; dir; dir = dir->next) {
+	cgroup_dir_path(dir, cgpath, sizeof(cgpath));
+	if (check_refresh(cgpath + mntlen, container, container_length))
+	    refresh(cgpath, dir->path[0] ? dir->path : "/", arg);
+	if (dir->child)
+	    cgroup_dir_walk(dir->child, refresh, container, container_length, arg);
+    }
+}
+
+/* bring all of the tracked hierarchies up to date */
+static void
+cgroup_dirs_update(void)
+{
+    char	errmsg[PM_MAXERRMSGLEN], reason[PM_MAXERRMSGLEN + 32];
+
+    if (cgroup_inotify_fd >= 0 && cgroup_dir_events() < 0) {
+	if (pmDebugOptions.appl0)
+	    fprintf(stderr, "cgroup_dirs_update: events lost, reading again\n");
+	cgroup_dirs_reset();
+    }
+    if (cgroup_inotify && cgroup_inotify_fd < 0 &&
+	(cgroup_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+	pmsprintf(reason, sizeof(reason), "cannot use inotify: %s",
+			osstrerror_r(errmsg, sizeof(errmsg)));
+	cgroup_inotify_stop(reason);
+    }
+}
+
 /*
  * Primary driver interface - finds any/all mount points for a given
  * cgroup subsystem and iteratively expands all of the cgroups below
@@ -582,6 +873,9 @@ refresh_cgroups(const char *subsys, const char *container, size_t length,
     filesys_t *fs;
     pmInDom mounts = INDOM(CGROUP_MOUNTS_INDOM);
 
+    if (cgroup_inotify)
+	cgroup_dirs_update();
+
     pmdaCacheOp(mounts, PMDA_CACHE_WALK_REWIND);
     while ((sts = pmdaCacheOp(mounts, PMDA_CACHE_WALK_NEXT)) != -1) {
 	if (!pmdaCacheLookup(mounts, sts, NULL, (void **)&fs))
@@ -593,7 +887,12 @@ refresh_cgroups(const char *subsys, const char *container, size_t length,
 	    continue;
 
 	setup(arg);
-	cgroup_scan(fs->path, "", refresh, container, length, arg);
+	if (cgroup_inotify && fs->dirs == NULL)
+	    cgroup_dir_add(fs, NULL, "", &fs->dirs);
+	if (cgroup_inotify && fs->dirs != NULL)
+	    cgroup_dir_walk(fs->dirs, refresh, container, length, arg);
+	else
+	    cgroup_scan(fs->path, "", refresh, container, length, arg);
     }
 }
 
@@ -1527,12 +1826,18 @@ refresh_all(const char *path, const char *name, void *arg)
     pmInDom indom = INDOM(CGROUP2_INDOM);
     char file[MAXPATHLEN], id[MAXCIDLEN];
     char *escname, escbuf[MAXPATHLEN+16];
-    int sts, *need_refresh = (int *)arg;
+    int inst, sts, *need_refresh = (int *)arg;
 
     escname = unit_name_unescape(name, escbuf);
-    sts = pmdaCacheLookupName(indom, escname, NULL, (void **)&cgroup);
+    sts = pmdaCacheLookupName(indom, escname, &inst, (void **)&cgroup);
     if (sts == PMDA_CACHE_ACTIVE)
 	goto v1;
+    if (sts == PMDA_CACHE_INACTIVE && cgroup2_profile != NULL &&
+	!__pmInProfile(indom, cgroup2_profile, inst)) {
+	/* no values wanted for this cgroup, keep the instance only */
+	pmdaCacheStore(indom, PMDA_CACHE_ADD, escname, cgroup);
+	goto v1;
+    }
     if (sts != PMDA_CACHE_INACTIVE &&
 	(cgroup = (cgroup2_t *)calloc(1, sizeof(cgroup2_t))) == NULL)
 	goto v1;
@@ -1613,8 +1918,15 @@ v1:
     }
 }
 
+/*
+ * The profile is that of the fetch - the cgroup2 files are only read
+ * for the cgroups in it, when the client asks for just a few of them.
+ */
 void
-refresh_cgroups2(const char *cgroup, size_t cgrouplen, void *arg)
+refresh_cgroups2(const char *cgroup, size_t cgrouplen,
+		const pmProfile *profile, void *arg)
 {
+    cgroup2_profile = profile;
     refresh_cgroups(NULL, cgroup, cgrouplen, setup_all, refresh_all, arg);
+    cgroup2_profile = NULL;
 }
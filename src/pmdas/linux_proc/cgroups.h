@@ -364,11 +364,25 @@ enum {
     CG_BLKIO_THROTTLEIOSERVICED_TOTAL		= 101,
 };
 
+/*
+ * A cgroup directory below a mount point, when the hierarchy is being
+ * tracked with inotify(7) rather than rescanned for each refresh.
+ */
+typedef struct cgroup_dir {
+    struct cgroup_dir	*parent;
+    struct cgroup_dir	*child;		/* first subdirectory */
+    struct cgroup_dir	*next;		/* next sibling */
+    struct filesys	*fs;
+    int			wd;		/* inotify watch descriptor */
+    char		*path;		/* below the mount point, "" at the top */
+} cgroup_dir_t;
+
 typedef struct filesys {
     int			id;
     int			version;
     char		*path;
     char		*options;
+    cgroup_dir_t	*dirs;		/* tracked hierarchy, if any */
 } filesys_t;
 
 enum {
@@ -494,11 +508,12 @@ extern char *cgroup_find_subsys(pmInDom, filesys_t *);
 extern void refresh_cgroup_subsys(void);
 extern void refresh_cgroup_filesys(void);
 extern void refresh_cgroups1(const char *, size_t, void *);
-extern void refresh_cgroups2(const char *, size_t, void *);
+extern void refresh_cgroups2(const char *, size_t, const pmProfile *, void *);
 
 extern char *cgroup_container_path(char *, size_t, const char *);
 extern char *cgroup_container_search(const char *, char *, int);
 
 extern unsigned int cgroup_version;
+extern int cgroup_inotify;
 
 #endif /* _CGROUP_H */
@@ -52,6 +52,7 @@
 #include "proc_dynamic.h"
 #include "cgroups.h"
 #include "acct.h"
+#include "worker.h"
 
 /* globals */
 static int			_isDSO = 1;	/* =0 I am a daemon */
@@ -63,8 +64,10 @@ static proc_acct_t		proc_acct;
 static int			all_access;	/* =1 no access checks */
 static int			have_access;	/* =1 recvd uid/gid */
 static int			autogroup = -1;	/* =1 autogroup enabled */
+static unsigned int		status_fields;	/* status lines for this fetch */
 static unsigned int		threads;	/* control.all.threads */
 static char *			cgroups;	/* control.all.cgroups */
+static int			workers;	/* -w refresh threads */
 size_t				_pm_system_pagesize;
 long				_pm_hertz;
 
@@ -1195,6 +1198,46 @@ static pmdaMetric metrictab[] = {
 /* proc.control.perclient.cgroups */
   { NULL, { PMDA_PMID(CLUSTER_CONTROL, 3), PM_TYPE_STRING, PM_INDOM_NULL,
     PM_SEM_INSTANT, PMDA_PMUNITS(0,0,0,0,0,0) } },
+/* proc.refresh.workers */
+  { &proc_refresh_stats.workers,
+    { PMDA_PMID(CLUSTER_CONTROL, 4), PM_TYPE_U32, PM_INDOM_NULL,
+    PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) } },
+/* proc.refresh.count */
+  { &proc_refresh_stats.count,
+    { PMDA_PMID(CLUSTER_CONTROL, 5), PM_TYPE_U64, PM_INDOM_NULL,
+    PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) } },
+/* proc.refresh.time */
+  { &proc_refresh_stats.time,
+    { PMDA_PMID(CLUSTER_CONTROL, 6), PM_TYPE_U64, PM_INDOM_NULL,
+    PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) } },
+/* proc.refresh.latency */
+  { &proc_refresh_stats.latency,
+    { PMDA_PMID(CLUSTER_CONTROL, 7), PM_TYPE_U64, PM_INDOM_NULL,
+    PM_SEM_INSTANT, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) } },
+/* proc.refresh.dirfd.limit */
+  { &proc_refresh_stats.dirfd_limit,
+    { PMDA_PMID(CLUSTER_CONTROL, 8), PM_TYPE_U32, PM_INDOM_NULL,
+    PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) } },
+/* proc.refresh.dirfd.cached */
+  { &proc_refresh_stats.dirfd_cached,
+    { PMDA_PMID(CLUSTER_CONTROL, 9), PM_TYPE_U32, PM_INDOM_NULL,
+    PM_SEM_INSTANT, PMDA_PMUNITS(0,0,0,0,0,0) } },
+/* proc.refresh.dirfd.opened */
+  { &proc_refresh_stats.dirfd_opened,
+    { PMDA_PMID(CLUSTER_CONTROL, 10), PM_TYPE_U64, PM_INDOM_NULL,
+    PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) } },
+/* proc.refresh.dirfd.evicted */
+  { &proc_refresh_stats.dirfd_evicted,
+    { PMDA_PMID(CLUSTER_CONTROL, 11), PM_TYPE_U64, PM_INDOM_NULL,
+    PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) } },
+/* proc.refresh.dirfd.hits */
+  { &proc_refresh_stats.dirfd_hits,
+    { PMDA_PMID(CLUSTER_CONTROL, 12), PM_TYPE_U64, PM_INDOM_NULL,
+    PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) } },
+/* proc.refresh.reads_saved */
+  { &proc_refresh_stats.reads_saved,
+    { PMDA_PMID(CLUSTER_CONTROL, 13), PM_TYPE_U64, PM_INDOM_NULL,
+    PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) } },
 
 /*
  * Hot processes clusters
@@ -1426,6 +1469,124 @@ refresh_sched_autogroup(void)
 	fclose(fp);
 }
 
+/*
+ * Lines of /proc/<pid>/status needed for a proc.* or hotproc.* metric
+ * from the status cluster (the PROC_STATUS_FIELD_* values).
+ */
+static unsigned int
+proc_status_fields(unsigned int item)
+{
+    switch (item) {
+    case 0: case 1: case 2: case 3: case 4:	/* proc.id.gid reports uid */
+    case 8: case 9: case 10: case 11:
+	return PROC_STATUS_FIELD_UID;
+    case 5: case 6: case 7:
+    case 12: case 13: case 14: case 15:
+	return PROC_STATUS_FIELD_GID;
+    case 16:
+	return PROC_STATUS_FIELD_SIGPND;
+    case 17:
+	return PROC_STATUS_FIELD_SIGBLK;
+    case 18:
+	return PROC_STATUS_FIELD_SIGIGN;
+    case 19:
+	return PROC_STATUS_FIELD_SIGCGT;
+    case 20:
+	return PROC_STATUS_FIELD_VMSIZE;
+    case 21:
+	return PROC_STATUS_FIELD_VMLCK;
+    case 22:
+	return PROC_STATUS_FIELD_VMRSS;
+    case 23:
+	return PROC_STATUS_FIELD_VMDATA;
+    case 24:
+	return PROC_STATUS_FIELD_VMSTK;
+    case 25:
+	return PROC_STATUS_FIELD_VMEXE;
+    case 26:
+	return PROC_STATUS_FIELD_VMLIB;
+    case 27:
+	return PROC_STATUS_FIELD_VMSWAP;
+    case 28:
+	return PROC_STATUS_FIELD_THREADS;
+    case 29:
+	return PROC_STATUS_FIELD_VCTXSW;
+    case 30:
+	return PROC_STATUS_FIELD_NVCTXSW;
+    case 31:
+	return PROC_STATUS_FIELD_CPUSALLOWED;
+    case 32:
+	return PROC_STATUS_FIELD_NGID;
+    case 33:
+	return PROC_STATUS_FIELD_VMPEAK;
+    case 34:
+	return PROC_STATUS_FIELD_VMPIN;
+    case 35:
+	return PROC_STATUS_FIELD_VMHWM;
+    case 36:
+	return PROC_STATUS_FIELD_VMPTE;
+    case 37:
+	return PROC_STATUS_FIELD_NSTGID;
+    case 38:
+	return PROC_STATUS_FIELD_NSPID;
+    case 39:
+	return PROC_STATUS_FIELD_NSPGID;
+    case 40:
+	return PROC_STATUS_FIELD_NSSID;
+    case 41:
+	return PROC_STATUS_FIELD_TGID;
+    case 42:
+	return PROC_STATUS_FIELD_ENVID;
+    case 43:
+	return PROC_STATUS_FIELD_VMRSS | PROC_STATUS_FIELD_VMSWAP;
+    case 44:
+	return PROC_STATUS_FIELD_VMRSS | PROC_STATUS_FIELD_VMSWAP |
+	       PROC_STATUS_FIELD_VMLIB;
+    }
+    return PROC_STATUS_FIELD_ALL;
+}
+
+/*
+ * Files to read for every process during the proc indom refresh, on
+ * the refresh threads.  Only worthwhile when the client wants values
+ * for (nearly) all of the processes, i.e. the profile for the proc
+ * indom is not "exclude all, include some".
+ */
+static int
+proc_refresh_want(pmdaExt *pmda, int *need_refresh)
+{
+    pmInDomProfile	*prof;
+    int			state, want = 0;
+
+    if (workers == 0)
+	return 0;
+
+    if (need_refresh[CLUSTER_PROC_RUNQ])
+	want |= PROC_PID_FLAG_STAT;	/* read for all processes anyway */
+
+    state = PM_PROFILE_INCLUDE;
+    if (pmda->e_prof != NULL) {
+	if ((prof = __pmFindProfile(INDOM(PROC_INDOM), pmda->e_prof)) != NULL)
+	    state = prof->state;
+	else
+	    state = pmda->e_prof->state;
+    }
+    if (state != PM_PROFILE_INCLUDE)
+	return want;
+
+    if (need_refresh[CLUSTER_PID_STAT])
+	want |= PROC_PID_FLAG_STAT;
+    if (need_refresh[CLUSTER_PID_STATM])
+	want |= PROC_PID_FLAG_STATM;
+    if (need_refresh[CLUSTER_PID_STATUS] && status_fields)
+	want |= PROC_PID_FLAG_STATUS;
+    if (need_refresh[CLUSTER_PID_IO])
+	want |= PROC_PID_FLAG_IO;
+    if (need_refresh[CLUSTER_PID_SCHEDSTAT])
+	want |= PROC_PID_FLAG_SCHEDSTAT;
+    return want;
+}
+
 static int
 proc_refresh(pmdaExt *pmda, int *need_refresh)
 {
@@ -1472,7 +1633,7 @@ proc_refresh(pmdaExt *pmda, int *need_refresh)
 	if (cgroup_version < 2)
 	    refresh_cgroups1(cgroup, cgrouplen, need_refresh);
 	else
-	    refresh_cgroups2(cgroup, cgrouplen, need_refresh);
+	    refresh_cgroups2(cgroup, cgrouplen, pmda->e_prof, need_refresh);
     }
 
     if (need_refresh[CLUSTER_ACCT] &&
@@ -1497,7 +1658,8 @@ proc_refresh(pmdaExt *pmda, int *need_refresh)
 		need_refresh[CLUSTER_PROC_RUNQ]? &proc_runq : NULL,
 		proc_ctx_threads(pmda->e_context, threads),
 		proc_ctx_cgroups(pmda->e_context, cgroups),
-		container ? cgroup : NULL, cgrouplen);
+		container ? cgroup : NULL, cgrouplen,
+		proc_refresh_want(pmda, need_refresh), status_fields);
 
     }
     if (need_refresh[CLUSTER_HOTPROC_PID_STAT] ||
@@ -1629,6 +1791,7 @@ proc_instance(pmInDom indom, int inst, char *name, pmInResult **result, pmdaExt
 
     if (have_access ||
 	((serial != PROC_INDOM) && (serial != HOTPROC_INDOM))) {
+	status_fields = 0;	/* no values are returned */
 	if ((sts = proc_refresh(pmda, need_refresh)) == 0)
 	    sts = pmdaInstance(indom, inst, name, result, pmda);
     }
@@ -1664,6 +1827,237 @@ scheduler_policy_name(int policy)
     return "?";
 }
 
+/*
+ * proc.psinfo metrics from /proc/<pid>/stat for one process
+ */
+static int
+proc_psinfo_fetch(unsigned int item, proc_pid_entry_t *entry, pmAtomValue *atom)
+{
+    switch (item) {
+    case 1: /* proc.psinfo.cmd */
+	if ((atom->cp = entry->stat.cmd) == NULL)
+	    return 0;
+	break;
+
+    case 2: /* proc.psinfo.sname */
+	atom->cp = entry->stat.state;
+	break;
+
+    case 3: /* proc.psinfo.ppid */
+	atom->ul = entry->stat.ppid;
+	break;
+
+    case 4: /* proc.psinfo.pgrp */
+	atom->ul = entry->stat.pgrp;
+	break;
+
+    case 5: /* proc.psinfo.session */
+	atom->ul = entry->stat.session;
+	break;
+
+    case 6: /* proc.psinfo.tty */
+	atom->ul = entry->stat.tty;
+	break;
+
+    case 7: /* proc.psinfo.tty_pgrp */
+	if (entry->stat.tty_pgrp < 0)
+	    return 0;
+	atom->ul = entry->stat.tty_pgrp;
+	break;
+
+    case 8: /* proc.psinfo.flags */
+	atom->ul = entry->stat.flags;
+	break;
+
+    case 9: /* proc.psinfo.minflt */
+	atom->ul = entry->stat.minflt;
+	break;
+
+    case 10: /* proc.psinfo.cmin_flt */
+	atom->ul = entry->stat.cminflt;
+	break;
+
+    case 11: /* proc.psinfo.maj_flt */
+	atom->ul = entry->stat.majflt;
+	break;
+
+    case 12: /* proc.psinfo.cmaj_flt */
+	atom->ul = entry->stat.cmajflt;
+	break;
+
+    case 13: /* proc.psinfo.utime */
+	_pm_assign_ulong(atom, entry->stat.utime * 1000 / _pm_hertz);
+	break;
+
+    case 14: /* proc.psinfo.stime */
+	_pm_assign_ulong(atom, entry->stat.stime * 1000 / _pm_hertz);
+	break;
+
+    case 15: /* proc.psinfo.cutime */
+	_pm_assign_ulong(atom, entry->stat.cutime * 1000 / _pm_hertz);
+	break;
+
+    case 16: /* proc.psinfo.cstime */
+	_pm_assign_ulong(atom, entry->stat.cstime * 1000 / _pm_hertz);
+	break;
+
+    case 17: /* proc.psinfo.priority */
+	atom->l = entry->stat.priority;
+	break;
+
+    case 18: /* proc.psinfo.nice */
+	atom->l = entry->stat.nice;
+	break;
+
+    /* case 19: -- threads */
+
+    case 20: /* proc.psinfo.it_real_value */
+	atom->ul = entry->stat.it_real_value;
+	break;
+
+    case 21: /* proc.psinfo.start_time */
+	atom->ull = entry->stat.start_time * 1000 / _pm_hertz;
+	break;
+
+    case 22: /* proc.psinfo.vsize */
+	atom->ull = entry->stat.vsize / 1024;
+	break;
+
+    case 23: /* proc.psinfo.rss */
+	atom->ull = entry->stat.rss * _pm_system_pagesize / 1024;
+	break;
+
+    case 24: /* proc.psinfo.rss_rlim */
+	atom->ull = entry->stat.rss_rlim / 1024;
+	break;
+
+    case 25: /* proc.psinfo.start_code */
+	atom->ul = entry->stat.start_code;
+	break;
+
+    case 26: /* proc.psinfo.end_code */
+	atom->ul = entry->stat.end_code;
+	break;
+
+    case 27: /* proc.psinfo.start_stack */
+	atom->ul = entry->stat.start_stack;
+	break;
+
+    case 28: /* proc.psinfo.esp */
+	atom->ul = entry->stat.esp;
+	break;
+
+    case 29: /* proc.psinfo.eip */
+	atom->ul = entry->stat.eip;
+	break;
+
+    case 30: /* proc.psinfo.signal */
+	atom->ul = entry->stat.signal;
+	break;
+
+    case 31: /* proc.psinfo.blocked */
+	atom->ul = entry->stat.blocked;
+	break;
+
+    case 32: /* proc.psinfo.sigignore */
+	atom->ul = entry->stat.sigignore;
+	break;
+
+    case 33: /* proc.psinfo.sigcatch */
+	atom->ul = entry->stat.sigcatch;
+	break;
+
+    case 34: /* proc.psinfo.wchan */
+	_pm_assign_ulong(atom, entry->stat.wchan);
+	break;
+
+    case 35: /* proc.psinfo.nswap */
+	atom->ul = entry->stat.nswap;
+	break;
+
+    case 36: /* proc.psinfo.cnswap */
+	atom->ul = entry->stat.cnswap;
+	break;
+
+    case 37: /* proc.psinfo.exit_signal */
+	atom->ul = entry->stat.exit_signal;
+	break;
+
+    case 38: /* proc.psinfo.processor */
+	atom->ul = entry->stat.processor;
+	break;
+
+    case 39: /* proc.psinfo.ttyname */
+	if (!entry->stat.tty)
+	    atom->cp = "?";
+	else
+	    atom->cp = get_ttyname_info((dev_t)entry->stat.tty);
+	break;
+
+    case 42: /* proc.psinfo.rt_priority */
+	atom->ul = entry->stat.rtpriority;
+	break;
+
+    case 43: /* proc.psinfo.policy */
+	atom->ul = entry->stat.policy;
+	break;
+
+    case 44: /* proc.psinfo.delayacct_blkio_time */
+	atom->ull = entry->stat.delayacct_blkio_time * 1000 / _pm_hertz;
+	break;
+
+    case 45: /* proc.psinfo.guest_time */
+	atom->ull = entry->stat.guest_time * 1000 / _pm_hertz;
+	break;
+
+    case 46: /* proc.psinfo.cguest_time */
+	atom->ull = entry->stat.cguest_time * 1000 / _pm_hertz;
+	break;
+
+    case 48: /* proc.psinfo.policy_s */
+	atom->cp = scheduler_policy_name(entry->stat.policy);
+	break;
+
+    default:
+	return PM_ERR_PMID;
+    }
+    return PMDA_FETCH_STATIC;
+}
+
+/*
+ * proc.memory metrics from /proc/<pid>/statm for one process
+ */
+static int
+proc_memory_fetch(unsigned int item, proc_pid_entry_t *entry, pmAtomValue *atom)
+{
+    switch (item) {
+    case 0: /* proc.memory.size */
+	atom->ul = entry->statm.size * _pm_system_pagesize / 1024;
+	break;
+    case 1:	/* proc.memory.rss */
+	atom->ul = entry->statm.rss * _pm_system_pagesize / 1024;
+	break;
+    case 2: /* proc.memory.share */
+	atom->ul = entry->statm.share * _pm_system_pagesize / 1024;
+	break;
+    case 3: /* proc.memory.textrss */
+	atom->ul = entry->statm.textrs * _pm_system_pagesize / 1024;
+	break;
+    case 4: /* proc.memory.librss */
+	atom->ul = entry->statm.librs * _pm_system_pagesize / 1024;
+	break;
+    case 5: /* proc.memory.datrss */
+	atom->ul = entry->statm.datrs * _pm_system_pagesize / 1024;
+	break;
+    case 6: /* proc.memory.dirty */
+	atom->ul = entry->statm.dirty * _pm_system_pagesize / 1024;
+	break;
+    default:
+	return PM_ERR_PMID;
+    }
+    return PMDA_FETCH_STATIC;
+}
+
 /*
  * callback provided to pmdaFetch
  */
@@ -1848,195 +2242,7 @@ proc_fetchCallBack(pmdaMetric *mdesc, unsigned int inst, pmAtomValue *atom)
 	if (!(entry->success & PROC_PID_FLAG_STAT))
 	    return 0;
 
-	switch (item) {
-	case 1: /* proc.psinfo.cmd */
-	    if ((atom->cp = entry->stat.cmd) == NULL)
-		return 0;
-	    break;
-
-	case 2: /* proc.psinfo.sname */
-	    atom->cp = entry->stat.state;
-	    break;
-
-	case 3: /* proc.psinfo.ppid */
-	    atom->ul = entry->stat.ppid;
-	    break;
-
-	case 4: /* proc.psinfo.pgrp */
-	    atom->ul = entry->stat.pgrp;
-	    break;
-
-	case 5: /* proc.psinfo.session */
-	    atom->ul = entry->stat.session;
-	    break;
-
-	case 6: /* proc.psinfo.tty */
-	    atom->ul = entry->stat.tty;
-	    break;
-
-	case 7: /* proc.psinfo.tty_pgrp */
-	    if (entry->stat.tty_pgrp < 0)
-		return 0;
-	    atom->ul = entry->stat.tty_pgrp;
-	    break;
-
-	case 8: /* proc.psinfo.flags */
-	    atom->ul = entry->stat.flags;
-	    break;
-
-	case 9: /* proc.psinfo.minflt */
-	    atom->ul = entry->stat.minflt;
-	    break;
-
-	case 10: /* proc.psinfo.cmin_flt */
-	    atom->ul = entry->stat.cminflt;
-	    break;
-
-	case 11: /* proc.psinfo.maj_flt */
-	    atom->ul = entry->stat.majflt;
-	    break;
-
-	case 12: /* proc.psinfo.cmaj_flt */
-	    atom->ul = entry->stat.cmajflt;
-	    break;
-
-	case 13: /* proc.psinfo.utime */
-	    _pm_assign_ulong(atom, entry->stat.utime * 1000 / _pm_hertz);
-	    break;
-
-	case 14: /* proc.psinfo.stime */
-	    _pm_assign_ulong(atom, entry->stat.stime * 1000 / _pm_hertz);
-	    break;
-
-	case 15: /* proc.psinfo.cutime */
-	    _pm_assign_ulong(atom, entry->stat.cutime * 1000 / _pm_hertz);
-	    break;
-
-	case 16: /* proc.psinfo.cstime */
-	    _pm_assign_ulong(atom, entry->stat.cstime * 1000 / _pm_hertz);
-	    break;
-
-	case 17: /* proc.psinfo.priority */
-	    atom->l = entry->stat.priority;
-	    break;
-
-	case 18: /* proc.psinfo.nice */
-	    atom->l = entry->stat.nice;
-	    break;
-
-	/* case 19: -- threads */
-
-	case 20: /* proc.psinfo.it_real_value */
-	    atom->ul = entry->stat.it_real_value;
-	    break;
-
-	case 21: /* proc.psinfo.start_time */
-	    atom->ull = entry->stat.start_time * 1000 / _pm_hertz;
-	    break;
-
-	case 22: /* proc.psinfo.vsize */
-	    atom->ull = entry->stat.vsize / 1024;
-	    break;
-
-	case 23: /* proc.psinfo.rss */
-	    atom->ull = entry->stat.rss * _pm_system_pagesize / 1024;
-	    break;
-
-	case 24: /* proc.psinfo.rss_rlim */
-	    atom->ull = entry->stat.rss_rlim / 1024;
-	    break;
-
-	case 25: /* proc.psinfo.start_code */
-	    atom->ul = entry->stat.start_code;
-	    break;
-
-	case 26: /* proc.psinfo.end_code */
-	    atom->ul = entry->stat.end_code;
-	    break;
-
-	case 27: /* proc.psinfo.start_stack */
-	    atom->ul = entry->stat.start_stack;
-	    break;
-
-	case 28: /* proc.psinfo.esp */
-	    atom->ul = entry->stat.esp;
-	    break;
-
-	case 29: /* proc.psinfo.eip */
-	    atom->ul = entry->stat.eip;
-	    break;
-
-	case 30: /* proc.psinfo.signal */
-	    atom->ul = entry->stat.signal;
-	    break;
-
-	case 31: /* proc.psinfo.blocked */
-	    atom->ul = entry->stat.blocked;
-	    break;
-
-	case 32: /* proc.psinfo.sigignore */
-	    atom->ul = entry->stat.sigignore;
-	    break;
-
-	case 33: /* proc.psinfo.sigcatch */
-	    atom->ul = entry->stat.sigcatch;
-	    break;
-
-	case 34: /* proc.psinfo.wchan */
-	    _pm_assign_ulong(atom, entry->stat.wchan);
-	    break;
-
-	case 35: /* proc.psinfo.nswap */
-	    atom->ul = entry->stat.nswap;
-	    break;
-
-	case 36: /* proc.psinfo.cnswap */
-	    atom->ul = entry->stat.cnswap;
-	    break;
-
-	case 37: /* proc.psinfo.exit_signal */
-	    atom->ul = entry->stat.exit_signal;
-	    break;
-
-	case 38: /* proc.psinfo.processor */
-	    atom->ul = entry->stat.processor;
-	    break;
-
-	case 39: /* proc.psinfo.ttyname */
-	    if (!entry->stat.tty)
-		atom->cp = "?";
-	    else
-		atom->cp = get_ttyname_info((dev_t)entry->stat.tty);
-	    break;
- 
-	case 42: /* proc.psinfo.rt_priority */
-	    atom->ul = entry->stat.rtpriority;
-	    break;
-
-	case 43: /* proc.psinfo.policy */
-	    atom->ul = entry->stat.policy;
-	    break;
-
-	case 44: /* proc.psinfo.delayacct_blkio_time */
-	    atom->ull = entry->stat.delayacct_blkio_time * 1000 / _pm_hertz;
-	    break;
-
-	case 45: /* proc.psinfo.guest_time */
-	    atom->ull = entry->stat.guest_time * 1000 / _pm_hertz;
-	    break;
-
-	case 46: /* proc.psinfo.cguest_time */
-	    atom->ull = entry->stat.cguest_time * 1000 / _pm_hertz;
-	    break;
-
-	case 48: /* proc.psinfo.policy_s */
-	    atom->cp = scheduler_policy_name(entry->stat.policy);
-	    break;
-
-	default:
-	    return PM_ERR_PMID;
-	}
-	break;
+	return proc_psinfo_fetch(item, entry, atom);
 
     case CLUSTER_HOTPROC_PID_STATM:
 	active_proc_pid = &hotproc_pid;
@@ -2054,32 +2260,7 @@ proc_fetchCallBack(pmdaMetric *mdesc, unsigned int inst, pmAtomValue *atom)
 	    return sts;
 	if (!(entry->success & PROC_PID_FLAG_STATM))
 	    return 0;
-	switch (item) {
-	case 0: /* proc.memory.size */
-	    atom->ul = entry->statm.size * _pm_system_pagesize / 1024;
-	    break;
-	case 1:	/* proc.memory.rss */
-	    atom->ul = entry->statm.rss * _pm_system_pagesize / 1024;
-	    break;
-	case 2: /* proc.memory.share */
-	    atom->ul = entry->statm.share * _pm_system_pagesize / 1024;
-	    break;
-	case 3: /* proc.memory.textrss */
-	    atom->ul = entry->statm.textrs * _pm_system_pagesize / 1024;
-	    break;
-	case 4: /* proc.memory.librss */
-	    atom->ul = entry->statm.librs * _pm_system_pagesize / 1024;
-	    break;
-	case 5: /* proc.memory.datrss */
-	    atom->ul = entry->statm.datrs * _pm_system_pagesize / 1024;
-	    break;
-	case 6: /* proc.memory.dirty */
-	    atom->ul = entry->statm.dirty * _pm_system_pagesize / 1024;
-	    break;
-	default:
-	    return PM_ERR_PMID;
-	}
-    	break;
+	return proc_memory_fetch(item, entry, atom);
 
     case CLUSTER_HOTPROC_PID_SCHEDSTAT:
 	active_proc_pid = &hotproc_pid;
@@ -2230,7 +2411,7 @@ proc_fetchCallBack(pmdaMetric *mdesc, unsigned int inst, pmAtomValue *atom)
     case CLUSTER_PID_STATUS:
 	if (!have_access)
 	    return PM_ERR_PERMISSION;
-	if ((entry = fetch_proc_pid_status(inst, active_proc_pid, &sts)) == NULL)
+	if ((entry = fetch_proc_pid_status(inst, active_proc_pid, status_fields, &sts)) == NULL)
 		return sts;
 	if (!(entry->success & PROC_PID_FLAG_STATUS))
 	    return 0;
@@ -3541,15 +3722,107 @@ proc_fetchCallBack(pmdaMetric *mdesc, unsigned int inst, pmAtomValue *atom)
     return PMDA_FETCH_STATIC;
 }
 
+/*
+ * batch callback provided to pmdaFetch - the per-process metrics
+ * most often requested for every process are extracted here with
+ * the cluster and item decoding, and access checks, done just once
+ * for all processes.  Everything else is handled per-instance by
+ * proc_fetchCallBack.
+ */
+
+static int
+proc_fetchBatchCallBack(pmdaMetric *mdesc, int numinst, const int *instlist,
+		pmAtomValue *atoms, int *status)
+{
+    unsigned int	cluster = pmID_cluster(mdesc->m_desc.pmid);
+    unsigned int	item = pmID_item(mdesc->m_desc.pmid);
+    proc_pid_entry_t	*entry;
+    proc_pid_t		*active_proc_pid;
+    int			i, sts;
+
+    if (mdesc->m_user != NULL)
+	return PM_ERR_NYI;
+
+    active_proc_pid = &proc_pid;
+
+    switch (cluster) {
+    case CLUSTER_HOTPROC_PID_STAT:
+	active_proc_pid = &hotproc_pid;
+	/*FALLTHROUGH*/
+    case CLUSTER_PID_STAT:
+	/*
+	 * wchan_s, environ and nprocs do not come from the stat file,
+	 * and ttyname is returned in a static buffer that would end up
+	 * shared by every instance in the batch.
+	 */
+	if (item == 39 || item == 40 || item == 47 || item == 99)
+	    return PM_ERR_NYI;
+	if (!have_access)
+	    return PM_ERR_PERMISSION;
+
+	if (item == 0 || item == 41) {
+	    for (i = 0; i < numinst; i++) {
+		if ((entry = proc_pid_entry_lookup(instlist[i], active_proc_pid)) == NULL) {
+		    status[i] = 0;
+		    continue;
+		}
+		if (item == 0) /* proc.psinfo.pid */
+		    atoms[i].ul = entry->id;
+		else           /* proc.psinfo.psargs */
+		    atoms[i].cp = entry->psargs;
+		status[i] = PMDA_FETCH_STATIC;
+	    }
+	    break;
+	}
+
+	for (i = 0; i < numinst; i++) {
+	    if ((entry = fetch_proc_pid_stat(instlist[i], active_proc_pid, &sts)) == NULL)
+		status[i] = sts;
+	    else if (!(entry->success & PROC_PID_FLAG_STAT))
+		status[i] = 0;
+	    else
+		status[i] = proc_psinfo_fetch(item, entry, &atoms[i]);
+	}
+	break;
+
+    case CLUSTER_HOTPROC_PID_STATM:
+	active_proc_pid = &hotproc_pid;
+	/*FALLTHROUGH*/
+    case CLUSTER_PID_STATM:
+	if (item == 7)
+	    return PM_ERR_NYI;
+	if (!have_access)
+	    return PM_ERR_PERMISSION;
+
+	for (i = 0; i < numinst; i++) {
+	    if ((entry = fetch_proc_pid_statm(instlist[i], active_proc_pid, &sts)) == NULL)
+		status[i] = sts;
+	    else if (!(entry->success & PROC_PID_FLAG_STATM))
+		status[i] = 0;
+	    else
+		status[i] = proc_memory_fetch(item, entry, &atoms[i]);
+	}
+	break;
+
+    default:
+	return PM_ERR_NYI;
+    }
+
+    return 0;
+}
+
 static int
 proc_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 {
     int			i, sts, need_refresh[MAX_CLUSTER] = { 0 };
 
+    status_fields = 0;
     for (i = 0; i < numpmid; i++) {
 	unsigned int	cluster = pmID_cluster(pmidlist[i]);
 	if (cluster >= MIN_CLUSTER && cluster < MAX_CLUSTER)
 	    need_refresh[cluster]++;
+	if (cluster == CLUSTER_PID_STATUS || cluster == CLUSTER_HOTPROC_PID_STATUS)
+	    status_fields |= proc_status_fields(pmID_item(pmidlist[i]));
     }
     autogroup = -1;	/* reset, state not known for this fetch */
 
@@ -3851,7 +4124,13 @@ proc_strings_lookup(int index)
 int
 proc_strings_insert(const char *buf)
 {
-    return pmdaCacheStore(INDOM(STRINGS_INDOM), PMDA_CACHE_ADD, buf, NULL);
+    int		sts;
+
+    /* may be called from the refresh threads */
+    proc_worker_lock();
+    sts = pmdaCacheStore(INDOM(STRINGS_INDOM), PMDA_CACHE_ADD, buf, NULL);
+    proc_worker_unlock();
+    return sts;
 }
 
 char *
@@ -3948,6 +4227,7 @@ proc_init(pmdaInterface *dp)
     pmdaSetLabelCallBack(dp, proc_labelCallBack);
     pmdaSetEndContextCallBack(dp, proc_ctx_end);
     pmdaSetFetchCallBack(dp, proc_fetchCallBack);
+    pmdaSetFetchBatchCallBack(dp, proc_fetchBatchCallBack);
 
     /*
      * Initialize the instance domain table.
@@ -4015,17 +4295,19 @@ pmLongOptions	longopts[] = {
     PMDA_OPTIONS_HEADER("Options"),
     PMOPT_DEBUG,
     { "no-access-checks", 0, 'A', 0, "no access checks will be performed (insecure, beware!)" },
+    { "cgroup-inotify", 0, 'C', 0, "track cgroup hierarchies with inotify, rather than rescanning" },
     PMDAOPT_DOMAIN,
     PMDAOPT_LOGFILE,
     { "with-threads", 0, 'L', 0, "include threads in the all-processes instance domain" },
     { "from-cgroup", 1, 'r', "NAME", "restrict monitoring to processes in the named cgroup" },
     PMDAOPT_USERNAME,
+    { "workers", 1, 'w', "N", "refresh the processes using N additional threads" },
     PMOPT_HELP,
     PMDA_OPTIONS_END
 };
 
 pmdaOptions	opts = {
-    .short_options = "AD:d:l:Lr:U:?",
+    .short_options = "ACD:d:l:Lr:U:w:?",
     .long_options = longopts,
 };
 
@@ -4036,6 +4318,7 @@ main(int argc, char **argv)
     pmdaInterface	dispatch;
     char		helppath[MAXPATHLEN];
     char		*username = "root";
+    char		*endnum;
 
     _isDSO = 0;
     pmSetProgname(argv[0]);
@@ -4048,12 +4331,23 @@ main(int argc, char **argv)
 	case 'A':
 	    all_access = 1;
 	    break;
+	case 'C':
+	    cgroup_inotify = 1;
+	    break;
 	case 'L':
 	    threads = 1;
 	    break;
 	case 'r':
 	    cgroups = opts.optarg;
 	    break;
+	case 'w':
+	    workers = (int)strtol(opts.optarg, &endnum, 10);
+	    if (*endnum != '\0' || workers < 0) {
+		pmprintf("%s: -w requires a non-negative number of threads\n",
+			pmGetProgname());
+		opts.errors++;
+	    }
+	    break;
 	}
     }
 
@@ -4068,6 +4362,8 @@ main(int argc, char **argv)
     pmSetProcessIdentity(username);
 
     proc_init(&dispatch);
+    workers = proc_refresh_stats.workers = proc_worker_init(workers);
+    proc_dirfd_init();
     pmdaConnect(&dispatch);
     pmdaMain(&dispatch);
     exit(0);
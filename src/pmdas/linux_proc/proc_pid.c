@@ -23,25 +23,46 @@
 #include <string.h>
 #include <ctype.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/syslog.h>
 #include <sys/types.h>
+#include <sys/resource.h>
 #include <pwd.h>
 #include <grp.h>
 #include "proc_pid.h"
 #include "indom.h"
 #include "cgroups.h"
 #include "hotproc.h"
+#include "worker.h"
+#include "../linux/procscan.h"
+
+#define DIRFD_MAXLIMIT	(1<<20)	/* most /proc/<pid> directories kept open */
 
 static size_t	procbuflen;
 static char	*procbuf;
 
+/* read buffers for the refresh threads, see refresh_proc_pidwork() */
+typedef struct {
+    size_t	len;
+    char	*buf;
+} proc_buf_t;
+
+static proc_buf_t	*workbufs;
+static proc_pid_entry_t	**worklist;	/* processes to refresh in parallel */
+static int		maxworklist;
+static unsigned int	workfields;	/* PROC_STATUS_FIELD_* the threads parse */
+
+proc_refresh_t	proc_refresh_stats;
+
 static proc_pid_list_t procpids; /* previous pids list that the proc pmda uses */
-static void refresh_proc_pidlist(proc_pid_t *, proc_pid_list_t *, proc_runq_t *);
-static int refresh_proc_pid_stat(proc_pid_entry_t *);
-static int refresh_proc_pid_status(proc_pid_entry_t *);
-static int refresh_proc_pid_io(proc_pid_entry_t *);
-static int refresh_proc_pid_schedstat(proc_pid_entry_t *);
+static void refresh_proc_pidlist(proc_pid_t *, proc_pid_list_t *, proc_runq_t *, int, unsigned int);
+static int refresh_proc_pid_stat(proc_pid_entry_t *, size_t *, char **);
+static int refresh_proc_pid_statm(proc_pid_entry_t *, size_t *, char **);
+static int refresh_proc_pid_status(proc_pid_entry_t *, unsigned int, size_t *, char **);
+static int refresh_proc_pid_io(proc_pid_entry_t *, size_t *, char **);
+static int refresh_proc_pid_schedstat(proc_pid_entry_t *, size_t *, char **);
+static void proc_dirfd_close(proc_pid_entry_t *);
 
 /* Hotproc variables */
 
@@ -456,7 +477,7 @@ hotproc_eval_procs(void)
 
     /* Whats running right now */
     refresh_global_pidlist(0, &hotpids);
-    refresh_proc_pidlist(hotproc_poss_pid, &hotpids, NULL);
+    refresh_proc_pidlist(hotproc_poss_pid, &hotpids, NULL, -1, 0);
 
     pmtimevalNow(&timestamp);
 
@@ -472,10 +493,10 @@ hotproc_eval_procs(void)
 	}
 
 	/* Collect all the stat/status/statm info */
-	refresh_proc_pid_stat(entry);
-	refresh_proc_pid_status(entry);
-	refresh_proc_pid_io(entry);
-	refresh_proc_pid_schedstat(entry);
+	refresh_proc_pid_stat(entry, &procbuflen, &procbuf);
+	refresh_proc_pid_status(entry, PROC_STATUS_FIELD_ALL, &procbuflen, &procbuf);
+	refresh_proc_pid_io(entry, &procbuflen, &procbuf);
+	refresh_proc_pid_schedstat(entry, &procbuflen, &procbuf);
 
         /* Note: /proc/pid/schedstat and /proc/pid/io not on all platforms */
 	if (!(entry->success & PROC_PID_FLAG_STAT) ||
@@ -765,25 +786,209 @@ refresh_proc_runq(proc_pid_entry_t *ep, proc_runq_t *runq)
     }
 }
 
+/*
+ * Name a process newly added to the hash table, from its command line
+ * (or its status file for a swapped out process).
+ */
 static void
-refresh_proc_pidlist(proc_pid_t *proc_pid, proc_pid_list_t *pids, proc_runq_t *runq)
+refresh_proc_pid_name(proc_pid_entry_t *ep)
 {
-    int			i, fd, numinst, idx = 0;
+    int			fd, k = 0;
     char		*p, buf[MAXPATHLEN];
+
+    pmsprintf(buf, sizeof(buf), "%s/proc/%d/cmdline", proc_statspath, ep->id);
+    if ((fd = open(buf, O_RDONLY)) >= 0) {
+	int numlen = pmsprintf(buf, sizeof(buf), "%06d ", ep->id);
+	if ((k = read(fd, buf+numlen, sizeof(buf)-numlen)) > 0) {
+	    p = buf + k + numlen;
+	    if (p - buf >= sizeof(buf))
+		p--;
+	    *p-- = '\0';
+	    /* Skip trailing nils, i.e. don't replace them */
+	    while (buf+numlen < p) {
+		if (*p-- != '\0') {
+			break;
+		}
+	    }
+	    /* Remove NULL terminators from cmdline string array */
+	    while (buf+numlen < p) {
+		if (*p == '\0') *p = ' ';
+		p--;
+	    }
+	}
+	close(fd);
+    }
+    else if (pmDebugOptions.appl1 && pmDebugOptions.desperate) {
+	fprintf(stderr, "%s: open(\"%s\", O_RDONLY) failed: %s\n",
+		"refresh_proc_pidlist", buf, pmErrStr(-oserror()));
+    }
+    if (k == 0) {
+	/*
+	 * If a process is swapped out, /proc/<pid>/cmdline
+	 * returns an empty string so we have to get it
+	 * from /proc/<pid>/status or /proc/<pid>/stat
+	 */
+	pmsprintf(buf, sizeof(buf), "%s/proc/%d/status", proc_statspath, ep->id);
+	if ((fd = open(buf, O_RDONLY)) >= 0) {
+	    /* We engage in a bit of a hanky-panky here:
+	     * the string should look like "123456 (name)",
+	     * we get it from /proc/XX/status as "Name:   name\n...",
+	     * to fit the 6 digits of PID and opening parenthesis, 
+             * save 2 bytes at the start of the buffer. 
+             * And don't forget to leave 2 bytes for the trailing 
+	     * parenthesis and the nil. Here is
+	     * an example of what we're trying to achieve:
+	     * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+	     * |  |  | N| a| m| e| :|\t| i| n| i| t|\n| S|...
+	     * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+	     * | 0| 0| 0| 0| 0| 1|  | (| i| n| i| t| )|\0|...
+	     * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+ */
+	    if ((k = read(fd, buf+2, sizeof(buf)-4)) > 0) {
+		int bc;
+
+		if ((p = strchr(buf+2, '\n')) == NULL)
+		    p = buf+k;
+		p[0] = ')'; 
+		p[1] = '\0';
+		bc = pmsprintf(buf, sizeof(buf), "%06d ", ep->id); 
+		buf[bc] = '(';
+	    }
+	    close(fd);
+	}
+	else if (pmDebugOptions.appl1 && pmDebugOptions.desperate) {
+	    fprintf(stderr, "%s: open(\"%s\", O_RDONLY) failed: %s\n",
+		    "refresh_proc_pidlist", buf, pmErrStr(-oserror()));
+	}
+    }
+
+    if (k <= 0) {
+	/* hmm .. must be exiting */
+	pmsprintf(buf, sizeof(buf), "%06d <exiting>", ep->id);
+    }
+
+    if ((ep->name = strdup(buf)) != NULL)
+	ep->psargs = index(ep->name, ' ') + 1;
+    else
+	ep->psargs = NULL;
+}
+
+static void
+refresh_proc_pid_instname(proc_pid_entry_t *ep)
+{
+    char		*p;
+
+    /*
+     * The external instance name is the pid followed by
+     * a copy of the psargs truncated at the first space.
+     * e.g. "012345 /path/to/command". Command line args,
+     * if any, are truncated. The full command line is
+     * available in the proc.psinfo.psargs metric.
+     */
+    if (ep->name == NULL)
+	return;
+    if ((p = strchr(ep->name, ' ')) != NULL) {
+	if ((p = strchr(p+1, ' ')) != NULL) {
+	    int len = p - ep->name;
+	    if (len > PROC_PID_STAT_CMD_MAXLEN)
+		len = PROC_PID_STAT_CMD_MAXLEN;
+	    ep->instname = (char *)malloc(len+1);
+	    strncpy(ep->instname, ep->name, len);
+	    ep->instname[len] = '\0';
+	}
+    }
+    if (ep->instname == NULL) /* no spaces found, so use the full name */
+	ep->instname = strndup(ep->name, PROC_PID_STAT_CMD_MAXLEN);
+}
+
+/*
+ * Refresh one process from the worklist, on any of the refresh threads:
+ * name it if it is new, then read the files in the want mask.  Only
+ * the hash entry for the process is updated (apart from the strings
+ * cache, which is serialised by proc_worker_lock), and each thread has
+ * its own read buffer.
+ *
+ * Files that cannot be read are not marked as fetched, so the usual
+ * fetch path tries them again and reports the error.
+ */
+static void
+refresh_proc_pidwork(void *arg, int item, int self)
+{
+    proc_pid_entry_t	*ep = worklist[item];
+    proc_buf_t		*bp = &workbufs[self];
+    int			want = *(int *)arg;
+
+    if (ep->name == NULL)
+	refresh_proc_pid_name(ep);
+    if (ep->instname == NULL)
+	refresh_proc_pid_instname(ep);
+
+    if (want & PROC_PID_FLAG_STAT)
+	refresh_proc_pid_stat(ep, &bp->len, &bp->buf);
+    if (want & PROC_PID_FLAG_STATM)
+	refresh_proc_pid_statm(ep, &bp->len, &bp->buf);
+    if (want & PROC_PID_FLAG_STATUS)
+	refresh_proc_pid_status(ep, workfields, &bp->len, &bp->buf);
+    if (want & PROC_PID_FLAG_IO)
+	refresh_proc_pid_io(ep, &bp->len, &bp->buf);
+    if (want & PROC_PID_FLAG_SCHEDSTAT)
+	refresh_proc_pid_schedstat(ep, &bp->len, &bp->buf);
+}
+
+/*
+ * Update the hash table and indom for the processes in pids.
+ *
+ * If there are refresh threads and want is not negative, new processes
+ * are named by the threads, and the files in the want mask (a set of
+ * PROC_PID_FLAG_* values) are read for every process at the same time,
+ * parsing the status_fields lines of any status files.
+ * Otherwise (want < 0 for the hotproc timer, which runs in signal
+ * context) everything is done here, and nothing beyond the names.
+ */
+static void
+refresh_proc_pidlist(proc_pid_t *proc_pid, proc_pid_list_t *pids, proc_runq_t *runq, int want,
+		unsigned int status_fields)
+{
+    int			i, numinst, nwork = 0, idx = 0, evict;
+    int			parallel = (want >= 0 && proc_worker_threads() > 1);
     __pmHashNode	*node, *next, *prev;
     proc_pid_entry_t	*ep;
     pmdaIndom		*indomp = proc_pid->indom;
 
     /*
-     * invalidate all entries so we can harvest pids that have exited
+     * invalidate all entries so we can harvest pids that have exited,
+     * and make room for new processes to cache their /proc directory
+     * if that has run out, see proc_dirfd()
      */
+    evict = (proc_refresh_stats.dirfd_limit > 0 &&
+	     proc_refresh_stats.dirfd_cached >= proc_refresh_stats.dirfd_limit);
     for (i=0; i < proc_pid->pidhash.hsize; i++) {
 	for (node=proc_pid->pidhash.hash[i]; node != NULL; node = node->next) {
 	    ep = (proc_pid_entry_t *)node->data;
 	    ep->fetched = ep->success = 0;
+	    if (evict && ep->dirfd >= 0 &&
+		ep->dirfd_used + 1 < proc_refresh_stats.count) {
+		proc_dirfd_close(ep);
+		proc_refresh_stats.dirfd_evicted++;
+	    }
 	}
     }
 
+    if (parallel) {
+	if (workbufs == NULL)
+	    workbufs = (proc_buf_t *)calloc(proc_worker_threads(), sizeof(proc_buf_t));
+	if (pids->count > maxworklist) {
+	    proc_pid_entry_t	**tmp;
+
+	    tmp = (proc_pid_entry_t **)realloc(worklist, pids->count * sizeof(worklist[0]));
+	    if (tmp != NULL) {
+		worklist = tmp;
+		maxworklist = pids->count;
+	    }
+	}
+	if (workbufs == NULL || pids->count > maxworklist)
+	    parallel = 0;
+    }
+
     /*
      * walk pid list and add new pids to the hash table,
      * marking entries valid as we go ...
@@ -793,119 +998,36 @@ refresh_proc_pidlist(proc_pid_t *proc_pid, proc_pid_list_t *pids, proc_runq_t *r
 	if (node)
 	    ep = (proc_pid_entry_t *)node->data;
 	else {
-	    int k = 0;
-
 	    ep = (proc_pid_entry_t *)malloc(sizeof(proc_pid_entry_t));
 	    memset(ep, 0, sizeof(proc_pid_entry_t));
 
 	    ep->id = pids->pids[i];
-
-	    pmsprintf(buf, sizeof(buf), "%s/proc/%d/cmdline", proc_statspath, pids->pids[i]);
-	    if ((fd = open(buf, O_RDONLY)) >= 0) {
-		int numlen = pmsprintf(buf, sizeof(buf), "%06d ", pids->pids[i]);
-		if ((k = read(fd, buf+numlen, sizeof(buf)-numlen)) > 0) {
-		    p = buf + k + numlen;
-		    if (p - buf >= sizeof(buf))
-			p--;
-		    *p-- = '\0';
-		    /* Skip trailing nils, i.e. don't replace them */
-		    while (buf+numlen < p) {
-			if (*p-- != '\0') {
-				break;
-			}
-		    }
-		    /* Remove NULL terminators from cmdline string array */
-		    while (buf+numlen < p) {
-			if (*p == '\0') *p = ' ';
-			p--;
-		    }
-		}
-		close(fd);
-	    }
-	    else if (pmDebugOptions.appl1 && pmDebugOptions.desperate) {
-		fprintf(stderr, "%s: open(\"%s\", O_RDONLY) failed: %s\n",
-			"refresh_proc_pidlist", buf, pmErrStr(-oserror()));
-	    }
-	    if (k == 0) {
-		/*
-		 * If a process is swapped out, /proc/<pid>/cmdline
-		 * returns an empty string so we have to get it
-		 * from /proc/<pid>/status or /proc/<pid>/stat
-		 */
-		pmsprintf(buf, sizeof(buf), "%s/proc/%d/status", proc_statspath, pids->pids[i]);
-		if ((fd = open(buf, O_RDONLY)) >= 0) {
-		    /* We engage in a bit of a hanky-panky here:
-		     * the string should look like "123456 (name)",
-		     * we get it from /proc/XX/status as "Name:   name\n...",
-		     * to fit the 6 digits of PID and opening parenthesis, 
-	             * save 2 bytes at the start of the buffer. 
-	             * And don't forget to leave 2 bytes for the trailing 
-		     * parenthesis and the nil. Here is
-		     * an example of what we're trying to achieve:
-		     * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+
-		     * |  |  | N| a| m| e| :|\t| i| n| i| t|\n| S|...
-		     * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+
-		     * | 0| 0| 0| 0| 0| 1|  | (| i| n| i| t| )|\0|...
-		     * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+ */
-		    if ((k = read(fd, buf+2, sizeof(buf)-4)) > 0) {
-			int bc;
-
-			if ((p = strchr(buf+2, '\n')) == NULL)
-			    p = buf+k;
-			p[0] = ')'; 
-			p[1] = '\0';
-			bc = pmsprintf(buf, sizeof(buf), "%06d ", pids->pids[i]); 
-			buf[bc] = '(';
-		    }
-		    close(fd);
-		}
-		else if (pmDebugOptions.appl1 && pmDebugOptions.desperate) {
-		    fprintf(stderr, "%s: open(\"%s\", O_RDONLY) failed: %s\n",
-			    "refresh_proc_pidlist", buf, pmErrStr(-oserror()));
-		}
-	    }
-
-	    if (k <= 0) {
-		/* hmm .. must be exiting */
-	    	pmsprintf(buf, sizeof(buf), "%06d <exiting>", pids->pids[i]);
-	    }
-
-	    if ((ep->name = strdup(buf)) != NULL)
-		ep->psargs = index(ep->name, ' ') + 1;
-	    else
-		ep->psargs = NULL;
+	    ep->dirfd = -1;
+	    if (!parallel)
+		refresh_proc_pid_name(ep);
 
 	    __pmHashAdd(pids->pids[i], (void *)ep, &proc_pid->pidhash);
-	    //fprintf(stderr, "key %d : ADDED \"%s\" to hash table\n", pids->pids[i], buf);
+	    //fprintf(stderr, "key %d : ADDED \"%s\" to hash table\n", pids->pids[i], ep->name);
 	}
 
-	if (ep->instname == NULL) {
-	   /*
-	     * The external instance name is the pid followed by
-	     * a copy of the psargs truncated at the first space.
-	     * e.g. "012345 /path/to/command". Command line args,
-	     * if any, are truncated. The full command line is
-	     * available in the proc.psinfo.psargs metric.
-	     */
-	    if ((p = strchr(ep->name, ' ')) != NULL) {
-	        if ((p = strchr(p+1, ' ')) != NULL) {
-	            int len = p - ep->name;
-		    if (len > PROC_PID_STAT_CMD_MAXLEN)
-			len = PROC_PID_STAT_CMD_MAXLEN;
-	            ep->instname = (char *)malloc(len+1);
-	            strncpy(ep->instname, ep->name, len);
-	            ep->instname[len] = '\0';
-	        }
-	    }
-	    if (ep->instname == NULL) /* no spaces found, so use the full name */
-	        ep->instname = strndup(ep->name, PROC_PID_STAT_CMD_MAXLEN);
+	if (parallel) {
+	    /* (once only, should a pid appear twice) */
+	    if (!(ep->fetched & PROC_PID_FLAG_VALID))
+		worklist[nwork++] = ep;
 	}
+	else if (ep->instname == NULL)
+	    refresh_proc_pid_instname(ep);
 	
 	/* mark pid as valid (new or still running) */
 	ep->fetched |= PROC_PID_FLAG_VALID;
 	ep->success |= PROC_PID_FLAG_VALID;
     }
 
+    if (parallel) {
+	workfields = status_fields;
+	proc_worker_run(nwork, refresh_proc_pidwork, &want);
+    }
+
     /* 
      * harvest pids that have exit'ed
      */
@@ -935,6 +1057,8 @@ refresh_proc_pidlist(proc_pid_t *proc_pid, proc_pid_list_t *pids, proc_runq_t *r
 		    free(ep->wchan_buf);
 		if (ep->environ_buf != NULL)
 		    free(ep->environ_buf);
+		if (ep->dirfd >= 0)
+		    proc_dirfd_close(ep);
 	    	if (prev == NULL)
 		    proc_pid->pidhash.hash[i] = node->next;
 		else
@@ -967,7 +1091,7 @@ refresh_proc_pidlist(proc_pid_t *proc_pid, proc_pid_list_t *pids, proc_runq_t *r
 	for (node=proc_pid->pidhash.hash[i]; node != NULL; node=node->next) {
 	    ep = (proc_pid_entry_t *)node->data;
 	    if (runq) {
-		refresh_proc_pid_stat(ep);
+		refresh_proc_pid_stat(ep, &procbuflen, &procbuf);
 		refresh_proc_runq(ep, runq);
 	    }
 	    refresh_proc_indom_entry(ep, indomp, idx++);
@@ -978,11 +1102,16 @@ refresh_proc_pidlist(proc_pid_t *proc_pid, proc_pid_list_t *pids, proc_runq_t *r
 int
 refresh_proc_pid(proc_pid_t *proc_pid, proc_runq_t *proc_runq,
 		 int want_threads, const char *cgroups,
-		 const char *container, int namelen)
+		 const char *container, int namelen, int want,
+		 unsigned int status_fields)
 {
+    struct timeval	start, end;
     char		path[MAXPATHLEN];
-    int			sts, want_cgroups;
+    int			sts, want_cgroups, parallel;
     const char		*filter = cgroups;
+    uint64_t		latency;
+
+    pmtimevalNow(&start);
 
     want_cgroups = container || (cgroups && cgroups[0] != '\0');
 
@@ -1004,7 +1133,21 @@ refresh_proc_pid(proc_pid_t *proc_pid, proc_runq_t *proc_runq,
 		"refresh_proc_pid", procpids.count, procpids.threads,
 		container ? "container" : "cgroups", filter ? filter : "");
 
-    refresh_proc_pidlist(proc_pid, &procpids, proc_runq);
+    /*
+     * The hotproc timer reuses the read buffer and pid lists, so hold
+     * it off while the refresh threads are busy.
+     */
+    if ((parallel = (proc_worker_threads() > 1)))
+	__pmAFblock();
+    refresh_proc_pidlist(proc_pid, &procpids, proc_runq, want, status_fields);
+    if (parallel)
+	__pmAFunblock();
+
+    pmtimevalNow(&end);
+    latency = (uint64_t)(pmtimevalSub(&end, &start) * 1000000);
+    proc_refresh_stats.count++;
+    proc_refresh_stats.time += latency;
+    proc_refresh_stats.latency = latency;
     return 0;
 }
 
@@ -1019,11 +1162,111 @@ refresh_hotproc_pid(proc_pid_t *proc_pid, int threads, const char *cgroups)
     if ((sts = refresh_hotproc_pidlist(&hotpids)) < 0)
 	return sts;
 
-    refresh_proc_pidlist(proc_pid, &hotpids, NULL);
+    refresh_proc_pidlist(proc_pid, &hotpids, NULL, 0, 0);
     return 0;
 }
 
 
+/*
+ * Each process keeps its /proc/<pid> directory (or /proc/<pid>/task/<pid>
+ * for threads) open once it has been read from, so the files in it are
+ * opened with openat(2) rather than by resolving the full path again.
+ * An open directory refers to the process, not the pid, so files cannot
+ * be opened through it once the process exits - even if the pid has been
+ * reused, when the directory is reopened by name.
+ *
+ * The number of open directories is bounded by the open files limit,
+ * see proc_dirfd_init().  Beyond that new processes use paths, until
+ * some directories are closed by the next refresh, when processes exit
+ * or the least recently used have not been read from for two refreshes.
+ */
+void
+proc_dirfd_init(void)
+{
+    struct rlimit	limit;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) < 0) {
+	pmNotifyErr(LOG_ERR, "Cannot %s open file limits\n", "get");
+	return;
+    }
+    if (limit.rlim_cur < limit.rlim_max) {
+	limit.rlim_cur = limit.rlim_max;
+	if (setrlimit(RLIMIT_NOFILE, &limit) < 0) {
+	    pmNotifyErr(LOG_ERR, "Cannot %s open file limits\n", "adjust");
+	    getrlimit(RLIMIT_NOFILE, &limit);
+	}
+    }
+    /* leave half the descriptors for everything else */
+    if (limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur / 2 > DIRFD_MAXLIMIT)
+	proc_refresh_stats.dirfd_limit = DIRFD_MAXLIMIT;
+    else
+	proc_refresh_stats.dirfd_limit = limit.rlim_cur / 2;
+    if (pmDebugOptions.appl1)
+	fprintf(stderr, "proc_dirfd_init: cache up to %u directories\n",
+		proc_refresh_stats.dirfd_limit);
+}
+
+static void
+proc_dirfd_close(proc_pid_entry_t *ep)
+{
+    close(ep->dirfd);
+    ep->dirfd = -1;
+    __sync_fetch_and_sub(&proc_refresh_stats.dirfd_cached, 1);
+}
+
+/*
+ * Return the cached directory for ep, opening it if there is room.
+ * The refresh threads only ever pass in their own processes, so ep
+ * needs no locking, and the shared counters are updated atomically.
+ */
+static int
+proc_dirfd(proc_pid_entry_t *ep)
+{
+    char		buf[128];
+
+    if (ep->dirfd >= 0) {
+	if (ep->dirfd_threads == procpids.threads)
+	    return ep->dirfd;
+	proc_dirfd_close(ep);
+    }
+    if (__sync_add_and_fetch(&proc_refresh_stats.dirfd_cached, 1) >
+	proc_refresh_stats.dirfd_limit) {
+	__sync_fetch_and_sub(&proc_refresh_stats.dirfd_cached, 1);
+	return -1;
+    }
+    if (procpids.threads)
+	pmsprintf(buf, sizeof(buf), "%s/proc/%d/task/%d",
+			proc_statspath, ep->id, ep->id);
+    else
+	pmsprintf(buf, sizeof(buf), "%s/proc/%d", proc_statspath, ep->id);
+    if ((ep->dirfd = open(buf, O_RDONLY|O_DIRECTORY|O_CLOEXEC)) < 0) {
+	if (pmDebugOptions.appl1 && pmDebugOptions.desperate)
+	    fprintf(stderr, "%s: open(\"%s\", O_DIRECTORY) failed: %s\n",
+			    "proc_dirfd", buf, pmErrStr(-oserror()));
+	__sync_fetch_and_sub(&proc_refresh_stats.dirfd_cached, 1);
+	return -1;
+    }
+    ep->dirfd_threads = procpids.threads;
+    __sync_fetch_and_add(&proc_refresh_stats.dirfd_opened, 1);
+    return ep->dirfd;
+}
+
+/*
+ * After a failed openat(2) - has the process gone?  Every process and
+ * task directory has a stat file, until the process exits.
+ */
+static int
+proc_dirfd_stale(proc_pid_entry_t *ep)
+{
+    int			sts = oserror();
+    int			stale;
+
+    stale = (sts == ENOENT || sts == ESRCH) &&
+	    faccessat(ep->dirfd, "stat", F_OK, 0) < 0;
+    setoserror(sts);
+    return stale;
+}
+
 /*
  * Open a proc file, taking into account that we may want thread info
  * rather than process information.
@@ -1036,9 +1279,33 @@ refresh_hotproc_pid(proc_pid_t *proc_pid, int threads, const char *cgroups)
 static int
 proc_open(const char *base, proc_pid_entry_t *ep)
 {
-    int			fd;
+    int			fd, dirfd, retry = 1;
     char		buf[128];
 
+again:
+    if ((dirfd = proc_dirfd(ep)) >= 0) {
+	if ((fd = openat(dirfd, base, O_RDONLY)) >= 0) {
+	    ep->dirfd_used = proc_refresh_stats.count;
+	    __sync_fetch_and_add(&proc_refresh_stats.dirfd_hits, 1);
+	    if (pmDebugOptions.appl1 && pmDebugOptions.desperate)
+		fprintf(stderr, "%s: dirfd=%d: %s -> fd=%d\n",
+				"proc_open", dirfd, base, fd);
+	    return fd;
+	}
+	if (pmDebugOptions.appl1 && pmDebugOptions.desperate)
+	    fprintf(stderr, "%s: openat(%d, \"%s\", O_RDONLY) failed: %s\n",
+			    "proc_open", dirfd, base, pmErrStr(-oserror()));
+	if (proc_dirfd_stale(ep)) {
+	    proc_dirfd_close(ep);	/* exited, try the pid again by name */
+	    if (retry--)
+		goto again;
+	}
+	else if (ep->dirfd_threads)
+	    goto process;		/* fallback to /proc path, as below */
+	else
+	    return fd;			/* no such file, or no permission */
+    }
+
     if (procpids.threads) {
 	pmsprintf(buf, sizeof(buf), "%s/proc/%d/task/%d/%s",
 			proc_statspath, ep->id, ep->id, base);
@@ -1055,6 +1322,7 @@ proc_open(const char *base, proc_pid_entry_t *ep)
 	    return fd;
 	}
     }
+process:
     pmsprintf(buf, sizeof(buf), "%s/proc/%d/%s", proc_statspath, ep->id, base);
     fd = open(buf, O_RDONLY);
     if (fd < 0) {
@@ -1071,26 +1339,21 @@ static DIR *
 proc_opendir(const char *base, proc_pid_entry_t *ep)
 {
     DIR			*dir;
+    int			fd, sts;
     char		buf[128];
 
-    if (procpids.threads) {
-	pmsprintf(buf, sizeof(buf), "%s/proc/%d/task/%d/%s", proc_statspath, ep->id, ep->id, base);
-	if ((dir = opendir(buf)) != NULL) {
-	    return dir;
-	}
-	else {
-	    if (pmDebugOptions.appl1 && pmDebugOptions.desperate)
-		fprintf(stderr, "%s: opendir(\"%s\") failed: %s\n",
-				"proc_opendir", buf, pmErrStr(-oserror()));
-	}
-	/* fallback to /proc path if task path opendir fails */
-    }
-    pmsprintf(buf, sizeof(buf), "%s/proc/%d/%s", proc_statspath, ep->id, base);
-    dir = opendir(buf);
-    if (dir == NULL) {
-	if (pmDebugOptions.appl1 && pmDebugOptions.desperate)
-	    fprintf(stderr, "%s: opendir(\"%s\") failed: %s\n",
+    /* fd and fdinfo are opened by the proc_open() rules */
+    if ((fd = proc_open(base, ep)) < 0)
+	return NULL;
+    if ((dir = fdopendir(fd)) == NULL) {
+	if (pmDebugOptions.appl1 && pmDebugOptions.desperate) {
+	    pmsprintf(buf, sizeof(buf), "%s/proc/%d/%s", proc_statspath, ep->id, base);
+	    fprintf(stderr, "%s: fdopendir(\"%s\") failed: %s\n",
 			    "proc_opendir", buf, pmErrStr(-oserror()));
+	}
+	sts = oserror();
+	close(fd);
+	setoserror(sts);
     }
     return dir;
 }
@@ -1172,6 +1435,68 @@ read_proc_entry(int fd, size_t *lenp, char **bufp)
     return sts;
 }
 
+/*
+ * Read a file holding a single record, like stat, statm, status, io and
+ * schedstat, straight into the (reused) buffer.  procfs returns such a
+ * record whole, so a short read means there is no more to come and the
+ * read that would return end-of-file is skipped.  Mostly it takes one
+ * read, where read_proc_entry() takes one per kilobyte and one more.
+ *
+ * The buffer is always allocated one byte longer than *lenp, as it is
+ * for read_proc_entry(), which shares some of these buffers.
+ */
+static int
+read_proc_record(int fd, size_t *lenp, char **bufp)
+{
+    size_t		len = 0, size;
+    ssize_t		n;
+    char		*p;
+    int			reads = 0, sts = 0;
+
+    if (*lenp < 1024) {
+	if ((p = (char *)realloc(*bufp, 1024+1)) == NULL)
+	    return -ENOMEM;
+	*bufp = p;
+	*lenp = 1024;
+    }
+    for (;;) {
+	reads++;
+	if ((n = read(fd, *bufp + len, *lenp - len)) <= 0)
+	    break;
+	len += n;
+	if (len < *lenp)
+	    break;
+	/* filled the buffer, there may be more */
+	size = *lenp * 2;
+	if ((p = (char *)realloc(*bufp, size+1)) == NULL) {
+	    sts = -ENOMEM;
+	    break;
+	}
+	*bufp = p;
+	*lenp = size;
+    }
+
+    if (len > 0) {
+	(*bufp)[len] = '\0';
+	/* compared to read_proc_entry() */
+	if ((len + 1023) / 1024 + 1 > reads)
+	    __sync_fetch_and_add(&proc_refresh_stats.reads_saved,
+				 (len + 1023) / 1024 + 1 - reads);
+    }
+    else if (sts == 0) {
+	/* invalid read */
+	if (n < 0)
+	    sts = maperr();
+	else {
+	    sts = PM_ERR_VALUE;
+	    if (pmDebugOptions.appl1 && pmDebugOptions.desperate)
+		fprintf(stderr, "%s: fd=%d: no data\n", "read_proc_record", fd);
+	}
+    }
+
+    return sts;
+}
+
 static void
 parse_proc_stat(proc_pid_entry_t *ep, size_t buflen, char *buf)
 {
@@ -1193,52 +1518,52 @@ parse_proc_stat(proc_pid_entry_t *ep, size_t buflen, char *buf)
     ep->stat.state[0] = p[0];
 
     /* the rest are numeric values */
-    ep->stat.ppid = strtoul(++p, &p, 10);
-    ep->stat.pgrp = strtoul(++p, &p, 10);
-    ep->stat.session = strtoul(++p, &p, 10);
-    ep->stat.tty = strtoul(++p, &p, 10);
-    ep->stat.tty_pgrp = strtol(++p, &p, 10);
-    ep->stat.flags = strtoul(++p, &p, 10);
-    ep->stat.minflt = strtoul(++p, &p, 10);
-    ep->stat.cminflt = strtoul(++p, &p, 10);
-    ep->stat.majflt = strtoul(++p, &p, 10);
-    ep->stat.cmajflt = strtoul(++p, &p, 10);
-    ep->stat.utime = strtoull(++p, &p, 10);
-    ep->stat.stime = strtoull(++p, &p, 10);
-    ep->stat.cutime = strtoull(++p, &p, 10);
-    ep->stat.cstime = strtoull(++p, &p, 10);
-    ep->stat.priority = strtol(++p, &p, 10);
-    ep->stat.nice = strtol(++p, &p, 10);
-    strtoul(++p, &p, 10); /* threads, we use /proc/pid/status */
-    ep->stat.it_real_value = strtoul(++p, &p, 10);
-    ep->stat.start_time = strtoull(++p, &p, 10);
-    ep->stat.vsize = strtoull(++p, &p, 10);
-    ep->stat.rss = strtoull(++p, &p, 10);
-    ep->stat.rss_rlim = strtoull(++p, &p, 10);
-    ep->stat.start_code = strtoul(++p, &p, 10);
-    ep->stat.end_code = strtoul(++p, &p, 10);
-    ep->stat.start_stack = strtoul(++p, &p, 10);
-    ep->stat.esp = strtoul(++p, &p, 10);
-    ep->stat.eip = strtoul(++p, &p, 10);
-    ep->stat.signal = strtoul(++p, &p, 10);
-    ep->stat.blocked = strtoul(++p, &p, 10);
-    ep->stat.sigignore = strtoul(++p, &p, 10);
-    ep->stat.sigcatch = strtoul(++p, &p, 10);
-    ep->stat.wchan = strtoul(++p, &p, 10);
-    ep->stat.nswap = strtoul(++p, &p, 10);
-    ep->stat.cnswap = strtoul(++p, &p, 10);
-    ep->stat.exit_signal = strtoul(++p, &p, 10);
-    ep->stat.processor = strtoul(++p, &p, 10);
-    ep->stat.priority = strtoul(++p, &p, 10);
-    ep->stat.rtpriority = strtoul(++p, &p, 10);
-    ep->stat.policy = strtoul(++p, &p, 10);
-    ep->stat.delayacct_blkio_time = strtoull(++p, &p, 10);
-    ep->stat.guest_time = strtoull(++p, &p, 10);
-    ep->stat.cguest_time = strtoull(++p, &p, 10);
+    p++;
+    ep->stat.ppid = scan_ull(&p);
+    ep->stat.pgrp = scan_ull(&p);
+    ep->stat.session = scan_ull(&p);
+    ep->stat.tty = scan_ull(&p);
+    ep->stat.tty_pgrp = scan_ll(&p);
+    ep->stat.flags = scan_ull(&p);
+    ep->stat.minflt = scan_ull(&p);
+    ep->stat.cminflt = scan_ull(&p);
+    ep->stat.majflt = scan_ull(&p);
+    ep->stat.cmajflt = scan_ull(&p);
+    ep->stat.utime = scan_ull(&p);
+    ep->stat.stime = scan_ull(&p);
+    ep->stat.cutime = scan_ull(&p);
+    ep->stat.cstime = scan_ull(&p);
+    ep->stat.priority = scan_ll(&p);
+    ep->stat.nice = scan_ll(&p);
+    scan_ull(&p); /* threads, we use /proc/pid/status */
+    ep->stat.it_real_value = scan_ull(&p);
+    ep->stat.start_time = scan_ull(&p);
+    ep->stat.vsize = scan_ull(&p);
+    ep->stat.rss = scan_ull(&p);
+    ep->stat.rss_rlim = scan_ull(&p);
+    ep->stat.start_code = scan_ull(&p);
+    ep->stat.end_code = scan_ull(&p);
+    ep->stat.start_stack = scan_ull(&p);
+    ep->stat.esp = scan_ull(&p);
+    ep->stat.eip = scan_ull(&p);
+    ep->stat.signal = scan_ull(&p);
+    ep->stat.blocked = scan_ull(&p);
+    ep->stat.sigignore = scan_ull(&p);
+    ep->stat.sigcatch = scan_ull(&p);
+    ep->stat.wchan = scan_ull(&p);
+    ep->stat.nswap = scan_ull(&p);
+    ep->stat.cnswap = scan_ull(&p);
+    ep->stat.exit_signal = scan_ull(&p);
+    ep->stat.processor = scan_ull(&p);
+    ep->stat.rtpriority = scan_ull(&p);
+    ep->stat.policy = scan_ull(&p);
+    ep->stat.delayacct_blkio_time = scan_ull(&p);
+    ep->stat.guest_time = scan_ull(&p);
+    ep->stat.cguest_time = scan_ull(&p);
 }
 
 static int
-refresh_proc_pid_stat(proc_pid_entry_t *ep)
+refresh_proc_pid_stat(proc_pid_entry_t *ep, size_t *lenp, char **bufp)
 {
     int			fd, sts;
 
@@ -1246,8 +1571,8 @@ refresh_proc_pid_stat(proc_pid_entry_t *ep)
 	return 0;
     if ((fd = proc_open("stat", ep)) < 0)
 	return maperr();
-    if ((sts = read_proc_entry(fd, &procbuflen, &procbuf)) >= 0) {
-	parse_proc_stat(ep, procbuflen, procbuf);
+    if ((sts = read_proc_record(fd, lenp, bufp)) >= 0) {
+	parse_proc_stat(ep, *lenp, *bufp);
 	ep->success |= PROC_PID_FLAG_STAT;
     }
     close(fd);
@@ -1266,7 +1591,7 @@ fetch_proc_pid_stat(int id, proc_pid_t *proc_pid, int *sts)
     if (!ep)
 	return NULL;
     if (!(ep->fetched & PROC_PID_FLAG_STAT)) {
-	*sts = refresh_proc_pid_stat(ep);
+	*sts = refresh_proc_pid_stat(ep, &procbuflen, &procbuf);
 	ep->fetched |= PROC_PID_FLAG_STAT;
     }
     return (*sts < 0) ? NULL : ep;
@@ -1390,9 +1715,10 @@ parse_string_value(char **buf, size_t length, int commasep)
 }
 
 static void
-parse_proc_status(proc_pid_entry_t *ep, size_t buflen, char *buf)
+parse_proc_status(proc_pid_entry_t *ep, unsigned int want, size_t buflen, char *buf)
 {
     char		*curline = buf;
+    unsigned int	found = 0;
 
     /*
      * Expecting something like ...
@@ -1436,14 +1762,18 @@ parse_proc_status(proc_pid_entry_t *ep, size_t buflen, char *buf)
      * Mems_allowed_list:	0
      * voluntary_ctxt_switches:	225
      * nonvoluntary_ctxt_switches:	56
+     *
+     * Parsing stops once all of the wanted lines have been found; if it
+     * reaches the end, any lines not found are not provided by this kernel.
      */
     ep->status.flags = 0;
-    while (curline) {
+    while (curline && (found & want) != want) {
 	switch (*curline) {
 	case 'C':
 	    if (strncmp(curline, "Cpus_allowed_list:", 18) == 0) {
 		ep->status.cpusallowed = parse_string_value(&curline, 19, 0);
 		ep->status.flags |= PROC_STATUS_FLAG_CPUSALLOWED;
+		found |= PROC_STATUS_FIELD_CPUSALLOWED;
 	    } else
 		goto nomatch;
 	    break;
@@ -1451,6 +1781,7 @@ parse_proc_status(proc_pid_entry_t *ep, size_t buflen, char *buf)
 	    if (strncmp(curline, "envID:", 6) == 0) {
 		ep->status.envid = strtoul(curline + 7, &curline, 0);
 		ep->status.flags |= PROC_STATUS_FLAG_ENVID;
+		found |= PROC_STATUS_FIELD_ENVID;
 	    } else
 		goto nomatch;
 	    break;
@@ -1460,52 +1791,65 @@ parse_proc_status(proc_pid_entry_t *ep, size_t buflen, char *buf)
 		ep->status.egid = strtoul(++curline, &curline, 10);
 		ep->status.sgid = strtoul(++curline, &curline, 10);
 		ep->status.fsgid = strtoul(++curline, &curline, 10);
+		found |= PROC_STATUS_FIELD_GID;
 	    } else
 		goto nomatch;
 	    break;
 	case 'N':
 	    if (strncmp(curline, "Ngid:", 5) == 0) {
-		ep->status.ngid = parse_string_value(&curline, 6, 0);
+		ep->status.ngid = strtoul(curline + 6, &curline, 0);
 		ep->status.flags |= PROC_STATUS_FLAG_NGID;
+		found |= PROC_STATUS_FIELD_NGID;
 	    } else if (strncmp(curline, "NStgid:", 7) == 0) {
 		ep->status.nstgid = parse_string_value(&curline, 8, 1);
 		ep->status.flags |= PROC_STATUS_FLAG_NSTGID;
+		found |= PROC_STATUS_FIELD_NSTGID;
 	    } else if (strncmp(curline, "NSpid:", 6) == 0) {
 		ep->status.nspid = parse_string_value(&curline, 7, 1);
 		ep->status.flags |= PROC_STATUS_FLAG_NSPID;
+		found |= PROC_STATUS_FIELD_NSPID;
 	    } else if (strncmp(curline, "NSpgid:", 7) == 0) {
 		ep->status.nspgid = parse_string_value(&curline, 8, 1);
 		ep->status.flags |= PROC_STATUS_FLAG_NSPGID;
+		found |= PROC_STATUS_FIELD_NSPGID;
 	    } else if (strncmp(curline, "NSsid:", 6) == 0) {
 		ep->status.nssid = parse_string_value(&curline, 7, 1);
 		ep->status.flags |= PROC_STATUS_FLAG_NSSID;
+		found |= PROC_STATUS_FIELD_NSSID;
 	    } else
 		goto nomatch;
 	    break;
 	case 'n':
-	    if (strncmp(curline, "nonvoluntary_ctxt_switches:", 27) == 0)
+	    if (strncmp(curline, "nonvoluntary_ctxt_switches:", 27) == 0) {
 		ep->status.nvctxsw = strtoul(curline + 28, &curline, 0);
-	    else
+		found |= PROC_STATUS_FIELD_NVCTXSW;
+	    } else
 		goto nomatch;
 	    break;
 	case 'S':
-	    if (strncmp(curline, "SigPnd:", 7) == 0)
+	    if (strncmp(curline, "SigPnd:", 7) == 0) {
 		ep->status.sigpnd = parse_string_value(&curline, 8, 0);
-	    else if (strncmp(curline, "SigBlk:", 7) == 0)
+		found |= PROC_STATUS_FIELD_SIGPND;
+	    } else if (strncmp(curline, "SigBlk:", 7) == 0) {
 		ep->status.sigblk = parse_string_value(&curline, 8, 0);
-	    else if (strncmp(curline, "SigIgn:", 7) == 0)
+		found |= PROC_STATUS_FIELD_SIGBLK;
+	    } else if (strncmp(curline, "SigIgn:", 7) == 0) {
 		ep->status.sigign = parse_string_value(&curline, 8, 0);
-	    else if (strncmp(curline, "SigCgt:", 7) == 0)
+		found |= PROC_STATUS_FIELD_SIGIGN;
+	    } else if (strncmp(curline, "SigCgt:", 7) == 0) {
 		ep->status.sigcgt = parse_string_value(&curline, 8, 0);
-	    else
+		found |= PROC_STATUS_FIELD_SIGCGT;
+	    } else
 		goto nomatch;
 	    break;
 	case 'T':
-	    if (strncmp(curline, "Threads:", 8) == 0)
+	    if (strncmp(curline, "Threads:", 8) == 0) {
 		ep->status.threads = strtoul(curline + 9, &curline, 0);
-	    else if (strncmp(curline, "Tgid:", 5) == 0) {
+		found |= PROC_STATUS_FIELD_THREADS;
+	    } else if (strncmp(curline, "Tgid:", 5) == 0) {
 		ep->status.tgid = strtoul(curline + 6, &curline, 0);
 		ep->status.flags |= PROC_STATUS_FLAG_TGID;
+		found |= PROC_STATUS_FIELD_TGID;
 	    } else
 		goto nomatch;
 	    break;
@@ -1515,41 +1859,55 @@ parse_proc_status(proc_pid_entry_t *ep, size_t buflen, char *buf)
 		ep->status.euid = strtoul(++curline, &curline, 10);
 		ep->status.suid = strtoul(++curline, &curline, 10);
 		ep->status.fsuid = strtoul(++curline, &curline, 10);
+		found |= PROC_STATUS_FIELD_UID;
 	    } else
 		goto nomatch;
 	    break;
 	case 'V':
-	    if (strncmp(curline, "VmPeak:", 7) == 0)
+	    if (strncmp(curline, "VmPeak:", 7) == 0) {
 		ep->status.vmpeak = strtoul(curline + 8, &curline, 0);
-	    else if (strncmp(curline, "VmSize:", 7) == 0)
+		found |= PROC_STATUS_FIELD_VMPEAK;
+	    } else if (strncmp(curline, "VmSize:", 7) == 0) {
 		ep->status.vmsize = strtoul(curline + 8, &curline, 0);
-	    else if (strncmp(curline, "VmLck:", 6) == 0)
+		found |= PROC_STATUS_FIELD_VMSIZE;
+	    } else if (strncmp(curline, "VmLck:", 6) == 0) {
 		ep->status.vmlck = strtoul(curline + 7, &curline, 0);
-	    else if (strncmp(curline, "VmPin:", 6) == 0)
+		found |= PROC_STATUS_FIELD_VMLCK;
+	    } else if (strncmp(curline, "VmPin:", 6) == 0) {
 		ep->status.vmpin = strtoul(curline + 7, &curline, 0);
-	    else if (strncmp(curline, "VmHWM:", 6) == 0)
+		found |= PROC_STATUS_FIELD_VMPIN;
+	    } else if (strncmp(curline, "VmHWM:", 6) == 0) {
 		ep->status.vmhwm = strtoul(curline + 7, &curline, 0);
-	    else if (strncmp(curline, "VmRSS:", 6) == 0)
+		found |= PROC_STATUS_FIELD_VMHWM;
+	    } else if (strncmp(curline, "VmRSS:", 6) == 0) {
 		ep->status.vmrss = strtoul(curline + 7, &curline, 0);
-	    else if (strncmp(curline, "VmData:", 7) == 0)
+		found |= PROC_STATUS_FIELD_VMRSS;
+	    } else if (strncmp(curline, "VmData:", 7) == 0) {
 		ep->status.vmdata = strtoul(curline + 8, &curline, 0);
-	    else if (strncmp(curline, "VmStk:", 6) == 0)
+		found |= PROC_STATUS_FIELD_VMDATA;
+	    } else if (strncmp(curline, "VmStk:", 6) == 0) {
 		ep->status.vmstk = strtoul(curline + 7, &curline, 0);
-	    else if (strncmp(curline, "VmExe:", 6) == 0)
+		found |= PROC_STATUS_FIELD_VMSTK;
+	    } else if (strncmp(curline, "VmExe:", 6) == 0) {
 		ep->status.vmexe = strtoul(curline + 7, &curline, 0);
-	    else if (strncmp(curline, "VmLib:", 6) == 0)
+		found |= PROC_STATUS_FIELD_VMEXE;
+	    } else if (strncmp(curline, "VmLib:", 6) == 0) {
 		ep->status.vmlib = strtoul(curline + 7, &curline, 0);
-	    else if (strncmp(curline, "VmPTE:", 6) == 0)
+		found |= PROC_STATUS_FIELD_VMLIB;
+	    } else if (strncmp(curline, "VmPTE:", 6) == 0) {
 		ep->status.vmpte = strtoul(curline + 7, &curline, 0);
-	    else if (strncmp(curline, "VmSwap:", 7) == 0)
+		found |= PROC_STATUS_FIELD_VMPTE;
+	    } else if (strncmp(curline, "VmSwap:", 7) == 0) {
 		ep->status.vmswap = strtoul(curline + 7, &curline, 0);
-	    else
+		found |= PROC_STATUS_FIELD_VMSWAP;
+	    } else
 		goto nomatch;
 	    break;
 	case 'v':
-	    if (strncmp(curline, "voluntary_ctxt_switches:", 24) == 0)
+	    if (strncmp(curline, "voluntary_ctxt_switches:", 24) == 0) {
 		ep->status.vctxsw = strtoul(curline + 25, &curline, 0);
-	    else
+		found |= PROC_STATUS_FIELD_VCTXSW;
+	    } else
 		goto nomatch;
 	    break;
 
@@ -1566,19 +1924,21 @@ parse_proc_status(proc_pid_entry_t *ep, size_t buflen, char *buf)
 	}
 	if (curline != NULL) curline++;
     }
+    ep->status.fields = curline ? found : PROC_STATUS_FIELD_ALL;
 }
 
 static int
-refresh_proc_pid_status(proc_pid_entry_t *ep)
+refresh_proc_pid_status(proc_pid_entry_t *ep, unsigned int want, size_t *lenp, char **bufp)
 {
     int			fd, sts;
 
-    if (ep->success & PROC_PID_FLAG_STATUS)
+    if ((ep->success & PROC_PID_FLAG_STATUS) &&
+	(ep->status.fields & want) == want)
 	return 0;
     if ((fd = proc_open("status", ep)) < 0)
 	return maperr();
-    if ((sts = read_proc_entry(fd, &procbuflen, &procbuf)) == 0) {
-	parse_proc_status(ep, procbuflen, procbuf);
+    if ((sts = read_proc_record(fd, lenp, bufp)) == 0) {
+	parse_proc_status(ep, want, *lenp, *bufp);
 	ep->success |= PROC_PID_FLAG_STATUS;
     }
     close(fd);
@@ -1586,10 +1946,11 @@ refresh_proc_pid_status(proc_pid_entry_t *ep)
 }
 
 /*
- * fetch a proc/<pid>/status entry for pid
+ * fetch a proc/<pid>/status entry for pid, parsing at least the
+ * lines in want (PROC_STATUS_FIELD_* values)
  */
 proc_pid_entry_t *
-fetch_proc_pid_status(int id, proc_pid_t *proc_pid, int *sts)
+fetch_proc_pid_status(int id, proc_pid_t *proc_pid, unsigned int want, int *sts)
 {
     proc_pid_entry_t	*ep = proc_pid_entry_lookup(id, proc_pid);
 
@@ -1598,7 +1959,7 @@ fetch_proc_pid_status(int id, proc_pid_t *proc_pid, int *sts)
 	return NULL;
 
     if (!(ep->fetched & PROC_PID_FLAG_STATUS)) {
-	*sts = refresh_proc_pid_status(ep);
+	*sts = refresh_proc_pid_status(ep, want, &procbuflen, &procbuf);
 	ep->fetched |= PROC_PID_FLAG_STATUS;
     }
     return (*sts < 0) ? NULL : ep;
@@ -1619,7 +1980,7 @@ parse_proc_statm(proc_pid_entry_t *ep, size_t buflen, char *buf)
 }
 
 static int
-refresh_proc_pid_statm(proc_pid_entry_t *ep)
+refresh_proc_pid_statm(proc_pid_entry_t *ep, size_t *lenp, char **bufp)
 {
     int			fd, sts;
 
@@ -1627,8 +1988,8 @@ refresh_proc_pid_statm(proc_pid_entry_t *ep)
 	return 0;
     if ((fd = proc_open("statm", ep)) < 0)
 	return maperr();
-    if ((sts = read_proc_entry(fd, &procbuflen, &procbuf)) == 0) {
-	parse_proc_statm(ep, procbuflen, procbuf);
+    if ((sts = read_proc_record(fd, lenp, bufp)) == 0) {
+	parse_proc_statm(ep, *lenp, *bufp);
 	ep->success |= PROC_PID_FLAG_STATM;
     }
     close(fd);
@@ -1648,7 +2009,7 @@ fetch_proc_pid_statm(int id, proc_pid_t *proc_pid, int *sts)
     	return NULL;
 
     if (!(ep->fetched & PROC_PID_FLAG_STATM)) {
-	*sts = refresh_proc_pid_statm(ep);
+	*sts = refresh_proc_pid_statm(ep, &procbuflen, &procbuf);
 	ep->fetched |= PROC_PID_FLAG_STATM;
     }
     return (*sts < 0) ? NULL : ep;
@@ -1715,7 +2076,7 @@ parse_proc_schedstat(proc_pid_entry_t *ep, size_t buflen, char *buf)
 }
 
 static int 
-refresh_proc_pid_schedstat(proc_pid_entry_t *ep)
+refresh_proc_pid_schedstat(proc_pid_entry_t *ep, size_t *lenp, char **bufp)
 {
     int			fd, sts;
 
@@ -1723,8 +2084,8 @@ refresh_proc_pid_schedstat(proc_pid_entry_t *ep)
 	return 0;
     if ((fd = proc_open("schedstat", ep)) < 0)
 	return maperr();
-    if ((sts = read_proc_entry(fd, &procbuflen, &procbuf)) >= 0) {
-	parse_proc_schedstat(ep, procbuflen, procbuf);
+    if ((sts = read_proc_record(fd, lenp, bufp)) >= 0) {
+	parse_proc_schedstat(ep, *lenp, *bufp);
 	ep->success |= PROC_PID_FLAG_SCHEDSTAT;
     }
     close(fd);
@@ -1744,7 +2105,7 @@ fetch_proc_pid_schedstat(int id, proc_pid_t *proc_pid, int *sts)
 	return NULL;
 
     if (!(ep->fetched & PROC_PID_FLAG_SCHEDSTAT)) {
-	*sts = refresh_proc_pid_schedstat(ep);
+	*sts = refresh_proc_pid_schedstat(ep, &procbuflen, &procbuf);
 	ep->fetched |= PROC_PID_FLAG_SCHEDSTAT;
     }
     return (*sts < 0) ? NULL : ep;
@@ -1794,7 +2155,7 @@ parse_proc_io(proc_pid_entry_t *ep, size_t buflen, char *buf)
 }
 
 static int
-refresh_proc_pid_io(proc_pid_entry_t *ep)
+refresh_proc_pid_io(proc_pid_entry_t *ep, size_t *lenp, char **bufp)
 {
     int			fd, sts;
 
@@ -1802,8 +2163,8 @@ refresh_proc_pid_io(proc_pid_entry_t *ep)
 	return 0;
     if ((fd = proc_open("io", ep)) < 0)
 	return maperr();
-    if ((sts = read_proc_entry(fd, &procbuflen, &procbuf)) >= 0) {
-	parse_proc_io(ep, procbuflen, procbuf);
+    if ((sts = read_proc_record(fd, lenp, bufp)) >= 0) {
+	parse_proc_io(ep, *lenp, *bufp);
 	ep->success |= PROC_PID_FLAG_IO;
     }
     close(fd);
@@ -1829,7 +2190,7 @@ fetch_proc_pid_io(int id, proc_pid_t *proc_pid, int *sts)
 	return NULL;
 
     if (!(ep->fetched & PROC_PID_FLAG_IO)) {
-	*sts = refresh_proc_pid_io(ep);
+	*sts = refresh_proc_pid_io(ep, &procbuflen, &procbuf);
 	ep->fetched |= PROC_PID_FLAG_IO;
     }
     return (*sts < 0) ? NULL : ep;
@@ -98,11 +98,50 @@ enum {
     PROC_STATUS_FLAG_CPUSALLOWED	= 1<<8,
 };
 
+/*
+ * lines of /proc/<pid>/status, so that parsing can stop once the
+ * lines wanted for a fetch have been seen
+ */
+enum {
+    PROC_STATUS_FIELD_UID		= 1<<0,
+    PROC_STATUS_FIELD_GID		= 1<<1,
+    PROC_STATUS_FIELD_TGID		= 1<<2,
+    PROC_STATUS_FIELD_NGID		= 1<<3,
+    PROC_STATUS_FIELD_NSTGID		= 1<<4,
+    PROC_STATUS_FIELD_NSPID		= 1<<5,
+    PROC_STATUS_FIELD_NSPGID		= 1<<6,
+    PROC_STATUS_FIELD_NSSID		= 1<<7,
+    PROC_STATUS_FIELD_ENVID		= 1<<8,
+    PROC_STATUS_FIELD_VMPEAK		= 1<<9,
+    PROC_STATUS_FIELD_VMSIZE		= 1<<10,
+    PROC_STATUS_FIELD_VMLCK		= 1<<11,
+    PROC_STATUS_FIELD_VMPIN		= 1<<12,
+    PROC_STATUS_FIELD_VMHWM		= 1<<13,
+    PROC_STATUS_FIELD_VMRSS		= 1<<14,
+    PROC_STATUS_FIELD_VMDATA		= 1<<15,
+    PROC_STATUS_FIELD_VMSTK		= 1<<16,
+    PROC_STATUS_FIELD_VMEXE		= 1<<17,
+    PROC_STATUS_FIELD_VMLIB		= 1<<18,
+    PROC_STATUS_FIELD_VMPTE		= 1<<19,
+    PROC_STATUS_FIELD_VMSWAP		= 1<<20,
+    PROC_STATUS_FIELD_THREADS		= 1<<21,
+    PROC_STATUS_FIELD_SIGPND		= 1<<22,
+    PROC_STATUS_FIELD_SIGBLK		= 1<<23,
+    PROC_STATUS_FIELD_SIGIGN		= 1<<24,
+    PROC_STATUS_FIELD_SIGCGT		= 1<<25,
+    PROC_STATUS_FIELD_CPUSALLOWED	= 1<<26,
+    PROC_STATUS_FIELD_VCTXSW		= 1<<27,
+    PROC_STATUS_FIELD_NVCTXSW		= 1<<28,
+
+    PROC_STATUS_FIELD_ALL		= (1<<29)-1,
+};
+
 /*
  * metrics in /proc/<pid>/status
  */
 typedef struct {
     int		flags;
+    unsigned int fields;	/* PROC_STATUS_FIELD_* values parsed */
     uint32_t	ngid;
     uint32_t	tgid;
     uint32_t	uid;
@@ -313,6 +352,11 @@ typedef struct {
 
     /* /proc/<pid>/fdinfo cluster */
     proc_pid_fdinfo_t	fdinfo;
+
+    /* cached /proc/<pid> (or task) directory, see proc_open() */
+    int			dirfd;
+    int			dirfd_threads;	/* dirfd is /proc/<pid>/task/<pid> */
+    uint64_t		dirfd_used;	/* proc.refresh.count at last use */
 } proc_pid_entry_t;
 
 typedef struct {
@@ -327,11 +371,32 @@ typedef struct {
     int			threads;	/* /proc/PID/{xxx,task/PID/xxx} flag */
 } proc_pid_list_t;
 
+/*
+ * Process indom refresh instrumentation (proc.refresh metrics)
+ */
+typedef struct {
+    uint32_t		workers;	/* refresh threads (-w) */
+    uint64_t		count;		/* number of refreshes */
+    uint64_t		time;		/* total refresh time (usec) */
+    uint64_t		latency;	/* most recent refresh time (usec) */
+    uint32_t		dirfd_limit;	/* most directories kept open */
+    uint32_t		dirfd_cached;	/* directories open right now */
+    uint64_t		dirfd_opened;	/* directories opened for caching */
+    uint64_t		dirfd_evicted;	/* idle directories closed early */
+    uint64_t		dirfd_hits;	/* files opened via a cached directory */
+    uint64_t		reads_saved;	/* read calls avoided, see read_proc_record */
+} proc_refresh_t;
+
+extern proc_refresh_t proc_refresh_stats;
+
+/* set the bound on cached /proc/<pid> directories from RLIMIT_NOFILE */
+extern void proc_dirfd_init(void);
+
 /* lookup a proc hash entry */
 extern proc_pid_entry_t *proc_pid_entry_lookup(int, proc_pid_t *);
 
-/* refresh the proc indom, reset all "fetched" flags */
-extern int refresh_proc_pid(proc_pid_t *, proc_runq_t *, int, const char *, const char *, int);
+/* refresh the proc indom, reset all "fetched" flags, read files for all pids */
+extern int refresh_proc_pid(proc_pid_t *, proc_runq_t *, int, const char *, const char *, int, int, unsigned int);
 
 /* refresh the hotproc indom, checking against the current configuration */
 extern int refresh_hotproc_pid(proc_pid_t *, int, const char *);
@@ -363,8 +428,8 @@ extern proc_pid_entry_t *fetch_proc_pid_environ(int, proc_pid_t *, int *);
 /* fetch a proc/<pid>/statm entry for pid */
 extern proc_pid_entry_t *fetch_proc_pid_statm(int, proc_pid_t *, int *);
 
-/* fetch a proc/<pid>/status entry for pid */
-extern proc_pid_entry_t *fetch_proc_pid_status(int, proc_pid_t *, int *);
+/* fetch a proc/<pid>/status entry for pid, parsing the PROC_STATUS_FIELD_* lines given */
+extern proc_pid_entry_t *fetch_proc_pid_status(int, proc_pid_t *, unsigned int, int *);
 
 /* fetch a proc/<pid>/smaps_rollup entry for pid */
 extern proc_pid_entry_t *fetch_proc_pid_smaps(int, proc_pid_t *, int *);
@@ -0,0 +1,190 @@
+/*
+ * Pool of threads for refreshing the process instance domain (-w)
+ *
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * proc_worker_run() hands out the items (processes) in chunks, to the
+ * worker threads and to the main thread, until none are left.  The
+ * chunks are small enough that a few slow /proc/<pid> reads do not
+ * hold up the rest of the refresh.
+ *
+ * Everything else in pmdaproc stays single threaded: the jobs must
+ * only update state that belongs to the item they are given, apart
+ * from code serialised by proc_worker_lock().
+ */
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include <signal.h>
+#include "worker.h"
+
+#define MINCHUNK	8	/* fewest items taken at a time */
+
+static pthread_mutex_t	pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	pool_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	pool_idle = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t	job_lock = PTHREAD_MUTEX_INITIALIZER;
+static int		nworkers;
+static unsigned int	generation;	/* bumped by each proc_worker_run() */
+static int		busy;		/* workers still busy in this run */
+static void		(*job)(void *, int, int);
+static void		*jobarg;
+static int		jobitems;	/* items in this run */
+static int		jobnext;	/* next item not yet taken */
+static int		jobchunk;	/* items taken at a time */
+
+/* do chunks of work items until there are none left */
+static void
+drain(int self)
+{
+    int		first, last;
+
+    for (;;) {
+	PM_LOCK(pool_lock);
+	first = jobnext;
+	if ((last = first + jobchunk) > jobitems)
+	    last = jobitems;
+	jobnext = last;
+	PM_UNLOCK(pool_lock);
+	if (first >= last)
+	    break;
+	for (; first < last; first++)
+	    (*job)(jobarg, first, self);
+    }
+}
+
+static void *
+worker(void *arg)
+{
+    int			self = (int)(__psint_t)arg;
+    unsigned int	seen = 0;
+
+    for (;;) {
+	PM_LOCK(pool_lock);
+	while (generation == seen)
+	    pthread_cond_wait(&pool_work, &pool_lock);
+	seen = generation;
+	PM_UNLOCK(pool_lock);
+
+	drain(self);
+
+	PM_LOCK(pool_lock);
+	if (--busy == 0)
+	    pthread_cond_signal(&pool_idle);
+	PM_UNLOCK(pool_lock);
+    }
+    return NULL;
+}
+
+/*
+ * Start n worker threads, once only, returning the number started.
+ */
+int
+proc_worker_init(int n)
+{
+    pthread_t	tid;
+    sigset_t	all, saved;
+    int		i, sts;
+
+    if (n <= 0 || nworkers > 0)
+	return nworkers;
+
+    /* signals, including the hotproc timer, belong to the main thread */
+    sigfillset(&all);
+    sigdelset(&all, SIGSEGV);
+    sigdelset(&all, SIGBUS);
+    sigdelset(&all, SIGFPE);
+    sigdelset(&all, SIGILL);
+    pthread_sigmask(SIG_BLOCK, &all, &saved);
+    for (i = 0; i < n; i++) {
+	if ((sts = pthread_create(&tid, NULL, worker, (void *)(__psint_t)(i + 1))) != 0) {
+	    pmNotifyErr(LOG_ERR, "proc_worker_init: pthread_create: %s\n",
+			pmErrStr(-sts));
+	    break;
+	}
+	pthread_detach(tid);
+    }
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+    nworkers = i;
+    if (pmDebugOptions.appl1)
+	fprintf(stderr, "proc_worker_init: %d refresh threads\n", nworkers);
+    return nworkers;
+}
+
+/*
+ * Number of threads that proc_worker_run() jobs may run on, so the
+ * self argument to a job is always less than this.
+ */
+int
+proc_worker_threads(void)
+{
+    return nworkers + 1;
+}
+
+/*
+ * Call fn(arg, i, self) for items i = 0 .. n-1, spread across the
+ * worker threads and this (the main) thread, returning when they are
+ * all done.  self identifies the calling thread, zero for the main
+ * thread, for per-thread buffers.
+ */
+void
+proc_worker_run(int n, void (*fn)(void *, int, int), void *arg)
+{
+    int		i;
+
+    if (n <= 0)
+	return;
+    if (nworkers == 0) {
+	for (i = 0; i < n; i++)
+	    (*fn)(arg, i, 0);
+	return;
+    }
+
+    /* the workers are all idle here */
+    PM_LOCK(pool_lock);
+    job = fn;
+    jobarg = arg;
+    jobitems = n;
+    jobnext = 0;
+    /* about eight chunks for each thread, to even out slow processes */
+    if ((jobchunk = n / (8 * (nworkers + 1))) < MINCHUNK)
+	jobchunk = MINCHUNK;
+    busy = nworkers;
+    generation++;
+    pthread_cond_broadcast(&pool_work);
+    PM_UNLOCK(pool_lock);
+
+    drain(0);
+
+    PM_LOCK(pool_lock);
+    while (busy > 0)
+	pthread_cond_wait(&pool_idle, &pool_lock);
+    PM_UNLOCK(pool_lock);
+}
+
+void
+proc_worker_lock(void)
+{
+    if (nworkers > 0)
+	PM_LOCK(job_lock);
+}
+
+void
+proc_worker_unlock(void)
+{
+    if (nworkers > 0)
+	PM_UNLOCK(job_lock);
+}
@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+#ifndef _WORKER_H
+#define _WORKER_H
+
+/*
+ * Pool of threads for refreshing the process instance domain (-w)
+ */
+extern int proc_worker_init(int);	/* start the threads, returns count */
+extern int proc_worker_threads(void);	/* workers plus the main thread */
+extern void proc_worker_run(int, void (*)(void *, int, int), void *);
+extern void proc_worker_lock(void);	/* serialise non-reentrant code */
+extern void proc_worker_unlock(void);
+
+#endif /* _WORKER_H */
@@ -17,6 +17,7 @@
 #include "deprecated.h"
 #include "pmda.h"
 #include "stats.h"
+#include "pmlogger/src/logstats.h"
 #include "pmcd/src/pmcd.h"
 #include "pmcd/src/client.h"
 #include <sys/stat.h>
@@ -97,6 +98,18 @@ static pmDesc	desctab[] = {
     { PMDA_PMID(0,29), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
 /* control.creds_timeout */
     { PMDA_PMID(0,30), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,1,0,0,PM_TIME_SEC,0) },
+/* buf.malloc */
+    { PMDA_PMID(0,31), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* buf.reuse */
+    { PMDA_PMID(0,32), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* control.fetchcache */
+    { PMDA_PMID(0,33), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,1,0,0,PM_TIME_MSEC,0) },
+/* fetchcache.hits */
+    { PMDA_PMID(0,34), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* fetchcache.misses */
+    { PMDA_PMID(0,35), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* fetchcache.coalesced */
+    { PMDA_PMID(0,36), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
 
 /* pdu_in.error */
     { PMDA_PMID(1,0), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
@@ -204,6 +217,20 @@ static pmDesc	desctab[] = {
     { PMDA_PMID(3,2), PM_TYPE_STRING, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
 /* pmlogger.host */
     { PMDA_PMID(3,3), PM_TYPE_STRING, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
+/* pmlogger.write.bytes */
+    { PMDA_PMID(3,4), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(1,0,0,PM_SPACE_BYTE,0,0) },
+/* pmlogger.write.records */
+    { PMDA_PMID(3,5), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* pmlogger.write.flushes */
+    { PMDA_PMID(3,6), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* pmlogger.write.time */
+    { PMDA_PMID(3,7), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) },
+/* pmlogger.write.pending */
+    { PMDA_PMID(3,8), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_INSTANT, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* pmlogger.write.latency */
+    { PMDA_PMID(3,9), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_USEC,0) },
+/* pmlogger.fetch.pipelined */
+    { PMDA_PMID(3,10), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
 
 /* agent.type */
     { PMDA_PMID(4,0), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
@@ -555,7 +582,8 @@ refresh_pmie_indom(void)
 				fullpath, osstrerror());
 		    continue;
 		}
-		if (statbuf.st_size != sizeof(pmiestats_t))
+		/* pmie -w appends per-thread data (pmiethreadstats_t) */
+		if (statbuf.st_size < sizeof(pmiestats_t))
 		    continue;
 		if  ((endp = strdup(dp->d_name)) == NULL) {
 		    pmNoMem("pmie iname", strlen(dp->d_name), PM_RECOV_ERR);
@@ -1062,6 +1090,41 @@ pmcd_instance(pmInDom indom, int inst, char *name, pmInResult **result, pmdaExt
     return 0;
 }
 
+/*
+ * Write statistics for the pmlogger with the given PID, from the file
+ * it maintains below PCP_TMP_DIR.  Older pmloggers (and those that
+ * cannot create the file) have none.
+ */
+static int
+logger_stats(__pmLogPort *lpp, int nports, int j, pmloggerstats_t *stats)
+{
+    char	path[MAXPATHLEN];
+    pid_t	pid = lpp[j].pid;
+    int		fd, sts;
+    int		k;
+
+    if (pid == PM_LOG_PRIMARY_PID) {
+	/* same pmlogger as the instance with the same port */
+	for (k = 0; k < nports; k++) {
+	    if (lpp[k].pid != PM_LOG_PRIMARY_PID && lpp[k].port == lpp[j].port)
+		break;
+	}
+	if (k == nports)
+	    return PM_ERR_VALUE;
+	pid = lpp[k].pid;
+    }
+    pmsprintf(path, sizeof(path), "%s%c%s%c%" FMT_PID,
+		pmGetConfig("PCP_TMP_DIR"), pmPathSeparator(),
+		PMLOGGER_STATS_SUBDIR, pmPathSeparator(), pid);
+    if ((fd = open(path, O_RDONLY)) < 0)
+	return PM_ERR_VALUE;
+    sts = read(fd, stats, sizeof(*stats));
+    close(fd);
+    if (sts != sizeof(*stats) || stats->version != 1)
+	return PM_ERR_VALUE;
+    return 0;
+}
+
 /*
  * numval != 1, so re-do vset[i] allocation
  */
@@ -1352,6 +1415,7 @@ pmcd_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
     static int		maxnpmids = 0;
     char		*host = NULL;	/* refresh max once per fetch */
     pmiestats_t		*pmie;
+    pmloggerstats_t	stats;
     pmValueSet		*vset;
     pmDesc		*dp = NULL;	/* initialize to pander to gcc */
     pmAtomValue		atom;
@@ -1587,6 +1651,32 @@ pmcd_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 				atom.ul = creds_timeout;
 				break;
 
+			case 31:	/* buf.malloc */
+			case 32:	/* buf.reuse */
+				{
+				    __uint64_t	allocs, reuses;
+
+				    __pmCountPDUBufReuse(&allocs, &reuses);
+				    atom.ull = (item == 31) ? allocs : reuses;
+				}
+				break;
+
+			case 33:	/* control.fetchcache */
+				atom.ul = pmcd_fetchcache;
+				break;
+
+			case 34:	/* fetchcache.hits */
+				atom.ull = pmcd_fetchcache_hits;
+				break;
+
+			case 35:	/* fetchcache.misses */
+				atom.ull = pmcd_fetchcache_misses;
+				break;
+
+			case 36:	/* fetchcache.coalesced */
+				atom.ull = pmcd_fetchcache_coalesced;
+				break;
+
 			default:
 				sts = atom.l = PM_ERR_PMID;
 				break;
@@ -1623,7 +1713,7 @@ pmcd_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 			atom.ul = __pmPDUCntOut[item-1];
 		    break;
 
-	    case 3:	/* pmlogger control port, pmcd_host, archive and host */
+	    case 3:	/* pmlogger control port, pmcd_host, archive, host, write */
 		    /* find all ports.  localhost => no recursive pmcd access */
 		    nports = __pmLogFindPort("localhost", PM_LOG_ALL_PIDS, &lpp);
 		    if (nports < 0) {
@@ -1644,6 +1734,9 @@ pmcd_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 		    for (j = numval = 0; j < nports; j++) {
 			if (!__pmInProfile(logindom, _profile, lpp[j].pid))
 			    continue;
+			/* no value for pmloggers without write statistics */
+			if (item >= 4 && logger_stats(lpp, nports, j, &stats) < 0)
+			    continue;
 			vset->vlist[numval].inst = lpp[j].pid;
 			switch (item) {
 			    case 0:		/* pmlogger.port */
@@ -1661,6 +1754,27 @@ pmcd_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 				    host = hostnameinfo();
                                 atom.cp = host;
 				break;
+			    case 4:		/* pmlogger.write.bytes */
+				atom.ull = stats.bytes;
+				break;
+			    case 5:		/* pmlogger.write.records */
+				atom.ull = stats.records;
+				break;
+			    case 6:		/* pmlogger.write.flushes */
+				atom.ull = stats.flushes;
+				break;
+			    case 7:		/* pmlogger.write.time */
+				atom.ull = stats.time;
+				break;
+			    case 8:		/* pmlogger.write.pending */
+				atom.ul = stats.pending;
+				break;
+			    case 9:		/* pmlogger.write.latency */
+				atom.ull = stats.latency;
+				break;
+			    case 10:		/* pmlogger.fetch.pipelined */
+				atom.ull = stats.pipelined;
+				break;
 			    default:
 				sts = atom.l = PM_ERR_PMID;
 				break;
@@ -1672,6 +1786,8 @@ pmcd_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 			valfmt = sts;
 			numval++;
 		    }
+		    if (sts >= 0)
+			vset->numval = numval;
 		    break;
 
 	    case 4:	/* PMDA metrics */
@@ -2013,6 +2129,18 @@ pmcd_store(pmResult *result, pmdaExt *pmda)
 		    creds_timeout = val;
 		}
 	    }
+	    else if (item == 33) { /* pmcd.control.fetchcache */
+		val = vsp->vlist[0].value.lval;
+		if (val < 0) {
+		    sts = PM_ERR_SIGN;
+		    break;
+		}
+		if (val != pmcd_fetchcache) {
+		    /* results shared before now are stale */
+		    pmcd_fetchcache = val;
+		    pmcd_fetchcache_epoch++;
+		}
+	    }
 	    else {
 		sts = PM_ERR_PMID;
 		break;
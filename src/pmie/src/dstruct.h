@@ -186,6 +186,7 @@ typedef struct fetch {
     int		   npmids;	/* number of metrics in fetch */
     pmID	   *pmids;	/* array of metric ids to fetch */
     pmResult       *result;     /* result of fetch */
+    int		   sts;		/* pmFetch status, for pmie -w */
 } Fetch;
 
 /* set of bundled fetches for single host (may be archive or live):
@@ -26,6 +26,7 @@
 #include "fun.h"
 #include "pragmatics.h"
 #include "show.h"
+#include "worker.h"
 
 int	run_done;
 
@@ -200,6 +201,23 @@ enable(Task *t)
 
 int	showTimeFlag = 0;	/* set when -e used on the command line */
 
+/*
+ * pmie -w ... evaluate everything for one rule except for actions,
+ * which are done afterwards in rule order, and rulesets, where the
+ * order of evaluation of the rules matters
+ */
+static void
+evalCond(void *arg, int i)
+{
+    Expr	*x = symValue(((Symbol *)arg)[i]);
+
+    if (x->op == RULE) {
+	EVALARG(x->arg1)
+    }
+    else if (x->op < NOP && x->op != CND_RULESET)
+	(x->eval)(x);
+}
+
 /* evaluate Task */
 static void
 eval(Task *task)
@@ -219,11 +237,16 @@ eval(Task *task)
 	return;
 
     /* evaluate rule expressions */
+    if (pmie_workers > 0)
+	workerRun(task->nrules, evalCond, task->rules, WORKER_EVAL);
     s = task->rules;
     for (i = 0; i < task->nrules; i++) {
 	curr = symValue(*s);
 	if (curr->op < NOP) {
-	    (curr->eval)(curr);
+	    if (pmie_workers == 0 || curr->op == CND_RULESET)
+		(curr->eval)(curr);
+	    else if (curr->op == RULE)
+		ruleAct(curr);
 	    perf->eval_actual++;
 	}
 	s++;
@@ -839,6 +862,7 @@ run(void)
 	return;
 
     inrun = 1;
+    workerInit();
 
     /* initialize task scheduling */
     t = taskq;
@@ -30,6 +30,7 @@
 
 /* expression evaluator function prototypes */
 void rule(Expr *);
+void ruleAct(Expr *);
 void ruleset(Expr *);
 void cndFetch_all(Expr *);
 void cndFetch_n(Expr *);
@@ -36,6 +36,7 @@
 #include "pragmatics.h"
 #include "eval.h"
 #include "show.h"
+#include "worker.h"
 
 /***********************************************************************
  * constants
@@ -110,6 +111,7 @@ static pmLongOptions longopts[] = {
     { "logfile", 1, 'l', "FILE", "send status and error messages to FILE" },
     { "note", 1, 'm', "MSG", "descriptive note" },
     { "username", 1, 'U', "USER", "run as named USER in daemon mode [default pcp]" },
+    { "workers", 1, 'w', "N", "fetch and evaluate rules with N worker threads [default 0]" },
     PMAPI_OPTIONS_HEADER("Reporting options"),
     { "buffer", 0, 'b', 0, "one line buffered output stream, stdout on stderr" },
     { "timestamp", 0, 'e', 0, "force timestamps to be reported with -V, -v or -W" },
@@ -125,7 +127,7 @@ static pmLongOptions longopts[] = {
 
 static pmOptions opts = {
     .flags = PM_OPTFLAG_STDOUT_TZ,
-    .short_options = "a:A:bc:CdD:efFHh:j:l:m:n:o:O:PqS:t:T:U:vVWXxzZ:?",
+    .short_options = "a:A:bc:CdD:efFHh:j:l:m:n:o:O:PqS:t:T:U:vVw:WXxzZ:?",
     .long_options = longopts,
     .short_usage = "[options] [filename ...]",
     .override = override,
@@ -338,6 +340,7 @@ startmonitor(void)
     int			fd;
     char		zero = '\0';
     char		pmie_dir[MAXPATHLEN];
+    size_t		size = sizeof(pmiestats_t);
 
     /* try to create the port file directory. OK if it already exists
      * - mode is 775 to match GNUmakefile
@@ -374,8 +377,12 @@ startmonitor(void)
 	perf = &instrument;
 	return;
     }
+    /* -w, per-thread data follows */
+    if (pmie_workers > 0)
+	size = PMIE_THREADSTATS_OFFSET + (pmie_workers + 1) * sizeof(pmiethreadstats_t);
+
     /* seek to struct size and write one zero */
-    if (lseek(fd, sizeof(pmiestats_t)-1, SEEK_SET) < 0) {
+    if (lseek(fd, size-1, SEEK_SET) < 0) {
 	fprintf(stderr, "%s: Warning: lseek failed for stats file %s: %s\n",
 		pmGetProgname(), perffile, osstrerror());
     }
@@ -385,12 +392,14 @@ startmonitor(void)
     }
 
     /* map perffile & associate the instrumentation struct with it */
-    if ((ptr = __pmMemoryMap(fd, sizeof(pmiestats_t), 1)) == NULL) {
+    if ((ptr = __pmMemoryMap(fd, size, 1)) == NULL) {
 	fprintf(stderr, "%s: memory map failed for stats file %s: %s\n",
 		pmGetProgname(), perffile, osstrerror());
 	perf = &instrument;
     } else {
 	perf = (pmiestats_t *)ptr;
+	if (pmie_workers > 0)
+	    threadperf = (pmiethreadstats_t *)((char *)ptr + PMIE_THREADSTATS_OFFSET);
     }
     close(fd);
 
@@ -503,6 +512,7 @@ getargs(int argc, char *argv[])
     char		*subopts;
     char		*subopt;
     char		*msg = NULL;
+    char		*endnum;
     int			checkFlag = 0;
     int			foreground = 0;
     int			primary = 0;
@@ -645,6 +655,15 @@ getargs(int argc, char *argv[])
 	    verbose = 2;
 	    break;
 
+	case 'w': 			/* size of worker thread pool */
+	    pmie_workers = (int)strtol(opts.optarg, &endnum, 10);
+	    if (*endnum != '\0' || pmie_workers < 0) {
+		pmprintf("%s: -w requires a non-negative numeric argument\n",
+			pmGetProgname());
+		opts.errors++;
+	    }
+	    break;
+
 	case 'W': 			/* print satisfying values */
 	    verbose = 3;
 	    break;
@@ -30,9 +30,11 @@
 int
 main(int argc, char **argv)
 {
-    int		fd;
-    int		sts;
-    pmiestats_t	stats;
+    int			fd;
+    int			sts;
+    int			i;
+    pmiestats_t		stats;
+    pmiethreadstats_t	thread;
 
     if (argc < 2) {
 	fprintf(stderr, "Usage: pmie_dump_stats file ...\n");
@@ -74,7 +76,19 @@ main(int argc, char **argv)
 	    printf("%s:eval_unknown=%d\n", p, stats.eval_unknown);
 	    printf("%s:eval_actual=%d\n", p, stats.eval_actual);
 	    printf("%s:version=%d\n", p, stats.version);
+
+	    /* pmie -w, per-thread data (main thread first) */
+	    if (lseek(fd, PMIE_THREADSTATS_OFFSET, SEEK_SET) == PMIE_THREADSTATS_OFFSET) {
+		for (i = 0; read(fd, &thread, sizeof(thread)) == sizeof(thread); i++) {
+		    printf("%s:thread%d_fetches=%u\n", p, i, thread.fetches);
+		    printf("%s:thread%d_fetch_time=%.6f\n", p, i, thread.fetch_time);
+		    printf("%s:thread%d_evals=%u\n", p, i, thread.evals);
+		    printf("%s:thread%d_eval_time=%.6f\n", p, i, thread.eval_time);
+		    printf("%s:thread%d_steals=%u\n", p, i, thread.steals);
+		}
+	    }
 	}
+	close(fd);
 	argc--;
 	argv++;
     }
@@ -30,6 +30,7 @@
 #include "dstruct.h"
 #include "eval.h"
 #include "pragmatics.h"
+#include "worker.h"
 #if defined(HAVE_IEEEFP_H)
 #include <ieeefp.h>
 #endif
@@ -1026,6 +1027,111 @@ mark_all(Host *hdown)
     }
 }
 
+/*
+ * check the status of a fetch for taskFetch(), returns -1 if pmie
+ * must exit (run_done is set)
+ */
+static int
+fetchDone(Fetch *f, int sts)
+{
+    Host	*h = f->host;
+
+    if (sts < 0) {
+	if (archives) {
+	    if (sts == PM_ERR_LOGREC) {
+		fprintf(stderr, "%s: pmFetch failed: %s\n", pmGetProgname(),
+			pmErrStr(sts));
+		exit(1);
+	    }
+	}
+	else {
+	    pmNotifyErr(LOG_ERR, "pmFetch from %s failed: %s\n",
+		    symName(f->host->name), pmErrStr(sts));
+	    host_state_changed(symName(f->host->conn), STATE_LOSTCONN);
+	    h->down = 1;
+	    mark_all(h);
+	}
+	f->result = NULL;
+    }
+    else if (sts & PMCD_HOSTNAME_CHANGE) {
+	/*
+	 * Hostname changed for pmcd and we were launched from
+	 * the control-driven scripts (pmie_check, pmie_daily),
+	 * then we need to exit.
+	 *
+	 * We rely on the systemd autorestart, systemd timer,
+	 * cron or the user to restart this pmie at which
+	 * time one or more of the following will happen:
+	 * - the correct pmcd hostname will be used internally,
+	 *   e.g. for %h in print actions
+	 * - for a pmie launched from the standard
+	 *   /etc/pcp/pmie control files, LOCALHOSTNAME will get
+	 *   correctly re-translated into a different pathname
+	 *   (usually the directory for the log file)
+	 */
+	const char	*host_name = pmGetContextHostName(f->handle);
+	pmNotifyErr(LOG_INFO, "PMCD hostname changed from %s to %s during pmFetch", symName(f->host->name), host_name);
+	if (runfromcontrol) {
+	    run_done = 1;
+	    return -1;
+	}
+    }
+    return 0;
+}
+
+/* one of the fetches for taskFetch(), called by the worker threads */
+static void
+fetchOne(void *arg, int i)
+{
+    Fetch	*f = ((Fetch **)arg)[i];
+
+    pmUseContext(f->handle);
+    f->sts = pmFetch(f->npmids, f->pmids, &f->result);
+}
+
+/*
+ * pmie -w ... do all of the fetches at once across the worker
+ * threads, then check them in the same order as taskFetch() would
+ */
+static int
+fetchAll(Task *t)
+{
+    static Fetch	**fetchv;
+    static int		maxfetch;
+    Host		*h;
+    Fetch		*f;
+    int			n = 0;
+    int			i;
+
+    for (h = t->hosts; h; h = h->next) {
+	for (f = h->fetches; f; f = f->next) {
+	    if (f->result) pmFreeResult(f->result);
+	    f->result = NULL;
+	    if (h->down)
+		continue;
+	    if (n == maxfetch) {
+		maxfetch = maxfetch ? maxfetch * 2 : 16;
+		fetchv = (Fetch **)ralloc(fetchv, maxfetch * sizeof(fetchv[0]));
+	    }
+	    fetchv[n++] = f;
+	}
+    }
+
+    workerRun(n, fetchOne, fetchv, WORKER_FETCH);
+
+    for (i = 0; i < n; i++) {
+	f = fetchv[i];
+	if (f->host->down) {
+	    /* an earlier fetch for this host failed */
+	    if (f->sts >= 0) pmFreeResult(f->result);
+	    f->result = NULL;
+	}
+	else if (fetchDone(f, f->sts) < 0)
+	    return -1;
+    }
+    return 0;
+}
+
 /* execute fetches for given Task */
 void
 taskFetch(Task *t)
@@ -1040,59 +1146,28 @@ taskFetch(Task *t)
     int		sts;
 
     /* do all fetches, quick as you can */
-    h = t->hosts;
-    while (h) {
-	f = h->fetches;
-	while (f) {
-	    if (f->result) pmFreeResult(f->result);
-	    if (! h->down) {
-		pmUseContext(f->handle);
-		if ((sts = pmFetch(f->npmids, f->pmids, &f->result)) < 0) {
-		    if (archives) {
-			if (sts == PM_ERR_LOGREC) {
-			    fprintf(stderr, "%s: pmFetch failed: %s\n", pmGetProgname(),
-				    pmErrStr(sts));
-			    exit(1);
-			}
-		    }
-		    else {
-			pmNotifyErr(LOG_ERR, "pmFetch from %s failed: %s\n",
-				symName(f->host->name), pmErrStr(sts));
-			host_state_changed(symName(f->host->conn), STATE_LOSTCONN);
-			h->down = 1;
-			mark_all(h);
-		    }
-		    f->result = NULL;
-		}
-		else if (sts & PMCD_HOSTNAME_CHANGE) {
-		    /*
-		     * Hostname changed for pmcd and we were launched from
-		     * the control-driven scripts (pmie_check, pmie_daily),
-		     * then we need to exit.
-		     *
-		     * We rely on the systemd autorestart, systemd timer,
-		     * cron or the user to restart this pmie at which
-		     * time one or more of the following will happen:
-		     * - the correct pmcd hostname will be used internally,
-		     *   e.g. for %h in print actions
-		     * - for a pmie launched from the standard
-		     *   /etc/pcp/pmie control files, LOCALHOSTNAME will get
-		     *   correctly re-translated into a different pathname
-		     *   (usually the directory for the log file)
-		     */
-		    const char	*host_name = pmGetContextHostName(f->handle);
-		    pmNotifyErr(LOG_INFO, "PMCD hostname changed from %s to %s during pmFetch", symName(f->host->name), host_name);
-		    if (runfromcontrol) {
-			run_done = 1;
+    if (pmie_workers > 0) {
+	if (fetchAll(t) < 0)
+	    return;
+    }
+    else {
+	h = t->hosts;
+	while (h) {
+	    f = h->fetches;
+	    while (f) {
+		if (f->result) pmFreeResult(f->result);
+		if (! h->down) {
+		    pmUseContext(f->handle);
+		    sts = pmFetch(f->npmids, f->pmids, &f->result);
+		    if (fetchDone(f, sts) < 0)
 			return;
-		    }
 		}
+		else
+		    f->result = NULL;
+		f = f->next;
 	    }
-	    else
-		f->result = NULL;
-	    f = f->next;
+	    h = h->next;
 	}
-	h = h->next;
     }
 
     /* sort and distribute pmValueSets to requesting Metrics */
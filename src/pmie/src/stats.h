@@ -35,4 +35,20 @@ typedef struct {
     unsigned int	version;
 } pmiestats_t;
 
+/*
+ * pmie -w per-thread instrumentation, one for the main thread and
+ * then one for each worker thread, following the pmiestats_t in the
+ * stats file (at PMIE_THREADSTATS_OFFSET)
+ */
+typedef struct {
+    double		fetch_time;		/* seconds doing host fetches */
+    double		eval_time;		/* seconds evaluating rules   */
+    unsigned int	fetches;		/* host fetches               */
+    unsigned int	evals;			/* rule expressions evaluated */
+    unsigned int	steals;			/* work taken from others     */
+    unsigned int	pad;
+} pmiethreadstats_t;
+
+#define PMIE_THREADSTATS_OFFSET	((sizeof(pmiestats_t) + 7) & ~7)
+
 #endif /* STATS_H */
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/***********************************************************************
+ * worker.c - optional pool of worker threads (pmie -w)
+ *
+ * With worker threads, a task is evaluated in three phases: the
+ * fetches for all of the task's hosts (taskFetch), then the rule
+ * conditions and other expressions apart from rulesets (eval), and
+ * finally the actions, rulesets and verbose output, which are done
+ * by the main thread in rule order, as they are without workers.
+ *
+ * For each of the first two phases, workerRun() divides the work
+ * items (fetches or rules) into one range for each thread, including
+ * the main thread.  Each thread takes items from the front of its
+ * own range, and once that is empty it steals from the back of the
+ * other threads' ranges, so one slow host or expensive rule does not
+ * hold up the rest.
+ *
+ * The expressions for different rules do not share state, except in
+ * indom_changed() (fetch.sk), which may create a context and update
+ * the symbol tables, so it is serialised with workerLock().
+ ***********************************************************************/
+
+#include <signal.h>
+#include "dstruct.h"
+#include "worker.h"
+
+int			pmie_workers;	/* -w: number of worker threads */
+pmiethreadstats_t	*threadperf;	/* per-thread data, main thread first */
+
+/* work items not yet taken by a thread */
+typedef struct {
+    pthread_mutex_t	lock;
+    int			next;		/* owner takes items from here */
+    int			end;		/* others take items from end-1 */
+} range_t;
+
+static pthread_mutex_t	pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	pool_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	pool_idle = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t	eval_lock = PTHREAD_MUTEX_INITIALIZER;
+static range_t		*ranges;	/* one per thread, main thread first */
+static int		nthreads;	/* workers + main thread */
+static unsigned int	generation;	/* bumped by each workerRun() */
+static int		busy;		/* workers still busy in this run */
+static void		(*job)(void *, int);
+static void		*jobarg;
+static int		jobphase;
+
+/* next work item for thread self, -1 when there are none left */
+static int
+take(int self)
+{
+    range_t	*rp = &ranges[self];
+    int		item = -1;
+    int		i;
+
+    PM_LOCK(rp->lock);
+    if (rp->next < rp->end)
+	item = rp->next++;
+    PM_UNLOCK(rp->lock);
+    for (i = 1; item < 0 && i < nthreads; i++) {
+	rp = &ranges[(self + i) % nthreads];
+	PM_LOCK(rp->lock);
+	if (rp->next < rp->end)
+	    item = --rp->end;
+	PM_UNLOCK(rp->lock);
+	if (item >= 0)
+	    threadperf[self].steals++;
+    }
+    return item;
+}
+
+/* do work items until there are none left */
+static void
+drain(int self)
+{
+    pmiethreadstats_t	*tp = &threadperf[self];
+    struct timeval	begin, end;
+    unsigned int	n = 0;
+    int			item;
+
+    pmtimevalNow(&begin);
+    while ((item = take(self)) >= 0) {
+	(*job)(jobarg, item);
+	n++;
+    }
+    pmtimevalNow(&end);
+    if (jobphase == WORKER_FETCH) {
+	tp->fetches += n;
+	tp->fetch_time += pmtimevalSub(&end, &begin);
+    }
+    else {
+	tp->evals += n;
+	tp->eval_time += pmtimevalSub(&end, &begin);
+    }
+}
+
+static void *
+worker(void *arg)
+{
+    int			self = (int)(__psint_t)arg;
+    unsigned int	seen = 0;
+
+    for ( ; ; ) {
+	PM_LOCK(pool_lock);
+	while (generation == seen)
+	    pthread_cond_wait(&pool_work, &pool_lock);
+	seen = generation;
+	PM_UNLOCK(pool_lock);
+
+	drain(self);
+
+	PM_LOCK(pool_lock);
+	if (--busy == 0)
+	    pthread_cond_signal(&pool_idle);
+	PM_UNLOCK(pool_lock);
+    }
+    return NULL;
+}
+
+/* start the worker threads, once only */
+void
+workerInit(void)
+{
+    pthread_t	tid;
+    sigset_t	all, saved;
+    int		i, sts;
+
+    if (pmie_workers <= 0 || ranges != NULL)
+	return;
+
+    if (threadperf == NULL)
+	/* no stats file, e.g. archive mode */
+	threadperf = (pmiethreadstats_t *)zalloc((pmie_workers + 1) * sizeof(threadperf[0]));
+    ranges = (range_t *)zalloc((pmie_workers + 1) * sizeof(ranges[0]));
+    for (i = 0; i <= pmie_workers; i++)
+	pthread_mutex_init(&ranges[i].lock, NULL);
+
+    /* signals are handled by the main thread */
+    sigfillset(&all);
+    sigdelset(&all, SIGSEGV);
+    sigdelset(&all, SIGBUS);
+    sigdelset(&all, SIGFPE);
+    sigdelset(&all, SIGILL);
+    pthread_sigmask(SIG_BLOCK, &all, &saved);
+    for (i = 0; i < pmie_workers; i++) {
+	if ((sts = pthread_create(&tid, NULL, worker, (void *)(__psint_t)(i + 1))) != 0) {
+	    pmNotifyErr(LOG_ERR, "workerInit: pthread_create: %s\n",
+			pmErrStr(-sts));
+	    break;
+	}
+	pthread_detach(tid);
+    }
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+    pmie_workers = i;
+    nthreads = pmie_workers + 1;
+    if (pmDebugOptions.appl0)
+	fprintf(stderr, "workerInit: %d worker threads\n", pmie_workers);
+}
+
+/*
+ * Call fn(arg, i) for items i = 0 .. n-1, spread across the worker
+ * threads and this (the main) thread, and return when they are all
+ * done.  phase is WORKER_FETCH or WORKER_EVAL, for the per-thread
+ * instrumentation.
+ */
+void
+workerRun(int n, void (*fn)(void *, int), void *arg, int phase)
+{
+    int		i;
+
+    if (n <= 0)
+	return;
+    if (nthreads == 0) {
+	/* workerInit not called, or no workers */
+	for (i = 0; i < n; i++)
+	    (*fn)(arg, i);
+	return;
+    }
+
+    /* the workers are all idle here */
+    job = fn;
+    jobarg = arg;
+    jobphase = phase;
+    for (i = 0; i < nthreads; i++) {
+	ranges[i].next = (int)((long)n * i / nthreads);
+	ranges[i].end = (int)((long)n * (i + 1) / nthreads);
+    }
+
+    PM_LOCK(pool_lock);
+    busy = nthreads - 1;
+    generation++;
+    pthread_cond_broadcast(&pool_work);
+    PM_UNLOCK(pool_lock);
+
+    drain(0);
+
+    PM_LOCK(pool_lock);
+    while (busy > 0)
+	pthread_cond_wait(&pool_idle, &pool_lock);
+    PM_UNLOCK(pool_lock);
+}
+
+void
+workerLock(void)
+{
+    if (nthreads > 1)
+	PM_LOCK(eval_lock);
+}
+
+void
+workerUnlock(void)
+{
+    if (nthreads > 1)
+	PM_UNLOCK(eval_lock);
+}
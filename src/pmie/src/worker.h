@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+#ifndef WORKER_H
+#define WORKER_H
+
+#include "stats.h"
+
+/*
+ * Pool of worker threads for fetches and rule evaluation, see worker.c
+ */
+extern int		pmie_workers;	/* -w: number of worker threads */
+extern pmiethreadstats_t *threadperf;	/* per-thread data, main thread first */
+
+#define WORKER_FETCH	0		/* workerRun() phases */
+#define WORKER_EVAL	1
+
+extern void workerInit(void);		/* start the worker threads */
+extern void workerRun(int, void (*)(void *, int), void *, int);
+extern void workerLock(void);		/* serialise non-reentrant code */
+extern void workerUnlock(void);
+
+#endif /* WORKER_H */
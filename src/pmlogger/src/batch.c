@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * Result records for the data volume.  By default each record is
+ * written as soon as it is encoded, but with -F they are held (still
+ * in their pinned PDU buffers) and written in batches with one
+ * __pmLogPutResultv() per flush.
+ *
+ * Anything else that writes to the data volume, or depends on where
+ * the data volume ends (temporal index entries, volume switches,
+ * <mark> records, the epilogue) must call flushresults() first.
+ *
+ * The write instrumentation is exported to the pmcd PMDA through a
+ * memory mapped file, as for pmie.
+ */
+
+#include "logger.h"
+#include "logstats.h"
+#include <sys/stat.h>
+
+int		flush_samples = -1;	/* -F records per flush */
+__int64_t	flush_bytes = -1;	/* -F bytes per flush */
+struct timeval	flush_time;		/* -F time between flushes */
+int		flush_alarm;		/* flush_callback() called */
+
+static __pmPDU		**pending;
+static struct timeval	*pending_sent;	/* when each record was fetched */
+static int		npending;
+static int		maxpending;
+static size_t		pending_bytes;
+
+static pmloggerstats_t	instrument;
+static pmloggerstats_t	*perf = &instrument;
+static char		perffile[MAXPATHLEN];
+
+/*
+ * Upper bound on held records, whatever the -F policy, so a long flush
+ * interval or a burst of pipelined fetches cannot grow the queue
+ * without limit.
+ */
+#define MAXPENDING	1024
+
+/* size of the record in the data volume, see logputresult() in libpcp */
+#define RECORD_BYTES(pb) ((pb)[0] - sizeof(__pmPDUHdr) + 2 * sizeof(int))
+
+static void
+stopstats(void)
+{
+    if (*perffile)
+	unlink(perffile);
+}
+
+void
+init_stats(void)
+{
+    void	*ptr;
+    int		fd;
+    char	zero = '\0';
+    char	dir[MAXPATHLEN];
+
+    /* OK if the stats file directory already exists */
+    pmsprintf(dir, sizeof(dir), "%s%c%s",
+	     pmGetConfig("PCP_TMP_DIR"), pmPathSeparator(), PMLOGGER_STATS_SUBDIR);
+    if (mkdir2(dir, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH) < 0) {
+	if (oserror() != EEXIST) {
+	    fprintf(stderr, "%s: warning cannot create stats file dir %s: %s\n",
+		    pmGetProgname(), dir, osstrerror());
+	}
+    }
+
+    /* remove entries for pmloggers that have died */
+    __pmCleanMapDir(dir, NULL);
+
+    atexit(stopstats);
+
+    pmsprintf(perffile, sizeof(perffile),
+		"%s%c%" FMT_PID, dir, pmPathSeparator(), (pid_t)getpid());
+    unlink(perffile);
+    if ((fd = open(perffile, O_RDWR | O_CREAT | O_EXCL | O_TRUNC,
+			     S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)) < 0) {
+	/* no stats file, carry on without it */
+	perffile[0] = '\0';
+	return;
+    }
+    /* seek to struct size and write one zero */
+    if (lseek(fd, sizeof(pmloggerstats_t)-1, SEEK_SET) < 0 ||
+	write(fd, &zero, 1) != 1) {
+	fprintf(stderr, "%s: Warning: cannot size stats file %s: %s\n",
+		pmGetProgname(), perffile, osstrerror());
+    }
+    if ((ptr = __pmMemoryMap(fd, sizeof(pmloggerstats_t), 1)) == NULL) {
+	fprintf(stderr, "%s: memory map failed for stats file %s: %s\n",
+		pmGetProgname(), perffile, osstrerror());
+    }
+    else {
+	perf = (pmloggerstats_t *)ptr;
+	*perf = instrument;		/* struct assignment */
+	perf->version = 1;
+    }
+    close(fd);
+}
+
+/*
+ * Warning: called in signal handler context ... be careful
+ */
+void
+flush_callback(int i, void *j)
+{
+    flush_alarm = 1;
+}
+
+/*
+ * Offset in the data volume where the next record will start, once
+ * everything pending has been written.
+ */
+long
+logoffset(void)
+{
+    return __pmFtell(archctl.ac_mfp) + (long)pending_bytes;
+}
+
+int
+flushresults(void)
+{
+    struct timeval	start, end;
+    int			sts;
+    int			i;
+
+    if (npending == 0)
+	return 0;
+
+    pmtimevalNow(&start);
+    sts = __pmLogPutResultv(&archctl, npending, pending);
+    pmtimevalNow(&end);
+
+    if (pmDebugOptions.appl2)
+	pmNotifyErr(LOG_INFO, "flushresults: %d records, %zd bytes: %s",
+		npending, pending_bytes, sts < 0 ? pmErrStr(sts) : "ok");
+
+    if (sts >= 0) {
+	perf->bytes += pending_bytes;
+	perf->records += npending;
+	for (i = 0; i < npending; i++)
+	    perf->latency += (uint64_t)(pmtimevalSub(&end, &pending_sent[i]) * 1000000);
+    }
+    perf->flushes++;
+    perf->time += (uint64_t)(pmtimevalSub(&end, &start) * 1000000);
+    perf->pending = 0;
+
+    for (i = 0; i < npending; i++)
+	__pmUnpinPDUBuf(pending[i]);
+    npending = 0;
+    pending_bytes = 0;
+    return sts < 0 ? sts : 0;
+}
+
+/*
+ * Append an encoded result record (from __pmEncodeResult or
+ * __pmEncodeResultView) to the data volume.  The PDU buffer is
+ * unpinned here, once it has been written.  sent is when the fetch
+ * for the result was sent to pmcd.
+ */
+int
+putresult(__pmPDU *pb, struct timeval *sent)
+{
+    if (npending == maxpending) {
+	int		need = maxpending ? maxpending * 2 : 16;
+	__pmPDU		**tmp_pending;
+	struct timeval	*tmp_sent;
+
+	tmp_pending = (__pmPDU **)realloc(pending, need * sizeof(pending[0]));
+	if (tmp_pending == NULL) {
+	    pmNoMem("putresult: pending realloc", need * sizeof(pending[0]), PM_FATAL_ERR);
+	    /* NOTREACHED */
+	}
+	pending = tmp_pending;
+	tmp_sent = (struct timeval *)realloc(pending_sent, need * sizeof(pending_sent[0]));
+	if (tmp_sent == NULL) {
+	    pmNoMem("putresult: pending_sent realloc", need * sizeof(pending_sent[0]), PM_FATAL_ERR);
+	    /* NOTREACHED */
+	}
+	pending_sent = tmp_sent;
+	maxpending = need;
+    }
+    pending_sent[npending] = *sent;
+    pending[npending++] = pb;
+    pending_bytes += RECORD_BYTES(pb);
+    perf->pending = npending;
+
+    if (npending >= MAXPENDING)
+	return flushresults();
+    if (flush_samples > 0 && npending < flush_samples)
+	return 0;
+    if (flush_bytes > 0 && pending_bytes < flush_bytes)
+	return 0;
+    if (flush_time.tv_sec > 0 || flush_time.tv_usec > 0)
+	/* flush_callback() decides */
+	return 0;
+    return flushresults();
+}
+
+/*
+ * A fetch was sent ahead of its logging task (-Q).
+ */
+void
+countpipelined(void)
+{
+    perf->pipelined++;
+}
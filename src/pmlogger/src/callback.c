@@ -29,6 +29,54 @@ static int	one_context = 1;
 __pmTimestamp	last_stamp;
 __pmHashCtl	hist_hash;
 
+/*
+ * A fetched result is either decoded, or for the direct write-through
+ * path it is a view of the result PDU from pmcd, which is written to
+ * the archive without decoding and re-encoding all of the values.
+ * Only pmids, numvals, instances and the timestamp are needed here
+ * to look for metadata changes, and the accessors below work for both.
+ */
+typedef struct {
+    __pmResult		*resp;		/* decoded result, else NULL */
+    __pmResultView	view;		/* PDU view, used if resp is NULL */
+} fetchres_t;
+
+#define FR_VALID(r)	((r)->resp != NULL || (r)->view.pdubuf != NULL)
+#define FR_NUMPMID(r)	((r)->resp ? (r)->resp->numpmid : (r)->view.numpmid)
+#define FR_STAMP(r)	((r)->resp ? &(r)->resp->timestamp : &(r)->view.timestamp)
+
+static pmID
+fr_pmid(fetchres_t *r, int i)
+{
+    return r->resp ? r->resp->vset[i]->pmid : __pmResultViewPMID(&r->view, i);
+}
+
+static int
+fr_numval(fetchres_t *r, int i)
+{
+    return r->resp ? r->resp->vset[i]->numval : __pmResultViewNumval(&r->view, i);
+}
+
+static int
+fr_inst(fetchres_t *r, int i, int j)
+{
+    return r->resp ? r->resp->vset[i]->vlist[j].inst : __pmResultViewInst(&r->view, i, j);
+}
+
+/* release the result, but keep the view's space for the next one */
+static void
+fr_release(fetchres_t *r)
+{
+    if (r->resp != NULL) {
+	/*
+	 * release memory that is allocated in pmDecodeResult
+	 */
+	__pmFreeResult(r->resp);
+	r->resp = NULL;
+    }
+    __pmReleaseResultView(&r->view);
+}
+
 /*
  * These structures allow us to keep track of the _last_ fetch
  * for each fetch in each AF group ... needed to track changes in
@@ -37,7 +85,7 @@ __pmHashCtl	hist_hash;
 typedef struct _lastfetch {
     struct _lastfetch	*lf_next;
     fetchctl_t		*lf_fp;
-    __pmResult		*lf_resp;
+    fetchres_t		lf_res;
 } lastfetch_t;
 
 typedef struct _AFctl {
@@ -114,20 +162,20 @@ clearavail(fetchctl_t *fcp)
 }
 
 static void
-setavail(__pmResult *resp)
+setavail(fetchres_t *r)
 {
     int			i;
 
-    for (i = 0; i < resp->numpmid; i++) {
+    for (i = 0; i < FR_NUMPMID(r); i++) {
 	pmID		pmid;
-	pmValueSet	*vsp;
+	int		numval;
 	__pmHashNode	*hp;
 	pmidhist_t	*php;
 	insthist_t	*ihp;
 	int		j;
 	
-	vsp = resp->vset[i];
-	pmid = vsp->pmid;
+	pmid = fr_pmid(r, i);
+	numval = fr_numval(r, i);
 	for (hp = __pmHashSearch(pmid, &hist_hash); hp != (__pmHashNode *)0; hp = hp->next)
 	    if (pmid == (pmID)hp->key)
 		break;
@@ -136,7 +184,7 @@ setavail(__pmResult *resp)
 	    php = (pmidhist_t *)hp->data;
 	else {
 	    /* add new pmid to history if it's pmValueSet is OK */
-	    if (vsp->numval <= 0)
+	    if (numval <= 0)
 		continue;
 	    /*
 	     * use the OTHER hash list to find the pmid's desc and thereby its
@@ -160,15 +208,15 @@ setavail(__pmResult *resp)
 	     * now create a new insthist list for all the instances in the
 	     * __pmResult and we're done
 	     */
-	    php->ph_numinst = vsp->numval;
-	    ihp = (insthist_t *)calloc(vsp->numval, sizeof(insthist_t));
+	    php->ph_numinst = numval;
+	    ihp = (insthist_t *)calloc(numval, sizeof(insthist_t));
 	    if (ihp == (insthist_t *)0) {
 		pmNoMem("setavail: inst list calloc",
-			 vsp->numval * sizeof(insthist_t), PM_FATAL_ERR);
+			 numval * sizeof(insthist_t), PM_FATAL_ERR);
 	    }
 	    php->ph_instlist = ihp;
-	    for (j = 0; j < vsp->numval; j++, ihp++) {
-		ihp->ih_inst = vsp->vlist[j].inst;
+	    for (j = 0; j < numval; j++, ihp++) {
+		ihp->ih_inst = fr_inst(r, i, j);
 		PMLC_SET_AVAIL(ihp->ih_flags, 1);
 	    }
 	    if ((j = __pmHashAdd(pmid, (void *)php, &hist_hash)) < 0) {
@@ -181,8 +229,8 @@ setavail(__pmResult *resp)
 	/* update an existing pmid history entry, adding any previously unseen
 	 * instances
 	 */
-	for (j = 0; j < vsp->numval; j++) {
-	    int		inst = vsp->vlist[j].inst;
+	for (j = 0; j < numval; j++) {
+	    int		inst = fr_inst(r, i, j);
 	    int		k;
 
 	    for (k = 0; k < php->ph_numinst; k++)
@@ -266,47 +314,50 @@ done:
 
 
 /*
- * compare __pmResults for a particular metric, and return 1 if
- * the set of instances has changed.
+ * compare fetched results for the metric in value set n of r, and
+ * return 1 if the set of instances has changed.
  */
 static int
-check_inst(pmValueSet *vsp, int hint, __pmResult *lrp)
+check_inst(fetchres_t *r, int n, fetchres_t *lr)
 {
     int		i;
     int		j;
-    pmValueSet	*lvsp;
+    int		numval = fr_numval(r, n);
+    pmID	pmid = fr_pmid(r, n);
 
-    /* Make sure vsp->pmid exists in lrp's result */
-    /* and find which value set in lrp it is. */
-    if (hint < lrp->numpmid && lrp->vset[hint]->pmid == vsp->pmid)
-	i = hint;
+    /* Make sure pmid exists in lr's result */
+    /* and find which value set in lr it is. */
+    if (n < FR_NUMPMID(lr) && fr_pmid(lr, n) == pmid)
+	i = n;
     else {
-	for (i = 0; i < lrp->numpmid; i++) {
-	    if (lrp->vset[i]->pmid == vsp->pmid)
+	for (i = 0; i < FR_NUMPMID(lr); i++) {
+	    if (fr_pmid(lr, i) == pmid)
 		break;
 	}
-	if (i == lrp->numpmid) {
+	if (i == FR_NUMPMID(lr)) {
 	    fprintf(stderr, "check_inst: cannot find PMID %s in last result ...\n",
-		pmIDStr(vsp->pmid));
-	    __pmPrintResult(stderr, lrp);
+		pmIDStr(pmid));
+	    if (lr->resp != NULL)
+		__pmPrintResult(stderr, lr->resp);
 	    return 0;
 	}
     }
 
-    lvsp = lrp->vset[i];
-
-    if (lvsp->numval != vsp->numval)
+    if (fr_numval(lr, i) != numval)
 	return 1;
 
     /* compare instances */
-    for (i = 0; i < lvsp->numval; i++) {
-	if (lvsp->vlist[i].inst != vsp->vlist[i].inst) {
+    for (j = 0; j < numval; j++) {
+	int	inst = fr_inst(r, n, j);
+	int	k;
+
+	if (fr_inst(lr, i, j) != inst) {
 	    /* the hard way */
-	    for (j = 0; j < vsp->numval; j++) {
-		if (lvsp->vlist[j].inst == vsp->vlist[i].inst)
+	    for (k = 0; k < numval; k++) {
+		if (fr_inst(lr, i, k) == inst)
 		    break;
 	    }
-	    if (j == vsp->numval)
+	    if (k == numval)
 		return 1;
 	}
     }
@@ -554,17 +605,92 @@ lookupTaskCacheNames(pmID pmid, char ***namesptr)
  * want the size in the archive file, not the size over the wire
  */
 static size_t
-pduresultbytes(__pmResult *resp)
+pduresultbytes(fetchres_t *r)
 {
     size_t	need, vneed;
 
-    __pmGetResultSize(PDU_RESULT, resp->numpmid, resp->vset, &need, &vneed);
+    if (r->resp != NULL) {
+	__pmGetResultSize(PDU_RESULT, r->resp->numpmid, r->resp->vset, &need, &vneed);
+	need += vneed;
+    }
+    else {
+	/*
+	 * same body as the PDU from pmcd, but a PDU_HIGHRES_RESULT
+	 * timestamp is two words longer than a PDU_RESULT one
+	 */
+	need = r->view.pdubuf[0];
+	if (r->view.type == PDU_HIGHRES_RESULT)
+	    need -= 2 * sizeof(__pmPDU);
+    }
     /*
      * extra word for sec in timestamp for V3
      */
     if (archive_version >= PM_LOG_VERS03)
 	need += sizeof(__int32_t);
-    return need + vneed;
+    return need;
+}
+
+/*
+ * The direct write-through path is used unless the task has
+ * derived metrics (the result needs __pmFinishResult and PMID
+ * rewriting) or event metrics (do_events needs the decoded records).
+ */
+static int
+direct_ok(task_t *tp)
+{
+    int		i;
+
+    if (tp->t_dm != 0)
+	return 0;
+    for (i = 0; i < tp->t_numpmid; i++) {
+	if (tp->t_desclist[i].type == PM_TYPE_EVENT ||
+	    tp->t_desclist[i].type == PM_TYPE_HIGHRES_EVENT)
+	    return 0;
+    }
+    return 1;
+}
+
+static void
+setprofile(fetchctl_t *fp)
+{
+    indomctl_t		*idp;
+
+    if (one_context || fp->f_state & OPT_STATE_PROFILE) {
+	/* profile for this fetch group has changed */
+	pmAddProfile(PM_INDOM_NULL, 0, (int *)0);
+	for (idp = fp->f_idp; idp != (indomctl_t *)0; idp = idp->i_next) {
+	    if (idp->i_indom != PM_INDOM_NULL && idp->i_numinst != 0)
+		pmAddProfile(idp->i_indom, idp->i_numinst, idp->i_instlist);
+	}
+	fp->f_state &= ~OPT_STATE_PROFILE;
+    }
+}
+
+/*
+ * With -Q, send the fetches for all the fetch groups of the alarmed
+ * tasks before do_work() is called for any of them, so they are in
+ * flight at pmcd together rather than one after another.  Tasks with
+ * derived metrics are left to myFetch() in do_work().
+ */
+void
+prefetch(task_t *alarmed)
+{
+    task_t		*tp;
+    fetchctl_t		*fp;
+
+    if (pipeline < 1 || !parse_done)
+	return;
+    for (tp = alarmed; tp != NULL; tp = tp->t_alarmed) {
+	if (tp->t_dm != 0)
+	    continue;
+	for (fp = tp->t_fetch; fp != (fetchctl_t *)0; fp = fp->f_next) {
+	    setprofile(fp);
+	    if (pipefetch(fp->f_numpmid, fp->f_pmidlist) < 0)
+		goto done;
+	}
+    }
+done:
+    pipesync();
 }
 
 /*
@@ -594,8 +720,11 @@ do_work(task_t *tp)
     int			k;
     int			sts;
     fetchctl_t		*fp;
-    indomctl_t		*idp;
-    __pmResult		*resp;
+    fetchres_t		*fr;
+    fetchres_t		tmp;
+    static fetchres_t	next;		/* space reused for each fetch */
+    int			direct;
+    struct timeval	sent;
     __pmPDU		*pb;
     AFctl_t		*acp;
     lastfetch_t		*lfp;
@@ -603,7 +732,7 @@ do_work(task_t *tp)
     int			changed;
     int			needindom;
     int			needti;
-    static off_t	flushsize = 100000;
+    static off_t	flushsize = -1;
     long		old_meta_offset;
     long		label_offset;
     long		new_offset;
@@ -648,14 +777,14 @@ do_work(task_t *tp)
 	    }
 	    if (fp == (fetchctl_t *)0) {
 		lfp->lf_fp = (fetchctl_t *)0;	/* mark lastfetch_t as free */
-		if (lfp->lf_resp != NULL) {
-		    __pmFreeResult(lfp->lf_resp);
-		    lfp->lf_resp = NULL;
-		}
+		fr_release(&lfp->lf_res);
 	    }
 	}
     }
 
+    direct = direct_ok(tp);
+    fr = &next;
+
     for (fp = tp->t_fetch; fp != (fetchctl_t *)0; fp = fp->f_next) {
 	
 	/* find lastfetch_t for this fetch group, else make a new one */
@@ -682,19 +811,12 @@ do_work(task_t *tp)
 	    lfp->lf_fp = fp;
 	}
 
-	if (one_context || fp->f_state & OPT_STATE_PROFILE) {
-	    /* profile for this fetch group has changed */
-	    pmAddProfile(PM_INDOM_NULL, 0, (int *)0);
-	    for (idp = fp->f_idp; idp != (indomctl_t *)0; idp = idp->i_next) {
-		if (idp->i_indom != PM_INDOM_NULL && idp->i_numinst != 0)
-		    pmAddProfile(idp->i_indom, idp->i_numinst, idp->i_instlist);
-	    }
-	    fp->f_state &= ~OPT_STATE_PROFILE;
-	}
-
+	setprofile(fp);
 	clearavail(fp);
 
-	if ((sts = changed = myFetch(fp->f_numpmid, fp->f_pmidlist, &resp)) < 0) {
+	sts = changed = myFetch(fp->f_numpmid, fp->f_pmidlist, &fr->resp,
+				direct ? &fr->view : NULL, &sent);
+	if (sts < 0) {
 	    if (sts == -EINTR) {
 		/* disconnect() already done in myFetch() */
 		return;
@@ -707,7 +829,7 @@ do_work(task_t *tp)
 	    }
 	    continue;
 	}
-	pdu_payload = pduresultbytes(resp);
+	pdu_payload = pduresultbytes(fr);
 
 	if (pmDebugOptions.appl2)
 	    pmNotifyErr(LOG_INFO, "callback: fetch group %p (%d metrics, 0x%x change)", fp, fp->f_numpmid, changed);
@@ -729,11 +851,11 @@ do_work(task_t *tp)
 	 * 2^63-1 bytes (for v3 archives).
 	 */
 	max_offset = (archive_version == PM_LOG_VERS02) ? 0x7fffffff : LONGLONG_MAX;
-	peek_offset = __pmFtell(archctl.ac_mfp);
+	peek_offset = logoffset();
 	peek_offset += pdu_payload - sizeof(__pmPDUHdr) + 2*sizeof(int);
 	if (peek_offset > max_offset) {
 	    if (pmDebugOptions.appl2)
-		pmNotifyErr(LOG_INFO, "callback: new volume based on max size, currently %ld", __pmFtell(archctl.ac_mfp));
+		pmNotifyErr(LOG_INFO, "callback: new volume based on max size, currently %ld", logoffset());
 	    (void)newvolume(VOL_SW_MAX);
 	}
 
@@ -757,42 +879,51 @@ do_work(task_t *tp)
 	 * and after the metadata changes have been written out, call
 	 * __pmEncodeResult to encode the right PDU buffer before doing
 	 * the correct style of result write.
+	 *
+	 * Except when none of that applies (direct_ok() above), when
+	 * myFetch gives us a view of the PDU from pmcd instead, and
+	 * __pmEncodeResultView only has to rewrite the timestamp and
+	 * copy the rest of the PDU.
+	 *
+	 * Offsets in the data volume are those once any results held
+	 * for -F have been written.
 	 */
-	last_log_offset = __pmFtell(archctl.ac_mfp);
+	last_log_offset = logoffset();
 	assert(last_log_offset >= 0);
 
-	setavail(resp);
+	setavail(fr);
 
 	if (changed & PMCD_LABEL_CHANGE) {
 	    /*
 	     * Change to the context labels associated with logged host
 	     */
-	    putlabels(PM_LABEL_CONTEXT, PM_IN_NULL, &resp->timestamp);
+	    putlabels(PM_LABEL_CONTEXT, PM_IN_NULL, FR_STAMP(fr));
 	}
 
 	needti = 0;
 	old_meta_offset = __pmFtell(logctl.mdfp);
 	assert(old_meta_offset >= 0);
 
-	for (i = 0; i < resp->numpmid; i++) {
-	    pmValueSet	*vsp = resp->vset[i];
+	for (i = 0; i < FR_NUMPMID(fr); i++) {
+	    pmID	pmid = fr_pmid(fr, i);
+	    int		numval = fr_numval(fr, i);
 	    pmDesc	desc;
 	    char	**names = NULL;
 	    int		numnames = 0;
 
-	    sts = __pmLogLookupDesc(&archctl, vsp->pmid, &desc);
+	    sts = __pmLogLookupDesc(&archctl, pmid, &desc);
 	    if (sts < 0) {
 		/* lookup name and descriptor in task cache */
-		int taskindex = lookupTaskCacheIndex(tp, vsp->pmid);
+		int taskindex = lookupTaskCacheIndex(tp, pmid);
 		if (taskindex == -1) {
 		    fprintf(stderr, "lookupTaskCacheIndex cannot find PMID %s\n",
-				pmIDStr(vsp->pmid));
+				pmIDStr(pmid));
 		    exit(1);
 		}
 		desc = tp->t_desclist[taskindex];
-		numnames = lookupTaskCacheNames(vsp->pmid, &names);
+		numnames = lookupTaskCacheNames(pmid, &names);
 		if (numnames < 1) {
-		    fprintf(stderr, "lookupTaskCacheNames(%s, ...): %s\n", pmIDStr(vsp->pmid), pmErrStr(sts));
+		    fprintf(stderr, "lookupTaskCacheNames(%s, ...): %s\n", pmIDStr(pmid), pmErrStr(sts));
 		    exit(1);
 		}
 		if (IS_DERIVED(desc.pmid))
@@ -806,19 +937,19 @@ do_work(task_t *tp)
 		    /* derived metric, restore cluster field ... */
 		    desc.pmid = CLEAR_DERIVED_LOGGED(desc.pmid);
 		free(names);
-		manageLabels(&desc, &resp->timestamp, 0);
+		manageLabels(&desc, FR_STAMP(fr), 0);
 		manageText(&desc);
 	    }
-	    if (desc.type == PM_TYPE_EVENT) {
+	    if (desc.type == PM_TYPE_EVENT && fr->resp != NULL) {
 		/*
 		 * Event records need some special handling ...
 		 */
-		if ((sts = do_events(vsp)) < 0) {
+		if ((sts = do_events(fr->resp->vset[i])) < 0) {
 		    fprintf(stderr, "Failed to process event records: %s\n", pmErrStr(sts));
 		    exit(1);
 		}
 	    }
-	    if (desc.indom != PM_INDOM_NULL && vsp->numval > 0) {
+	    if (desc.indom != PM_INDOM_NULL && numval > 0) {
 		/*
 		 * __pmLogGetInDom has been replaced by __localLogGetInDom
 		 * so that the timestamp of the retrieved indom is also
@@ -828,7 +959,7 @@ do_work(task_t *tp)
 		old.indom = desc.indom;
 		old.alloc = 0;
 		(void)__localLogGetInDom(&logctl, &old);
-		if (old.numinst > 0 && __pmTimestampSub(&resp->timestamp, &old.stamp) <= 0) {
+		if (old.numinst > 0 && __pmTimestampSub(FR_STAMP(fr), &old.stamp) <= 0) {
 		    /*
 		     * Already have indom with the same (or later, in the
 		     * case of some time warp) timestamp compared to the
@@ -843,7 +974,7 @@ do_work(task_t *tp)
 		    needindom = 0;
 		    if (pmDebugOptions.logmeta && pmDebugOptions.desperate) {
 			fprintf(stderr, "time warp: pmResult: % " FMT_INT64 ".%09d last %s indom: %" FMT_INT64 ".%09d\n",
-			    resp->timestamp.sec, resp->timestamp.nsec,
+			    FR_STAMP(fr)->sec, FR_STAMP(fr)->nsec,
 			    pmInDomStr(old.indom),
 			    old.stamp.sec, old.stamp.nsec);
 		    }
@@ -860,16 +991,18 @@ do_work(task_t *tp)
 		     * somewhere in the most recent hashed/cached indom.
 		     * Thus a potential numval^2 search.
                      */
-		    for (j = 0; j < vsp->numval; j++) {
+		    for (j = 0; j < numval; j++) {
+			int	inst = fr_inst(fr, i, j);
+
 			for (k = 0; k < old.numinst; k++) {
-			    if (vsp->vlist[j].inst == old.instlist[k])
+			    if (inst == old.instlist[k])
 				break;
 			}
 			if (k == old.numinst) {
 			    needindom = 1;
 			    if (pmDebugOptions.logmeta && pmDebugOptions.desperate) {
 				fprintf(stderr, "inst %d in pmResult, not in cached indom => needindom %s\n",
-				    vsp->vlist[j].inst, pmInDomStr(desc.indom));
+				    inst, pmInDomStr(desc.indom));
 			    }
 			    break;
 			}
@@ -880,8 +1013,8 @@ do_work(task_t *tp)
 		     * tests above, but still the indom still needs to
 		     * be refeshed.
 		     */
-		    if (needindom == 0 && lfp->lf_resp != NULL) {
-			needindom = check_inst(vsp, i, lfp->lf_resp);
+		    if (needindom == 0 && FR_VALID(&lfp->lf_res)) {
+			needindom = check_inst(fr, i, &lfp->lf_res);
 			if (pmDebugOptions.logmeta && pmDebugOptions.desperate) {
 			    if (needindom)
 				fprintf(stderr, "check_inst => needindom %s\n",
@@ -901,7 +1034,7 @@ do_work(task_t *tp)
 		     */
 		    __pmLogInDom	new;
 		    __pmLogInDom	new_delta;
-		    new.stamp = resp->timestamp;	/* struct assignment */
+		    new.stamp = *FR_STAMP(fr);	/* struct assignment */
 		    new.indom = desc.indom;
 		    new.alloc = 0;
 		    if ((new.numinst = pmGetInDom(desc.indom, &new.instlist, &new.namelist)) < 0) {
@@ -937,7 +1070,7 @@ do_work(task_t *tp)
 			int	pdu_type;
 			if (pmDebugOptions.appl2)
 			    pmNotifyErr(LOG_INFO, "callback: indom (%s) full change", pmInDomStr(desc.indom));
-			new.stamp = resp->timestamp;	/* struct assignment */
+			new.stamp = *FR_STAMP(fr);	/* struct assignment */
 			new.indom = desc.indom;
 			if (archive_version >= PM_LOG_VERS03)
 			    pdu_type = TYPE_INDOM;
@@ -961,7 +1094,7 @@ do_work(task_t *tp)
 		    else if (needindom == 2) {
 			if (pmDebugOptions.appl2)
 			    pmNotifyErr(LOG_INFO, "callback: indom (%s) delta change", pmInDomStr(desc.indom));
-			new_delta.stamp = resp->timestamp;	/* struct assignment */
+			new_delta.stamp = *FR_STAMP(fr);	/* struct assignment */
 			new_delta.indom = desc.indom;
 			/* emit delta indom record */
 			if ((sts = __pmLogPutInDom(&archctl, TYPE_INDOM_DELTA, &new_delta)) < 0) {
@@ -1009,38 +1142,48 @@ do_work(task_t *tp)
 	     * the PMID of a derived metric, which is need to replay
 	     * the archive correctly.
 	     */
-	    for (i = 0; i < resp->numpmid; i++) {
-		pmValueSet	*vsp = resp->vset[i];
+	    for (i = 0; i < fr->resp->numpmid; i++) {
+		pmValueSet	*vsp = fr->resp->vset[i];
 		if (IS_DERIVED(vsp->pmid))
 		    vsp->pmid = SET_DERIVED_LOGGED(vsp->pmid);
 	    }
 	}
 
-	if ((sts = __pmEncodeResult(&logctl, resp, &pb)) < 0) {
-	    fprintf(stderr, "__pmEncodeResult: %s\n", pmErrStr(sts));
-	    exit(1);
-	}
-	if (archive_version >= PM_LOG_VERS03) {
-	    if ((sts = __pmLogPutResult3(&archctl, pb)) < 0) {
-		fprintf(stderr, "__pmLogPutResult3: (encode) %s\n", pmErrStr(sts));
+	if (fr->resp != NULL) {
+	    if ((sts = __pmEncodeResult(&logctl, fr->resp, &pb)) < 0) {
+		fprintf(stderr, "__pmEncodeResult: %s\n", pmErrStr(sts));
 		exit(1);
 	    }
-	} else {
-	    if ((sts = __pmLogPutResult2(&archctl, pb)) < 0) {
-		fprintf(stderr, "__pmLogPutResult2: (encode) %s\n", pmErrStr(sts));
+	}
+	else {
+	    if ((sts = __pmEncodeResultView(&logctl, &fr->view, &pb)) < 0) {
+		fprintf(stderr, "__pmEncodeResultView: %s\n", pmErrStr(sts));
 		exit(1);
 	    }
 	}
-	__pmUnpinPDUBuf(pb);
+	if ((sts = putresult(pb, &sent)) < 0) {
+	    fprintf(stderr, "putresult: %s\n", pmErrStr(sts));
+	    exit(1);
+	}
 	__pmOverrideLastFd(__pmFileno(archctl.ac_mfp));
 
-	if (__pmFtell(archctl.ac_mfp) > flushsize) {
+	if (flushsize < 0)
+	    flushsize = index_bytes;
+	if (logoffset() > flushsize) {
 	    needti = 1;
 	    if (pmDebugOptions.appl2)
-		pmNotifyErr(LOG_INFO, "callback: file size (%d) reached flushsize (%ld)", (int)__pmFtell(archctl.ac_mfp), (long)flushsize);
+		pmNotifyErr(LOG_INFO, "callback: file size (%d) reached flushsize (%ld)", (int)logoffset(), (long)flushsize);
 	}
 
 	if (needti) {
+	    /*
+	     * the index entry must not point past the end of what
+	     * has been written, so flush any results held for -F
+	     */
+	    if ((sts = flushresults()) < 0) {
+		fprintf(stderr, "flushresults: %s\n", pmErrStr(sts));
+		exit(1);
+	    }
 	    /*
 	     * need to unwind seek pointer to start of most recent
 	     * result (but if this is the first one, skip the label
@@ -1052,24 +1195,22 @@ do_work(task_t *tp)
 	    assert(new_meta_offset >= 0);
 	    __pmFseek(archctl.ac_mfp, last_log_offset, SEEK_SET);
 	    __pmFseek(logctl.mdfp, old_meta_offset, SEEK_SET);
-	    __pmLogPutIndex(&archctl, &resp->timestamp);
+	    __pmLogPutIndex(&archctl, FR_STAMP(fr));
 	    /*
 	     * ... and put them back
 	     */
 	    __pmFseek(archctl.ac_mfp, new_offset, SEEK_SET);
 	    __pmFseek(logctl.mdfp, new_meta_offset, SEEK_SET);
-	    flushsize = __pmFtell(archctl.ac_mfp) + 100000;
+	    flushsize = __pmFtell(archctl.ac_mfp) + index_bytes;
 	}
 
-	last_stamp = resp->timestamp;	/* struct assignment */
+	last_stamp = *FR_STAMP(fr);	/* struct assignment */
 
-	if (lfp->lf_resp != NULL) {
-	    /*
-	     * release memory that is allocated in pmDecodeResult
-	     */
-	    __pmFreeResult(lfp->lf_resp);
-	}
-	lfp->lf_resp = resp;
+	/* this result is now the last one, reuse the space of the old one */
+	tmp = lfp->lf_res;		/* struct assignment */
+	lfp->lf_res = *fr;		/* struct assignment */
+	*fr = tmp;			/* struct assignment */
+	fr_release(fr);
     }
 
     if (rflag && tp->t_size == 0 && pdu_metrics > 0) {
@@ -1128,7 +1269,7 @@ do_work(task_t *tp)
 	run_done(0, "Sample limit reached");
 
     if (exit_bytes != -1 && 
-        (vol_bytes + __pmFtell(archctl.ac_mfp) >= exit_bytes)) 
+        (vol_bytes + logoffset() >= exit_bytes)) 
         /* reached exit_bytes limit, so stop logging */
         run_done(0, "Byte limit reached");
 
@@ -1140,7 +1281,7 @@ do_work(task_t *tp)
     }
 
     if (vol_switch_bytes > 0 &&
-        (__pmFtell(archctl.ac_mfp) >= vol_switch_bytes)) {
+        (logoffset() >= vol_switch_bytes)) {
         (void)newvolume(VOL_SW_BYTES);
 	if (pmDebugOptions.appl2)
 	    pmNotifyErr(LOG_INFO, "callback: new volume based on size (%d)", (int)__pmFtell(archctl.ac_mfp));
@@ -1151,10 +1292,13 @@ int
 putmark(void)
 {
     __pmTimestamp	msec = { 0, 1000000 };		/* 1msec */
+    int			sts;
 
     if (last_stamp.sec == 0 && last_stamp.nsec == 0)
 	/* no earlier result, no point adding a mark record */
 	return 0;
 
+    if ((sts = flushresults()) < 0)
+	return sts;
     return __pmLogWriteMark(&archctl, &last_stamp, &msec);
 }
@@ -45,42 +45,199 @@ myLocalFetch(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult **resul
     return 0;
 }
 
-int
-myFetch(int numpmid, pmID pmidlist[], __pmResult **result)
-{
-    int			n = 0;
-    int			fd; /* pmcd */
-    int			sts;
-    int			changed = 0;
-    int			ctx;
-    __pmPDU		*pb;
-    __pmContext		*ctxp;
+/*
+ * Pipelined fetches (-Q) ... when several fetch groups are due at the
+ * same time, pipefetch() sends their PDU_FETCHes to pmcd back to back,
+ * with up to "pipeline" of them outstanding, rather than one at a time
+ * from myFetch().  pmcd answers in order, and every reply is received
+ * before control returns to the main loop, so the replies are waiting
+ * when myFetch() is called for each fetch group from do_work(), and
+ * other PDU traffic with pmcd (metadata, pmlc requests) never sees a
+ * reply it does not expect.
+ */
+int		pipeline;		/* -Q max fetches in flight, 0 for off */
 
-    if (numpmid < 1)
-	return PM_ERR_TOOSMALL;
+typedef struct {
+    pmID		*pmidlist;	/* fetch group, matched in myFetch() */
+    int			numpmid;
+    int			highres;
+    int			sts;		/* from getresult() */
+    int			changed;	/* PMCD state changes */
+    __pmPDU		*pb;		/* pinned result PDU */
+    struct timeval	sent;
+} pipefetch_t;
+
+static pipefetch_t	*pipe_list;
+static int		pipe_max;
+static int		pipe_next;	/* next to be used by myFetch() */
+static int		pipe_recv;	/* next reply to be received */
+static int		pipe_count;
 
-    if ((ctx = pmWhichContext()) >= 0) {
-	ctxp = __pmHandleToPtr(ctx);
-	if (ctxp == NULL)
-	    return PM_ERR_NOCONTEXT;
+/*
+ * Wait for the reply to a fetch, following any PMCD state change
+ * PDU_ERRORs.  Returns the PDU type with the result PDU (pinned)
+ * in *pbp, else a negative status after disconnecting.
+ */
+static int
+getresult(int fd, int highres, __pmPDU **pbp, int *changed)
+{
+    __pmPDU	*pb;
+    int		n;
+    int		sts;
+
+    do {
+	n = __pmGetPDU(fd, ANY_SIZE, TIMEOUT_DEFAULT, &pb);
 	/*
-	 * Note: This application is single threaded, and once we have ctxp
-	 *	 the associated __pmContext will not move and will only be
-	 *	 accessed or modified synchronously either here or in libpcp.
-	 *	 We unlock the context so that it can be locked as required
-	 *	 within libpcp.
+	 * expect PDU_[HIGHRES_]RESULT or
+	 *        PDU_ERROR(changed > 0)+PDU_[HIGHRES_]RESULT or
+	 *        PDU_ERROR(real error < 0 from PMCD) or
+	 *        0 (end of file)
+	 *        < 0 (local error or IPC problem)
+	 *        other (bogus PDU)
 	 */
-	PM_UNLOCK(ctxp->c_lock);
-	if (ctxp->c_type != PM_CONTEXT_HOST) {
-	    if (ctxp->c_type == PM_CONTEXT_LOCAL)
-		return myLocalFetch(ctxp, numpmid, pmidlist, result);
-	    return PM_ERR_NOTHOST;
+
+	if (pmDebugOptions.fetch) {
+	    fprintf(stderr, "myFetch returns ...\n");
+	    if (n == PDU_ERROR) {
+		int		flag = 0;
+
+		__pmDecodeError(pb, &sts);
+		fprintf(stderr, "PMCD state changes: ");
+		if (sts & PMCD_AGENT_CHANGE) {
+		    fprintf(stderr, "agent(s)");
+		    if (sts & PMCD_ADD_AGENT) fprintf(stderr, " added");
+		    if (sts & PMCD_RESTART_AGENT) fprintf(stderr, " restarted");
+		    if (sts & PMCD_DROP_AGENT) fprintf(stderr, " dropped");
+		    flag++;
+		}
+		if (sts & PMCD_LABEL_CHANGE) {
+		    if (flag++)
+			fprintf(stderr, ", ");
+		    fprintf(stderr, "label change");
+		}
+		if (sts & PMCD_NAMES_CHANGE) {
+		    if (flag++)
+			fprintf(stderr, ", ");
+		    fprintf(stderr, "names change");
+		}
+		if (sts & PMCD_HOSTNAME_CHANGE) {
+		    if (flag++)
+			fprintf(stderr, ", ");
+		    fprintf(stderr, "hostname change");
+		}
+		fputc('\n', stderr);
+	    }
+	    else if (n == PDU_HIGHRES_RESULT && !highres)
+		fprintf(stderr, "__pmGetPDU: bad PDU_HIGHRES_RESULT\n");
+	    else if (n == PDU_RESULT && highres)
+		fprintf(stderr, "__pmGetPDU: bad PDU_RESULT\n");
+	    else
+		fprintf(stderr, "__pmGetPDU: Error: %s\n", pmErrStr(n));
 	}
-    }
+
+	if ((n == PDU_HIGHRES_RESULT && highres) ||
+	    (n == PDU_RESULT && !highres)) {
+	    /* Success with a result in a PDU buffer */
+	    *pbp = pb;
+	}
+	else if (n == PDU_ERROR) {
+	    __pmDecodeError(pb, &n);
+	    if (n > 0) {
+		/* PMCD state change protocol */
+		*changed = n;
+		n = 0;
+	    }
+	    else {
+		fprintf(stderr, "myFetch: ERROR PDU: %s\n", pmErrStr(n));
+		disconnect(PM_ERR_IPC);
+		*changed = 0;
+	    }
+	    __pmUnpinPDUBuf(pb);
+	}
+	else if (n == 0) {
+	    fprintf(stderr, "myFetch: End of File: PMCD exited?\n");
+	    disconnect(PM_ERR_IPC);
+	    n = PM_ERR_IPC;
+	    *changed = 0;
+	}
+	else if (n == -EINTR) {
+	    /* SIGINT, let the normal cleanup happen */
+	    ;
+	}
+	else if (n < 0) {
+	    /* other badness, disconnect */
+	    fprintf(stderr, "myFetch: __pmGetPDU: Error: %s\n", pmErrStr(n));
+	    disconnect(PM_ERR_IPC);
+	    *changed = 0;
+	}
+	else {
+	    /* protocol botch, disconnect */
+	    fprintf(stderr, "myFetch: Unexpected %s PDU from PMCD\n", __pmPDUTypeStr(n));
+	    __pmDumpPDUTrace(stderr);
+	    disconnect(PM_ERR_IPC);
+	    *changed = 0;
+	    __pmUnpinPDUBuf(pb);
+	    n = PM_ERR_IPC;
+	}
+    } while (n == 0);
+
+    return n;
+}
+
+static int
+decoderesult(__pmContext *ctxp, int type, int have_dm, __pmPDU *pb,
+		__pmResult **result, __pmResultView *view)
+{
+    int		sts;
+
+    PM_LOCK(ctxp->c_lock);
+    if (view != NULL && !have_dm)
+	/* view holds its own pin on pb */
+	sts = __pmDecodeResultView(pb, view);
     else
+	sts = (type == PDU_RESULT) ?
+		__pmDecodeResult_ctx(ctxp, pb, result) :
+		__pmDecodeHighResResult_ctx(ctxp, pb, result);
+    __pmUnpinPDUBuf(pb);
+    if (sts >= 0 && have_dm)
+	__pmFinishResult(ctxp, sts, result);
+    PM_UNLOCK(ctxp->c_lock);
+    return sts < 0 ? sts : type;
+}
+
+/*
+ * Current context, if it is a host context that is connected to pmcd,
+ * sending the profile if that is needed.  Returns the pmcd fd, else
+ * a negative status (and *ctxpp is still set for a local context).
+ */
+static int
+getpmcd(__pmContext **ctxpp, int reconn)
+{
+    __pmContext		*ctxp;
+    int			ctx;
+    int			fd;
+    int			n;
+
+    *ctxpp = NULL;
+    if ((ctx = pmWhichContext()) < 0)
 	return PM_ERR_NOCONTEXT;
+    if ((ctxp = __pmHandleToPtr(ctx)) == NULL)
+	return PM_ERR_NOCONTEXT;
+    /*
+     * Note: This application is single threaded, and once we have ctxp
+     *	 the associated __pmContext will not move and will only be
+     *	 accessed or modified synchronously either here or in libpcp.
+     *	 We unlock the context so that it can be locked as required
+     *	 within libpcp.
+     */
+    PM_UNLOCK(ctxp->c_lock);
+    *ctxpp = ctxp;
+    if (ctxp->c_type != PM_CONTEXT_HOST)
+	return PM_ERR_NOTHOST;
 
     if ((fd = ctxp->c_pmcd->pc_fd) < 0) {
+	if (!reconn)
+	    return PM_ERR_IPC;
 	/* lost connection, try to get it back */
 	n = reconnect();
 	if (n < 0)
@@ -95,16 +252,187 @@ myFetch(int numpmid, pmID pmidlist[], __pmResult **result)
 	 */
 	if (pmDebugOptions.profile)
 	    fprintf(stderr, "myFetch: calling __pmSendProfile, context: %d\n", ctx);
-	if ((n = __pmSendProfile(fd, FROM_ANON, ctx, ctxp->c_instprof)) >= 0)
-	    ctxp->c_sent = 1;
+	if ((n = __pmSendProfile(fd, FROM_ANON, ctx, ctxp->c_instprof)) < 0)
+	    return n;
+	ctxp->c_sent = 1;
     }
+    return fd;
+}
+
+static int
+sendfetch(int fd, int numpmid, pmID pmidlist[], int *highres)
+{
+    int		pdutype;
 
-    if (n >= 0) {
+    if ((__pmFeaturesIPC(fd) & PDU_FLAG_HIGHRES)) {
+	pdutype = PDU_HIGHRES_FETCH;
+	*highres = 1;
+    } else {
+	pdutype = PDU_FETCH;
+	*highres = 0;
+    }
+    return __pmSendFetchPDU(fd, FROM_ANON, pmWhichContext(), numpmid,
+			    pmidlist, pdutype);
+}
+
+/*
+ * Receive the oldest outstanding pipelined reply.
+ */
+static int
+piperecv(int fd)
+{
+    pipefetch_t	*pp = &pipe_list[pipe_recv];
+
+    pp->changed = 0;
+    pp->sts = getresult(fd, pp->highres, &pp->pb, &pp->changed);
+    pipe_recv++;
+    return pp->sts;
+}
+
+/*
+ * Drop any pipelined replies not used by myFetch(), e.g. the fetch
+ * group went away or the connection to pmcd was lost.
+ */
+void
+pipediscard(void)
+{
+    int		i;
+
+    for (i = pipe_next; i < pipe_recv; i++) {
+	if (pipe_list[i].sts > 0)
+	    __pmUnpinPDUBuf(pipe_list[i].pb);
+    }
+    pipe_next = pipe_recv = pipe_count = 0;
+}
+
+/*
+ * Send a fetch for this fetch group (the profile has already been set)
+ * ahead of the myFetch() call for it.  Returns 0 if the fetch is
+ * in flight, else myFetch() will do this fetch itself.  The caller
+ * must call pipesync() once all the fetches have been sent.
+ */
+int
+pipefetch(int numpmid, pmID pmidlist[])
+{
+    __pmContext		*ctxp;
+    pipefetch_t		*pp;
+    int			fd;
+    int			sts;
+
+    if (pipeline < 1 || numpmid < 1)
+	return PM_ERR_TOOSMALL;
+    if ((fd = getpmcd(&ctxp, 0)) < 0)
+	return fd;
+
+    if (pipe_count == pipe_max) {
+	int		need = pipe_max ? pipe_max * 2 : 16;
+	pipefetch_t	*tmp_list;
+
+	tmp_list = (pipefetch_t *)realloc(pipe_list, need * sizeof(pipe_list[0]));
+	if (tmp_list == NULL) {
+	    pmNoMem("pipefetch: realloc", need * sizeof(pipe_list[0]), PM_FATAL_ERR);
+	    /* NOTREACHED */
+	}
+	pipe_list = tmp_list;
+	pipe_max = need;
+    }
+
+    /* keep no more than "pipeline" fetches in flight */
+    if (pipe_count - pipe_recv >= pipeline) {
+	if ((sts = piperecv(fd)) < 0)
+	    return sts;
+    }
+
+    pp = &pipe_list[pipe_count];
+    pp->pmidlist = pmidlist;
+    pp->numpmid = numpmid;
+    pmtimevalNow(&pp->sent);
+    if ((sts = sendfetch(fd, numpmid, pmidlist, &pp->highres)) < 0)
+	return sts;
+    pipe_count++;
+    countpipelined();
+    return 0;
+}
+
+/*
+ * Receive the replies to all pipelined fetches.
+ */
+void
+pipesync(void)
+{
+    __pmContext	*ctxp;
+    int		fd;
+
+    while (pipe_recv < pipe_count) {
+	if ((fd = getpmcd(&ctxp, 0)) < 0 || piperecv(fd) < 0) {
+	    /* connection is gone, so are any other replies */
+	    pipe_count = pipe_recv;
+	    break;
+	}
+    }
+}
+
+/*
+ * If view is not NULL, the caller can use a view of the result PDU
+ * from pmcd (see __pmDecodeResultView), and this is done unless
+ * derived metrics or a local context need a decoded result.
+ * On success, *result is NULL if the view was used, and *sent is
+ * when the fetch was sent to pmcd.
+ */
+int
+myFetch(int numpmid, pmID pmidlist[], __pmResult **result,
+	__pmResultView *view, struct timeval *sent)
+{
+    int			n = 0;
+    int			fd; /* pmcd */
+    int			sts;
+    int			changed = 0;
+    int			i;
+    __pmPDU		*pb = NULL;
+    __pmContext		*ctxp;
+
+    if (numpmid < 1)
+	return PM_ERR_TOOSMALL;
+    *result = NULL;
+    pmtimevalNow(sent);
+
+    /* a pipelined reply for this fetch group? */
+    for (i = pipe_next; i < pipe_recv; i++) {
+	if (pipe_list[i].pmidlist == pmidlist &&
+	    pipe_list[i].numpmid == numpmid)
+	    break;
+    }
+    if (i < pipe_recv) {
+	/* earlier replies are for fetch groups that have gone away */
+	for ( ; pipe_next < i; pipe_next++) {
+	    if (pipe_list[pipe_next].sts > 0)
+		__pmUnpinPDUBuf(pipe_list[pipe_next].pb);
+	}
+	if ((fd = getpmcd(&ctxp, 0)) == PM_ERR_NOCONTEXT)
+	    return fd;
+	pipe_next++;
+	*sent = pipe_list[i].sent;
+	changed = pipe_list[i].changed;
+	if ((n = pipe_list[i].sts) > 0) {
+	    pb = pipe_list[i].pb;
+	    n = decoderesult(ctxp, n, 0, pb, result, view);
+	}
+    }
+    else if ((fd = getpmcd(&ctxp, 1)) == PM_ERR_NOTHOST) {
+	if (ctxp->c_type == PM_CONTEXT_LOCAL)
+	    return myLocalFetch(ctxp, numpmid, pmidlist, result);
+	return fd;
+    }
+    else if (fd < 0) {
+	if (fd == PM_ERR_NOCONTEXT)
+	    return fd;
+	n = fd;
+    }
+    else {
 	pmID		*newlist = NULL;
 	int		newcnt;
 	int		have_dm;
 	int		highres;
-	int		pdutype;
 
 	/* for derived metrics, may need to rewrite the pmidlist */
 	have_dm = newcnt = __pmPrepareFetch(ctxp, numpmid, pmidlist, &newlist);
@@ -114,180 +442,10 @@ myFetch(int numpmid, pmID pmidlist[], __pmResult **result)
 	    pmidlist = newlist;
 	}
 
-	if ((__pmFeaturesIPC(fd) & PDU_FLAG_HIGHRES)) {
-	    pdutype = PDU_HIGHRES_FETCH;
-	    highres = 1;
-	} else {
-	    pdutype = PDU_FETCH;
-	    highres = 0;
-	}
-	n = __pmSendFetchPDU(fd, FROM_ANON, ctx, numpmid, pmidlist, pdutype);
+	n = sendfetch(fd, numpmid, pmidlist, &highres);
 	if (n >= 0) {
-	    do {
-		n = __pmGetPDU(fd, ANY_SIZE, TIMEOUT_DEFAULT, &pb);
-		/*
-		 * expect PDU_[HIGHRES_]RESULT or
-		 *        PDU_ERROR(changed > 0)+PDU_[HIGHRES_]RESULT or
-		 *        PDU_ERROR(real error < 0 from PMCD) or
-		 *        0 (end of file)
-		 *        < 0 (local error or IPC problem)
-		 *        other (bogus PDU)
-		 */
-
-		if (pmDebugOptions.fetch) {
-		    fprintf(stderr, "myFetch returns ...\n");
-		    if (n == PDU_ERROR) {
-			int		flag = 0;
-
-			__pmDecodeError(pb, &sts);
-			fprintf(stderr, "PMCD state changes: ");
-			if (sts & PMCD_AGENT_CHANGE) {
-			    fprintf(stderr, "agent(s)");
-			    if (sts & PMCD_ADD_AGENT) fprintf(stderr, " added");
-			    if (sts & PMCD_RESTART_AGENT) fprintf(stderr, " restarted");
-			    if (sts & PMCD_DROP_AGENT) fprintf(stderr, " dropped");
-			    flag++;
-			}
-			if (sts & PMCD_LABEL_CHANGE) {
-			    if (flag++)
-				fprintf(stderr, ", ");
-			    fprintf(stderr, "label change");
-			}
-			if (sts & PMCD_NAMES_CHANGE) {
-			    if (flag++)
-				fprintf(stderr, ", ");
-			    fprintf(stderr, "names change");
-			}
-			if (sts & PMCD_HOSTNAME_CHANGE) {
-			    if (flag++)
-				fprintf(stderr, ", ");
-			    fprintf(stderr, "hostname change");
-			}
-			fputc('\n', stderr);
-		    }
-		    else if (n == PDU_HIGHRES_RESULT && !highres)
-			fprintf(stderr, "__pmGetPDU: bad PDU_HIGHRES_RESULT\n");
-		    else if (n == PDU_RESULT && highres)
-			fprintf(stderr, "__pmGetPDU: bad PDU_RESULT\n");
-		    else
-			fprintf(stderr, "__pmGetPDU: Error: %s\n", pmErrStr(n));
-		}
-
-		if ((n == PDU_HIGHRES_RESULT && highres) ||
-		    (n == PDU_RESULT && !highres)) {
-		    /* Success with a result in a PDU buffer */
-		    PM_LOCK(ctxp->c_lock);
-		    sts = (n == PDU_RESULT) ?
-			    __pmDecodeResult_ctx(ctxp, pb, result) :
-			    __pmDecodeHighResResult_ctx(ctxp, pb, result);
-		    __pmUnpinPDUBuf(pb);
-		    if (sts < 0)
-			n = sts;
-		    else if (have_dm)
-			__pmFinishResult(ctxp, sts, result);
-		    PM_UNLOCK(ctxp->c_lock);
-		}
-		else if (n == PDU_ERROR) {
-		    __pmDecodeError(pb, &n);
-		    if (n > 0) {
-			/* PMCD state change protocol */
-			changed = n;
-			n = 0;
-		    }
-		    else {
-			fprintf(stderr, "myFetch: ERROR PDU: %s\n", pmErrStr(n));
-			disconnect(PM_ERR_IPC);
-			changed = 0;
-		    }
-		    __pmUnpinPDUBuf(pb);
-		}
-		else if (n == 0) {
-		    fprintf(stderr, "myFetch: End of File: PMCD exited?\n");
-		    disconnect(PM_ERR_IPC);
-		    n = PM_ERR_IPC;
-		    changed = 0;
-		}
-		else if (n == -EINTR) {
-		    /* SIGINT, let the normal cleanup happen */
-		    ;
-		}
-		else if (n < 0) {
-		    /* other badness, disconnect */
-		    fprintf(stderr, "myFetch: __pmGetPDU: Error: %s\n", pmErrStr(n));
-		    disconnect(PM_ERR_IPC);
-		    changed = 0;
-		}
-		else {
-		    /* protocol botch, disconnect */
-		    fprintf(stderr, "myFetch: Unexpected %s PDU from PMCD\n", __pmPDUTypeStr(n));
-		    __pmDumpPDUTrace(stderr);
-		    disconnect(PM_ERR_IPC);
-		    changed = 0;
-		    __pmUnpinPDUBuf(pb);
-		}
-	    } while (n == 0);
-
-	    if (changed & PMCD_HOSTNAME_CHANGE) {
-		/*
-		 * Hostname changed for pmcd and we were launched from
-		 * the control-driven scripts (pmlogger_check, pmlogger_daily)
-		 * or re-exec'd, then we need to exit.
-		 *
-		 * We rely on the systemd autorestart, systemd timer,
-		 * cron or the user to restart this pmlogger at which
-		 * time one or more of the following will happen:
-		 * - the correct pmcd hostname will appear in the archive
-		 *   label record
-		 * - for a pmlogger launched from the standard
-		 *   /etc/pcp/pmlogger control files, LOCALHOSTNAME will get
-		 *   correctly re-translated into a different pathname
-		 *   (usually the directory for the archive)
-		 */
-		if (runfromcontrol) {
-		    run_done(0, "PMCD hostname changed");
-		    /* NOTREACHED */
-		}
-		pmNotifyErr(LOG_INFO, "PMCD hostname changed");
-	    }
-	    if (changed & PMCD_NAMES_CHANGE) {
-		/*
-		 * Fetch has returned with the PMCD_NAMES_CHANGE flag set.
-		 */
-		check_dynamic_metrics();
-	    }
-
-	    if (changed & PMCD_ADD_AGENT) {
-		/*
-		 * PMCD_DROP_AGENT does not matter, no values are returned.
-		 * Trying to restart (PMCD_RESTART_AGENT) is less interesting
-		 * than when we actually start (PMCD_ADD_AGENT) ... the latter
-		 * is also set when a successful restart occurs, but more
-		 * to the point the sequence Install-Remove-Install does
-		 * not involve a restart ... it is the second Install that
-		 * generates the second PMCD_ADD_AGENT that we need to be
-		 * particularly sensitive to, as this may reset counter
-		 * metrics.
-		 *
-		 * The potentially new instance of the agent may also be an
-		 * updated one, so it's PMNS could have changed. We need to
-		 * recheck each metric to make sure that its pmid and semantics
-		 * have not changed.
-		 * This call will not return if there is an incompatible change.
-		 */
-		validate_metrics();
-
-		if (changed & PMCD_ADD_AGENT) {
-		     /*
-		      * All metrics have been validated, however, the state change
-		      * PMCD_ADD_AGENT represents a potential gap in the stream of
-		      * metrics. So we generate a <mark> record for this case.
-		      */
-		    if ((sts = putmark()) < 0) {
-			fprintf(stderr, "putmark: %s\n", pmErrStr(sts));
-			exit(1);
-		    }
-		}
-	    }
+	    if ((n = getresult(fd, highres, &pb, &changed)) > 0)
+		n = decoderesult(ctxp, n, have_dm, pb, result, view);
 	}
 	else {
 	    fprintf(stderr, "Error: __pmSendFetch: %s\n", pmErrStr(n));
@@ -302,5 +460,67 @@ myFetch(int numpmid, pmID pmidlist[], __pmResult **result)
 	return n;
     }
 
+    if (changed & PMCD_HOSTNAME_CHANGE) {
+	/*
+	 * Hostname changed for pmcd and we were launched from
+	 * the control-driven scripts (pmlogger_check, pmlogger_daily)
+	 * or re-exec'd, then we need to exit.
+	 *
+	 * We rely on the systemd autorestart, systemd timer,
+	 * cron or the user to restart this pmlogger at which
+	 * time one or more of the following will happen:
+	 * - the correct pmcd hostname will appear in the archive
+	 *   label record
+	 * - for a pmlogger launched from the standard
+	 *   /etc/pcp/pmlogger control files, LOCALHOSTNAME will get
+	 *   correctly re-translated into a different pathname
+	 *   (usually the directory for the archive)
+	 */
+	if (runfromcontrol) {
+	    run_done(0, "PMCD hostname changed");
+	    /* NOTREACHED */
+	}
+	pmNotifyErr(LOG_INFO, "PMCD hostname changed");
+    }
+    if (changed & PMCD_NAMES_CHANGE) {
+	/*
+	 * Fetch has returned with the PMCD_NAMES_CHANGE flag set.
+	 */
+	check_dynamic_metrics();
+    }
+
+    if (changed & PMCD_ADD_AGENT) {
+	/*
+	 * PMCD_DROP_AGENT does not matter, no values are returned.
+	 * Trying to restart (PMCD_RESTART_AGENT) is less interesting
+	 * than when we actually start (PMCD_ADD_AGENT) ... the latter
+	 * is also set when a successful restart occurs, but more
+	 * to the point the sequence Install-Remove-Install does
+	 * not involve a restart ... it is the second Install that
+	 * generates the second PMCD_ADD_AGENT that we need to be
+	 * particularly sensitive to, as this may reset counter
+	 * metrics.
+	 *
+	 * The potentially new instance of the agent may also be an
+	 * updated one, so it's PMNS could have changed. We need to
+	 * recheck each metric to make sure that its pmid and semantics
+	 * have not changed.
+	 * This call will not return if there is an incompatible change.
+	 */
+	validate_metrics();
+
+	if (changed & PMCD_ADD_AGENT) {
+	     /*
+	      * All metrics have been validated, however, the state change
+	      * PMCD_ADD_AGENT represents a potential gap in the stream of
+	      * metrics. So we generate a <mark> record for this case.
+	      */
+	    if ((sts = putmark()) < 0) {
+		fprintf(stderr, "putmark: %s\n", pmErrStr(sts));
+		exit(1);
+	    }
+	}
+    }
+
     return changed;
 }
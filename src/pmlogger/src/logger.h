@@ -129,7 +129,14 @@ extern FILE		*yyin;
 extern char		*configfile;
 extern int		lineno;
 
-extern int myFetch(int, pmID *, __pmResult **);
+extern int myFetch(int, pmID *, __pmResult **, __pmResultView *, struct timeval *);
+
+/* pipelined fetches for -Q */
+extern int	pipeline;
+extern void prefetch(task_t *);
+extern int pipefetch(int, pmID *);
+extern void pipesync(void);
+extern void pipediscard(void);
 extern void yyerror(char *);
 extern void yywarn(char *);
 extern void yylinemarker(char *);
@@ -193,6 +200,7 @@ extern int		ctlfds[CFD_NUM];
 extern int		exit_samples;
 extern int		vol_switch_samples;
 extern __int64_t	vol_switch_bytes;
+extern __int64_t	index_bytes;
 extern int		vol_switch_flag; /* logvol switch: set on SIGHUP */
 extern int		log_switch_flag; /* archive switch: set on SIGUSR2 */
 extern int		pmlogger_reexec;
@@ -204,6 +212,18 @@ extern __int64_t	exit_bytes;
 extern __int64_t	vol_bytes;
 extern int		sig_code;
 
+/* result record writes, batched for -F */
+extern int		flush_samples;
+extern __int64_t	flush_bytes;
+extern struct timeval	flush_time;
+extern int		flush_alarm;
+extern void init_stats(void);
+extern void flush_callback(int, void *);
+extern long logoffset(void);
+extern int flushresults(void);
+extern int putresult(__pmPDU *, struct timeval *);
+extern void countpipelined(void);
+
 /* event record handling */
 extern int do_events(pmValueSet *);
 
@@ -229,7 +249,7 @@ extern int	qa_case;
 #endif
 
 /*
- * parse -v arg
+ * parse -i, -s, -v and -F args
  */
 extern int
 ParseSize(char *, int *, __int64_t *, struct timeval *);
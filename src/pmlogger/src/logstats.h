@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ * 
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+#ifndef LOGSTATS_H
+#define LOGSTATS_H
+
+#include <sys/types.h>
+#include <inttypes.h>
+
+/*
+ * subdir nested under PCP_TMP_DIR ... not the pmlogger port file
+ * directory, where every file name is expected to be a PID
+ */
+#define PMLOGGER_STATS_SUBDIR	"pmlogstats"
+
+/* pmlogger data volume write instrumentation */
+typedef struct {
+    uint64_t		bytes;		/* pmcd.pmlogger.write.bytes    */
+    uint64_t		records;	/* pmcd.pmlogger.write.records  */
+    uint64_t		flushes;	/* pmcd.pmlogger.write.flushes  */
+    uint64_t		time;		/* pmcd.pmlogger.write.time     */
+    uint64_t		latency;	/* pmcd.pmlogger.write.latency  */
+    uint64_t		pipelined;	/* pmcd.pmlogger.fetch.pipelined */
+    unsigned int	pending;	/* pmcd.pmlogger.write.pending  */
+    unsigned int	version;
+} pmloggerstats_t;
+
+#endif /* LOGSTATS_H */
@@ -306,5 +306,10 @@ do_prologue(void)
 int
 do_epilogue(void)
 {
+    int		sts;
+
+    /* the epilogue has to follow any pending results */
+    if ((sts = flushresults()) < 0)
+	return sts;
     return do_logue(EPILOGUE);
 }
@@ -39,6 +39,9 @@ __int64_t	vol_bytes;		 /* total in earlier volumes */
 struct timeval  exit_time;               /* time interval 'til exit */
 int		vol_switch_samples = -1; /* number of samples 'til vol switch */
 __int64_t	vol_switch_bytes = -1;   /* number of bytes 'til vol switch */
+__int64_t	index_bytes = 100000;	 /* data bytes between temporal index entries */
+static __pmLogPmidx pmidx;		 /* PMID sidecar index, for -X */
+static int	pmidx_flag;
 struct timeval	vol_switch_time;         /* time interval 'til vol switch */
 int		vol_samples_counter;     /* Counts samples - reset for new vol*/
 int		vol_switch_afid = -1;    /* afid of event for vol switch */
@@ -122,6 +125,10 @@ run_done(int sts, char *msg)
 	__pmLogPutIndex(&archctl, &last_stamp);
     }
 
+    if (logctl.pmidx != NULL && (lsts = __pmLogPutPmidx(archName, &logctl.label, logctl.pmidx)) < 0)
+	fprintf(stderr, "Warning: problem writing PMID sidecar index: %s\n",
+	    pmErrStr(lsts));
+
     /*
      * close the archive
      */
@@ -296,7 +303,7 @@ do_dialog(char cmd)
 	/* hack is close enough! */
 	now = 1;
 
-    archsize = vol_bytes + __pmFtell(archctl.ac_mfp);
+    archsize = vol_bytes + logoffset();
 
     nchar = add_msg(&p, 0, "");
     p[0] = '\0';
@@ -461,8 +468,10 @@ static pmLongOptions longopts[] = {
     { "directory", 1, 'd', "DIR", "create archive in this directory" },
     { "check", 0, 'C', 0, "parse configuration and exit" },
     PMOPT_DEBUG,
+    { "flush", 1, 'F', "SIZE", "batch data volume writes, flushing after SIZE" },
     PMOPT_HOST,
     { "labelhost", 1, 'H', "LABELHOST", "override the hostname written into the label" },
+    { "index-size", 1, 'i', "SIZE", "add a temporal index entry every SIZE bytes [default 100Kb]" },
     { "pmlc-ipc-version", 1, 'I', "VERSION", "set IPC version for pmlc port [defaily LOG_PDU_VERSION]" },
     { "log", 1, 'l', "FILE", "redirect diagnostics and trace output" },
     { "linger", 0, 'L', 0, "run even if not primary logger instance and nothing to log" },
@@ -473,6 +482,7 @@ static pmLongOptions longopts[] = {
     { "notify", 0, 'N', 0, "notify service manager (if any) when started and ready" },
     { "PID", 1, 'p', "PID", "Log specified metric for the lifetime of the pid" },
     { "primary", 0, 'P', 0, "execute as primary logger instance" },
+    { "pipeline", 1, 'Q', "N", "keep up to N fetches for due logging tasks in flight" },
     { "report", 0, 'r', 0, "report record sizes and archive growth rate" },
     { "size", 1, 's', "SIZE", "terminate after endsize has been accumulated" },
     { "interval", 1, 't', "DELTA", "default logging interval [default 60.0 seconds]" },
@@ -482,13 +492,15 @@ static pmLongOptions longopts[] = {
     { "volsize", 1, 'v', "SIZE", "switch log volumes after size has been accumulated" },
     { "version", 1, 'V', "NUM", "version for archive (default and only version is 2)" },
     { "", 1, 'x', "FD", "control file descriptor for running from pmRecordControl(3)" },
+    { "pmid-index", 0, 'X', 0, "also write a PMID sidecar index for the data volumes" },
     { "", 0, 'y', 0, "set timezone for times to local time rather than from PMCD host" },
+    { "compress", 0, 'z', 0, "compress data volumes with zstd as they are written" },
     PMOPT_HELP,
     PMAPI_OPTIONS_END
 };
 
 static pmOptions opts = {
-    .short_options = "c:Cd:D:fh:H:I:l:K:Lm:Nn:op:Prs:T:t:uU:v:V:x:y?",
+    .short_options = "c:Cd:D:fF:h:H:i:I:l:K:Lm:Nn:op:PQ:rs:T:t:uU:v:V:x:Xyz?",
     .long_options = longopts,
     .short_usage = "[options] archive",
 };
@@ -807,6 +819,8 @@ main(int argc, char **argv)
     int			i;
     int			suff;		/* for -NN */
     int			make_uniq = 0;	/* set if -NN suffix regime is in play */
+    int			index_samples;	/* -i, only byte size is valid */
+    struct timeval	index_time;
     task_t		*tp;
     optcost_t		ocp;
     char		*p;
@@ -912,6 +926,16 @@ main(int argc, char **argv)
 	    }
 	    break;
 
+	case 'F':		/* batch result writes, flush after given size */
+	    sts = ParseSize(opts.optarg, &flush_samples, &flush_bytes,
+			    &flush_time);
+	    if (sts < 0) {
+		pmprintf("%s: illegal size argument '%s' for flush size\n",
+			pmGetProgname(), opts.optarg);
+		opts.errors++;
+	    }
+	    break;
+
 	case 'h':		/* hostname for PMCD to contact */
 	    pmcd_host_conn = opts.optarg;
 	    break;
@@ -920,6 +944,16 @@ main(int argc, char **argv)
 	    pmcd_host_label = strndup(opts.optarg, PM_LOG_MAXHOSTLEN-1);
 	    break;
 
+	case 'i':		/* temporal index entry after given size */
+	    sts = ParseSize(opts.optarg, &index_samples, &index_bytes,
+			    &index_time);
+	    if (sts < 0 || index_bytes <= 0) {
+		pmprintf("%s: -i requires a byte size argument, e.g. 16Kb\n",
+			pmGetProgname());
+		opts.errors++;
+	    }
+	    break;
+
 	case 'I':
 	    pmlc_ipc_version = (int)strtol(opts.optarg, &endnum, 10);
 	    if (*endnum != '\0') {
@@ -995,6 +1029,15 @@ main(int argc, char **argv)
 	    isdaemon = 1;
 	    break;
 
+	case 'Q':		/* pipelined fetches */
+	    pipeline = (int)strtol(opts.optarg, &endnum, 10);
+	    if (*endnum != '\0' || pipeline < 1) {
+		pmprintf("%s: -Q requires a positive numeric argument\n",
+			pmGetProgname());
+		opts.errors++;
+	    }
+	    break;
+
 	case 'r':		/* report sizes of pmResult records */
 	    rflag = 1;
 	    break;
@@ -1064,10 +1107,21 @@ main(int argc, char **argv)
 	    }
 	    break;
 
+	case 'X':		/* PMID sidecar index */
+	    pmidx_flag = 1;
+	    break;
+
 	case 'y':
 	    use_localtime = 1;
 	    break;
 
+	case 'z':		/* seekable zstd data volumes */
+	    if ((sts = __pmLogSetCompress(".zst")) < 0) {
+		pmprintf("%s: -z not supported: %s\n", pmGetProgname(), pmErrStr(sts));
+		opts.errors++;
+	    }
+	    break;
+
 	case '?':
 	default:
 	    opts.errors++;
@@ -1417,6 +1471,8 @@ main(int argc, char **argv)
 	fprintf(stderr, "__pmLogCreate(%s, %s, ...): %s\n", pmcd_host, archName, pmErrStr(sts));
 	exit(1);
     }
+    if (pmidx_flag)
+	logctl.pmidx = &pmidx;	/* libpcp adds each record as it is written */
 
     /*
      * Get FQDN of host where pmlogger is running ... do this before
@@ -1515,6 +1571,8 @@ main(int argc, char **argv)
 
     /* set up control port socket and external map files */
     init_ports();
+    /* and the write instrumentation for the pmcd PMDA */
+    init_stats();
 
     if (pmDebugOptions.appl4)
 	pmNotifyErr(LOG_INFO, "Setup pmlc socket and map files done");
@@ -1551,6 +1609,8 @@ main(int argc, char **argv)
 					 vol_switch_callback);
     if (exit_time.tv_sec > 0)
 	__pmAFregister(&exit_time, NULL, run_done_callback);
+    if (flush_time.tv_sec > 0 || flush_time.tv_usec > 0)
+	__pmAFregister(&flush_time, NULL, flush_callback);
 
     for ( ; ; ) {
 	int		nready;
@@ -1587,6 +1647,8 @@ main(int argc, char **argv)
 		    last = tp;
 		}
 	    }
+	    /* with -Q, get the fetches for all of them under way */
+	    prefetch(alarmed);
 	    __pmAFunblock();
 
 	    /*
@@ -1624,6 +1686,8 @@ main(int argc, char **argv)
 			}
 			fputc('\n', stderr);
 		    }
+		    /* pmlc may change what is logged, refetch if so */
+		    pipediscard();
 		    control_port_ready();
 		    __pmFD_COPY(&readyfds, &fds);
 		    if (pmDebugOptions.appl2 && pmDebugOptions.desperate) {
@@ -1645,6 +1709,7 @@ main(int argc, char **argv)
 		__pmAFunblock();
 		tp->t_alarm = 0;
 	    }
+	    pipediscard();
 	}
 
 	if (vol_switch_alarm) {
@@ -1656,6 +1721,18 @@ main(int argc, char **argv)
 	    __pmAFunblock();
 	}
 
+	if (flush_alarm) {
+	    flush_alarm = 0;
+	    if (pmDebugOptions.appl2)
+		pmNotifyErr(LOG_INFO, "main: flush_alarm");
+	    __pmAFblock();
+	    if ((nready = flushresults()) < 0) {
+		fprintf(stderr, "flushresults: %s\n", pmErrStr(nready));
+		exit(1);
+	    }
+	    __pmAFunblock();
+	}
+
 	if (run_done_alarm) {
 	    if (pmDebugOptions.appl2)
 		pmNotifyErr(LOG_INFO, "main: run_done_alarm");
@@ -1718,12 +1795,17 @@ newvolume(int vol_switch_type)
 {
     __pmFILE	*newfp;
     int		nextvol = archctl.ac_curvol + 1;
+    int		sts;
     time_t	now;
     static char *vol_sw_strs[] = {
        "SIGHUP", "pmlc request", "sample counter",
        "sample byte size", "sample time", "max data volume size"
     };
 
+    /* pending records belong in the old volume */
+    if ((sts = flushresults()) < 0)
+	return sts;
+
     vol_samples_counter = 0;
     vol_bytes += __pmFtell(archctl.ac_mfp);
     if (exit_bytes != -1) {
@@ -1773,6 +1855,10 @@ newvolume(int vol_switch_type)
 	archctl.ac_mfp = newfp;
 	logctl.label.vol = archctl.ac_curvol = nextvol;
 	__pmLogWriteLabel(archctl.ac_mfp, &logctl.label);
+
+	/* the sidecar now covers every completed volume */
+	if (logctl.pmidx != NULL)
+	    __pmLogPutPmidx(archName, &logctl.label, logctl.pmidx);
 	time(&now);
 	fprintf(stderr, "New log volume %d, via %s at %s",
 		nextvol, vol_sw_strs[vol_switch_type], ctime(&now));
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * pmlogindex - build the PMID sidecar index (<archive>.pmidx) for an
+ * existing archive, see e_pmidx.c in libpcp
+ */
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include <assert.h>
+
+static int	vflag;
+
+static pmLongOptions longopts[] = {
+    PMAPI_OPTIONS_HEADER("Options"),
+    PMOPT_DEBUG,
+    { "verbose", 0, 'v', 0, "report the size of each index built" },
+    PMOPT_HELP,
+    PMAPI_OPTIONS_END
+};
+
+static pmOptions opts = {
+    .short_options = "D:v?",
+    .long_options = longopts,
+    .short_usage = "[options] archive [...]",
+};
+
+static int
+do_index(const char *archive)
+{
+    __pmContext		*ctxp;
+    __pmArchCtl		*acp;
+    __pmResult		*rp;
+    __pmLogPmidx	pmidx;
+    off_t		off, end;
+    int			ctx, vol, nvol;
+    int			recno;
+    int			i, sts;
+
+    if ((ctx = pmNewContext(PM_CONTEXT_ARCHIVE, archive)) < 0) {
+	fprintf(stderr, "%s: Error: cannot open archive \"%s\": %s\n",
+		pmGetProgname(), archive, pmErrStr(ctx));
+	return 1;
+    }
+    ctxp = __pmHandleToPtr(ctx);
+    assert(ctxp != NULL);
+    /*
+     * single threaded, so we can unlock the context and let libpcp
+     * lock it as required below __pmLogRead_ctx()
+     */
+    PM_UNLOCK(ctxp->c_lock);
+    acp = ctxp->c_archctl;
+    if (acp->ac_num_logs > 1) {
+	fprintf(stderr, "%s: Error: \"%s\" is a multi-archive context, index each archive separately\n",
+		pmGetProgname(), archive);
+	pmDestroyContext(ctx);
+	return 1;
+    }
+
+    memset(&pmidx, 0, sizeof(pmidx));
+    vol = acp->ac_curvol;
+    nvol = 1;
+    for ( ; ; ) {
+	off = __pmFtell(acp->ac_mfp);
+	sts = __pmLogRead_ctx(ctxp, PM_MODE_FORW, NULL, &rp, PMLOGREAD_NEXT);
+	if (sts < 0)
+	    break;
+	if (acp->ac_curvol != vol) {
+	    /* volume switch, record starts after the new volume's label */
+	    vol = acp->ac_curvol;
+	    off = __pmLogLabelSize(acp->ac_log);
+	    nvol++;
+	}
+	end = __pmFtell(acp->ac_mfp);
+	if ((recno = sts = __pmLogPmidxAddRecord(&pmidx, vol, off, (int)(end - off))) >= 0) {
+	    if (rp->numpmid == 0)
+		sts = __pmLogPmidxAddPMID(&pmidx, recno, PM_ID_NULL);
+	    for (i = 0; sts >= 0 && i < rp->numpmid; i++)
+		sts = __pmLogPmidxAddPMID(&pmidx, recno, rp->vset[i]->pmid);
+	}
+	__pmFreeResult(rp);
+	if (sts < 0)
+	    break;
+    }
+    if (sts != PM_ERR_EOL) {
+	fprintf(stderr, "%s: Error: archive \"%s\" vol %d offset %ld: %s\n",
+		pmGetProgname(), archive, vol, (long)off, pmErrStr(sts));
+	sts = 1;
+    }
+    else if ((sts = __pmLogPutPmidx(acp->ac_log->name, &acp->ac_log->label, &pmidx)) < 0) {
+	fprintf(stderr, "%s: Error: cannot write %s.pmidx: %s\n",
+		pmGetProgname(), acp->ac_log->name, pmErrStr(sts));
+	sts = 1;
+    }
+    else {
+	if (vflag)
+	    printf("%s.pmidx: %d records in %d volume%s, %d metrics\n",
+		    acp->ac_log->name, pmidx.nrec, nvol, nvol == 1 ? "" : "s",
+		    pmidx.nmetric);
+	sts = 0;
+    }
+
+    __pmLogFreePmidx(&pmidx);
+    pmDestroyContext(ctx);
+    return sts;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int		c;
+    int		sts = 0;
+
+    while ((c = pmGetOptions(argc, argv, &opts)) != EOF) {
+	switch (c) {
+	case 'v':	/* report index sizes */
+	    vflag++;
+	    break;
+	}
+    }
+
+    if (!opts.errors && opts.optind >= argc) {
+	fprintf(stderr, "Error: no archive specified\n\n");
+	opts.errors++;
+    }
+
+    if (opts.errors) {
+	pmUsageMessage(&opts);
+	exit(EXIT_FAILURE);
+    }
+
+    while (opts.optind < argc)
+	sts |= do_index(argv[opts.optind++]);
+
+    exit(sts);
+}